@@ -4,7 +4,9 @@ esp_timer_handle_t trigger_timer_handle = NULL;
 TaskHandle_t ping_timer_task_handle = NULL;
 
 void trigger_timer_callback(void *arg) {
+    int64_t firedAt = esp_timer_get_time();
     Device *dev = static_cast<Device *>(arg);
+    dev->recordTriggerFired(firedAt);
     dev->setTriggerTimerFlag(true);
     dev->timer_on = false;
     if(dev->isTransmitter()) {
@@ -35,32 +37,34 @@ void ping_timer_task(void *pvParams) {
     }
 }
 
-BaseType_t Device::processHandshake(const char* data) {
-    Serial.println("Handshake Received.");
+BaseType_t Device::processHandshake(const ESP_NOW_PACKET* packet) {
+    // Built without the heap since this runs on the ESP-NOW processing task.
+    NEGOTIATED_SETTINGS settings = node->getNegotiatedSettings();
+    char line[128];
+    snprintf(line, sizeof(line), "Handshake Received. Protocol v%u, features 0x%04x, ping >= %u ms, read %u ms, payload %u B%s.\n",
+        settings.protocolVersion, settings.features, settings.minPingInterval, settings.readTime, settings.maxPayload,
+        settings.channelMatch ? "" : ", channel mismatch");
+    Serial.print(line);
     return pdPASS;
 }
 
-BaseType_t Device::processWave(const char* data) {
+BaseType_t Device::processWave(const ESP_NOW_PACKET* packet) {
     Serial.println("Wave Received.");
     return pdPASS;
 }
 
-BaseType_t Device::processInfoReceived(const char* data) {
+BaseType_t Device::processInfoReceived(const ESP_NOW_PACKET* packet) {
     // Notify the timer tasks if the device is the 
     if(!deviceIsTx) 
         if(trigger_timer_handle == NULL) log_e("Trigger Timer Not Created.");
-        else {
-            if(!timer_on) startOneshotEspTimer(triggerTimerDelay);
-        }
+        else armTrigger(packet);
     return pdPASS;
 }
 
-BaseType_t Device::processDataSent(const char* data) {
+BaseType_t Device::processDataSent(const ESP_NOW_PACKET* packet) {
     if(deviceIsTx) 
         if(trigger_timer_handle == NULL) log_e("Trigger Timer Not Created.");
-        else {
-            if(!timer_on) startOneshotEspTimer(triggerTimerDelay);
-        }
+        else armTrigger(packet);
     return pdPASS;
 }
 
@@ -74,6 +78,176 @@ void Device::startPeripheralManager()  {
     manager->beginTasks();
     manager->initUS();
     manager->attachInterrupts();
+    manager->applyConfig(*config);
+}
+
+void Device::initConfig(Mode mode) {
+    // Every device starts from the same compile time defaults, then shares what changes.
+    config = new ConfigStore((mode == Mode::Transmitter) ? 0 : 1);
+    config->setDefault(cfg_TRIGGER_DELAY, TTR_US);
+    config->setDefault(cfg_OBSTACLE_LIMIT, OBS_LIM);
+    config->setDefault(cfg_PRESENCE_LIMIT, DEF_HP_EST_LIM);
+    config->setDefault(cfg_PRESENCE_DIFF, HPE_PERCENT_DIFF);
+    config->setDefault(cfg_PRESENCE_WEAK, HPE_WEAK_PERCENT);
+    config->setDefault(cfg_PRESENCE_STRONG, HPE_STRONG_PERCENT);
+    config->setListener(&Device::onConfigChanged, this);
+    tx->attachConfigStore(config);
+}
+
+void Device::onConfigChanged(ConfigKey key, float value, void *context) {
+    Device *device = static_cast<Device *>(context);
+
+    // The trigger delay sets the timer and the lead of scheduled triggers.
+    if(key == cfg_TRIGGER_DELAY) {
+        triggerTimerDelay = (uint64_t) value;
+        if(trigger_timer_handle != NULL) node->enableScheduledTriggers(triggerTimerDelay * 1000, TRIGGER_PERIOD_MS * 1000);
+    }
+    else device->manager->applyConfig(*device->config);
+
+    // Built without the heap since this can run on the ESP-NOW processing task.
+    char line[64];
+    snprintf(line, sizeof(line), "Config %s = %.2f\n", ConfigStore::name(key), value);
+    Serial.print(line);
+}
+
+bool Device::setConfig(const char *name, float value) {
+    ConfigKey key;
+    if(!ConfigStore::keyOf(name, &key)) return false;
+    return tx->setConfig(key, value);
+}
+
+bool Device::sendCommand(const char *name, float value) {
+    CommandType type;
+    if(!CommandQueue::typeOf(name, &type)) return false;
+    return tx->sendCommand(type, value) != 0;
+}
+
+BaseType_t Device::processCommand(const COMMAND_ENTRY* command) {
+    // Carried out before anything is printed, since the stop latency is timed from here.
+    commandTarget->executeCommand(*command);
+
+    // Built without the heap since this runs on the ESP-NOW tasks.
+    char line[64];
+    snprintf(line, sizeof(line), "Command %s %.2f\n", CommandQueue::name((CommandType) command->type), command->value);
+    Serial.print(line);
+    return pdPASS;
+}
+
+void Device::pollSerialCommands() {
+    // Lines are config writes of the form `name=value`, e.g. `obstacle_in=24`, or commands for
+    // the peer, e.g. `stop` or `speed_cap=128`.
+    while(Serial.available() > 0) {
+        char c = Serial.read();
+        if(c != '\n' && c != '\r') {
+            if(commandLength < sizeof(command) - 1) command[commandLength++] = c;
+            continue;
+        }
+        if(commandLength == 0) continue;
+        command[commandLength] = '\0';
+        commandLength = 0;
+
+        char *equals = strchr(command, '=');
+        float value = 0;
+        if(equals != NULL) {
+            *equals = '\0';
+            value = strtof(equals + 1, NULL);
+        }
+        if(sendCommand(command, value)) continue;
+        if(equals == NULL) Serial.printf("Command %s unknown.\n", command);
+        else if(!setConfig(command, value)) Serial.printf("Config %s unknown or unchanged.\n", command);
+    }
+}
+
+BaseType_t Device::processTelemetry(const ESP_NOW_PACKET* packet) {
+    TELEMETRY_SAMPLE samples[TELEMETRY_MAX_BATCH];
+    int64_t baseTime;
+    uint8_t count = TelemetryPacker::readBatch(packet, &baseTime, samples, TELEMETRY_MAX_BATCH);
+
+    // Map the peer's timestamps into this device's clock when possible.
+    if(node->isClockSynchronized()) baseTime = node->fromPeerTime(baseTime);
+    for(uint8_t i = 0; i < count; i++) {
+        // Feed the ping rate governor the range to the target, averaged over whichever receivers measured it.
+        int64_t sampleTime = baseTime + samples[i].timeOffset;
+        int16_t left = samples[i].leftDistance, right = samples[i].rightDistance;
+        if(left != TELEMETRY_NO_VALUE && right != TELEMETRY_NO_VALUE) node->observeTargetRange(sampleTime, (left + right) / 200.0f);
+        else if(left != TELEMETRY_NO_VALUE) node->observeTargetRange(sampleTime, left / 100.0f);
+        else if(right != TELEMETRY_NO_VALUE) node->observeTargetRange(sampleTime, right / 100.0f);
+        if(samples[i].bearing != TELEMETRY_NO_VALUE) node->observeTargetBearing(sampleTime, samples[i].bearing / 100.0f);
+
+        // Format on the stack; Serial.printf allocates for lines over 64 characters.
+        char line[128];
+        snprintf(line, sizeof(line), "Telemetry %lld: Left: %d, Right: %d, Bearing: %d, Motors: %d/%d, Obstacles: 0x%02x\n",
+                (long long) sampleTime,
+                samples[i].leftDistance,
+                samples[i].rightDistance,
+                samples[i].bearing,
+                samples[i].leftMotor,
+                samples[i].rightMotor,
+                samples[i].obstacleFlags
+            );
+        Serial.print(line);
+    }
+    return pdPASS;
+}
+
+void Device::requestPing() { tx->requestPing(); }
+
+void Device::recordTelemetry(const TELEMETRY_SAMPLE &sample) {
+    tx->queueTelemetry(sample);
+}
+
+esp_err_t Device::armTrigger(const ESP_NOW_PACKET* packet) {
+    // Frames without a trigger announcement only keep the clocks in sync.
+    TRIGGER_RECORD trigger;
+    if(!readRecord(packet, RecordType::rec_TRIGGER, &trigger, sizeof(trigger))) return ESP_OK;
+
+    // The belt announces in its own clock. The bot maps it over once synchronized, 
+    // and until then falls back on a delay relative to this callback.
+    int64_t fireAt;
+    if(deviceIsTx) fireAt = trigger.fireAt;
+    else if(node->isClockSynchronized()) fireAt = node->fromPeerTime(trigger.fireAt);
+    else {
+        if(timer_on) return ESP_OK;
+        pendingTriggerId = 0;
+        return startOneshotEspTimer(triggerTimerDelay);
+    }
+    return startTriggerAt(fireAt, trigger.triggerId);
+}
+
+/**
+ * @param fireAt Time to fire at, in this device's clock (in microseconds).
+ * @param triggerId Trigger being armed.
+ */
+esp_err_t Device::startTriggerAt(int64_t fireAt, uint16_t triggerId) {
+    // Retransmissions re-announce a trigger that is already armed.
+    if(timer_on && triggerId == pendingTriggerId) return ESP_OK;
+
+    int64_t delay = fireAt - esp_timer_get_time();
+    if(delay <= 0) {
+        lateTriggers++;
+        log_e("Trigger %u announced %lld us too late.", triggerId, (long long) -delay);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // A newer announcement supersedes a trigger still pending.
+    if(timer_on) esp_timer_stop(trigger_timer_handle);
+    timer_on = true;
+    pendingTriggerId = triggerId;
+    pendingTriggerAt = fireAt;
+    esp_err_t success = esp_timer_start_once(trigger_timer_handle, delay);
+    if(success != ESP_OK) {
+        timer_on = false;
+        log_e("Scheduled esp_timer unable to start.");
+    }
+    return success;
+}
+
+void Device::recordTriggerFired(int64_t firedAt) {
+    firedTriggerId = pendingTriggerId;
+    Device::firedAt = firedAt;
+    if(pendingTriggerId == 0) return;
+    if(MEASURE_TRIGGER_ALIGNMENT) log_e("Trigger %u fired %lld us after schedule.", pendingTriggerId, (long long) (firedAt - pendingTriggerAt));
+    node->reportTriggerFired(pendingTriggerId, firedAt);
 }
 
 void Device::startESPNow() {
@@ -81,6 +255,26 @@ void Device::startESPNow() {
     tx->registerProcessWaveCallBack(Device::processWave);
     tx->registerProcessInfoReceivedCallBack(Device::processInfoReceived);
     tx->registerDataSentCallBack(Device::processDataSent);
+    tx->registerProcessTelemetryCallBack(Device::processTelemetry);
+    if(!deviceIsTx) tx->registerProcessCommandCallBack(Device::processCommand);
+    if(trigger_timer_handle != NULL) tx->enableScheduledTriggers(triggerTimerDelay * 1000, TRIGGER_PERIOD_MS * 1000);
+    tx->setTriggerMeasurement(MEASURE_TRIGGER_ALIGNMENT);
+    tx->setRangingLatency(RANGING_LATENCY_US);
+    uint8_t sensors = deviceIsTx ? CAP_SENSOR_TX_TRANSDUCER
+        : (CAP_SENSOR_RX_LEFT | CAP_SENSOR_RX_RIGHT | CAP_SENSOR_OBSTACLE | CAP_SENSOR_DRIVE);
+    tx->setCapabilities(sensors, TTR_US, TRIGGER_PERIOD_MS);
+    tx->setStreaming(STREAM_ACKS);
+    tx->setPhyRate(ESPNOW_PHY_RATE);
+    if(ADAPTIVE_PING_RATE) tx->enablePingRateGovernor(TRIGGER_PERIOD_MS * 1000, KEEPALIVE_PERIOD_MS * 1000);
+    if(FAULT_INJECTION) {
+        FAULT_PROFILE faults = {};
+        faults.drop = FAULT_DROP_PERCENT / 100.0f;
+        faults.burstStart = FAULT_BURST_PERCENT / 100.0f;
+        faults.burstLength = FAULT_BURST_FRAMES;
+        faults.delay = FAULT_DELAY_PERCENT / 100.0f;
+        faults.delayMaxUs = FAULT_DELAY_MAX_MS * 1000;
+        tx->injectFaults(faults, faults, FAULT_SEED);
+    }
     tx->start();
 }
 
@@ -21,16 +21,22 @@ void setup() {
     belt.startPeripheralManager();
     belt.startESPNow();
 
+    // Everything is allocated by now. The communication tasks must not allocate from here on.
+    allocGuardArm();
+
     log_e("Belt Setup Complete.");
 }
 
 bool listShown = true;
+uint32_t loopCount = 0;
 void loop() {
     if(listShown) {
         vTaskList(info);
         Serial.println(info); 
         listShown = false;
     }
+    belt.pollSerialCommands();
+    if(ALLOC_GUARD && ++loopCount % 10 == 0) allocGuardReport();
     vTaskDelay(1000);
 }
 
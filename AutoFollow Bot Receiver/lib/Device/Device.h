@@ -19,6 +19,13 @@ class Device {
         bool ledOn = false;
         bool trigger_timer_flag = false;
         inline static uint64_t triggerTimerDelay = -1;
+        inline static EspNowNode *node = NULL;          // Node whose frames carry the trigger schedule.
+        inline static uint16_t pendingTriggerId = 0;    // Trigger the timer is armed for. Zero for callback-relative triggers.
+        inline static int64_t pendingTriggerAt = 0;     // When the armed trigger is due (in microseconds).
+        inline static uint32_t lateTriggers = 0;        // Triggers announced too late to be armed.
+        inline static uint16_t firedTriggerId = 0;      // Trigger the timer last fired for. Zero for callback-relative triggers.
+        inline static int64_t firedAt = 0;              // When the timer last fired (in microseconds).
+        inline static PeripheralManager *commandTarget = NULL;  // Manager that carries out the peer's commands.
         const esp_timer_create_args_t trigger_timer_params = {
             .callback = &trigger_timer_callback,
             .arg = this, 
@@ -30,11 +37,20 @@ class Device {
         SocConfig socInUse;
         PeripheralManager *manager;
         EspNowNode *tx;
+        ConfigStore *config;                            // Tuning values shared with the peer.
+        char command[48];                               // Command being read from Serial.
+        size_t commandLength = 0;
 
-        static BaseType_t processHandshake(const char* data);
-        static BaseType_t processWave(const char* data);
-        static BaseType_t processInfoReceived(const char* data);
-        static BaseType_t processDataSent(const char* data);
+        static BaseType_t processHandshake(const ESP_NOW_PACKET* packet);
+        static BaseType_t processWave(const ESP_NOW_PACKET* packet);
+        static BaseType_t processInfoReceived(const ESP_NOW_PACKET* packet);
+        static BaseType_t processDataSent(const ESP_NOW_PACKET* packet);
+        static esp_err_t armTrigger(const ESP_NOW_PACKET* packet);
+        static BaseType_t processTelemetry(const ESP_NOW_PACKET* packet);
+        static BaseType_t processCommand(const COMMAND_ENTRY* command);
+        static void onConfigChanged(ConfigKey key, float value, void *context);
+
+        void initConfig(Mode mode);
 
         void initTasks();
 
@@ -46,6 +62,9 @@ class Device {
             // Create the ESP Now Node and Manager.
             this->tx = new EspNowNode(peerMacAddress, mode, ackRequired);
             this->manager = new PeripheralManager(this);
+            node = this->tx;
+            commandTarget = this->manager;
+            initConfig(mode);
 
             // Do some checks.
             deviceIsTx = (mode == Mode::Transmitter) ? true : false;
@@ -68,10 +87,21 @@ class Device {
         void toggleRgbLed();
         void createOneshotEspTimer(uint64_t delay = 1);
         static esp_err_t startOneshotEspTimer(uint64_t delay = 1);
+        static esp_err_t startTriggerAt(int64_t fireAt, uint16_t triggerId);
+        void recordTriggerFired(int64_t firedAt);
+        uint32_t getLateTriggerCount() { return lateTriggers; }
+        uint16_t getFiredTriggerId() { return firedTriggerId; }
+        int64_t getFiredAt() { return firedAt; }
+        void recordTelemetry(const TELEMETRY_SAMPLE &sample);
+        void requestPing();
+        bool setConfig(const char *name, float value);
+        bool sendCommand(const char *name, float value);
+        void pollSerialCommands();
         BaseType_t beginPingTimerTask();
         
         bool isTransmitter();
         PeripheralManager *getPeripheralManager() { return manager; }
+        EspNowNode *getNode() { return tx; }
         SocConfig getSocInUse() { return socInUse; }
 
         void testTriggerSynchronization();
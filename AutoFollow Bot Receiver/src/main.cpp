@@ -21,15 +21,21 @@ void setup() {
     bot.startPeripheralManager();   
     bot.startESPNow();
 
+    // Everything is allocated by now. The communication tasks must not allocate from here on.
+    allocGuardArm();
+
     log_e("Bot Setup Complete.");
 }
 
 bool listPrinted = false;
+uint32_t loopCount = 0;
 void loop() {
     if(!listPrinted) {
         vTaskList(info);
         Serial.println(info);
         listPrinted = true;
     }
+    bot.pollSerialCommands();
+    if(ALLOC_GUARD && ++loopCount % 10 == 0) allocGuardReport();
     vTaskDelay(1000);
 }
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef NODE_HARNESS_H
+#define NODE_HARNESS_H
+
+#include "EspNowNode/EspNowNode.h"
+#include "EspNowNode/LoopbackTransport.h"
+
+#define HARNESS_STEP_US 250     // Simulated time per pass over the nodes, standing in for the radio's latency (us).
+
+/**
+ * What the nodes' callbacks saw. The callbacks carry no context, so every node of a test shares them.
+ */
+struct _harness_counters {
+    uint32_t handshakes;        // Handshakes processed.
+    uint32_t waves;             // Waves processed.
+    uint32_t pings;             // Trigger pings processed.
+    uint32_t sent;              // Frames the transports were done with.
+    uint32_t commands;          // Commands carried out.
+};
+typedef struct _harness_counters HARNESS_COUNTERS;
+
+inline HARNESS_COUNTERS harness = {};
+
+inline BaseType_t harnessHandshake(const ESP_NOW_PACKET *packet) { harness.handshakes++; return pdPASS; }
+inline BaseType_t harnessWave(const ESP_NOW_PACKET *packet) { harness.waves++; return pdPASS; }
+inline BaseType_t harnessPing(const ESP_NOW_PACKET *packet) { harness.pings++; return pdPASS; }
+inline BaseType_t harnessSent(const ESP_NOW_PACKET *packet) { harness.sent++; return pdPASS; }
+inline BaseType_t harnessCommand(const COMMAND_ENTRY *command) { harness.commands++; return pdPASS; }
+
+/**
+ * A belt and a bot connected back to back over loopback transports, run without tasks on
+ * the simulated platform clock.
+ */
+class NodePair {
+    public:
+        LoopbackTransport beltLink;
+        LoopbackTransport botLink;
+        EspNowNode belt;
+        EspNowNode bot;
+
+        NodePair(bool ackRequired = true) :
+            belt(&beltLink, Mode::Transmitter, ackRequired),
+            bot(&botLink, Mode::Receiver, ackRequired)
+        {
+            LoopbackTransport::connect(beltLink, botLink);
+            EspNowNode *nodes[2] = {&belt, &bot};
+            for(EspNowNode *node : nodes) {
+                node->registerProcessHandshakeCallBack(harnessHandshake);
+                node->registerProcessWaveCallBack(harnessWave);
+                node->registerProcessInfoReceivedCallBack(harnessPing);
+                node->registerDataSentCallBack(harnessSent);
+            }
+            bot.registerProcessCommandCallBack(harnessCommand);
+        }
+
+        bool start() { return belt.startPolled() && bot.startPolled(); }
+};
+
+/**
+ * One pass of a node's tasks, as they would run after being woken.
+ */
+inline void serviceNode(EspNowNode *node) {
+    if(node->isTransmissionPaused()) return;
+    node->serviceReceived();
+    node->serviceTxRx();
+}
+
+/**
+ * Run pairs side by side for a while of simulated time.
+ */
+inline void runPairs(NodePair **pairs, int count, int64_t durationUs) {
+    int64_t until = platformMicros() + durationUs;
+    while(platformMicros() < until) {
+        for(int i = 0; i < count; i++) {
+            serviceNode(&pairs[i]->belt);
+            serviceNode(&pairs[i]->bot);
+        }
+        platformAdvanceMicros(HARNESS_STEP_US);
+    }
+}
+
+inline void runPair(NodePair *pair, int64_t durationUs) { runPairs(&pair, 1, durationUs); }
+
+#endif /* NODE_HARNESS_H */
@@ -0,0 +1,189 @@
+#include <unity.h>
+#include <stdlib.h>
+#include "EspNowNode/ClockSync.h"
+
+#define EXCHANGE_PERIOD_US 20000        // Ping/ack spacing while streaming (us).
+#define TURNAROUND_US 200               // Time the peer holds a frame before answering (us).
+
+/**
+ * Peer crystal running at a fixed rate off the local one, from a fixed offset.
+ */
+struct _peer_clock {
+    int64_t offset;         // Peer minus local at local time zero (us).
+    double drift;           // Extra peer microseconds per local microsecond.
+};
+typedef struct _peer_clock PEER_CLOCK;
+
+static int64_t peerTime(const PEER_CLOCK *peer, int64_t local) {
+    return local + peer->offset + (int64_t) (peer->drift * (double) local);
+}
+
+static int64_t trueOffset(const PEER_CLOCK *peer, int64_t local) {
+    return peerTime(peer, local) - local;
+}
+
+/**
+ * Small deterministic generator, so a failing seed can be replayed.
+ */
+static uint32_t rngState;
+static uint32_t nextRandom(uint32_t below) {
+    rngState = rngState * 1664525u + 1013904223u;
+    return (rngState >> 8) % below;
+}
+
+/**
+ * Run one request/reply exchange starting at `local` with the given one-way delays.
+ * @return Local time the reply arrived.
+ */
+static int64_t exchange(ClockSync *sync, const PEER_CLOCK *peer, int64_t local, int64_t up, int64_t down) {
+    int64_t t1 = local;
+    int64_t t2 = peerTime(peer, t1 + up);
+    int64_t t3 = peerTime(peer, t1 + up + TURNAROUND_US);
+    int64_t t4 = t1 + up + TURNAROUND_US + down;
+    sync->addExchange(t1, t2, t3, t4);
+    return t4;
+}
+
+void setUp(void) {
+    rngState = 1;
+}
+
+void tearDown(void) {}
+
+/**
+ * Drive `seconds` of exchanges with 1-1.3 ms of jitter each way and check the fit against the truth.
+ */
+static void checkTracksDrift(double driftPpm) {
+    ClockSync sync;
+    PEER_CLOCK peer = {123456789, driftPpm / 1e6};
+    int64_t local = 1000000;
+    for(int i = 0; i < 1000; i++) {
+        exchange(&sync, &peer, local, 1000 + nextRandom(300), 1000 + nextRandom(300));
+        local += EXCHANGE_PERIOD_US;
+    }
+
+    TEST_ASSERT_TRUE(sync.isSynchronized());
+    // A few microseconds of asymmetry across the 8 s window is worth a few ppm of slope.
+    TEST_ASSERT_FLOAT_WITHIN(5.0, driftPpm, sync.getDriftPpm());
+
+    // Mapping a little past the last exchange, as a trigger scheduled ahead would.
+    int64_t query = local + 50000;
+    TEST_ASSERT_INT_WITHIN(100, trueOffset(&peer, query), sync.offsetAt(query));
+    TEST_ASSERT_INT_WITHIN(100, peerTime(&peer, query), sync.toPeerTime(query));
+    TEST_ASSERT_INT_WITHIN(2, query, sync.fromPeerTime(sync.toPeerTime(query)));
+}
+
+void test_tracks_a_fast_peer_crystal(void) {
+    checkTracksDrift(40);
+}
+
+void test_tracks_a_slow_peer_crystal(void) {
+    checkTracksDrift(-120);
+}
+
+void test_tracks_matched_crystals(void) {
+    checkTracksDrift(0);
+}
+
+void test_drift_is_clamped_to_plausible_crystals(void) {
+    ClockSync sync;
+    PEER_CLOCK peer = {0, 2000e-6};
+    int64_t local = 0;
+    for(int i = 0; i < 500; i++) {
+        exchange(&sync, &peer, local, 1000, 1000);
+        local += EXCHANGE_PERIOD_US;
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.01, CLOCK_SYNC_MAX_DRIFT_PPM, sync.getDriftPpm());
+}
+
+/**
+ * However the delay splits between the two directions and whatever the drift, the error bound
+ * must cover the true error, both at the last exchange and extrapolated past it.
+ */
+void test_error_bound_covers_asymmetric_paths_and_drift(void) {
+    uint32_t checks = 0;
+    for(int run = 0; run < 40; run++) {
+        ClockSync sync;
+        PEER_CLOCK peer = {(int64_t) nextRandom(1000000000), ((double) nextRandom(201) - 100) / 1e6};
+        int64_t local = nextRandom(1000000);
+        for(int i = 0; i < 600; i++) {
+            // Occasional queueing in one direction only, which biases the offset of that exchange.
+            int64_t up = 900 + nextRandom(400) + ((nextRandom(4) == 0) ? nextRandom(3000) : 0);
+            int64_t down = 900 + nextRandom(400) + ((nextRandom(8) == 0) ? nextRandom(3000) : 0);
+            int64_t arrived = exchange(&sync, &peer, local, up, down);
+            local += EXCHANGE_PERIOD_US + nextRandom(5000);
+            if(!sync.isSynchronized()) continue;
+
+            for(int64_t ahead = 0; ahead <= 200000; ahead += 50000) {
+                int64_t query = arrived + ahead;
+                int64_t error = llabs(sync.offsetAt(query) - trueOffset(&peer, query));
+                TEST_ASSERT_LESS_OR_EQUAL_INT64(sync.errorBoundAt(query), error);
+                checks++;
+            }
+        }
+    }
+    TEST_ASSERT_GREATER_THAN(10000, checks);
+}
+
+void test_fastest_exchange_per_bin_rejects_queueing(void) {
+    ClockSync sync;
+    PEER_CLOCK peer = {5000000, 0};
+    int64_t local = 0;
+    for(int i = 0; i < 1000; i++) {
+        // Most exchanges queue 2-4 ms on the way out, which alone would bias the offset by 1-2 ms.
+        int64_t up = (i % 10 == 0) ? 1000 : 3000 + nextRandom(2000);
+        exchange(&sync, &peer, local, up, 1000);
+        local += EXCHANGE_PERIOD_US;
+    }
+    TEST_ASSERT_INT_WITHIN(20, trueOffset(&peer, local), sync.offsetAt(local));
+
+    // Bounded by half the fast exchanges' delay, not the queued ones'.
+    TEST_ASSERT_LESS_THAN(1500, sync.errorBoundAt(local));
+}
+
+void test_peer_restart_starts_over(void) {
+    ClockSync sync;
+    PEER_CLOCK peer = {700000000, 30e-6};
+    int64_t local = 0;
+    for(int i = 0; i < 200; i++) {
+        exchange(&sync, &peer, local, 1000, 1000);
+        local += EXCHANGE_PERIOD_US;
+    }
+    TEST_ASSERT_TRUE(sync.isSynchronized());
+
+    // The peer reboots and its clock starts again from zero.
+    peer.offset = -local;
+    exchange(&sync, &peer, local, 1000, 1000);
+    TEST_ASSERT_EQUAL_UINT32(1, sync.getStepCount());
+    TEST_ASSERT_FALSE(sync.isSynchronized());
+
+    for(int i = 0; i < CLOCK_SYNC_MIN_SAMPLES; i++) {
+        local += EXCHANGE_PERIOD_US;
+        exchange(&sync, &peer, local, 1000, 1000);
+    }
+    TEST_ASSERT_TRUE(sync.isSynchronized());
+    TEST_ASSERT_INT_WITHIN(10, trueOffset(&peer, local), sync.offsetAt(local));
+}
+
+void test_impossible_exchanges_are_rejected(void) {
+    ClockSync sync;
+    TEST_ASSERT_FALSE(sync.addExchange(1000, 5000, 5100, 900));     // Reply before the request.
+    TEST_ASSERT_FALSE(sync.addExchange(1000, 5000, 4900, 3000));    // Peer answered before it heard.
+    TEST_ASSERT_FALSE(sync.addExchange(1000, 5000, 8000, 3000));    // Peer held it longer than the round trip.
+    TEST_ASSERT_EQUAL_UINT32(3, sync.getRejectedCount());
+    TEST_ASSERT_FALSE(sync.isSynchronized());
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, sync.errorBoundAt(0));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_tracks_a_fast_peer_crystal);
+    RUN_TEST(test_tracks_a_slow_peer_crystal);
+    RUN_TEST(test_tracks_matched_crystals);
+    RUN_TEST(test_drift_is_clamped_to_plausible_crystals);
+    RUN_TEST(test_error_bound_covers_asymmetric_paths_and_drift);
+    RUN_TEST(test_fastest_exchange_per_bin_rejects_queueing);
+    RUN_TEST(test_peer_restart_starts_over);
+    RUN_TEST(test_impossible_exchanges_are_rejected);
+    return UNITY_END();
+}
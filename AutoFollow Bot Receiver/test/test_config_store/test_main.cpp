@@ -0,0 +1,171 @@
+#include <unity.h>
+#include "EspNowNode/ConfigStore.h"
+
+#define BELT_REPLICA 0
+#define BOT_REPLICA 1
+#define SYNC_MAX_FRAMES 16      // Frames after which two stores that haven't agreed are stuck.
+
+/**
+ * A belt and a bot store, each with its view of the other.
+ */
+struct _store_pair {
+    ConfigStore belt = ConfigStore(BELT_REPLICA);
+    ConfigStore bot = ConfigStore(BOT_REPLICA);
+    ConfigPeer beltPeer;        // What the belt knows the bot holds.
+    ConfigPeer botPeer;         // What the bot knows the belt holds.
+};
+typedef struct _store_pair STORE_PAIR;
+
+/**
+ * Send what one store has for the other in a frame of its own.
+ * @return True if a record went.
+ */
+static bool send(ConfigStore &from, ConfigPeer &fromPeer, ConfigStore &to, ConfigPeer &toPeer) {
+    ESP_NOW_PACKET packet;
+    clearPacket(&packet, Header::TRIGGER_PING, AckMessage::Received_Ping);
+    if(!from.writeDelta(&packet, &fromPeer)) return false;
+    to.merge(&packet, &toPeer);
+    return true;
+}
+
+/**
+ * Exchange frames both ways until neither store has anything to send.
+ * @return Records that went, or SYNC_MAX_FRAMES if the stores never went quiet.
+ */
+static int sync(STORE_PAIR &pair) {
+    int frames = 0;
+    while(frames < SYNC_MAX_FRAMES) {
+        bool sent = send(pair.belt, pair.beltPeer, pair.bot, pair.botPeer);
+        sent |= send(pair.bot, pair.botPeer, pair.belt, pair.beltPeer);
+        if(!sent) break;
+        frames++;
+    }
+    return frames;
+}
+
+static void assertAgree(STORE_PAIR &pair, float value) {
+    float belt = pair.belt.get(cfg_OBSTACLE_LIMIT);
+    float bot = pair.bot.get(cfg_OBSTACLE_LIMIT);
+    TEST_ASSERT_EQUAL_FLOAT(value, belt);
+    TEST_ASSERT_EQUAL_FLOAT(value, bot);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/**
+ * A write made after the other device's writes have been merged wins, however many writes
+ * the other device made.
+ */
+void test_later_write_wins_over_more_writes(void) {
+    STORE_PAIR pair;
+    for(int i = 0; i < 5; i++) TEST_ASSERT_TRUE(pair.belt.set(cfg_OBSTACLE_LIMIT, 10 + i));
+    TEST_ASSERT_LESS_THAN(SYNC_MAX_FRAMES, sync(pair));
+    assertAgree(pair, 14);
+
+    TEST_ASSERT_TRUE(pair.bot.set(cfg_OBSTACLE_LIMIT, 99));
+    TEST_ASSERT_LESS_THAN(SYNC_MAX_FRAMES, sync(pair));
+    assertAgree(pair, 99);
+
+    TEST_ASSERT_TRUE(pair.belt.set(cfg_OBSTACLE_LIMIT, 7));
+    TEST_ASSERT_LESS_THAN(SYNC_MAX_FRAMES, sync(pair));
+    assertAgree(pair, 7);
+}
+
+/**
+ * Writes made on both devices before either hears of the other's settle on the same value
+ * on both, and writes to different keys both survive.
+ */
+void test_concurrent_writes_converge(void) {
+    STORE_PAIR pair;
+    TEST_ASSERT_TRUE(pair.belt.set(cfg_OBSTACLE_LIMIT, 20));
+    TEST_ASSERT_TRUE(pair.bot.set(cfg_OBSTACLE_LIMIT, 30));
+    TEST_ASSERT_TRUE(pair.belt.set(cfg_PRESENCE_LIMIT, 60));
+    TEST_ASSERT_TRUE(pair.bot.set(cfg_TRIGGER_DELAY, 5));
+    TEST_ASSERT_LESS_THAN(SYNC_MAX_FRAMES, sync(pair));
+
+    // Both wrote obstacle_in at counter 1, so the higher device wins.
+    assertAgree(pair, 30);
+    float presence = pair.bot.get(cfg_PRESENCE_LIMIT);
+    float delay = pair.belt.get(cfg_TRIGGER_DELAY);
+    TEST_ASSERT_EQUAL_FLOAT(60, presence);
+    TEST_ASSERT_EQUAL_FLOAT(5, delay);
+    for(int i = 0; i < CONFIG_MAX_REPLICAS; i++) TEST_ASSERT_EQUAL_UINT32(pair.belt.getVersion(i), pair.bot.getVersion(i));
+}
+
+/**
+ * Once both stores agree, neither has anything to send, and writing a value already held
+ * changes nothing.
+ */
+void test_no_traffic_once_in_sync(void) {
+    STORE_PAIR pair;
+    TEST_ASSERT_EQUAL(0, sync(pair));
+    TEST_ASSERT_TRUE(pair.belt.set(cfg_OBSTACLE_LIMIT, 40));
+    TEST_ASSERT_TRUE(pair.bot.set(cfg_PRESENCE_LIMIT, 80));
+    TEST_ASSERT_LESS_THAN(SYNC_MAX_FRAMES, sync(pair));
+
+    TEST_ASSERT_FALSE(pair.belt.hasDelta(pair.beltPeer));
+    TEST_ASSERT_FALSE(pair.bot.hasDelta(pair.botPeer));
+    TEST_ASSERT_FALSE(pair.belt.set(cfg_OBSTACLE_LIMIT, 40));
+    TEST_ASSERT_FALSE(pair.bot.set(cfg_OBSTACLE_LIMIT, 40));
+    TEST_ASSERT_EQUAL(0, sync(pair));
+}
+
+/**
+ * A write goes out once, the peer answers once so the writer knows it landed, and then
+ * both go quiet.
+ */
+void test_write_is_acked_once(void) {
+    STORE_PAIR pair;
+    TEST_ASSERT_TRUE(pair.belt.set(cfg_OBSTACLE_LIMIT, 25));
+    TEST_ASSERT_TRUE(pair.belt.hasDelta(pair.beltPeer));
+    TEST_ASSERT_FALSE(pair.bot.hasDelta(pair.botPeer));
+
+    // The write lands, and the bot now owes word of it though it has nothing new.
+    TEST_ASSERT_TRUE(send(pair.belt, pair.beltPeer, pair.bot, pair.botPeer));
+    float landed = pair.bot.get(cfg_OBSTACLE_LIMIT);
+    TEST_ASSERT_EQUAL_FLOAT(25, landed);
+    TEST_ASSERT_TRUE(pair.botPeer.ackOwed);
+
+    // Until the ack comes, the belt can't tell the write landed and would send it again.
+    TEST_ASSERT_TRUE(pair.belt.hasDelta(pair.beltPeer));
+    TEST_ASSERT_TRUE(send(pair.bot, pair.botPeer, pair.belt, pair.beltPeer));
+    TEST_ASSERT_FALSE(pair.belt.hasDelta(pair.beltPeer));
+    TEST_ASSERT_FALSE(pair.bot.hasDelta(pair.botPeer));
+
+    // An ack carries nothing new, so it isn't answered.
+    TEST_ASSERT_FALSE(pair.beltPeer.ackOwed);
+    TEST_ASSERT_EQUAL(0, sync(pair));
+}
+
+/**
+ * A device that restarts with only its defaults gets the values back, and its next write
+ * still wins over the ones it lost.
+ */
+void test_restarted_store_catches_up(void) {
+    STORE_PAIR pair;
+    for(int i = 0; i < 3; i++) TEST_ASSERT_TRUE(pair.bot.set(cfg_OBSTACLE_LIMIT, 50 + i));
+    TEST_ASSERT_LESS_THAN(SYNC_MAX_FRAMES, sync(pair));
+
+    // The bot restarts, and the handshake makes the belt forget what it held.
+    pair.bot = ConfigStore(BOT_REPLICA);
+    pair.botPeer.reset();
+    pair.beltPeer.reset();
+    TEST_ASSERT_LESS_THAN(SYNC_MAX_FRAMES, sync(pair));
+    assertAgree(pair, 52);
+
+    TEST_ASSERT_TRUE(pair.bot.set(cfg_OBSTACLE_LIMIT, 45));
+    TEST_ASSERT_LESS_THAN(SYNC_MAX_FRAMES, sync(pair));
+    assertAgree(pair, 45);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_later_write_wins_over_more_writes);
+    RUN_TEST(test_concurrent_writes_converge);
+    RUN_TEST(test_no_traffic_once_in_sync);
+    RUN_TEST(test_write_is_acked_once);
+    RUN_TEST(test_restarted_store_catches_up);
+    return UNITY_END();
+}
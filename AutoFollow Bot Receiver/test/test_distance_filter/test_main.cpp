@@ -0,0 +1,117 @@
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "HCSR04/DistanceFilter.h"
+#include "EspNowNode/FaultyTransport.h"
+
+#define SAMPLES (1 << 16)   // Readings in the benchmark stream.
+#define ROUNDS 200          // Passes over the stream each stage is timed for.
+
+// The chains HCSR04.h gives transducers and obstacle sensors, which the host can't include.
+typedef FilterChain<MedianFilter<3>, RateLimiter<6>, RunningMean<5>> TransducerFilter;
+typedef FilterChain<MedianFilter<3>, ExponentialSmoothing<50>> ObstacleFilter;
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_running_mean_over_filling_window(void) {
+    RunningMean<5> mean;
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, mean.push(1));
+    TEST_ASSERT_EQUAL_FLOAT(1.5f, mean.push(2));
+    for(int i = 3; i <= 5; i++) mean.push(i);
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, mean.push(6));
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, mean.push(7));
+    mean.reset();
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, mean.push(10));
+}
+
+void test_median_rejects_spike(void) {
+    MedianFilter<3> median;
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, median.push(5));
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, median.push(100));
+    TEST_ASSERT_EQUAL_FLOAT(6.0f, median.push(6));
+    TEST_ASSERT_EQUAL_FLOAT(7.0f, median.push(7));
+    TEST_ASSERT_EQUAL_FLOAT(7.0f, median.push(8));
+}
+
+void test_smoothing_and_rate_limit(void) {
+    ExponentialSmoothing<50> smoothing;
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, smoothing.push(10));
+    TEST_ASSERT_EQUAL_FLOAT(15.0f, smoothing.push(20));
+
+    RateLimiter<6> limiter;
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, limiter.push(10));
+    TEST_ASSERT_EQUAL_FLOAT(16.0f, limiter.push(40));
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, limiter.push(0));
+    TEST_ASSERT_EQUAL_FLOAT(12.0f, limiter.push(12));
+}
+
+/**
+ * A chain gives exactly what its stages give run one after the other.
+ */
+void test_chain_runs_stages_in_order(void) {
+    TransducerFilter chain;
+    MedianFilter<3> median;
+    RateLimiter<6> limiter;
+    RunningMean<5> mean;
+    FaultRandom random(0xD157);
+    for(int i = 0; i < 1000; i++) {
+        float x = 20 + random.between(0, 999) / 10.0f;
+        float staged = mean.push(limiter.push(median.push(x)));
+        TEST_ASSERT_EQUAL_FLOAT(staged, chain.push(x));
+    }
+}
+
+static float readings[SAMPLES];
+
+/**
+ * Time a stage or chain over the benchmark stream (ns/sample).
+ */
+template<typename Filter>
+static double benchmark(const char *name) {
+    Filter filter;
+    volatile float sink = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for(int r = 0; r < ROUNDS; r++) {
+        for(int i = 0; i < SAMPLES; i++) sink = filter.push(readings[i]);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / ((double) ROUNDS * SAMPLES);
+    (void) sink;
+
+    char message[96];
+    snprintf(message, sizeof(message), "%-26s %.2f ns/sample", name, ns);
+    TEST_MESSAGE(message);
+    return ns;
+}
+
+/**
+ * Time each stage, and each sensor's chain, over a pseudo-random stream of readings. A chain
+ * costs no more than its stages together, as it adds no dispatch of its own.
+ */
+void test_filter_benchmark(void) {
+    FaultRandom random(3);
+    for(int i = 0; i < SAMPLES; i++) readings[i] = 20 + random.between(0, 999) / 10.0f;
+
+    double median = benchmark<MedianFilter<3>>("MedianFilter<3>");
+    double limiter = benchmark<RateLimiter<6>>("RateLimiter<6>");
+    double mean = benchmark<RunningMean<5>>("RunningMean<5>");
+    double smoothing = benchmark<ExponentialSmoothing<50>>("ExponentialSmoothing<50>");
+    benchmark<MedianFilter<5>>("MedianFilter<5>");
+    double transducer = benchmark<TransducerFilter>("transducer chain");
+    double obstacle = benchmark<ObstacleFilter>("obstacle chain");
+
+    // Timing on a shared host is noisy, so only a gross overhead fails.
+    TEST_ASSERT_LESS_THAN(2 * (median + limiter + mean) + 5, transducer);
+    TEST_ASSERT_LESS_THAN(2 * (median + smoothing) + 5, obstacle);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_running_mean_over_filling_window);
+    RUN_TEST(test_median_rejects_spike);
+    RUN_TEST(test_smoothing_and_rate_limit);
+    RUN_TEST(test_chain_runs_stages_in_order);
+    RUN_TEST(test_filter_benchmark);
+    return UNITY_END();
+}
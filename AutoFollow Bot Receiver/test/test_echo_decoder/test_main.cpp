@@ -0,0 +1,155 @@
+#include <unity.h>
+#include "HCSR04/EchoDecoder.h"
+#include "EspNowNode/FaultyTransport.h"
+
+#define CAPTURE_HZ 80000000     // Tick rate of the MCPWM capture timer.
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static uint32_t ticksOf(uint32_t us) { return us * (CAPTURE_HZ / 1000000); }
+
+void test_pulse_decodes_to_width(void) {
+    EchoDecoder decoder(CAPTURE_HZ);
+    TEST_ASSERT_FALSE(decoder.onEdge(edge_RISING, 100));
+    TEST_ASSERT_TRUE(decoder.isHigh());
+    TEST_ASSERT_TRUE(decoder.onEdge(edge_FALLING, 100 + ticksOf(1000)));
+    TEST_ASSERT_EQUAL_UINT32(ticksOf(1000), decoder.getWidthTicks());
+    TEST_ASSERT_EQUAL_FLOAT(1000.0f, decoder.getWidthUs());
+    TEST_ASSERT_FALSE(decoder.isHigh());
+}
+
+void test_pulse_across_counter_wrap(void) {
+    EchoDecoder decoder(CAPTURE_HZ);
+    uint32_t rise = 0xFFFFFF00u;
+    decoder.onEdge(edge_RISING, rise);
+    TEST_ASSERT_TRUE(decoder.onEdge(edge_FALLING, rise + ticksOf(500)));
+    TEST_ASSERT_EQUAL_FLOAT(500.0f, decoder.getWidthUs());
+}
+
+void test_glitch_and_overlong_are_rejected(void) {
+    EchoDecoder decoder(CAPTURE_HZ);
+    decoder.onEdge(edge_RISING, 0);
+    TEST_ASSERT_FALSE(decoder.onEdge(edge_FALLING, ticksOf(ECHO_MIN_US) - 1));
+    decoder.onEdge(edge_RISING, 0);
+    TEST_ASSERT_FALSE(decoder.onEdge(edge_FALLING, ticksOf(ECHO_MAX_US) + 1));
+    decoder.onEdge(edge_RISING, 0);
+    TEST_ASSERT_TRUE(decoder.onEdge(edge_FALLING, ticksOf(ECHO_MIN_US)));
+    decoder.onEdge(edge_RISING, 0);
+    TEST_ASSERT_TRUE(decoder.onEdge(edge_FALLING, ticksOf(ECHO_MAX_US)));
+
+    ECHO_STATS stats = decoder.getStats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.glitches);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.overlong);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.pulses);
+}
+
+void test_missed_edges_resynchronise(void) {
+    EchoDecoder decoder(CAPTURE_HZ);
+
+    // A missed fall times the pulse from the newer rise.
+    decoder.onEdge(edge_RISING, 0);
+    decoder.onEdge(edge_RISING, 1000);
+    TEST_ASSERT_TRUE(decoder.onEdge(edge_FALLING, 1000 + ticksOf(200)));
+    TEST_ASSERT_EQUAL_UINT32(ticksOf(200), decoder.getWidthTicks());
+
+    // A fall without a rise gives nothing, and the next pulse decodes.
+    TEST_ASSERT_FALSE(decoder.onEdge(edge_FALLING, 5));
+    decoder.onEdge(edge_RISING, 10);
+    TEST_ASSERT_TRUE(decoder.onEdge(edge_FALLING, 10 + ticksOf(300)));
+
+    ECHO_STATS stats = decoder.getStats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.missedFalls);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.missedRises);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.pulses);
+}
+
+void test_reset_drops_pulse_under_way(void) {
+    EchoDecoder decoder(CAPTURE_HZ);
+    decoder.onEdge(edge_RISING, 0);
+    decoder.reset();
+    TEST_ASSERT_FALSE(decoder.onEdge(edge_FALLING, ticksOf(1000)));
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.getStats().missedRises);
+}
+
+/**
+ * A long synthetic edge stream, starting near the counter's wrap, of echoes with glitches,
+ * overlong pulses and dropped edges mixed in. Every echo that kept both its edges must
+ * decode to its exact width, and every fault must be counted as what it was.
+ */
+void test_synthetic_edge_stream(void) {
+    const int PULSES = 200000;
+    EchoDecoder decoder(CAPTURE_HZ);
+    FaultRandom random(0xEC40);
+    ECHO_STATS expected = {};
+    uint32_t now = 0xF0000000u;
+    bool high = false;              // Has the decoder seen a rise not yet ended.
+    uint32_t decodedWrong = 0;
+
+    for(int i = 0; i < PULSES; i++) {
+        now += random.between(ticksOf(1000), ticksOf(60000));
+
+        // Mostly echoes, some glitches and some pulses spanning a missed fall.
+        uint32_t roll = random.between(0, 99);
+        uint32_t widthUs;
+        if(roll < 3) widthUs = random.between(1, ECHO_MIN_US - 1);
+        else if(roll < 5) widthUs = random.between(ECHO_MAX_US + 1, 3 * ECHO_MAX_US);
+        else widthUs = random.between(ECHO_MIN_US, ECHO_MAX_US);
+        uint32_t width = ticksOf(widthUs) + random.between(0, CAPTURE_HZ / 1000000 - 1);
+        if(width < ticksOf(ECHO_MIN_US) && widthUs >= ECHO_MIN_US) width = ticksOf(ECHO_MIN_US);
+        if(width > ticksOf(ECHO_MAX_US) && widthUs <= ECHO_MAX_US) width = ticksOf(ECHO_MAX_US);
+
+        // Now and then the capture misses one of the edges.
+        bool dropRise = random.chance(0.01f);
+        bool dropFall = random.chance(0.01f);
+
+        if(!dropRise) {
+            if(high) expected.missedFalls++;
+            TEST_ASSERT_FALSE(decoder.onEdge(edge_RISING, now));
+            high = true;
+        }
+        if(dropFall) continue;
+        if(!high) {
+            expected.missedRises++;
+            TEST_ASSERT_FALSE(decoder.onEdge(edge_FALLING, now + width));
+            continue;
+        }
+        high = false;
+
+        // Without its own rise, the fall ends the pulse of the last rise kept.
+        bool decoded = decoder.onEdge(edge_FALLING, now + width);
+        if(dropRise) {
+            expected.pulses += decoded;
+            expected.overlong += !decoded;
+            continue;
+        }
+        if(width < ticksOf(ECHO_MIN_US)) expected.glitches++;
+        else if(width > ticksOf(ECHO_MAX_US)) expected.overlong++;
+        else {
+            expected.pulses++;
+            if(!decoded || decoder.getWidthTicks() != width) decodedWrong++;
+        }
+    }
+
+    ECHO_STATS stats = decoder.getStats();
+    TEST_ASSERT_EQUAL_UINT32(0, decodedWrong);
+    TEST_ASSERT_EQUAL_UINT32(expected.pulses, stats.pulses);
+    TEST_ASSERT_EQUAL_UINT32(expected.missedFalls, stats.missedFalls);
+    TEST_ASSERT_EQUAL_UINT32(expected.missedRises, stats.missedRises);
+    TEST_ASSERT_EQUAL_UINT32(expected.glitches, stats.glitches);
+    TEST_ASSERT_EQUAL_UINT32(expected.overlong, stats.overlong);
+    TEST_ASSERT_GREATER_THAN(0, stats.missedFalls);
+    TEST_ASSERT_GREATER_THAN(0, stats.missedRises);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_pulse_decodes_to_width);
+    RUN_TEST(test_pulse_across_counter_wrap);
+    RUN_TEST(test_glitch_and_overlong_are_rejected);
+    RUN_TEST(test_missed_edges_resynchronise);
+    RUN_TEST(test_reset_drops_pulse_under_way);
+    RUN_TEST(test_synthetic_edge_stream);
+    return UNITY_END();
+}
@@ -0,0 +1,146 @@
+#include <unity.h>
+#include <stdio.h>
+#include "../NodeHarness.h"
+#include "EspNowNode/EspNowNetwork.h"
+
+#define RIG_RUN_US 10000000     // Simulated time each rig is measured over (us).
+
+/**
+ * A belt's network with a bot on each of its slots, every pair over its own loopback link.
+ */
+class NetworkRig {
+    public:
+        EspNowNetwork belt;
+        LoopbackTransport beltLinks[TDMA_MAX_SLOTS];
+        LoopbackTransport botLinks[TDMA_MAX_SLOTS];
+        EspNowNode *bots[TDMA_MAX_SLOTS] = {NULL};
+        int peers;
+
+        NetworkRig(int peers) : belt(Mode::Transmitter, true), peers(peers) {
+            for(int i = 0; i < peers; i++) {
+                LoopbackTransport::connect(beltLinks[i], botLinks[i]);
+                bots[i] = new EspNowNode(&botLinks[i], Mode::Receiver, true);
+                EspNowNode *nodes[2] = {belt.addPeer(&beltLinks[i]), bots[i]};
+                for(EspNowNode *node : nodes) {
+                    node->registerProcessHandshakeCallBack(harnessHandshake);
+                    node->registerProcessWaveCallBack(harnessWave);
+                    node->registerProcessInfoReceivedCallBack(harnessPing);
+                    node->registerDataSentCallBack(harnessSent);
+                }
+                bots[i]->registerProcessCommandCallBack(harnessCommand);
+            }
+        }
+
+        ~NetworkRig() {
+            for(int i = 0; i < peers; i++) delete bots[i];
+        }
+
+        bool start() {
+            bool res = belt.startPolled();
+            for(int i = 0; i < peers; i++) res = bots[i]->startPolled() && res;
+            return res;
+        }
+
+        /**
+         * One pass over every node.
+         */
+        void step() {
+            for(int i = 0; i < peers; i++) {
+                serviceNode(belt.getPeer(i));
+                serviceNode(bots[i]);
+            }
+            platformAdvanceMicros(HARNESS_STEP_US);
+        }
+
+        void run(int64_t durationUs) {
+            int64_t until = platformMicros() + durationUs;
+            while(platformMicros() < until) step();
+        }
+};
+
+void setUp(void) {
+    harness = {};
+    platformSetMicros(1000000);
+}
+
+void tearDown(void) {}
+
+void test_guard_covers_trigger_lead_and_echo(void) {
+    TdmaScheduler scheduler;
+    TEST_ASSERT_GREATER_OR_EQUAL(TDMA_TRIGGER_LEAD_US + ECHO_MAX_US, scheduler.getGuard());
+    TEST_ASSERT_LESS_THAN(scheduler.getSlotLength(), scheduler.getGuard());
+}
+
+/**
+ * No session starts an exchange outside the open part of its own slot. A loopback reply
+ * comes back within the pass, so every frame a belt session sends must go while it is open.
+ */
+void test_sessions_keep_to_their_slots(void) {
+    NetworkRig rig(3);
+    TEST_ASSERT_TRUE(rig.start());
+
+    uint32_t outside = 0;
+    uint32_t sent[3] = {0};
+    int64_t until = platformMicros() + RIG_RUN_US;
+    while(platformMicros() < until) {
+        uint32_t before[3];
+        for(int i = 0; i < 3; i++) before[i] = rig.beltLinks[i].getDeliveredCount();
+        int64_t now = platformMicros();
+        rig.step();
+        for(int i = 0; i < 3; i++) {
+            uint32_t frames = rig.beltLinks[i].getDeliveredCount() - before[i];
+            sent[i] += frames;
+            if(frames > 0 && !rig.belt.getScheduler().isOpen(i, now)) outside += frames;
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, outside);
+    for(int i = 0; i < 3; i++) TEST_ASSERT_GREATER_THAN(0, sent[i]);
+}
+
+/**
+ * Frames each pair gets through per second of simulated time as peers are added. The slots
+ * share the cycle, so each pair's rate falls as one over the peers while the belt's total
+ * stays put, and no pair is starved.
+ */
+void test_throughput_per_pair_as_peers_are_added(void) {
+    double single = 0;
+    for(int peers = 1; peers <= 4; peers++) {
+        setUp();
+        NetworkRig rig(peers);
+        TEST_ASSERT_TRUE(rig.start());
+        rig.run(TDMA_DEFAULT_SLOT_US * peers);
+
+        uint32_t before[TDMA_MAX_SLOTS];
+        for(int i = 0; i < peers; i++) before[i] = rig.beltLinks[i].getDeliveredCount();
+        rig.run(RIG_RUN_US);
+
+        double slowest = 1e12;
+        double fastest = 0;
+        double total = 0;
+        for(int i = 0; i < peers; i++) {
+            double rate = (rig.beltLinks[i].getDeliveredCount() - before[i]) * 1e6 / RIG_RUN_US;
+            if(rate < slowest) slowest = rate;
+            if(rate > fastest) fastest = rate;
+            total += rate;
+        }
+        if(peers == 1) single = total;
+
+        TEST_ASSERT_GREATER_THAN(0, slowest);
+        TEST_ASSERT_LESS_THAN(1.25 * slowest, fastest);
+        TEST_ASSERT_FLOAT_WITHIN(0.25 * single / peers, single / peers, total / peers);
+
+        char message[128];
+        snprintf(message, sizeof(message), "%d peer(s): %.0f frames/s per pair (slowest %.0f), %.0f in all",
+                 peers, total / peers, slowest, total);
+        TEST_MESSAGE(message);
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_guard_covers_trigger_lead_and_echo);
+    RUN_TEST(test_sessions_keep_to_their_slots);
+    RUN_TEST(test_throughput_per_pair_as_peers_are_added);
+    return UNITY_END();
+}
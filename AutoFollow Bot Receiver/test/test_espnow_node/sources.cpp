@@ -0,0 +1,11 @@
+// The native env doesn't build SharedFiles, so the suite compiles the code it covers itself.
+#include "Platform/Platform.cpp"
+#include "EspNowNode/EspNowNode.cpp"
+#include "EspNowNode/EspNowPacket.cpp"
+#include "EspNowNode/ClockSync.cpp"
+#include "EspNowNode/CommandQueue.cpp"
+#include "EspNowNode/ConfigStore.cpp"
+#include "EspNowNode/FaultyTransport.cpp"
+#include "EspNowNode/LoopbackTransport.cpp"
+#include "EspNowNode/OneWayRanger.cpp"
+#include "EspNowNode/TelemetryPacker.cpp"
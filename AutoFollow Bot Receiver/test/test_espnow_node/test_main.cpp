@@ -0,0 +1,349 @@
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include "../NodeHarness.h"
+
+void setUp(void) {
+    harness = {};
+    platformSetMicros(1000000);
+}
+
+void tearDown(void) {}
+
+void test_nodes_handshake_then_ping(void) {
+    NodePair pair;
+    TEST_ASSERT_TRUE(pair.start());
+    runPair(&pair, 1000000);
+
+    TEST_ASSERT_GREATER_OR_EQUAL(1, harness.handshakes);
+    TEST_ASSERT_GREATER_THAN(100, harness.pings);
+    TEST_ASSERT_EQUAL(st_PINGING, pair.belt.getProtocolState());
+    TEST_ASSERT_EQUAL(st_PINGING, pair.bot.getProtocolState());
+    TEST_ASSERT_TRUE(pair.belt.isClockSynchronized());
+    TEST_ASSERT_TRUE(pair.bot.isClockSynchronized());
+    TEST_ASSERT_EQUAL_UINT32(0, pair.belt.getRejectedFrameCount());
+    TEST_ASSERT_EQUAL_UINT32(0, pair.belt.getLossStats().retransmits);
+}
+
+void test_start_needs_callbacks(void) {
+    LoopbackTransport a, b;
+    LoopbackTransport::connect(a, b);
+    EspNowNode node(&a, Mode::Transmitter, true);
+    TEST_ASSERT_FALSE(node.startPolled());
+    TEST_ASSERT_FALSE(node.is_esp_now_setup());
+}
+
+#define SENT_LOG_DEPTH 16
+
+static ESP_NOW_PACKET sentLog[SENT_LOG_DEPTH];  // Frames the belt sent, oldest first.
+static int sentCount = 0;
+
+static BaseType_t logSent(const ESP_NOW_PACKET *packet) {
+    if(sentCount < SENT_LOG_DEPTH) sentLog[sentCount++] = *packet;
+    return pdPASS;
+}
+
+/**
+ * A safety command sent while a ping is in flight must not take the ping's place: when the
+ * reply times out it is the ping that goes again, and the reply that finally comes is taken.
+ */
+void test_command_keeps_the_ping_in_flight(void) {
+    NodePair pair;
+    pair.belt.setStreaming(false);
+    pair.bot.setStreaming(false);
+    TEST_ASSERT_TRUE(pair.start());
+    runPair(&pair, 100000);
+    TEST_ASSERT_EQUAL(st_PINGING, pair.belt.getProtocolState());
+    pair.belt.registerDataSentCallBack(logSent);
+    sentCount = 0;
+    LOSS_STATS before = pair.belt.getLossStats();
+
+    // A ping goes out, then the command, before the bot gets to either.
+    platformAdvanceMicros(HARNESS_STEP_US);
+    serviceNode(&pair.belt);
+    TEST_ASSERT_EQUAL(1, sentCount);
+    ESP_NOW_PACKET ping = sentLog[0];
+    TEST_ASSERT_EQUAL(Header::TRIGGER_PING, ping.header);
+    TEST_ASSERT_NOT_EQUAL(0, pair.belt.sendCommand(cmd_STOP, 0));
+    serviceNode(&pair.belt);
+    TEST_ASSERT_EQUAL(2, sentCount);
+    TEST_ASSERT_EQUAL(Header::COMMAND, sentLog[1].header);
+
+    // The reply is overdue, so the ping is resent as it was.
+    platformAdvanceMicros(pair.belt.getLossStats().retransmitTimeout);
+    serviceNode(&pair.belt);
+    TEST_ASSERT_EQUAL(3, sentCount);
+    TEST_ASSERT_EQUAL(Header::TRIGGER_PING, sentLog[2].header);
+    TEST_ASSERT_EQUAL_UINT16(ping.seq, sentLog[2].seq);
+    TEST_ASSERT_EQUAL_UINT32(before.retransmits + 1, pair.belt.getLossStats().retransmits);
+
+    // The bot answers the ping once, carries the command out once, and the belt takes the answer.
+    serviceNode(&pair.bot);
+    serviceNode(&pair.belt);
+    runPair(&pair, 100000);
+    TEST_ASSERT_EQUAL_UINT32(1, harness.commands);
+    TEST_ASSERT_EQUAL_UINT32(before.staleAcks, pair.belt.getLossStats().staleAcks);
+    TEST_ASSERT_EQUAL_UINT32(before.retransmits + 1, pair.belt.getLossStats().retransmits);
+    TEST_ASSERT_EQUAL_UINT32(1, pair.belt.getCommandStats().acked);
+
+    // The command came in on the bot's priority ring, not its ordinary one.
+    RingStats priority = pair.bot.getPriorityQueueStats();
+    TEST_ASSERT_GREATER_OR_EQUAL(1, priority.pushed);
+    TEST_ASSERT_EQUAL_UINT32(0, priority.dropped);
+}
+
+static uint32_t handshakesSent = 0;    // HANDSHAKE frames either node was done with.
+
+static BaseType_t countHandshakes(const ESP_NOW_PACKET *packet) {
+    if(packet->header == Header::HANDSHAKE) handshakesSent++;
+    return pdPASS;
+}
+
+/**
+ * The bot's end goes down for a few seconds at a time. Both nodes must declare the link lost
+ * within LINK_LOSS_MISSES heartbeats, and once the bot is back the session must resume where
+ * it left off, without a new handshake.
+ */
+void test_outage_is_detected_and_resumed(void) {
+    const int OUTAGES = 5;
+    const int64_t DETECT_BOUND_US = (int64_t) LINK_LOSS_MISSES * LINK_HEARTBEAT_US;
+    NodePair pair;
+    TEST_ASSERT_TRUE(pair.start());
+    runPair(&pair, 1000000);
+    TEST_ASSERT_EQUAL(st_PINGING, pair.belt.getProtocolState());
+    pair.belt.registerDataSentCallBack(countHandshakes);
+    pair.bot.registerDataSentCallBack(countHandshakes);
+    handshakesSent = 0;
+
+    EspNowNode *nodes[2] = {&pair.belt, &pair.bot};
+    int64_t slowestResume = 0;      // Longest from the bot coming back to both ends being up (us).
+    for(int i = 0; i < OUTAGES; i++) {
+        int64_t downAt = platformMicros();
+        int64_t downUs = 3000000 + i * 1000000;
+        pair.botLink.end();
+
+        // Both ends notice the silence in time.
+        int64_t detected[2] = {-1, -1};
+        while(platformMicros() < downAt + downUs) {
+            serviceNode(&pair.belt);
+            serviceNode(&pair.bot);
+            for(int n = 0; n < 2; n++) {
+                if(detected[n] < 0 && !nodes[n]->isLinkUp()) detected[n] = platformMicros() - downAt;
+            }
+            platformAdvanceMicros(HARNESS_STEP_US);
+        }
+        for(int n = 0; n < 2; n++) {
+            TEST_ASSERT_GREATER_OR_EQUAL(0, detected[n]);
+            TEST_ASSERT_LESS_OR_EQUAL(DETECT_BOUND_US, detected[n]);
+        }
+
+        // The bot comes back, both ends hear each other within a heartbeat, and the exchange picks up again.
+        TEST_ASSERT_TRUE(pair.botLink.begin());
+        int64_t backAt = platformMicros();
+        uint32_t pings = harness.pings;
+        while((!pair.belt.isLinkUp() || !pair.bot.isLinkUp()) && platformMicros() < backAt + LINK_HEARTBEAT_US) {
+            serviceNode(&pair.belt);
+            serviceNode(&pair.bot);
+            platformAdvanceMicros(HARNESS_STEP_US);
+        }
+        int64_t resumedUs = platformMicros() - backAt;
+        TEST_ASSERT_LESS_THAN(LINK_HEARTBEAT_US, resumedUs);
+        if(resumedUs > slowestResume) slowestResume = resumedUs;
+        runPair(&pair, 1000000);
+        TEST_ASSERT_GREATER_THAN(pings, harness.pings);
+        for(EspNowNode *node : nodes) {
+            TEST_ASSERT_TRUE(node->isLinkUp());
+            TEST_ASSERT_EQUAL(st_PINGING, node->getProtocolState());
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, handshakesSent);
+    TEST_ASSERT_TRUE(pair.belt.isClockSynchronized());
+    TEST_ASSERT_TRUE(pair.bot.isClockSynchronized());
+
+    const char *names[2] = {"belt", "bot"};
+    for(int n = 0; n < 2; n++) {
+        LINK_RECOVERY_STATS recovery = nodes[n]->getRecoveryStats();
+        TEST_ASSERT_EQUAL_UINT32(OUTAGES, recovery.outages);
+        TEST_ASSERT_EQUAL_UINT32(OUTAGES, recovery.recoveries);
+        TEST_ASSERT_EQUAL_UINT32(OUTAGES, recovery.recoveryTime.getCount());
+
+        char message[160];
+        snprintf(message, sizeof(message), "%s: %u outages, recovery min %u us, p50 %u us, p90 %u us, max %u us",
+                 names[n], (unsigned) recovery.outages, (unsigned) recovery.recoveryTime.getMin(),
+                 (unsigned) recovery.recoveryTime.percentile(50), (unsigned) recovery.recoveryTime.percentile(90),
+                 (unsigned) recovery.recoveryTime.getMax());
+        TEST_MESSAGE(message);
+    }
+    char message[96];
+    snprintf(message, sizeof(message), "both ends up at most %ld us after the bot came back", (long) slowestResume);
+    TEST_MESSAGE(message);
+}
+
+/**
+ * Minutes of simulated link with every fault the injector has, in both directions. The
+ * exchange must never stall, the link must come back from every outage, and the clocks must
+ * stay in sync, whatever is dropped, repeated, corrupted or held back.
+ */
+static void soak(bool streaming) {
+    const int64_t WINDOW_US = 5000000;
+    const int WINDOWS = 60;
+    NodePair pair;
+    pair.belt.setStreaming(streaming);
+    pair.bot.setStreaming(streaming);
+
+    FAULT_PROFILE faults = {};
+    faults.drop = 0.05f;
+    faults.burstStart = 0.01f;
+    faults.burstLength = 4;
+    faults.duplicate = 0.02f;
+    faults.corrupt = 0.02f;
+    faults.reorder = 0.02f;
+    faults.delay = 0.05f;
+    faults.delayMinUs = 1000;
+    faults.delayMaxUs = 20000;
+    TEST_ASSERT_TRUE(pair.belt.injectFaults(faults, faults, 0x5EED));
+    TEST_ASSERT_TRUE(pair.bot.injectFaults(faults, faults, 0xB07));
+    TEST_ASSERT_TRUE(pair.start());
+
+    uint32_t slowestWindow = UINT32_MAX;
+    for(int w = 0; w < WINDOWS; w++) {
+        uint32_t before = harness.pings;
+        runPair(&pair, WINDOW_US);
+        uint32_t pings = harness.pings - before;
+        if(w > 0 && pings < slowestWindow) slowestWindow = pings;
+    }
+
+    // Every window kept exchanging.
+    TEST_ASSERT_GREATER_THAN(10, slowestWindow);
+    TEST_ASSERT_EQUAL(streaming, pair.belt.isStreaming());
+    // Request/response can back off past the loss timeout in a long burst, but must always come back.
+    EspNowNode *nodes[2] = {&pair.belt, &pair.bot};
+    for(EspNowNode *node : nodes) {
+        LINK_RECOVERY_STATS recovery = node->getRecoveryStats();
+        if(streaming) TEST_ASSERT_EQUAL_UINT32(0, recovery.outages);
+        TEST_ASSERT_EQUAL_UINT32(recovery.outages, recovery.recoveries);
+        TEST_ASSERT_TRUE(node->isLinkUp());
+    }
+    TEST_ASSERT_TRUE(pair.belt.isClockSynchronized());
+    TEST_ASSERT_TRUE(pair.bot.isClockSynchronized());
+
+    // The faults really happened, and were caught where they should be.
+    FAULT_STATS outgoing = pair.belt.getOutgoingFaultStats();
+    TEST_ASSERT_GREATER_THAN(0, outgoing.dropped + outgoing.burstDropped);
+    TEST_ASSERT_GREATER_THAN(0, outgoing.corrupted);
+    TEST_ASSERT_GREATER_THAN(0, pair.bot.getRejectedFrameCount());
+    TEST_ASSERT_GREATER_THAN(0, pair.bot.getLossStats().duplicates);
+    if(!streaming) TEST_ASSERT_GREATER_THAN(0, pair.belt.getLossStats().retransmits);
+
+    char message[128];
+    LINK_STATS link = pair.belt.getLinkStats();
+    snprintf(message, sizeof(message), "%s: %u pings in %d s, slowest %d s window %u, loss rate %.3f",
+             streaming ? "streaming" : "request/response", (unsigned) harness.pings,
+             (int) (WINDOWS * WINDOW_US / 1000000), (int) (WINDOW_US / 1000000), (unsigned) slowestWindow, link.lossRate);
+    TEST_MESSAGE(message);
+}
+
+void test_soak_request_response_with_faults(void) {
+    soak(false);
+}
+
+void test_soak_streaming_with_faults(void) {
+    soak(true);
+}
+
+/**
+ * How many exchanges a pair gets through per second of host time, with nothing lost.
+ */
+void test_exchange_benchmark(void) {
+    NodePair pair;
+    TEST_ASSERT_TRUE(pair.start());
+    runPair(&pair, 100000);
+
+    uint32_t framesBefore = pair.beltLink.getDeliveredCount() + pair.botLink.getDeliveredCount();
+    auto begin = std::chrono::steady_clock::now();
+    runPair(&pair, 30000000);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    uint32_t frames = pair.beltLink.getDeliveredCount() + pair.botLink.getDeliveredCount() - framesBefore;
+    uint32_t exchanges = frames / 2;        // A ping and its reply.
+
+    TEST_ASSERT_GREATER_THAN(1000, exchanges / seconds);
+    char message[128];
+    snprintf(message, sizeof(message), "%u exchanges (%u frames) in %.3f s: %.0f exchanges/s, %.2f us per frame",
+             (unsigned) exchanges, (unsigned) frames, seconds, exchanges / seconds, seconds * 1e6 / frames);
+    TEST_MESSAGE(message);
+}
+
+struct _mode_run {
+    double pingsPerSecond;      // Frames from the belt per simulated second.
+    double framesPerPing;       // Frames on air, both ways, per frame from the belt.
+};
+typedef struct _mode_run MODE_RUN;
+
+/**
+ * Run a pair in one exchange mode for a while of simulated time, with a millisecond's
+ * latency each way and a share of the frames lost.
+ */
+static MODE_RUN runMode(bool streaming, float drop) {
+    const int64_t RUN_US = 10000000;
+    NodePair pair;
+    pair.belt.setStreaming(streaming);
+    pair.bot.setStreaming(streaming);
+    FAULT_PROFILE faults = {};
+    faults.drop = drop;
+    faults.delay = 1;
+    faults.delayMinUs = 1000;
+    faults.delayMaxUs = 1000;
+    TEST_ASSERT_TRUE(pair.belt.injectFaults(faults, faults, 0x5EED));
+    TEST_ASSERT_TRUE(pair.bot.injectFaults(faults, faults, 0xB07));
+    TEST_ASSERT_TRUE(pair.start());
+    runPair(&pair, 100000);
+    TEST_ASSERT_EQUAL(streaming, pair.belt.isStreaming());
+
+    uint32_t beltBefore = pair.beltLink.getDeliveredCount();
+    uint32_t botBefore = pair.botLink.getDeliveredCount();
+    runPair(&pair, RUN_US);
+    uint32_t belt = pair.beltLink.getDeliveredCount() - beltBefore;
+    uint32_t bot = pair.botLink.getDeliveredCount() - botBefore;
+
+    MODE_RUN res;
+    res.pingsPerSecond = belt * 1e6 / RUN_US;
+    res.framesPerPing = (double) (belt + bot) / belt;
+    return res;
+}
+
+/**
+ * Frames on air and ping rate of streaming against request/response, over a clean link and
+ * a lossy one. Streaming must put fewer frames on air per ping and, no longer waiting out
+ * the round trip, ping at least twice as often.
+ */
+void test_streaming_against_request_response(void) {
+    const float drops[2] = {0, 0.05f};
+    for(float drop : drops) {
+        MODE_RUN requestResponse = runMode(false, drop);
+        MODE_RUN streaming = runMode(true, drop);
+
+        TEST_ASSERT_FLOAT_WITHIN(0.1, 2.0, requestResponse.framesPerPing);
+        TEST_ASSERT_LESS_THAN(1.5, streaming.framesPerPing);
+        TEST_ASSERT_GREATER_THAN(2 * requestResponse.pingsPerSecond, streaming.pingsPerSecond);
+
+        char message[160];
+        snprintf(message, sizeof(message),
+                 "drop %.2f: request/response %.0f pings/s, %.2f frames/ping; streaming %.0f pings/s, %.2f frames/ping",
+                 drop, requestResponse.pingsPerSecond, requestResponse.framesPerPing,
+                 streaming.pingsPerSecond, streaming.framesPerPing);
+        TEST_MESSAGE(message);
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_nodes_handshake_then_ping);
+    RUN_TEST(test_start_needs_callbacks);
+    RUN_TEST(test_command_keeps_the_ping_in_flight);
+    RUN_TEST(test_outage_is_detected_and_resumed);
+    RUN_TEST(test_soak_request_response_with_faults);
+    RUN_TEST(test_soak_streaming_with_faults);
+    RUN_TEST(test_exchange_benchmark);
+    RUN_TEST(test_streaming_against_request_response);
+    return UNITY_END();
+}
@@ -0,0 +1,176 @@
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "EspNowNode/EspNowPacket.h"
+
+static ESP_NOW_PACKET packet;
+static uint8_t wire[ESPNOW_MAX_FRAME_SIZE];
+
+void setUp(void) {
+    clearPacket(&packet, Header::COMMAND, AckMessage::Received_Ping);
+    packet.seq = 0x1234;
+    packet.ackSeq = 0xBEEF;
+}
+
+void tearDown(void) {}
+
+/**
+ * Encode the packet and copy the bytes that would go on the air into `wire`.
+ */
+static size_t encodeToWire(uint64_t timestamp) {
+    size_t len = encodePacket(&packet, timestamp);
+    memcpy(wire, &packet, len);
+    return len;
+}
+
+void test_round_trip_keeps_header_and_records(void) {
+    SYNC_RECORD sync = {0x0102030405060708ULL, 0x1112131415161718ULL};
+    TRIGGER_RECORD trigger = {42, 987654321ULL};
+    TEST_ASSERT_TRUE(appendRecord(&packet, RecordType::rec_SYNC, &sync, sizeof(sync)));
+    TEST_ASSERT_TRUE(appendRecord(&packet, RecordType::rec_TRIGGER, &trigger, sizeof(trigger)));
+    packet.flags = PACKET_FLAG_PULL;
+
+    size_t len = encodeToWire(0xCAFEF00DDEADULL);
+    TEST_ASSERT_EQUAL(ESPNOW_PACKET_HEADER_SIZE + 2 * ESPNOW_RECORD_HEADER_SIZE + sizeof(sync) + sizeof(trigger), len);
+
+    const ESP_NOW_PACKET *decoded = decodePacket(wire, len);
+    TEST_ASSERT_NOT_NULL(decoded);
+    TEST_ASSERT_EQUAL(Header::COMMAND, decoded->header);
+    TEST_ASSERT_EQUAL(AckMessage::Received_Ping, decoded->ack);
+    TEST_ASSERT_EQUAL_UINT16(0x1234, decoded->seq);
+    TEST_ASSERT_EQUAL_UINT16(0xBEEF, decoded->ackSeq);
+    TEST_ASSERT_EQUAL_UINT64(0xCAFEF00DDEADULL, decoded->timestamp);
+    TEST_ASSERT_EQUAL_UINT8(PACKET_FLAG_PULL, decoded->flags);
+
+    SYNC_RECORD syncOut;
+    TRIGGER_RECORD triggerOut;
+    TEST_ASSERT_TRUE(readRecord(decoded, RecordType::rec_SYNC, &syncOut, sizeof(syncOut)));
+    TEST_ASSERT_TRUE(readRecord(decoded, RecordType::rec_TRIGGER, &triggerOut, sizeof(triggerOut)));
+    TEST_ASSERT_EQUAL_MEMORY(&sync, &syncOut, sizeof(sync));
+    TEST_ASSERT_EQUAL_MEMORY(&trigger, &triggerOut, sizeof(trigger));
+    TEST_ASSERT_NULL(findRecord(decoded, RecordType::rec_TELEMETRY, NULL));
+}
+
+void test_record_of_wrong_length_is_not_read(void) {
+    EMISSION_RECORD emission = {7, 123};
+    TEST_ASSERT_TRUE(appendRecord(&packet, RecordType::rec_EMISSION, &emission, sizeof(emission)));
+    SYNC_RECORD sync;
+    TEST_ASSERT_FALSE(readRecord(&packet, RecordType::rec_EMISSION, &sync, sizeof(sync)));
+}
+
+void test_full_payload_rejects_further_records(void) {
+    uint8_t filler[ESPNOW_PAYLOAD_SIZE - ESPNOW_RECORD_HEADER_SIZE] = {0};
+    TEST_ASSERT_TRUE(appendRecord(&packet, RecordType::rec_TELEMETRY, filler, sizeof(filler)));
+    TEST_ASSERT_EQUAL(ESPNOW_PAYLOAD_SIZE, packet.payloadLength);
+
+    uint8_t oneByte = 1;
+    TEST_ASSERT_FALSE(appendRecord(&packet, RecordType::rec_ACK, &oneByte, 0));
+    TEST_ASSERT_EQUAL(ESPNOW_PAYLOAD_SIZE, packet.payloadLength);
+
+    size_t len = encodeToWire(1);
+    TEST_ASSERT_EQUAL(ESPNOW_MAX_FRAME_SIZE, len);
+    TEST_ASSERT_NOT_NULL(decodePacket(wire, len));
+}
+
+void test_truncated_frames_are_rejected(void) {
+    TRIGGER_RECORD trigger = {1, 2};
+    appendRecord(&packet, RecordType::rec_TRIGGER, &trigger, sizeof(trigger));
+    size_t len = encodeToWire(5);
+
+    // Every length short of the full frame, including ones shorter than the header.
+    for(size_t cut = 0; cut < len; cut++) TEST_ASSERT_NULL(decodePacket(wire, cut));
+    TEST_ASSERT_NULL(decodePacket(NULL, len));
+
+    // Trailing bytes the header doesn't account for are rejected too.
+    TEST_ASSERT_NULL(decodePacket(wire, len + 1));
+    TEST_ASSERT_NOT_NULL(decodePacket(wire, len));
+}
+
+void test_corrupt_frames_fail_the_crc(void) {
+    TRIGGER_RECORD trigger = {9, 99};
+    appendRecord(&packet, RecordType::rec_TRIGGER, &trigger, sizeof(trigger));
+    size_t len = encodeToWire(77);
+
+    // Flip every bit outside the magic, version and length fields, which are checked on their own.
+    for(size_t i = 0; i < len; i++) {
+        if(i == offsetof(ESP_NOW_PACKET, magic) || i == offsetof(ESP_NOW_PACKET, version) ||
+           i == offsetof(ESP_NOW_PACKET, payloadLength)) continue;
+        for(int bit = 0; bit < 8; bit++) {
+            wire[i] ^= (1 << bit);
+            TEST_ASSERT_NULL(decodePacket(wire, len));
+            wire[i] ^= (1 << bit);
+        }
+    }
+    TEST_ASSERT_NOT_NULL(decodePacket(wire, len));
+}
+
+void test_foreign_magic_and_version_are_rejected(void) {
+    size_t len = encodeToWire(3);
+
+    wire[offsetof(ESP_NOW_PACKET, magic)] = ESPNOW_WIRE_MAGIC ^ 0xFF;
+    TEST_ASSERT_NULL(decodePacket(wire, len));
+
+    // A frame from another version is rejected even with a CRC that matches.
+    encodeToWire(3);
+    ESP_NOW_PACKET *other = (ESP_NOW_PACKET *) wire;
+    other->version = ESPNOW_WIRE_VERSION + 1;
+    other->crc = 0;
+    uint16_t crc = crc16(wire, len);
+    other->crc = crc;
+    TEST_ASSERT_NULL(decodePacket(wire, len));
+}
+
+void test_payload_length_past_the_frame_is_rejected(void) {
+    size_t len = encodeToWire(3);
+    wire[offsetof(ESP_NOW_PACKET, payloadLength)] = ESPNOW_PAYLOAD_SIZE + 1;
+    TEST_ASSERT_NULL(decodePacket(wire, len));
+    TEST_ASSERT_NULL(decodePacket(wire, ESPNOW_MAX_FRAME_SIZE));
+}
+
+void test_crc_matches_the_ccitt_false_check_value(void) {
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16(check, sizeof(check)));
+}
+
+/**
+ * Encode and decode a frame like the ones sent while streaming: ack, sync and a telemetry batch.
+ */
+void test_codec_throughput(void) {
+    const int FRAMES = 200000;
+    ACK_RECORD ack = {100, 0xFFFFFFFF, 250};
+    SYNC_RECORD sync = {1, 2};
+    uint8_t telemetry[64] = {0};
+    appendRecord(&packet, RecordType::rec_ACK, &ack, sizeof(ack));
+    appendRecord(&packet, RecordType::rec_SYNC, &sync, sizeof(sync));
+    appendRecord(&packet, RecordType::rec_TELEMETRY, telemetry, sizeof(telemetry));
+
+    uint32_t decoded = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for(int i = 0; i < FRAMES; i++) {
+        size_t len = encodeToWire(i);
+        const ESP_NOW_PACKET *view = decodePacket(wire, len);
+        if(view != NULL && readRecord(view, RecordType::rec_SYNC, &sync, sizeof(sync))) decoded++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    TEST_ASSERT_EQUAL_UINT32(FRAMES, decoded);
+
+    char message[96];
+    snprintf(message, sizeof(message), "%u-byte frames: %.0f encode+decode/s, %.0f ns each",
+             (unsigned) packetWireLength(&packet), FRAMES / seconds, seconds * 1e9 / FRAMES);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_keeps_header_and_records);
+    RUN_TEST(test_record_of_wrong_length_is_not_read);
+    RUN_TEST(test_full_payload_rejects_further_records);
+    RUN_TEST(test_truncated_frames_are_rejected);
+    RUN_TEST(test_corrupt_frames_fail_the_crc);
+    RUN_TEST(test_foreign_magic_and_version_are_rejected);
+    RUN_TEST(test_payload_length_past_the_frame_is_rejected);
+    RUN_TEST(test_crc_matches_the_ccitt_false_check_value);
+    RUN_TEST(test_codec_throughput);
+    return UNITY_END();
+}
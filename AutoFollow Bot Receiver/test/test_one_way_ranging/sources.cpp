@@ -0,0 +1,3 @@
+// The native env doesn't build SharedFiles, so the suite compiles the code it covers itself.
+#include "EspNowNode/ClockSync.cpp"
+#include "EspNowNode/OneWayRanger.cpp"
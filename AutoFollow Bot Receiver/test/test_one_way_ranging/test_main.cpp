@@ -0,0 +1,183 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include "HCSR04/CaptureClock.h"
+#include "EspNowNode/ClockSync.h"
+#include "EspNowNode/OneWayRanger.h"
+#include "EspNowNode/FaultyTransport.h"
+
+#define CAPTURE_HZ 80000000         // Tick rate of the MCPWM capture timer.
+#define TICKS_PER_US (CAPTURE_HZ / 1000000)
+#define RUNS 200                    // Belt and bot pairs simulated.
+#define EXCHANGES 300               // Clock sync exchanges, each followed by a burst, per pair.
+#define EXCHANGE_PERIOD_US 80000
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/**
+ * One node's clocks: esp_timer, running at an offset and drift from true time, and the
+ * capture counter, off the same crystal but started at a random phase.
+ */
+struct SimClock {
+    double offsetUs;
+    double drift;
+    uint32_t phase;
+
+    double at(double t) const { return offsetUs + (1 + drift) * t; }
+    int64_t read(double t) const { return (int64_t) floor(at(t)); }
+    uint32_t ticks(double t) const { return phase + (uint32_t) (uint64_t) floor(at(t) * TICKS_PER_US); }
+
+    /**
+     * Take a reference pair the way the capture driver does: esp_timer read, the counter
+     * latched some time later, esp_timer read again.
+     */
+    void reference(CaptureClock *clock, double t, FaultRandom &random) const {
+        double latchedAt = t + random.between(0, 30);
+        double after = latchedAt + random.between(0, 30);
+        clock->setReference(ticks(latchedAt), read(t), read(after));
+    }
+};
+
+static SimClock randomClock(FaultRandom &random) {
+    SimClock clock;
+    clock.offsetUs = (double) random.between(0, 2000000000);
+    clock.drift = ((double) random.between(0, 80) - 40) * 1e-6;
+    clock.phase = random.next();
+    return clock;
+}
+
+void test_capture_clock_maps_across_wrap(void) {
+    CaptureClock clock;
+    clock.setResolution(CAPTURE_HZ);
+    int64_t us;
+    TEST_ASSERT_FALSE(clock.toMicros(0, &us));
+
+    uint32_t ref = 0xFFFFFF00u;
+    clock.setReference(ref, 1000, 1000);
+    TEST_ASSERT_TRUE(clock.toMicros(ref + 500 * TICKS_PER_US, &us));
+    TEST_ASSERT_EQUAL_INT64(1500, us);
+    TEST_ASSERT_TRUE(clock.toMicros(ref - 200 * TICKS_PER_US, &us));
+    TEST_ASSERT_EQUAL_INT64(800, us);
+}
+
+void test_capture_clock_bound(void) {
+    CaptureClock clock;
+    clock.setResolution(CAPTURE_HZ, 10);
+    clock.setReference(0, 100, 107);
+    TEST_ASSERT_EQUAL_UINT32(4 + 2 + 10, clock.boundUs());
+
+    // Reads out of order aren't a reference, and a new resolution drops the one there was.
+    clock.reset();
+    clock.setReference(0, 107, 100);
+    TEST_ASSERT_FALSE(clock.hasReference());
+    clock.setReference(0, 100, 107);
+    clock.setResolution(CAPTURE_HZ);
+    TEST_ASSERT_FALSE(clock.hasReference());
+}
+
+/**
+ * A repeat of the emission in the slot to be written next must replace it, not push out
+ * the oldest other one.
+ */
+void test_repeat_of_next_slot_keeps_others(void) {
+    OneWayRanger ranger;
+    for(uint16_t id = 1; id <= RANGING_EMISSIONS; id++) ranger.addEmission(id, id * 1000, 0);
+    ranger.addEmission(1, 1000, 0);
+    ranger.addEmission(RANGING_EMISSIONS + 1, 9000, 0);
+
+    RANGE_RESULT result;
+    TEST_ASSERT_EQUAL(range_OK, ranger.range(2, 2000 + 100, 0, &result));
+    TEST_ASSERT_EQUAL(range_PENDING, ranger.range(1, 1000 + 100, 0, &result));
+    TEST_ASSERT_EQUAL_UINT32(RANGING_EMISSIONS + 1, ranger.getStats().emissions);
+}
+
+/**
+ * Belt and bot on clocks of random offset and drift, each timestamping its echo edge on a
+ * capture counter of random phase and mapping it through a reference of random spread. The
+ * bot maps the belt's emission through clock sync and ranges its arrival; the flight must
+ * come out within the bound given for it, every time.
+ */
+void test_flight_error_within_bound(void) {
+    FaultRandom random(0x0E4A);
+    uint32_t checks = 0;
+    uint32_t ranged = 0;
+    uint32_t outside = 0;
+    uint32_t captureOutside = 0;        // Capture timestamps mapped further out than their own bound.
+    double worstError = 0;
+    double boundSum = 0;
+
+    for(int run = 0; run < RUNS; run++) {
+        SimClock belt = randomClock(random);
+        SimClock bot = randomClock(random);
+        ClockSync sync;
+        OneWayRanger ranger;
+        CaptureClock beltCapture, botCapture;
+        beltCapture.setResolution(CAPTURE_HZ);
+        botCapture.setResolution(CAPTURE_HZ);
+        double t = 1e6;
+        uint16_t triggerId = 0;
+
+        for(int k = 0; k < EXCHANGES; k++, t += EXCHANGE_PERIOD_US) {
+            // The bot polls, the belt answers.
+            double there = random.between(300, 2000);
+            double turn = random.between(200, 500);
+            double back = random.between(300, 2000);
+            sync.addExchange(bot.read(t), belt.read(t + there), belt.read(t + there + turn),
+                             bot.read(t + there + turn + back));
+            if(!sync.isSynchronized()) continue;
+
+            // Both sample their capture clocks before the trigger, and the burst goes out after it.
+            double sampledAt = t + 5000;
+            belt.reference(&beltCapture, sampledAt, random);
+            bot.reference(&botCapture, sampledAt + random.between(0, 2000), random);
+            double emittedAt = sampledAt + 40000 + random.between(0, 1000);
+            double flight = random.between(500, 20000) + random.between(0, 99) / 100.0;
+
+            int64_t beltEmitted, botArrived;
+            TEST_ASSERT_TRUE(beltCapture.toMicros(belt.ticks(emittedAt), &beltEmitted));
+            TEST_ASSERT_TRUE(botCapture.toMicros(bot.ticks(emittedAt + flight), &botArrived));
+            if(fabs(beltEmitted - belt.at(emittedAt)) > beltCapture.boundUs()) captureOutside++;
+            if(fabs(botArrived - bot.at(emittedAt + flight)) > botCapture.boundUs()) captureOutside++;
+            int64_t emittedLocal = sync.fromPeerTime(beltEmitted);
+            ranger.addEmission(++triggerId, emittedLocal, sync.errorBoundAt(emittedLocal) + beltCapture.boundUs());
+
+            // The true flight in the bot's clock. A flight that maps out negative while the sync is
+            // still loose is turned down, but has to be within the bound all the same.
+            double truth = bot.at(emittedAt + flight) - bot.at(emittedAt);
+            uint32_t boundUs = sync.errorBoundAt(emittedLocal) + beltCapture.boundUs() + botCapture.boundUs();
+            double error = fabs((botArrived - emittedLocal) - truth);
+            RANGE_RESULT result;
+            RangeStatus status = ranger.range(triggerId, botArrived, botCapture.boundUs(), &result);
+            if(status == range_OK) {
+                TEST_ASSERT_EQUAL_UINT32(boundUs, result.boundUs);
+                ranged++;
+            } else {
+                TEST_ASSERT_EQUAL(range_IMPLAUSIBLE, status);
+            }
+            checks++;
+            boundSum += boundUs;
+            if(error > worstError) worstError = error;
+            if(error > boundUs) outside++;
+        }
+    }
+
+    TEST_ASSERT_GREATER_THAN(checks * 9 / 10, ranged);
+    TEST_ASSERT_EQUAL_UINT32(0, captureOutside);
+    TEST_ASSERT_EQUAL_UINT32(0, outside);
+
+    char message[128];
+    snprintf(message, sizeof(message), "%u of %u ranged: worst error %.1f us, mean bound %.1f us",
+             ranged, checks, worstError, boundSum / checks);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_capture_clock_maps_across_wrap);
+    RUN_TEST(test_capture_clock_bound);
+    RUN_TEST(test_repeat_of_next_slot_keeps_others);
+    RUN_TEST(test_flight_error_within_bound);
+    return UNITY_END();
+}
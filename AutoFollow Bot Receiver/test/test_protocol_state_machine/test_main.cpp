@@ -0,0 +1,199 @@
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include "EspNowNode/ProtocolStateMachine.h"
+
+static int pauses = 0;
+
+static void countPauses(ProtocolAction action, void *context) {
+    if(action == act_PAUSE) pauses++;
+}
+
+/**
+ * The protocol's rules written out as branches, the way determineNextHeader used to be, to
+ * check the tables against and to time them against.
+ */
+static ProtocolState referenceNext(ProtocolState state, ProtocolEvent event) {
+    bool announced = state != st_IDLE && state != st_ANNOUNCE_HANDSHAKE && state != st_ANNOUNCE_PING;
+    switch(event) {
+        case ev_RX_HANDSHAKE:
+            return announced ? st_CONNECTED : st_ANNOUNCE_HANDSHAKE;
+        case ev_RX_PING:
+            return announced ? st_PINGING : st_ANNOUNCE_PING;
+        case ev_RX_WAVE:
+            return st_CLOSING;
+        case ev_FRAME_BUILT:
+            // The first frame sent is the handshake announcing this node.
+            if(state == st_IDLE || state == st_ANNOUNCE_HANDSHAKE) return st_CONNECTED;
+            if(state == st_ANNOUNCE_PING) return st_PINGING;
+            if(state == st_CLOSING) return st_CLOSED;
+            return state;
+        default:
+            return state;
+    }
+}
+
+static Header referenceHeader(ProtocolState state) {
+    return (state == st_CONNECTED || state == st_PINGING) ? Header::TRIGGER_PING : Header::HANDSHAKE;
+}
+
+static AckMessage referenceAck(ProtocolState state) {
+    switch(state) {
+        case st_ANNOUNCE_PING:
+        case st_PINGING:
+            return AckMessage::Received_Ping;
+        case st_CLOSING:
+        case st_CLOSED:
+            return AckMessage::Received_Wave;
+        default:
+            return AckMessage::Received_Handshake;
+    }
+}
+
+/**
+ * Drive a machine from start into a state through the events themselves, breadth first.
+ */
+static bool driveTo(ProtocolStateMachine *machine, ProtocolState target) {
+    ProtocolEvent path[st_COUNT][st_COUNT];
+    int length[st_COUNT];
+    bool seen[st_COUNT] = {false};
+    ProtocolState queue[st_COUNT];
+    int head = 0, tail = 0;
+    queue[tail++] = st_IDLE;
+    seen[st_IDLE] = true;
+    length[st_IDLE] = 0;
+    while(head < tail) {
+        ProtocolState from = queue[head++];
+        for(int e = 0; e < ev_COUNT; e++) {
+            ProtocolState to = ProtocolStateMachine::transitions[from][e];
+            if(seen[to]) continue;
+            seen[to] = true;
+            for(int i = 0; i < length[from]; i++) path[to][i] = path[from][i];
+            path[to][length[from]] = (ProtocolEvent) e;
+            length[to] = length[from] + 1;
+            queue[tail++] = to;
+        }
+    }
+    if(!seen[target]) return false;
+
+    machine->reset();
+    for(int i = 0; i < length[target]; i++) machine->dispatch(path[target][i]);
+    return machine->getState() == target;
+}
+
+void setUp(void) {
+    pauses = 0;
+}
+
+void tearDown(void) {}
+
+void test_fresh_node_announces_itself(void) {
+    ProtocolStateMachine machine;
+    TEST_ASSERT_EQUAL(st_IDLE, machine.getState());
+    TEST_ASSERT_EQUAL(Header::HANDSHAKE, machine.nextHeader());
+
+    // Even when the first thing heard is a ping.
+    machine.dispatch(ev_RX_PING);
+    TEST_ASSERT_EQUAL(Header::HANDSHAKE, machine.nextHeader());
+    TEST_ASSERT_EQUAL(AckMessage::Received_Ping, machine.nextAck());
+    machine.dispatch(ev_FRAME_BUILT);
+    TEST_ASSERT_EQUAL(Header::TRIGGER_PING, machine.nextHeader());
+}
+
+void test_every_state_is_reachable(void) {
+    ProtocolStateMachine machine;
+    for(int s = 0; s < st_COUNT; s++) TEST_ASSERT_TRUE(driveTo(&machine, (ProtocolState) s));
+}
+
+/**
+ * Every event in every state, against the rules written out as branches, with the actions
+ * run exactly when the state changes.
+ */
+void test_transition_table_is_exhaustive(void) {
+    ProtocolStateMachine machine;
+    machine.setActionCallback(countPauses, NULL);
+    for(int s = 0; s < st_COUNT; s++) {
+        for(int e = 0; e < ev_COUNT; e++) {
+            char message[48];
+            snprintf(message, sizeof(message), "state %d event %d", s, e);
+            TEST_ASSERT_TRUE_MESSAGE(driveTo(&machine, (ProtocolState) s), message);
+            pauses = 0;
+
+            ProtocolState expected = referenceNext((ProtocolState) s, (ProtocolEvent) e);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(expected, machine.dispatch((ProtocolEvent) e), message);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(referenceHeader(expected), machine.nextHeader(), message);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(referenceAck(expected), machine.nextAck(), message);
+            TEST_ASSERT_EQUAL_INT_MESSAGE((expected == st_CLOSED && s != st_CLOSED) ? 1 : 0, pauses, message);
+        }
+    }
+}
+
+void test_out_of_range_event_is_ignored(void) {
+    ProtocolStateMachine machine;
+    machine.dispatch(ev_RX_PING);
+    TEST_ASSERT_EQUAL(st_ANNOUNCE_PING, machine.dispatch(ev_COUNT));
+}
+
+void test_headers_map_to_events(void) {
+    TEST_ASSERT_EQUAL(ev_RX_HANDSHAKE, ProtocolStateMachine::eventFor(Header::HANDSHAKE));
+    TEST_ASSERT_EQUAL(ev_RX_PING, ProtocolStateMachine::eventFor(Header::TRIGGER_PING));
+    TEST_ASSERT_EQUAL(ev_RX_WAVE, ProtocolStateMachine::eventFor(Header::WAVE));
+    TEST_ASSERT_EQUAL(ev_RX_OTHER, ProtocolStateMachine::eventFor(Header::ACK));
+    TEST_ASSERT_EQUAL(ev_RX_OTHER, ProtocolStateMachine::eventFor(Header::COMMAND));
+    TEST_ASSERT_EQUAL(ev_RX_OTHER, ProtocolStateMachine::eventFor(Header::EMISSION));
+}
+
+/**
+ * Time table dispatch, header and ack lookup against the same rules run as branches, over a
+ * fixed pseudo-random event stream.
+ */
+void test_dispatch_benchmark(void) {
+    const int EVENTS = 1 << 16;
+    const int ROUNDS = 200;
+    static ProtocolEvent events[EVENTS];
+    uint32_t seed = 1;
+    for(int i = 0; i < EVENTS; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        events[i] = (ProtocolEvent) ((seed >> 16) % ev_COUNT);
+    }
+
+    ProtocolStateMachine machine;
+    uint32_t tableSum = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for(int r = 0; r < ROUNDS; r++) {
+        for(int i = 0; i < EVENTS; i++) {
+            machine.dispatch(events[i]);
+            tableSum += machine.nextHeader() + machine.nextAck();
+        }
+    }
+    double tableNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / ((double) ROUNDS * EVENTS);
+
+    ProtocolState state = st_IDLE;
+    uint32_t branchSum = 0;
+    begin = std::chrono::steady_clock::now();
+    for(int r = 0; r < ROUNDS; r++) {
+        for(int i = 0; i < EVENTS; i++) {
+            state = referenceNext(state, events[i]);
+            branchSum += referenceHeader(state) + referenceAck(state);
+        }
+    }
+    double branchNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / ((double) ROUNDS * EVENTS);
+
+    // Both walk the same states, so they must agree.
+    TEST_ASSERT_EQUAL_UINT32(branchSum, tableSum);
+
+    char message[96];
+    snprintf(message, sizeof(message), "dispatch + header + ack: tables %.2f ns/event, branches %.2f ns/event", tableNs, branchNs);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fresh_node_announces_itself);
+    RUN_TEST(test_every_state_is_reachable);
+    RUN_TEST(test_transition_table_is_exhaustive);
+    RUN_TEST(test_out_of_range_event_is_ignored);
+    RUN_TEST(test_headers_map_to_events);
+    RUN_TEST(test_dispatch_benchmark);
+    return UNITY_END();
+}
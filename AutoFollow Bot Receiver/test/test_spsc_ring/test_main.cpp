@@ -0,0 +1,114 @@
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "EspNowNode/SpscRing.h"
+
+struct _frame {
+    uint32_t seq;
+    uint32_t check;         // Derived from seq, so a torn slot shows up.
+    uint8_t body[56];
+};
+typedef struct _frame FRAME;
+
+static uint32_t checkOf(uint32_t seq) { return seq * 2654435761u ^ 0xA5A5A5A5u; }
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_empty_ring_has_no_front(void) {
+    SpscRing<int, 4> ring;
+    TEST_ASSERT_NULL(ring.front());
+    TEST_ASSERT_EQUAL(0, ring.size());
+}
+
+void test_full_ring_drops_and_counts(void) {
+    SpscRing<int, 4> ring;
+    for(int i = 0; i < 4; i++) {
+        int *slot = ring.reserve();
+        TEST_ASSERT_NOT_NULL(slot);
+        *slot = i;
+        ring.commit();
+    }
+    TEST_ASSERT_NULL(ring.reserve());
+    TEST_ASSERT_NULL(ring.reserve());
+
+    RingStats stats = ring.stats();
+    TEST_ASSERT_EQUAL_UINT32(4, stats.pushed);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.dropped);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.highWater);
+
+    // Items come back in order and free their slots.
+    for(int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(i, *ring.front());
+        ring.pop();
+    }
+    TEST_ASSERT_NULL(ring.front());
+    TEST_ASSERT_NOT_NULL(ring.reserve());
+}
+
+void test_indices_wrap_past_capacity(void) {
+    SpscRing<uint32_t, 2> ring;
+    for(uint32_t i = 0; i < 1000; i++) {
+        *ring.reserve() = i;
+        ring.commit();
+        TEST_ASSERT_EQUAL_UINT32(i, *ring.front());
+        ring.pop();
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, ring.stats().highWater);
+}
+
+/**
+ * A producer thread standing in for the Wi-Fi callback floods the ring while the consumer
+ * drains it. Every item accepted must come out once, whole and in order, and every item
+ * refused must be counted as dropped.
+ */
+void test_producer_thread_never_loses_or_tears_items(void) {
+    const uint32_t ITEMS = 2000000;
+    static SpscRing<FRAME, 16> ring;
+    std::atomic<bool> done{false};
+
+    std::thread producer([&]() {
+        for(uint32_t seq = 0; seq < ITEMS; seq++) {
+            FRAME *slot = ring.reserve();
+            if(slot == NULL) continue;
+            slot->seq = seq;
+            for(size_t i = 0; i < sizeof(slot->body); i++) slot->body[i] = (uint8_t) (seq + i);
+            slot->check = checkOf(seq);
+            ring.commit();
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    uint32_t received = 0, torn = 0, outOfOrder = 0;
+    int64_t last = -1;
+    while(true) {
+        FRAME *frame = ring.front();
+        if(frame == NULL) {
+            if(done.load(std::memory_order_acquire) && ring.front() == NULL) break;
+            continue;
+        }
+        if(frame->check != checkOf(frame->seq) || frame->body[sizeof(frame->body) - 1] != (uint8_t) (frame->seq + sizeof(frame->body) - 1)) torn++;
+        if((int64_t) frame->seq <= last) outOfOrder++;
+        last = frame->seq;
+        received++;
+        ring.pop();
+    }
+    producer.join();
+
+    RingStats stats = ring.stats();
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(received, stats.pushed);
+    TEST_ASSERT_EQUAL_UINT32(ITEMS, stats.pushed + stats.dropped);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(16, stats.highWater);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_ring_has_no_front);
+    RUN_TEST(test_full_ring_drops_and_counts);
+    RUN_TEST(test_indices_wrap_past_capacity);
+    RUN_TEST(test_producer_thread_never_loses_or_tears_items);
+    return UNITY_END();
+}
@@ -0,0 +1,2 @@
+// The native env doesn't build SharedFiles, so the suite compiles the code it covers itself.
+#include "TargetTracker/TargetTracker.cpp"
@@ -0,0 +1,224 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <random>
+#include "TargetTracker/TargetTracker.h"
+#include "TargetTracker/FollowControl.h"
+
+#define BASELINE_IN 12.0        // Distance between the receivers (inches).
+#define RUN_STEPS 1000          // Drive ticks a trajectory is replayed for: 20 s at 50 Hz.
+#define STEP_US 20000           // Time between drive ticks (us).
+#define PING_STEPS 4            // Drive ticks between pings: a ping every 80 ms.
+#define SETTLE_S 2.0            // Time the track is left to settle before errors are counted (s).
+#define MISS_CHANCE 0.1         // Chance each receiver misses a ping.
+#define STRAY_CHANCE 0.03       // Chance each receiver hears a stray echo instead.
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+struct _truth {
+    double range;           // Inches.
+    double rangeRate;       // In/s.
+    double bearing;         // Degrees.
+    double bearingRate;     // Deg/s.
+};
+typedef struct _truth TRUTH;
+
+typedef TRUTH (*Trajectory)(double t);
+
+static TRUTH standingStill(double t) { return {48, 0, 0, 0}; }
+
+static TRUTH walkingAway(double t) { return {36 + 10 * t, 10, 0, 0}; }
+
+static TRUTH weaving(double t) {
+    return {60 + 12 * sin(2 * M_PI * t / 10), 12 * 2 * M_PI / 10 * cos(2 * M_PI * t / 10),
+            30 * sin(2 * M_PI * t / 8), 30 * 2 * M_PI / 8 * cos(2 * M_PI * t / 8)};
+}
+
+static TRUTH steppingAcross(double t) { return {72, 0, (t < 10) ? -20.0 : 20.0, 0}; }
+
+/**
+ * Distance from the belt to a receiver half the baseline off the middle.
+ */
+static double receiverRange(const TRUTH &truth, RxSide side) {
+    double sinB = sin(truth.bearing * M_PI / 180);
+    double cross = (side == side_LEFT) ? truth.range * BASELINE_IN * sinB : -truth.range * BASELINE_IN * sinB;
+    return sqrt(truth.range * truth.range + cross + BASELINE_IN * BASELINE_IN / 4);
+}
+
+struct _rms {
+    double range;           // Inches.
+    double rangeRate;       // In/s.
+    double bearing;         // Degrees.
+    double rawBearing;      // Bearing taken straight from the range difference (degrees).
+};
+typedef struct _rms RMS;
+
+/**
+ * Replay a trajectory with noisy, missed and stray ranges on each side, and take the RMS
+ * error of the estimates the drive task would be handed after the track settles.
+ */
+static RMS replay(Trajectory trajectory, int seed, TRACKER_STATS *stats) {
+    std::mt19937 generator(seed);
+    std::normal_distribution<double> noise(0, TRACK_RANGE_SIGMA_IN);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    TargetTracker tracker(BASELINE_IN);
+    double range = 0, rate = 0, bearing = 0, raw = 0;
+    int estimates = 0, pings = 0;
+
+    for(int step = 0; step < RUN_STEPS; step++) {
+        int64_t now = (int64_t) step * STEP_US;
+        double t = now / 1e6;
+        TRUTH truth = trajectory(t);
+
+        if(step % PING_STEPS == 0) {
+            double left = receiverRange(truth, side_LEFT);
+            double right = receiverRange(truth, side_RIGHT);
+            double heardLeft = left + noise(generator);
+            double heardRight = right + noise(generator);
+            if(uniform(generator) < STRAY_CHANCE) heardLeft += 40 * uniform(generator);
+            if(uniform(generator) < STRAY_CHANCE) heardRight -= 30 * uniform(generator);
+            if(uniform(generator) > MISS_CHANCE) tracker.observeRange(side_LEFT, now + (int64_t) (left * 74), heardLeft);
+            if(uniform(generator) > MISS_CHANCE) tracker.observeRange(side_RIGHT, now + (int64_t) (right * 74) + 50, heardRight);
+
+            double sinRaw = fmax(-1.0, fmin(1.0, (heardLeft - heardRight) / BASELINE_IN));
+            if(t >= SETTLE_S) {
+                raw += pow(asin(sinRaw) * 180 / M_PI - truth.bearing, 2);
+                pings++;
+            }
+        }
+        if(t < SETTLE_S) continue;
+
+        TARGET_ESTIMATE estimate;
+        tracker.estimate(now, &estimate);
+        TEST_ASSERT_TRUE(estimate.tracking);
+        range += pow(estimate.range - truth.range, 2);
+        rate += pow(estimate.rangeRate - truth.rangeRate, 2);
+        bearing += pow(estimate.bearing - truth.bearing, 2);
+        estimates++;
+    }
+
+    *stats = tracker.getStats();
+    return {sqrt(range / estimates), sqrt(rate / estimates), sqrt(bearing / estimates), sqrt(raw / pings)};
+}
+
+/**
+ * RMS errors over each trajectory. The range comes out tighter than a single receiver's, the
+ * bearing several times tighter than the raw range difference gives, and no stray echo
+ * restarts the track.
+ */
+static void checkTrajectory(const char *name, Trajectory trajectory, int seed, double maxBearing) {
+    TRACKER_STATS stats;
+    RMS rms = replay(trajectory, seed, &stats);
+
+    char message[160];
+    snprintf(message, sizeof(message), "%-10s RMS range %.2f in, rate %.2f in/s, bearing %.2f deg (raw difference %.1f deg), %u rejected",
+             name, rms.range, rms.rangeRate, rms.bearing, rms.rawBearing, stats.rejected);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_LESS_THAN(TRACK_RANGE_SIGMA_IN, rms.range);
+    TEST_ASSERT_LESS_THAN(4.0, rms.rangeRate);
+    TEST_ASSERT_LESS_THAN(maxBearing, rms.bearing);
+    TEST_ASSERT_LESS_THAN(rms.rawBearing / 2, rms.bearing);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.restarts);
+    TEST_ASSERT_GREATER_THAN(0, stats.rejected);
+}
+
+void test_standing_still(void) { checkTrajectory("still", standingStill, 1, 6); }
+
+void test_walking_away(void) { checkTrajectory("walk away", walkingAway, 8, 6); }
+
+void test_weaving(void) { checkTrajectory("weave", weaving, 15, 8); }
+
+void test_stepping_across(void) { checkTrajectory("step turn", steppingAcross, 22, 9); }
+
+/**
+ * Ranges far off the track are rejected, until enough in a row restart it on the new range.
+ */
+void test_gate_restarts_after_rejects(void) {
+    TargetTracker tracker(BASELINE_IN);
+    int64_t now = 0;
+    for(int i = 0; i < 20; i++, now += 80000) {
+        tracker.observeRange(side_LEFT, now, 48);
+        tracker.observeRange(side_RIGHT, now, 48);
+    }
+    for(int i = 0; i < TRACK_MAX_REJECTS; i++, now += 80000) TEST_ASSERT_FALSE(tracker.observeRange(side_LEFT, now, 120));
+    TEST_ASSERT_TRUE(tracker.observeRange(side_LEFT, now, 120));
+
+    TARGET_ESTIMATE estimate;
+    tracker.estimate(now, &estimate);
+    TEST_ASSERT_FLOAT_WITHIN(1, 120, estimate.range);
+    TEST_ASSERT_EQUAL_UINT32(2, tracker.getStats().restarts);
+}
+
+void test_target_lost_without_ranges(void) {
+    TargetTracker tracker(BASELINE_IN);
+    tracker.observeRange(side_LEFT, 0, 48);
+    TARGET_ESTIMATE estimate;
+    tracker.estimate(TRACK_LOST_US, &estimate);
+    TEST_ASSERT_TRUE(estimate.tracking);
+    tracker.estimate(TRACK_LOST_US + 1, &estimate);
+    TEST_ASSERT_FALSE(estimate.tracking);
+}
+
+/**
+ * The drive closes on a target beyond the follow distance, turns toward its bearing, waits
+ * on one that comes too close, and stops once it is lost.
+ */
+void test_follow_command(void) {
+    const float FOLLOW_IN = 36;
+    TARGET_ESTIMATE estimate = {};
+    estimate.tracking = true;
+
+    // Straight ahead at the follow distance, and closer: hold still rather than back up.
+    estimate.range = FOLLOW_IN;
+    DRIVE_COMMAND command = followCommand(estimate, FOLLOW_IN);
+    TEST_ASSERT_EQUAL(0, command.left);
+    TEST_ASSERT_EQUAL(0, command.right);
+    estimate.range = FOLLOW_IN / 2;
+    command = followCommand(estimate, FOLLOW_IN);
+    TEST_ASSERT_EQUAL(0, command.left);
+    TEST_ASSERT_EQUAL(0, command.right);
+
+    // Further away, both sides go forward alike, and faster the further it is.
+    estimate.range = FOLLOW_IN + 12;
+    DRIVE_COMMAND near = followCommand(estimate, FOLLOW_IN);
+    TEST_ASSERT_GREATER_THAN(0, near.left);
+    TEST_ASSERT_EQUAL(near.left, near.right);
+    estimate.range = FOLLOW_IN + 24;
+    DRIVE_COMMAND far = followCommand(estimate, FOLLOW_IN);
+    TEST_ASSERT_GREATER_THAN(near.left, far.left);
+    estimate.range = FOLLOW_IN * 10;
+    command = followCommand(estimate, FOLLOW_IN);
+    TEST_ASSERT_EQUAL(FOLLOW_DUTY_MAX, command.left);
+
+    // Off to the right the left side drives harder, and the other way off to the left.
+    estimate.range = FOLLOW_IN + 12;
+    estimate.bearing = 20;
+    command = followCommand(estimate, FOLLOW_IN);
+    TEST_ASSERT_GREATER_THAN(near.left, command.left);
+    TEST_ASSERT_LESS_THAN(near.right, command.right);
+    estimate.bearing = -20;
+    command = followCommand(estimate, FOLLOW_IN);
+    TEST_ASSERT_LESS_THAN(near.left, command.left);
+    TEST_ASSERT_GREATER_THAN(near.right, command.right);
+
+    // A lost target stops the drive wherever it was.
+    estimate.tracking = false;
+    command = followCommand(estimate, FOLLOW_IN);
+    TEST_ASSERT_EQUAL(0, command.left);
+    TEST_ASSERT_EQUAL(0, command.right);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_standing_still);
+    RUN_TEST(test_walking_away);
+    RUN_TEST(test_weaving);
+    RUN_TEST(test_stepping_across);
+    RUN_TEST(test_gate_restarts_after_rejects);
+    RUN_TEST(test_target_lost_without_ranges);
+    RUN_TEST(test_follow_command);
+    return UNITY_END();
+}
@@ -0,0 +1,230 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <random>
+#include "TargetTracker/TdoaBearing.h"
+
+#define BASELINE_IN 12.0f       // Distance between the receivers (inches).
+#define CAPTURE_HZ 80000000     // Tick rate of the MCPWM capture timer both receivers share.
+#define TICKS_PER_US (CAPTURE_HZ / 1000000.0)
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/**
+ * Distance from a target to each receiver, half the baseline either side of the middle.
+ */
+static void receiverPaths(double range, double degrees, double *left, double *right) {
+    double sinB = sin(degrees * M_PI / 180);
+    *left = sqrt(range * range + range * BASELINE_IN * sinB + BASELINE_IN * BASELINE_IN / 4);
+    *right = sqrt(range * range - range * BASELINE_IN * sinB + BASELINE_IN * BASELINE_IN / 4);
+}
+
+/**
+ * Pair the capture ticks of one burst's arrival at each receiver, the burst going out at a
+ * given tick of the shared timer.
+ */
+static BearingStatus observePair(TdoaBearing &estimator, uint16_t triggerId, uint32_t emittedTicks,
+                                 double left, double right, float rangeIn, BEARING_RESULT *result) {
+    uint32_t leftTicks = emittedTicks + (uint32_t) lround(left * TDOA_US_PER_INCH * TICKS_PER_US);
+    uint32_t rightTicks = emittedTicks + (uint32_t) lround(right * TDOA_US_PER_INCH * TICKS_PER_US);
+    estimator.observeArrival(side_LEFT, triggerId, leftTicks, rangeIn, result);
+    return estimator.observeArrival(side_RIGHT, triggerId, rightTicks, rangeIn, result);
+}
+
+void test_sign_and_symmetry(void) {
+    TdoaBearing estimator(BASELINE_IN);
+    BEARING_RESULT right, left;
+    TEST_ASSERT_EQUAL(bearing_OK, estimator.solve(200, 48, &right));
+    TEST_ASSERT_EQUAL(bearing_OK, estimator.solve(-200, 48, &left));
+    TEST_ASSERT_GREATER_THAN(0, right.bearing);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, -right.bearing, left.bearing);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, right.sigma, left.sigma);
+
+    BEARING_RESULT ahead;
+    estimator.solve(0, 48, &ahead);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 0, ahead.bearing);
+    TEST_ASSERT_GREATER_THAN(0.9, ahead.confidence);
+}
+
+/**
+ * Noise-free arrivals timed in capture ticks solve to the true bearing up close, where the
+ * wavefront's curvature matters, as well as far off.
+ */
+void test_near_field_is_exact(void) {
+    TdoaBearing estimator(BASELINE_IN);
+    estimator.setResolution(CAPTURE_HZ);
+    double worst = 0;
+    uint16_t triggerId = 0;
+    for(double range : {8.0, 12.0, 24.0, 60.0, 200.0}) {
+        for(double degrees = -80; degrees <= 80; degrees += 5) {
+            double left, right;
+            receiverPaths(range, degrees, &left, &right);
+            BEARING_RESULT result;
+            triggerId++;
+            TEST_ASSERT_EQUAL(bearing_OK, observePair(estimator, triggerId, 0x12345678u * triggerId, left, right, range, &result));
+            if(fabs(result.bearing - degrees) > worst) worst = fabs(result.bearing - degrees);
+        }
+    }
+
+    char message[64];
+    snprintf(message, sizeof(message), "worst error 8-200 in, +/-80 deg: %.4f deg", worst);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN(0.05, worst);
+}
+
+/**
+ * Without a range, the far-field solution holds for a target a few baselines off.
+ */
+void test_far_field_without_range(void) {
+    TdoaBearing estimator(BASELINE_IN);
+    for(double degrees = -80; degrees <= 80; degrees += 5) {
+        double left, right;
+        receiverPaths(60, degrees, &left, &right);
+        BEARING_RESULT result;
+        estimator.solve((float) ((left - right) * TDOA_US_PER_INCH), 0, &result);
+        TEST_ASSERT_FLOAT_WITHIN(2.5, degrees, result.bearing);
+    }
+}
+
+void test_side_on_is_clamped(void) {
+    TdoaBearing estimator(BASELINE_IN);
+    BEARING_RESULT result;
+    TEST_ASSERT_EQUAL(bearing_OK, estimator.solve(BASELINE_IN * TDOA_US_PER_INCH + 20, 0, &result));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 90, result.bearing);
+    TEST_ASSERT_TRUE(isfinite(result.sigma));
+    TEST_ASSERT_LESS_THAN(0.9, result.confidence);
+
+    TEST_ASSERT_EQUAL(bearing_OK, estimator.solve(-(BASELINE_IN * TDOA_US_PER_INCH + 20), 48, &result));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, -90, result.bearing);
+}
+
+/**
+ * Arrivals further apart than the baseline allows are turned down, as are arrivals of
+ * different triggers and of an unscheduled one.
+ */
+void test_gating_and_pairing(void) {
+    TdoaBearing estimator(BASELINE_IN);
+    BEARING_RESULT result;
+    TEST_ASSERT_EQUAL(bearing_IMPLAUSIBLE, estimator.solve(BASELINE_IN * TDOA_US_PER_INCH * 1.5f, 48, &result));
+
+    estimator.setResolution(CAPTURE_HZ);
+    TEST_ASSERT_EQUAL(bearing_PENDING, estimator.observeArrival(side_LEFT, 5, 1000, 48, &result));
+    TEST_ASSERT_EQUAL(bearing_PENDING, estimator.observeArrival(side_RIGHT, 6, 1000, 48, &result));
+    TEST_ASSERT_EQUAL(bearing_PENDING, estimator.observeArrival(side_LEFT, 0, 1000, 48, &result));
+    TEST_ASSERT_EQUAL(bearing_IMPLAUSIBLE, estimator.observeArrival(side_LEFT, 6, 1000 + 2 * BASELINE_IN * TDOA_US_PER_INCH * TICKS_PER_US, 48, &result));
+
+    // A pair straddling the counter's wrap compares right.
+    uint32_t leftTicks = 0xFFFFFF00u;
+    TEST_ASSERT_EQUAL(bearing_PENDING, estimator.observeArrival(side_LEFT, 7, leftTicks, 48, &result));
+    TEST_ASSERT_EQUAL(bearing_OK, estimator.observeArrival(side_RIGHT, 7, leftTicks + (uint32_t) (100 * TICKS_PER_US), 48, &result));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, -100, result.tdoaUs);
+    TEST_ASSERT_LESS_THAN(0, result.bearing);
+
+    BEARING_STATS stats = estimator.getStats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.solved);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.implausible);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.unpaired);
+}
+
+void test_skew_is_taken_off(void) {
+    TdoaBearing estimator(BASELINE_IN);
+    estimator.setSkew(30);
+    BEARING_RESULT result;
+    estimator.solve(30, 48, &result);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 0, result.bearing);
+}
+
+/**
+ * With each arrival jittered by TDOA_TIMING_SIGMA_US, the bearing's spread matches the sigma
+ * reported for it.
+ */
+void test_reported_sigma_matches_jitter(void) {
+    TdoaBearing estimator(BASELINE_IN);
+    std::mt19937 generator(1);
+    std::normal_distribution<double> jitter(0, TDOA_TIMING_SIGMA_US);
+    for(double degrees : {0.0, 30.0, 60.0}) {
+        double squares = 0, sigmas = 0;
+        const int TRIALS = 20000;
+        double left, right;
+        receiverPaths(60, degrees, &left, &right);
+        for(int i = 0; i < TRIALS; i++) {
+            BEARING_RESULT result;
+            estimator.solve((float) ((left - right) * TDOA_US_PER_INCH + jitter(generator) - jitter(generator)), 60, &result);
+            squares += pow(result.bearing - degrees, 2);
+            sigmas += result.sigma;
+        }
+        double rms = sqrt(squares / TRIALS);
+        double sigma = sigmas / TRIALS;
+
+        char message[96];
+        snprintf(message, sizeof(message), "%2.0f deg: RMS %.2f deg, reported sigma %.2f deg", degrees, rms, sigma);
+        TEST_MESSAGE(message);
+        TEST_ASSERT_FLOAT_WITHIN(0.25 * sigma, sigma, rms);
+    }
+}
+
+/**
+ * The tracker's bearing on a weaving target, fed ranges alone and then TDOA bearings too.
+ */
+static double weavingBearingRms(bool withBearings) {
+    std::mt19937 generator(7);
+    std::normal_distribution<double> jitter(0, TDOA_TIMING_SIGMA_US);
+    std::normal_distribution<double> rangeNoise(0, TRACK_RANGE_SIGMA_IN);
+    TargetTracker tracker(BASELINE_IN);
+    TdoaBearing estimator(BASELINE_IN);
+    estimator.setResolution(CAPTURE_HZ);
+    double squares = 0;
+    int estimates = 0;
+
+    for(int k = 0; k < 250; k++) {
+        int64_t now = (int64_t) k * 80000;
+        double t = now / 1e6;
+        double degrees = 30 * sin(2 * M_PI * t / 8);
+        double left, right;
+        receiverPaths(60, degrees, &left, &right);
+        double leftUs = left * TDOA_US_PER_INCH + jitter(generator);
+        double rightUs = right * TDOA_US_PER_INCH + jitter(generator);
+        tracker.observeRange(side_LEFT, now + (int64_t) leftUs, left + rangeNoise(generator));
+        tracker.observeRange(side_RIGHT, now + (int64_t) rightUs, right + rangeNoise(generator));
+        if(withBearings) {
+            uint32_t emitted = (uint32_t) (now * TICKS_PER_US);
+            BEARING_RESULT result;
+            estimator.observeArrival(side_LEFT, k + 1, emitted + (uint32_t) lround(leftUs * TICKS_PER_US), 60, &result);
+            if(estimator.observeArrival(side_RIGHT, k + 1, emitted + (uint32_t) lround(rightUs * TICKS_PER_US), 60, &result) == bearing_OK) {
+                tracker.observeBearing(now + (int64_t) rightUs, result.bearing, result.sigma);
+            }
+        }
+        if(t <= 2) continue;
+
+        TARGET_ESTIMATE estimate;
+        tracker.estimate(now + 20000, &estimate);
+        squares += pow(estimate.bearing - 30 * sin(2 * M_PI * (t + 0.02) / 8), 2);
+        estimates++;
+    }
+    return sqrt(squares / estimates);
+}
+
+void test_bearings_tighten_the_track(void) {
+    double rangesOnly = weavingBearingRms(false);
+    double withBearings = weavingBearingRms(true);
+
+    char message[96];
+    snprintf(message, sizeof(message), "weaving at 60 in: bearing RMS %.2f deg on ranges, %.2f deg with TDOA", rangesOnly, withBearings);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN(rangesOnly / 2, withBearings);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_sign_and_symmetry);
+    RUN_TEST(test_near_field_is_exact);
+    RUN_TEST(test_far_field_without_range);
+    RUN_TEST(test_side_on_is_clamped);
+    RUN_TEST(test_gating_and_pairing);
+    RUN_TEST(test_skew_is_taken_off);
+    RUN_TEST(test_reported_sigma_matches_jitter);
+    RUN_TEST(test_bearings_tighten_the_track);
+    return UNITY_END();
+}
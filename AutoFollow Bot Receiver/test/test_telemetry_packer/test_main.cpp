@@ -0,0 +1,66 @@
+#include <unity.h>
+#include "EspNowNode/TelemetryPacker.h"
+
+static ESP_NOW_PACKET packet;
+
+void setUp(void) {
+    clearPacket(&packet, Header::TRIGGER_PING, AckMessage::Received_Ping);
+}
+
+void tearDown(void) {}
+
+static TELEMETRY_SAMPLE sampleOf(int16_t left) {
+    TELEMETRY_SAMPLE sample = {};
+    sample.leftDistance = left;
+    sample.rightDistance = TELEMETRY_NO_VALUE;
+    sample.bearing = TELEMETRY_NO_VALUE;
+    sample.leftMotor = -40;
+    sample.rightMotor = 75;
+    sample.obstacleFlags = 0x21;
+    return sample;
+}
+
+void test_batch_round_trip(void) {
+    TelemetryPacker packer;
+    for(int i = 0; i < 4; i++) TEST_ASSERT_TRUE(packer.push(1000000 + i * 20000, sampleOf(100 * i)));
+    TEST_ASSERT_EQUAL_UINT8(4, packer.writeBatch(&packet));
+    TEST_ASSERT_EQUAL(0, packer.size());
+
+    int64_t baseTime = 0;
+    TELEMETRY_SAMPLE out[TELEMETRY_MAX_BATCH];
+    TEST_ASSERT_EQUAL_UINT8(4, TelemetryPacker::readBatch(&packet, &baseTime, out, TELEMETRY_MAX_BATCH));
+    TEST_ASSERT_EQUAL_INT64(1000000, baseTime);
+    for(int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL_UINT32(i * 20000, out[i].timeOffset);
+        TEST_ASSERT_EQUAL_INT16(100 * i, out[i].leftDistance);
+        TEST_ASSERT_EQUAL_INT8(-40, out[i].leftMotor);
+        TEST_ASSERT_EQUAL_INT8(75, out[i].rightMotor);
+        TEST_ASSERT_EQUAL_UINT8(0x21, out[i].obstacleFlags);
+    }
+}
+
+/**
+ * A sample stamped before the one queued ahead of it takes that one's time, rather than
+ * wrapping its offset around.
+ */
+void test_late_stamp_does_not_wrap(void) {
+    TelemetryPacker packer;
+    packer.push(1000000, sampleOf(1));
+    packer.push(1000500, sampleOf(2));
+    packer.push(1000400, sampleOf(3));
+    packer.push(999000, sampleOf(4));
+    TEST_ASSERT_EQUAL_UINT8(4, packer.writeBatch(&packet));
+
+    int64_t baseTime = 0;
+    TELEMETRY_SAMPLE out[TELEMETRY_MAX_BATCH];
+    TEST_ASSERT_EQUAL_UINT8(4, TelemetryPacker::readBatch(&packet, &baseTime, out, TELEMETRY_MAX_BATCH));
+    const uint32_t expected[4] = {0, 500, 500, 500};
+    for(int i = 0; i < 4; i++) TEST_ASSERT_EQUAL_UINT32(expected[i], out[i].timeOffset);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_batch_round_trip);
+    RUN_TEST(test_late_stamp_does_not_wrap);
+    return UNITY_END();
+}
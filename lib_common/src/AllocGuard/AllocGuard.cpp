@@ -0,0 +1,120 @@
+#include "AllocGuard.h"
+
+#if ALLOC_GUARD
+
+#include <Arduino.h>
+#include <esp_rom_sys.h>
+
+extern "C" {
+    void *__real_malloc(size_t size);
+    void *__real_calloc(size_t count, size_t size);
+    void *__real_realloc(void *ptr, size_t size);
+    void *__wrap_malloc(size_t size);
+    void *__wrap_calloc(size_t count, size_t size);
+    void *__wrap_realloc(void *ptr, size_t size);
+}
+
+static ALLOC_GUARD_TASK tasks[ALLOC_GUARD_MAX_TASKS];
+static portMUX_TYPE guardLock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool armed = false;
+
+// Runs from IRAM, as the heap may be used while the flash cache is disabled.
+
+/**
+ * Slot of the calling task, claiming a free one if needed. Call with guardLock held.
+ */
+static IRAM_ATTR ALLOC_GUARD_TASK *slotOf(TaskHandle_t task) {
+    for(int i = 0; i < ALLOC_GUARD_MAX_TASKS - 1; i++) {
+        if(tasks[i].task == task) return &tasks[i];
+        if(tasks[i].task == NULL) {
+            tasks[i].task = task;
+            return &tasks[i];
+        }
+    }
+    return &tasks[ALLOC_GUARD_MAX_TASKS - 1];
+}
+
+/**
+ * Count an allocation of the calling task, aborting if it is watched and the guard is armed.
+ */
+static IRAM_ATTR void recordAllocation(size_t size) {
+    // Allocations from interrupts or before the scheduler runs aren't attributed to a task.
+    if(xPortInIsrContext()) return;
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    if(task == NULL) return;
+
+    bool fail = false;
+    portENTER_CRITICAL(&guardLock);
+    ALLOC_GUARD_TASK *slot = slotOf(task);
+    if(slot->exemptDepth > 0) slot->exempted++;
+    else {
+        slot->allocations++;
+        fail = armed && slot->watched && slot->task == task;
+    }
+    portEXIT_CRITICAL(&guardLock);
+
+    if(fail) {
+        esp_rom_printf("ALLOC GUARD: %u byte allocation by task \"%s\" after init.\n", (unsigned) size, pcTaskGetName(task));
+        abort();
+    }
+}
+
+IRAM_ATTR void *__wrap_malloc(size_t size) {
+    recordAllocation(size);
+    return __real_malloc(size);
+}
+
+IRAM_ATTR void *__wrap_calloc(size_t count, size_t size) {
+    recordAllocation(count * size);
+    return __real_calloc(count, size);
+}
+
+IRAM_ATTR void *__wrap_realloc(void *ptr, size_t size) {
+    recordAllocation(size);
+    return __real_realloc(ptr, size);
+}
+
+void allocGuardWatchTask() {
+    portENTER_CRITICAL(&guardLock);
+    slotOf(xTaskGetCurrentTaskHandle())->watched = true;
+    portEXIT_CRITICAL(&guardLock);
+}
+
+void allocGuardArm() { armed = true; }
+
+uint32_t allocGuardTaskCount() {
+    portENTER_CRITICAL(&guardLock);
+    uint32_t res = slotOf(xTaskGetCurrentTaskHandle())->allocations;
+    portEXIT_CRITICAL(&guardLock);
+    return res;
+}
+
+void allocGuardReport() {
+    // Copy out under the lock, print outside it.
+    ALLOC_GUARD_TASK copy[ALLOC_GUARD_MAX_TASKS];
+    portENTER_CRITICAL(&guardLock);
+    memcpy(copy, tasks, sizeof(copy));
+    portEXIT_CRITICAL(&guardLock);
+
+    esp_rom_printf("Allocations per task (%s):\n", armed ? "armed" : "not armed");
+    for(int i = 0; i < ALLOC_GUARD_MAX_TASKS; i++) {
+        if(copy[i].allocations == 0 && copy[i].exempted == 0) continue;
+        const char *name = (copy[i].task != NULL) ? pcTaskGetName(copy[i].task) : "(others)";
+        esp_rom_printf("\t%s: %u (+%u exempt)%s\n", name, (unsigned) copy[i].allocations, (unsigned) copy[i].exempted, copy[i].watched ? " watched" : "");
+    }
+}
+
+void allocGuardEnterExempt() {
+    portENTER_CRITICAL(&guardLock);
+    slotOf(xTaskGetCurrentTaskHandle())->exemptDepth++;
+    portEXIT_CRITICAL(&guardLock);
+}
+
+void allocGuardExitExempt() {
+    portENTER_CRITICAL(&guardLock);
+    ALLOC_GUARD_TASK *slot = slotOf(xTaskGetCurrentTaskHandle());
+    if(slot->exemptDepth > 0) slot->exemptDepth--;
+    portEXIT_CRITICAL(&guardLock);
+}
+
+#endif /* ALLOC_GUARD */
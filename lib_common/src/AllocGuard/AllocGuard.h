@@ -0,0 +1,74 @@
+#ifndef ALLOC_GUARD_H
+#define ALLOC_GUARD_H
+
+#include "../Platform/Platform.h"
+
+/**
+ * Debug instrumentation of heap allocations. Build with -DALLOC_GUARD=1 and link with
+ * -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc (see the `*-alloc-guard` PlatformIO
+ * environments) to count every allocation per task. Once armed at the end of setup, any
+ * allocation made by a watched task aborts with the task's name, so the steady-state paths
+ * stay allocation-free. Without ALLOC_GUARD every call below compiles to nothing.
+ */
+#ifndef ALLOC_GUARD
+#define ALLOC_GUARD 0
+#endif
+
+#define ALLOC_GUARD_MAX_TASKS 24    // Tasks counted individually. Later tasks share the last slot.
+
+struct _alloc_guard_task {
+    TaskHandle_t task;          // Task counted. NULL for the shared slot.
+    uint32_t allocations;       // Allocations made by the task.
+    uint32_t exempted;          // Allocations made while exempt, e.g. inside the Wi-Fi driver.
+    bool watched;               // Does an allocation by this task abort once armed.
+    uint8_t exemptDepth;        // Nesting of AllocGuardExempt scopes in the task.
+};
+typedef struct _alloc_guard_task ALLOC_GUARD_TASK;
+
+#if ALLOC_GUARD
+
+/**
+ * Abort if the calling task allocates once the guard is armed.
+ */
+void allocGuardWatchTask();
+
+/**
+ * End of initialization. Watched tasks must not allocate from now on.
+ */
+void allocGuardArm();
+
+/**
+ * Allocations the calling task has made.
+ */
+uint32_t allocGuardTaskCount();
+
+/**
+ * Print the allocation count of every task seen. Doesn't allocate.
+ */
+void allocGuardReport();
+
+void allocGuardEnterExempt();
+void allocGuardExitExempt();
+
+#else
+
+inline void allocGuardWatchTask() {}
+inline void allocGuardArm() {}
+inline uint32_t allocGuardTaskCount() { return 0; }
+inline void allocGuardReport() {}
+inline void allocGuardEnterExempt() {}
+inline void allocGuardExitExempt() {}
+
+#endif /* ALLOC_GUARD */
+
+/**
+ * Scope in which the calling task's allocations are counted but allowed, for calls into
+ * code that allocates by design (the Wi-Fi driver's transmit buffers).
+ */
+class AllocGuardExempt {
+    public:
+        AllocGuardExempt() { allocGuardEnterExempt(); }
+        ~AllocGuardExempt() { allocGuardExitExempt(); }
+};
+
+#endif /* ALLOC_GUARD_H */
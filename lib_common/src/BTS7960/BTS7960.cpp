@@ -1,6 +1,64 @@
 #include "BTS7960.h"
 
+/**
+ * Drive one side at a duty, positive forward.
+ */
+static void driveSide(Motor &motor, int duty, bool mirrored) {
+    if(duty == 0) {
+        motor.stop(COAST);
+        return;
+    }
+    motor.setSpeed(abs(duty));
+    if((duty > 0) != mirrored) motor.spinCW();
+    else motor.spinCCW();
+}
+
 void BTS7960::init() {
     leftMotors.init();
     rightMotors.init();
-}
\ No newline at end of file
+}
+
+void BTS7960::apply(int left, int right) {
+    leftDuty = (left < -speedCap) ? -speedCap : (left > speedCap) ? speedCap : left;
+    rightDuty = (right < -speedCap) ? -speedCap : (right > speedCap) ? speedCap : right;
+    driveSide(leftMotors, leftDuty, false);
+    driveSide(rightMotors, rightDuty, true);
+}
+
+void BTS7960::drive(int left, int right) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if(!halted) apply(left, right);
+    xSemaphoreGive(lock);
+}
+
+int BTS7960::getLeftDuty() { return leftDuty; }
+
+int BTS7960::getRightDuty() { return rightDuty; }
+
+void BTS7960::halt(stopType sType) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    halted = true;
+    leftDuty = 0;
+    rightDuty = 0;
+    leftMotors.stop(sType);
+    rightMotors.stop(sType);
+    xSemaphoreGive(lock);
+}
+
+// The drive picks up again on the next command it is given.
+void BTS7960::resume() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    halted = false;
+    xSemaphoreGive(lock);
+}
+
+bool BTS7960::isHalted() { return halted; }
+
+void BTS7960::setSpeedCap(int cap) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    speedCap = (cap < LED_C_LOW) ? LED_C_LOW : (cap > LED_C_HIGH) ? LED_C_HIGH : cap;
+    if(!halted) apply(leftDuty, rightDuty);
+    xSemaphoreGive(lock);
+}
+
+int BTS7960::getSpeedCap() { return speedCap; }
@@ -3,18 +3,58 @@
 
 #include "Motor.h"
 
+/**
+ * Both sides of the bot's drive. The sides are mounted mirrored, so forward is clockwise on
+ * the left and counter-clockwise on the right. Safe to use from several tasks: a halt can't
+ * be overtaken by a drive already under way.
+ */
 class BTS7960 {
     private:
         Motor leftMotors;
         Motor rightMotors;
+        int leftDuty = 0;               // Duty the left side was last driven at, positive forward.
+        int rightDuty = 0;              // Duty the right side was last driven at, positive forward.
+        bool halted = false;            // Are the motors held stopped until resumed.
+        int speedCap = LED_C_HIGH;      // Highest duty either side is driven at.
+        SemaphoreHandle_t lock;         // Serializes driving, halting and capping.
+
+        /**
+         * Drive each side at a duty, clamped to the speed cap. The lock must be held.
+         */
+        void apply(int left, int right);
 
     public:
         BTS7960(int leftPwmL, int leftPwmR, int rightPwmL, int rightPwmR) : 
             leftMotors(leftPwmL, leftPwmR),
-            rightMotors(rightPwmL, rightPwmR) {}
+            rightMotors(rightPwmL, rightPwmR),
+            lock(xSemaphoreCreateMutex()) {}
         
         void init();
 
+        /**
+         * Drive each side at a duty, positive forward, limited to the speed cap. A side at zero
+         * coasts. Does nothing while halted.
+         * @param left Duty of the left side, from -LED_C_HIGH to LED_C_HIGH.
+         * @param right Duty of the right side, from -LED_C_HIGH to LED_C_HIGH.
+         */
+        void drive(int left, int right);
+        int getLeftDuty();
+        int getRightDuty();
+
+        /**
+         * Stop both sides and hold them stopped until resumed.
+         */
+        void halt(stopType sType);
+        void resume();
+        bool isHalted();
+
+        /**
+         * Cap the duty of both sides, slowing either side already above it.
+         * @param cap Highest duty, from LED_C_LOW to LED_C_HIGH.
+         */
+        void setSpeedCap(int cap);
+        int getSpeedCap();
+
 };
 
 
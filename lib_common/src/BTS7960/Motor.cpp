@@ -4,6 +4,7 @@ void Motor::init() {
     // Set motor terminals as PWM outputs.
     ledcAttach(posTerm, PWM_FREQ, PWM_RES);
     ledcAttach(negTerm, PWM_FREQ, PWM_RES);
+    enabled = true;
 }
 
 void Motor::spinCW() {
@@ -0,0 +1,189 @@
+#ifndef ACK_WINDOW_H
+#define ACK_WINDOW_H
+
+#include <stdint.h>
+#include "EspNowPacket.h"
+
+#define ACK_WINDOW_SIZE 32                  // Frames covered by an ack's bitmap, and tracked in flight.
+#define STREAM_ACK_TIMEOUT_US 2500000       // Unacked frames are given up as lost after this long (us). Outlasts a heartbeat.
+
+struct _stream_stats {
+    uint32_t framesTracked;             // Frames sent that expect an ack.
+    uint32_t framesAcked;               // Of those, frames the peer acked.
+    uint32_t framesLost;                // Of those, frames the peer reported missing or never acked.
+    uint32_t gapsSeen;                  // Frames of the peer's this node found missing.
+    uint32_t piggybackedAcks;           // Acks carried on frames sent for other reasons.
+    uint32_t explicitAcks;              // Ack-only frames sent to report a gap.
+};
+typedef struct _stream_stats STREAM_STATS;
+
+/**
+ * Frames received from the peer, as the highest sequence number seen plus a bitmap of the
+ * ACK_WINDOW_SIZE before it. Frames are never resent, so the window slides past a gap
+ * instead of waiting for it to fill. Not thread safe.
+ */
+class ReceiveWindow {
+    private:
+        uint16_t highest = 0;           // Highest sequence number received.
+        uint32_t received = 0;          // Bit i set if frame `highest - 1 - i` was received.
+        int64_t highestArrival = 0;     // When the highest frame arrived (us).
+        bool started = false;           // Has a frame been received yet.
+
+    public:
+        /**
+         * Record a frame arriving.
+         * @param missed Set to the number of frames this one skipped over.
+         * @return True if the frame is new, false if a duplicate or too old to tell.
+         */
+        bool record(uint16_t seq, int64_t arrival, uint16_t *missed) {
+            *missed = 0;
+            if(!started) {
+                started = true;
+                highest = seq;
+                received = 0;
+                highestArrival = arrival;
+                return true;
+            }
+
+            int16_t ahead = (int16_t) (seq - highest);
+            if(ahead == 0) return false;
+
+            // A late frame fills in its bit, if the window still covers it.
+            if(ahead < 0) {
+                int age = -ahead - 1;
+                if(age >= ACK_WINDOW_SIZE || (received & (1UL << age))) return false;
+                received |= (1UL << age);
+                return true;
+            }
+
+            // Slide the window up. The old highest lands `ahead - 1` bits down.
+            *missed = (uint16_t) (ahead - 1);
+            if(ahead > ACK_WINDOW_SIZE) received = 0;
+            else if(ahead == ACK_WINDOW_SIZE) received = (1UL << (ACK_WINDOW_SIZE - 1));
+            else received = (received << ahead) | (1UL << (ahead - 1));
+            highest = seq;
+            highestArrival = arrival;
+            return true;
+        }
+
+        /**
+         * Fill an ack of everything received so far.
+         * @param now Time the ack is sent (us).
+         * @return False if nothing has been received.
+         */
+        bool fill(ACK_RECORD *ack, int64_t now) const {
+            if(!started) return false;
+            ack->highestSeq = highest;
+            ack->received = received;
+            ack->ackDelay = (now > highestArrival) ? (uint32_t) (now - highestArrival) : 0;
+            return true;
+        }
+
+        /**
+         * Forget the peer's numbering, e.g. when it restarts with a handshake.
+         */
+        void reset() { started = false; }
+
+        bool hasStarted() const { return started; }
+};
+
+/**
+ * Frames sent to the peer that are waiting for an ack. A frame is acked when the peer's
+ * ack covers it, and lost when the peer acks a later frame without it or when it goes
+ * unacked too long. Not thread safe.
+ */
+class SendWindow {
+    private:
+        struct _in_flight {
+            uint16_t seq;
+            int64_t sentAt;     // When the frame was sent (us).
+            bool waiting;       // Is the frame still waiting for its ack.
+        };
+        _in_flight frames[ACK_WINDOW_SIZE] = {};
+        uint32_t tracked = 0;
+        uint32_t acked = 0;
+        uint32_t lost = 0;
+
+        /**
+         * Did the ack cover this sequence number.
+         */
+        static bool covers(const ACK_RECORD &ack, uint16_t seq) {
+            int16_t age = (int16_t) (ack.highestSeq - seq);
+            if(age == 0) return true;
+            return age > 0 && age <= ACK_WINDOW_SIZE && (ack.received & (1UL << (age - 1)));
+        }
+
+    public:
+        /**
+         * Start waiting for a frame's ack. A frame still waiting in its place is given up as lost.
+         */
+        void track(uint16_t seq, int64_t now) {
+            _in_flight &frame = frames[seq % ACK_WINDOW_SIZE];
+            if(frame.waiting) lost++;
+            frame.seq = seq;
+            frame.sentAt = now;
+            frame.waiting = true;
+            tracked++;
+        }
+
+        /**
+         * Apply an ack from the peer.
+         * @param arrival When the ack arrived (us).
+         * @param rtt Set to the round trip to the newest frame acked, with the peer's delay taken out.
+         *            Left untouched if this ack newly covers no frame.
+         * @return Number of frames this ack showed to be lost.
+         */
+        uint16_t onAck(const ACK_RECORD &ack, int64_t arrival, uint32_t *rtt) {
+            uint16_t res = 0;
+            int64_t newest = -1;
+            for(int i = 0; i < ACK_WINDOW_SIZE; i++) {
+                _in_flight &frame = frames[i];
+                if(!frame.waiting) continue;
+
+                // Frames sent after the ack's highest are still in flight.
+                if((int16_t) (ack.highestSeq - frame.seq) < 0) continue;
+                frame.waiting = false;
+                if(covers(ack, frame.seq)) {
+                    acked++;
+                    if(frame.sentAt > newest) newest = frame.sentAt;
+                }
+                else {
+                    lost++;
+                    res++;
+                }
+            }
+            if(newest >= 0) {
+                int64_t roundTrip = arrival - newest - ack.ackDelay;
+                *rtt = (roundTrip > 0) ? (uint32_t) roundTrip : 0;
+            }
+            return res;
+        }
+
+        /**
+         * Give up on frames unacked for longer than the timeout (us).
+         * @return Number of frames given up on.
+         */
+        uint16_t expire(int64_t now, uint32_t timeout) {
+            uint16_t res = 0;
+            for(int i = 0; i < ACK_WINDOW_SIZE; i++) {
+                if(!frames[i].waiting || now - frames[i].sentAt < timeout) continue;
+                frames[i].waiting = false;
+                lost++;
+                res++;
+            }
+            return res;
+        }
+
+        /**
+         * Stop waiting for every frame without counting them, e.g. after a handshake.
+         */
+        void clear() { for(int i = 0; i < ACK_WINDOW_SIZE; i++) frames[i].waiting = false; }
+
+        void snapshot(STREAM_STATS *out) const {
+            out->framesTracked = tracked;
+            out->framesAcked = acked;
+            out->framesLost = lost;
+        }
+};
+
+#endif /* ACK_WINDOW_H */
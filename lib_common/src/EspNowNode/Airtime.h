@@ -0,0 +1,189 @@
+#ifndef AIRTIME_H
+#define AIRTIME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "EspNowPacket.h"
+
+#define ESPNOW_MAC_OVERHEAD 43      // MAC header, action frame fields, vendor element header and FCS around an ESP-NOW body (bytes).
+#define AIRTIME_SIFS_US 10          // Gap between a frame and its MAC ack (us).
+#define AIRTIME_MAC_ACK_BYTES 14    // Size of a MAC ack (bytes).
+#define AIRTIME_WINDOW_US 1000000   // Window the channel use is measured over (us).
+
+/**
+ * PHY rates a peer can be sent to at. Rates are 2.4 GHz, 20 MHz and long guard interval.
+ */
+enum _phy_rate : uint8_t {
+    phy_DSSS_1M = 0,    // 802.11b, long preamble. The ESP-NOW default.
+    phy_DSSS_2M,
+    phy_CCK_5M5,
+    phy_CCK_11M,
+    phy_OFDM_6M,        // 802.11g.
+    phy_OFDM_9M,
+    phy_OFDM_12M,
+    phy_OFDM_18M,
+    phy_OFDM_24M,
+    phy_OFDM_36M,
+    phy_OFDM_48M,
+    phy_OFDM_54M,
+    phy_HT_MCS0,        // 802.11n, mixed format.
+    phy_HT_MCS1,
+    phy_HT_MCS2,
+    phy_HT_MCS3,
+    phy_HT_MCS4,
+    phy_HT_MCS5,
+    phy_HT_MCS6,
+    phy_HT_MCS7,
+    phy_COUNT
+};
+typedef enum _phy_rate PhyRate;
+
+/**
+ * Kinds of traffic the channel time is split between.
+ */
+enum _airtime_class : uint8_t {
+    air_PING = 0,       // Pings and the replies to them.
+    air_CONTROL,        // Handshakes and waves.
+    air_ACK,            // Ack-only frames.
+    air_RETRANSMIT,     // Frames sent again.
+    air_COUNT
+};
+typedef enum _airtime_class AirtimeClass;
+
+struct _airtime_stats {
+    PhyRate rate;                       // Rate frames are sent at.
+    uint32_t frames[air_COUNT];         // Frames on air, per class.
+    uint64_t airtime[air_COUNT];        // Channel time used, per class (in microseconds).
+    uint32_t lastFrame[air_COUNT];      // Channel time of the last frame, per class (in microseconds).
+    float channelUse;                   // Fraction of the last completed window the channel was busy with this link.
+};
+typedef struct _airtime_stats AIRTIME_STATS;
+
+/**
+ * Estimates how long frames occupy the channel at a PHY rate. Counts the PHY preamble, the
+ * frame and its MAC ack, but not contention (DIFS and backoff), which depends on other traffic.
+ */
+class Airtime {
+    private:
+        // Data rate of each PhyRate (in 100 kbps).
+        static constexpr uint16_t rates[phy_COUNT] = {
+            10, 20, 55, 110,
+            60, 90, 120, 180, 240, 360, 480, 540,
+            65, 130, 195, 260, 390, 520, 585, 650
+        };
+
+        // Data bits per OFDM symbol of each PhyRate. Zero for DSSS/CCK.
+        static constexpr uint16_t bitsPerSymbol[phy_COUNT] = {
+            0, 0, 0, 0,
+            24, 36, 48, 72, 96, 144, 192, 216,
+            26, 52, 78, 104, 156, 208, 234, 260
+        };
+
+        static bool isDsss(PhyRate rate) { return rate <= phy_CCK_11M; }
+        static bool isHt(PhyRate rate) { return rate >= phy_HT_MCS0; }
+
+        /**
+         * Rate the peer answers with a MAC ack: the fastest mandatory rate of the same
+         * modulation no faster than the frame's.
+         */
+        static PhyRate ackRate(PhyRate rate) {
+            if(isDsss(rate)) return (rate >= phy_DSSS_2M) ? phy_DSSS_2M : phy_DSSS_1M;
+            uint16_t r = rates[rate];
+            if(r >= 240) return phy_OFDM_24M;
+            if(r >= 120) return phy_OFDM_12M;
+            return phy_OFDM_6M;
+        }
+
+    public:
+        /**
+         * Time a PHY frame (PSDU) of this many bytes is on air (us).
+         */
+        static uint32_t psduTime(PhyRate rate, size_t bytes) {
+            uint32_t bits = (uint32_t) bytes * 8;
+
+            // Long preamble and PLCP header, then the payload at the data rate.
+            if(isDsss(rate)) return 192 + (bits * 10 + rates[rate] - 1) / rates[rate];
+
+            // Preamble and SIGNAL, then 4 us symbols carrying the SERVICE, payload and tail bits,
+            // then the 2.4 GHz signal extension.
+            uint32_t preamble = isHt(rate) ? 36 : 20;
+            uint32_t symbols = (16 + bits + 6 + bitsPerSymbol[rate] - 1) / bitsPerSymbol[rate];
+            return preamble + symbols * 4 + 6;
+        }
+
+        /**
+         * Channel time of an ESP-NOW frame carrying this many bytes, including its MAC ack (us).
+         */
+        static uint32_t frameTime(PhyRate rate, size_t bodyBytes) {
+            return psduTime(rate, bodyBytes + ESPNOW_MAC_OVERHEAD) + AIRTIME_SIFS_US + psduTime(ackRate(rate), AIRTIME_MAC_ACK_BYTES);
+        }
+
+        /**
+         * Data rate (in kbps).
+         */
+        static uint32_t kbps(PhyRate rate) { return rates[rate] * 100U; }
+
+        /**
+         * Class of a frame by its header.
+         */
+        static AirtimeClass classOf(Header header, bool resend) {
+            if(resend) return air_RETRANSMIT;
+            switch(header) {
+                case Header::ACK :          return air_ACK;
+                case Header::TRIGGER_PING : return air_PING;
+                default :                   return air_CONTROL;
+            }
+        }
+};
+
+/**
+ * Fixed-memory tally of the channel time a link uses, per class of traffic.
+ * Each counter has a single writer; a snapshot may mix slightly different instants.
+ */
+class AirtimeMeter {
+    private:
+        PhyRate rate = phy_DSSS_1M;
+        uint32_t frames[air_COUNT] = {0};
+        uint64_t airtime[air_COUNT] = {0};
+        uint32_t lastFrame[air_COUNT] = {0};
+        int64_t windowStart = 0;        // Start of the current window (us).
+        uint64_t windowAirtime = 0;     // Channel time used in the current window (us).
+        float channelUse = 0;
+
+    public:
+        void setRate(PhyRate rate) { this->rate = rate; }
+        PhyRate getRate() const { return rate; }
+
+        /**
+         * Record a frame put on air at a time (us).
+         * @return Its estimated channel time (us).
+         */
+        uint32_t record(AirtimeClass cls, size_t bodyBytes, int64_t now) {
+            uint32_t us = Airtime::frameTime(rate, bodyBytes);
+            if(windowStart == 0) windowStart = now;
+            frames[cls]++;
+            airtime[cls] += us;
+            lastFrame[cls] = us;
+
+            // Roll the channel use over once a window.
+            windowAirtime += us;
+            if(now - windowStart >= AIRTIME_WINDOW_US) {
+                channelUse = (float) windowAirtime / (float) (now - windowStart);
+                windowAirtime = 0;
+                windowStart = now;
+            }
+            return us;
+        }
+
+        void snapshot(AIRTIME_STATS *out) const {
+            out->rate = rate;
+            for(int i = 0; i < air_COUNT; i++) {
+                out->frames[i] = frames[i];
+                out->airtime[i] = airtime[i];
+                out->lastFrame[i] = lastFrame[i];
+            }
+            out->channelUse = channelUse;
+        }
+};
+
+#endif /* AIRTIME_H */
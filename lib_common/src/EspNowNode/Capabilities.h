@@ -0,0 +1,92 @@
+#ifndef CAPABILITIES_H
+#define CAPABILITIES_H
+
+#include <stdint.h>
+#include <string.h>
+#include "EspNowPacket.h"
+
+#define ESPNOW_PROTOCOL_VERSION 1       // Bumped whenever the meaning of the exchange changes.
+
+// Feature bits of CAPABILITY_RECORD::features.
+#define CAP_CLOCK_SYNC          0x0001  // Sends and reads rec_SYNC.
+#define CAP_SCHEDULED_TRIGGERS  0x0002  // Fires on rec_TRIGGER's absolute time.
+#define CAP_TRIGGER_REPORTS     0x0004  // Sends and reads rec_TRIGGER_REPORT.
+#define CAP_TELEMETRY           0x0008  // Sends or reads rec_TELEMETRY.
+#define CAP_PING_PULL           0x0010  // Honours PACKET_FLAG_PULL.
+#define CAP_STREAMING           0x0020  // Streams frames without per-frame replies, acking with rec_ACK.
+#define CAP_CONFIG_SYNC         0x0040  // Replicates the config store with rec_CONFIG.
+#define CAP_COMMANDS            0x0080  // Sends or carries out rec_COMMAND, acking with rec_COMMAND_ACK.
+#define CAP_EMISSION_TIMES      0x0100  // Sends or reads rec_EMISSION.
+#define CAP_EMISSION_BOUNDS     0x0200  // Sends or reads rec_EMISSION with its capture bound.
+
+// Everything a peer that sends no capability record (firmware from before negotiation) is taken to support.
+#define CAP_BASELINE_FEATURES (CAP_CLOCK_SYNC | CAP_SCHEDULED_TRIGGERS | CAP_TRIGGER_REPORTS | CAP_TELEMETRY | CAP_PING_PULL)
+#define CAP_LOCAL_FEATURES (CAP_BASELINE_FEATURES | CAP_STREAMING | CAP_CONFIG_SYNC | CAP_COMMANDS | CAP_EMISSION_TIMES | CAP_EMISSION_BOUNDS)     // Everything this firmware supports.
+
+// Sensor bits of CAPABILITY_RECORD::sensors.
+#define CAP_SENSOR_TX_TRANSDUCER    0x01    // Ultrasonic transmitter.
+#define CAP_SENSOR_RX_LEFT          0x02    // Left ultrasonic receiver.
+#define CAP_SENSOR_RX_RIGHT         0x04    // Right ultrasonic receiver.
+#define CAP_SENSOR_OBSTACLE         0x08    // HCSR04 obstacle sensors.
+#define CAP_SENSOR_DRIVE            0x10    // Drive motors.
+
+/**
+ * Settings both nodes can run at, derived from their capability records.
+ */
+struct _negotiated_settings {
+    uint8_t protocolVersion;    // Highest version both speak.
+    uint16_t features;          // Features both support.
+    uint8_t peerSensors;        // Sensors the peer has.
+    uint16_t minPingInterval;   // Shortest spacing between pings both can keep up with (ms).
+    uint16_t readTime;          // Time the slower node needs to read a transducer (ms).
+    uint8_t maxPayload;         // Largest payload both accept (bytes).
+    bool channelMatch;          // Do both nodes think they are on the same channel.
+};
+typedef struct _negotiated_settings NEGOTIATED_SETTINGS;
+
+class Capabilities {
+    public:
+        /**
+         * Capabilities assumed of a peer that sent none.
+         */
+        static CAPABILITY_RECORD baseline(uint8_t channel) {
+            CAPABILITY_RECORD res = {};
+            res.protocolVersion = 1;
+            res.features = CAP_BASELINE_FEATURES;
+            res.maxPayload = ESPNOW_PAYLOAD_SIZE;
+            res.channel = channel;
+            return res;
+        }
+
+        /**
+         * Read the capability record of a packet, tolerating records longer or shorter than this
+         * firmware's.
+         * @return True if the packet carried one.
+         */
+        static bool read(const ESP_NOW_PACKET *packet, CAPABILITY_RECORD *out) {
+            uint8_t len = 0;
+            const uint8_t *rec = findRecord(packet, RecordType::rec_CAPABILITIES, &len);
+            if(rec == NULL) return false;
+            memset(out, 0, sizeof(*out));
+            memcpy(out, rec, (len < sizeof(*out)) ? len : sizeof(*out));
+            return true;
+        }
+
+        /**
+         * The best settings both nodes support.
+         */
+        static NEGOTIATED_SETTINGS negotiate(const CAPABILITY_RECORD &local, const CAPABILITY_RECORD &peer) {
+            NEGOTIATED_SETTINGS res;
+            res.protocolVersion = (local.protocolVersion < peer.protocolVersion) ? local.protocolVersion : peer.protocolVersion;
+            res.features = local.features & peer.features;
+            res.peerSensors = peer.sensors;
+            res.minPingInterval = (local.minPingInterval > peer.minPingInterval) ? local.minPingInterval : peer.minPingInterval;
+            res.readTime = (local.readTime > peer.readTime) ? local.readTime : peer.readTime;
+            res.maxPayload = (local.maxPayload < peer.maxPayload) ? local.maxPayload : peer.maxPayload;
+            if(res.maxPayload == 0) res.maxPayload = local.maxPayload;
+            res.channelMatch = (local.channel == peer.channel);
+            return res;
+        }
+};
+
+#endif /* CAPABILITIES_H */
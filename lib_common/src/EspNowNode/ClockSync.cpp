@@ -0,0 +1,137 @@
+#include "ClockSync.h"
+#include <stdlib.h>
+#include <math.h>
+
+bool ClockSync::addExchange(int64_t t1, int64_t t2, int64_t t3, int64_t t4) {
+    exchanges++;
+
+    // Each side's timestamps must run forward, and the peer can't take longer than the whole round trip.
+    int64_t roundTrip = t4 - t1;
+    int64_t turnaround = t3 - t2;
+    if(roundTrip < 0 || turnaround < 0 || turnaround > roundTrip) {
+        rejected++;
+        return false;
+    }
+
+    ClockSample sample;
+    sample.localTime = t4;
+    sample.offset = ((t2 - t1) + (t3 - t4)) / 2;
+    sample.delay = (uint32_t) (roundTrip - turnaround);
+
+    // A jump far beyond any drift means the peer's clock restarted, so start over.
+    if(count > 0 && llabs(sample.offset - offsetAt(t4)) > CLOCK_SYNC_STEP_US) {
+        reset();
+        steps++;
+    }
+    accepted++;
+
+    // Open a new bin once the current one has run its length.
+    int newest = (next + CLOCK_SYNC_WINDOW - 1) % CLOCK_SYNC_WINDOW;
+    if(count == 0 || t4 - binStart >= CLOCK_SYNC_BIN_US) {
+        samples[next] = sample;
+        next = (next + 1) % CLOCK_SYNC_WINDOW;
+        if(count < CLOCK_SYNC_WINDOW) count++;
+        binStart = t4;
+    }
+
+    // Within a bin keep only the fastest exchange.
+    else if(sample.delay <= samples[newest].delay) samples[newest] = sample;
+    else return true;
+
+    fit();
+    return true;
+}
+
+void ClockSync::fit() {
+    // Only trust the exchanges that were nearly as fast as the fastest one; slower ones carry queueing asymmetry.
+    uint32_t minDelay = UINT32_MAX;
+    for(int i = 0; i < count; i++) if(samples[i].delay < minDelay) minDelay = samples[i].delay;
+    uint32_t maxDelay = minDelay + CLOCK_SYNC_DELAY_SLACK_US;
+
+    // Anchor at the newest sample so the fit works in small numbers.
+    int newest = (next + CLOCK_SYNC_WINDOW - 1) % CLOCK_SYNC_WINDOW;
+    int64_t anchor = samples[newest].localTime;
+
+    // Least squares fit of offset against local time.
+    int n = 0;
+    double sumX = 0, sumY = 0;
+    int64_t earliest = anchor;
+    for(int i = 0; i < count; i++) {
+        if(samples[i].delay > maxDelay) continue;
+        sumX += (double) (samples[i].localTime - anchor);
+        sumY += (double) samples[i].offset;
+        if(samples[i].localTime < earliest) earliest = samples[i].localTime;
+        n++;
+    }
+    double meanX = sumX / n;
+    double meanY = sumY / n;
+
+    double slope = 0;
+    if(anchor - earliest >= CLOCK_SYNC_MIN_DRIFT_SPAN_US) {
+        double sxx = 0, sxy = 0;
+        for(int i = 0; i < count; i++) {
+            if(samples[i].delay > maxDelay) continue;
+            double dx = (double) (samples[i].localTime - anchor) - meanX;
+            sxx += dx * dx;
+            sxy += dx * ((double) samples[i].offset - meanY);
+        }
+        if(sxx > 0) slope = sxy / sxx;
+
+        // Clamp to what two crystals can plausibly do.
+        double maxSlope = CLOCK_SYNC_MAX_DRIFT_PPM / 1e6;
+        if(slope > maxSlope) slope = maxSlope;
+        if(slope < -maxSlope) slope = -maxSlope;
+    }
+
+    refTime = anchor;
+    drift = slope;
+    refOffset = (int64_t) (meanY - slope * meanX);
+}
+
+void ClockSync::reset() {
+    count = 0;
+    next = 0;
+    binStart = 0;
+    accepted = 0;
+    refTime = 0;
+    refOffset = 0;
+    drift = 0;
+}
+
+bool ClockSync::isSynchronized() const { return accepted >= CLOCK_SYNC_MIN_SAMPLES; }
+
+int64_t ClockSync::offsetAt(int64_t localTime) const {
+    return refOffset + (int64_t) (drift * (double) (localTime - refTime));
+}
+
+int64_t ClockSync::toPeerTime(int64_t localTime) const {
+    return localTime + offsetAt(localTime);
+}
+
+int64_t ClockSync::fromPeerTime(int64_t peerTime) const {
+    // Solve peer = local + refOffset + drift * (local - refTime) for local.
+    double local = ((double) (peerTime - refOffset - refTime)) / (1.0 + drift);
+    return refTime + (int64_t) local;
+}
+
+uint32_t ClockSync::errorBoundAt(int64_t localTime) const {
+    if(count == 0) return UINT32_MAX;
+
+    // Narrow down where the true offset can be. Each offset was halved, so allow a microsecond of rounding.
+    double low = -1e18, high = 1e18;
+    for(int i = 0; i < count; i++) {
+        double reach = samples[i].delay / 2.0 + 1 + CLOCK_SYNC_MAX_DRIFT_PPM / 1e6 * (double) llabs(localTime - samples[i].localTime);
+        if(samples[i].offset - reach > low) low = samples[i].offset - reach;
+        if(samples[i].offset + reach < high) high = samples[i].offset + reach;
+    }
+
+    // The estimate is off by at most its distance to the farther end.
+    double estimate = (double) offsetAt(localTime);
+    double res = (estimate - low > high - estimate) ? estimate - low : high - estimate;
+    return (res > 0) ? (uint32_t) ceil(res) : 0;
+}
+
+uint32_t ClockSync::getLastDelay() const {
+    if(count == 0) return 0;
+    return samples[(next + CLOCK_SYNC_WINDOW - 1) % CLOCK_SYNC_WINDOW].delay;
+}
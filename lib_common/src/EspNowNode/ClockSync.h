@@ -0,0 +1,96 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <stdint.h>
+
+#define CLOCK_SYNC_WINDOW 16                // Number of recent bins the estimate is fit over.
+#define CLOCK_SYNC_BIN_US 500000            // Only the fastest exchange in each bin of local time is kept (us).
+#define CLOCK_SYNC_MIN_SAMPLES 4            // Exchanges needed before the estimate is trusted.
+#define CLOCK_SYNC_DELAY_SLACK_US 500       // Exchanges slower than the fastest in the window by more than this are ignored (us).
+#define CLOCK_SYNC_MIN_DRIFT_SPAN_US 1000000 // Time the window must cover before drift is estimated (us).
+#define CLOCK_SYNC_MAX_DRIFT_PPM 500.0      // Largest believable drift between two crystals (ppm).
+#define CLOCK_SYNC_STEP_US 100000           // Offset jump treated as the peer's clock restarting (us).
+
+struct _clock_sample {
+    int64_t localTime;      // Local time the exchange completed (us).
+    int64_t offset;         // Peer clock minus local clock (us).
+    uint32_t delay;         // Round trip delay excluding the peer's turnaround (us).
+};
+typedef struct _clock_sample ClockSample;
+
+/**
+ * NTP-style estimator of the offset and drift between this node's clock and its peer's.
+ * Each exchange supplies the four timestamps of a request/reply pair:
+ * t1 (local send), t2 (peer receive), t3 (peer send) and t4 (local receive).
+ * Only the fastest exchange of each CLOCK_SYNC_BIN_US bin is kept, and offset is fit against
+ * local time by least squares over those bins, so the slope tracks the relative drift of the
+ * two crystals over several seconds rather than over a burst of pings.
+ */
+class ClockSync {
+    private:
+        ClockSample samples[CLOCK_SYNC_WINDOW];
+        int count = 0;                  // Samples held.
+        int next = 0;                   // Slot the next bin is written to.
+        int64_t binStart = 0;           // Local time the newest bin opened (us).
+        uint32_t exchanges = 0;         // Exchanges offered.
+        uint32_t accepted = 0;          // Exchanges accepted since the last reset.
+        uint32_t rejected = 0;          // Exchanges discarded as implausible.
+        uint32_t steps = 0;             // Times the peer's clock jumped and the estimate restarted.
+
+        int64_t refTime = 0;            // Local time the fit is anchored at (us).
+        int64_t refOffset = 0;          // Fitted offset at refTime (us).
+        double drift = 0;               // Fitted change in offset per unit of local time.
+
+        /**
+         * Refit offset and drift over the current window.
+         */
+        void fit();
+
+    public:
+        /**
+         * Fold in one request/reply exchange.
+         * @return True if the exchange was plausible and kept.
+         */
+        bool addExchange(int64_t t1, int64_t t2, int64_t t3, int64_t t4);
+
+        /**
+         * Forget every exchange, for instance after the peer restarts.
+         */
+        void reset();
+
+        /**
+         * Is there enough history to trust the mapping.
+         */
+        bool isSynchronized() const;
+
+        /**
+         * Map a local timestamp to the peer's clock.
+         */
+        int64_t toPeerTime(int64_t localTime) const;
+
+        /**
+         * Map a peer timestamp to the local clock.
+         */
+        int64_t fromPeerTime(int64_t peerTime) const;
+
+        /**
+         * Current offset (peer minus local, in microseconds) at a local time.
+         */
+        int64_t offsetAt(int64_t localTime) const;
+
+        /**
+         * Bound on the error of the offset at a local time (us). However the path splits between
+         * the two directions, the true offset at each exchange kept is within half its delay of
+         * the one measured, and has drifted no more than CLOCK_SYNC_MAX_DRIFT_PPM since. The
+         * bound is how far the estimate can be from the truth within all of those at once.
+         */
+        uint32_t errorBoundAt(int64_t localTime) const;
+
+        double getDriftPpm() const { return drift * 1e6; }
+        uint32_t getLastDelay() const;
+        uint32_t getExchangeCount() const { return exchanges; }
+        uint32_t getRejectedCount() const { return rejected; }
+        uint32_t getStepCount() const { return steps; }
+};
+
+#endif /* CLOCK_SYNC_H */
@@ -0,0 +1,168 @@
+#include "CommandQueue.h"
+#include <string.h>
+
+static const char *const commandNames[cmd_COUNT] = {
+    "none",
+    "stop",
+    "resume",
+    "follow_in",
+    "speed_cap"
+};
+
+uint16_t CommandQueue::push(CommandType type, float value, int64_t now, bool *superseded) {
+    *superseded = false;
+    int slot = slotOf(type);
+    if(slot < 0) return 0;
+
+    // Ids skip zero so an empty ack never covers a command.
+    if(++lastId == 0) lastId = 1;
+    _pending &pending = slots[slot];
+    *superseded = pending.waiting;
+    pending.entry.id = lastId;
+    pending.entry.type = type;
+    pending.entry.value = value;
+    pending.entry.issuedAt = (uint64_t) now;
+    pending.lastSent = 0;
+    pending.waiting = true;
+    return lastId;
+}
+
+uint8_t CommandQueue::writeRecord(ESP_NOW_PACKET *packet, int64_t now, uint8_t maxPayload) {
+    // Take as many waiting commands as fit, safety first.
+    size_t limit = (maxPayload < ESPNOW_PAYLOAD_SIZE) ? maxPayload : ESPNOW_PAYLOAD_SIZE;
+    size_t room = (limit > (size_t) packet->payloadLength + ESPNOW_RECORD_HEADER_SIZE) ? limit - packet->payloadLength - ESPNOW_RECORD_HEADER_SIZE : 0;
+    uint8_t count = 0;
+    uint8_t *rec = &packet->payload[packet->payloadLength];
+    uint8_t *out = &rec[ESPNOW_RECORD_HEADER_SIZE];
+    for(int prio = 0; prio < prio_COUNT; prio++) {
+        for(int i = 0; i < COMMAND_SLOTS; i++) {
+            _pending &pending = slots[i];
+            if(!pending.waiting || priorityOf((CommandType) pending.entry.type) != prio) continue;
+            if((count + 1) * sizeof(COMMAND_ENTRY) > room) break;
+            memcpy(out, &pending.entry, sizeof(COMMAND_ENTRY));
+            out += sizeof(COMMAND_ENTRY);
+            pending.lastSent = now;
+            count++;
+        }
+    }
+    if(count == 0) return 0;
+
+    // Write the record's header last, once its length is known: [type][len][entries].
+    rec[0] = RecordType::rec_COMMAND;
+    rec[1] = count * sizeof(COMMAND_ENTRY);
+    packet->payloadLength += ESPNOW_RECORD_HEADER_SIZE + rec[1];
+    return count;
+}
+
+int64_t CommandQueue::nextDueAt() const {
+    int64_t res = INT64_MAX;
+    for(int i = 0; i < COMMAND_SLOTS; i++) {
+        const _pending &pending = slots[i];
+        if(!pending.waiting) continue;
+
+        // A command that has not gone out yet is timed from when it was issued.
+        int64_t since = (pending.lastSent != 0) ? pending.lastSent : (int64_t) pending.entry.issuedAt;
+        if(pending.lastSent == 0 && priorityOf((CommandType) pending.entry.type) == prio_SAFETY) since -= COMMAND_SAFETY_RESEND_US;
+        int64_t due = since + waitOf((CommandType) pending.entry.type);
+        if(due < res) res = due;
+    }
+    return res;
+}
+
+uint8_t CommandQueue::onAck(const ACK_RECORD &ack, int64_t arrival, LatencyHistogram *ackLatency) {
+    uint8_t res = 0;
+    for(int i = 0; i < COMMAND_SLOTS; i++) {
+        _pending &pending = slots[i];
+        if(!pending.waiting) continue;
+        int16_t age = (int16_t) (ack.highestSeq - pending.entry.id);
+        bool covered = (age == 0) || (age > 0 && age <= ACK_WINDOW_SIZE && (ack.received & (1UL << (age - 1))));
+        if(!covered) continue;
+        pending.waiting = false;
+        int64_t latency = arrival - (int64_t) pending.entry.issuedAt;
+        if(ackLatency != NULL) ackLatency->record((latency > 0) ? (uint32_t) latency : 0);
+        res++;
+    }
+    return res;
+}
+
+bool CommandQueue::isWaiting() const {
+    for(int i = 0; i < COMMAND_SLOTS; i++) if(slots[i].waiting) return true;
+    return false;
+}
+
+const char *CommandQueue::name(CommandType type) { return (type < cmd_COUNT) ? commandNames[type] : "unknown"; }
+
+bool CommandQueue::typeOf(const char *name, CommandType *type) {
+    for(int i = cmd_NONE + 1; i < cmd_COUNT; i++) {
+        if(strcmp(name, commandNames[i]) == 0) {
+            *type = (CommandType) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t CommandInbox::read(const ESP_NOW_PACKET *packet, int64_t arrival, COMMAND_ENTRY *out, uint8_t max, uint8_t *stale) {
+    *stale = 0;
+    uint8_t len = 0;
+    const uint8_t *rec = findRecord(packet, RecordType::rec_COMMAND, &len);
+    if(rec == NULL) return 0;
+
+    uint8_t res = 0;
+    uint8_t available = len / sizeof(COMMAND_ENTRY);
+    for(uint8_t i = 0; i < available; i++) {
+        COMMAND_ENTRY entry;
+        memcpy(&entry, &rec[i * sizeof(COMMAND_ENTRY)], sizeof(entry));
+        int slot = CommandQueue::slotOf((CommandType) entry.type);
+        if(entry.id == 0 || slot < 0) continue;
+
+        // Every command is acked, repeats too, since the peer resends until it hears back.
+        ackOwed = true;
+        uint16_t missed;
+        if(!window.record(entry.id, arrival, &missed)) continue;
+
+        // A command sent before one already carried out of the same kind is out of date.
+        if(applied[slot] && (int16_t) (entry.id - lastApplied[slot]) < 0) {
+            (*stale)++;
+            continue;
+        }
+        applied[slot] = true;
+        lastApplied[slot] = entry.id;
+        if(res < max) out[res++] = entry;
+    }
+
+    // Carry out safety commands first. The sender already orders them, but a receiver shouldn't count on it.
+    for(uint8_t i = 1; i < res; i++) {
+        COMMAND_ENTRY entry = out[i];
+        CommandPriority prio = CommandQueue::priorityOf((CommandType) entry.type);
+        uint8_t j = i;
+        for(; j > 0 && CommandQueue::priorityOf((CommandType) out[j - 1].type) > prio; j--) out[j] = out[j - 1];
+        out[j] = entry;
+    }
+    return res;
+}
+
+bool CommandInbox::writeAck(ESP_NOW_PACKET *packet, int64_t now) {
+    ACK_RECORD ack;
+    if(!ackOwed || !window.fill(&ack, now)) return false;
+    if(!appendRecord(packet, RecordType::rec_COMMAND_ACK, &ack, sizeof(ack))) return false;
+    ackOwed = false;
+    return true;
+}
+
+void CommandInbox::reset() {
+    window.reset();
+    for(int i = 0; i < COMMAND_SLOTS; i++) applied[i] = false;
+    ackOwed = false;
+}
+
+bool CommandInbox::hasSafety(const ESP_NOW_PACKET *packet) {
+    uint8_t len = 0;
+    const uint8_t *rec = findRecord(packet, RecordType::rec_COMMAND, &len);
+    if(rec == NULL) return false;
+    for(uint8_t i = 0; i < len / sizeof(COMMAND_ENTRY); i++) {
+        CommandType type = (CommandType) rec[i * sizeof(COMMAND_ENTRY) + offsetof(COMMAND_ENTRY, type)];
+        if(CommandQueue::priorityOf(type) == prio_SAFETY) return true;
+    }
+    return false;
+}
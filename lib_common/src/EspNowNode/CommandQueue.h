@@ -0,0 +1,178 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <stdint.h>
+#include "EspNowPacket.h"
+#include "AckWindow.h"
+#include "LatencyHistogram.h"
+
+#define COMMAND_SAFETY_RESEND_US 20000      // Unacked safety commands get a frame of their own this often (us).
+#define COMMAND_CONTROL_WAIT_US 100000      // Longest a control command waits to ride on another frame before getting its own (us).
+#define COMMAND_STOP_DEADLINE_US 50000      // Stop latency, from the sender issuing to the motors stopping, counted as a miss (us).
+#define COMMAND_SLOTS 3                     // Commands that can be waiting at once: one per kind.
+
+/**
+ * Commands one device gives the other.
+ */
+enum _command_type : uint8_t {
+    cmd_NONE = 0,               // Reserved. Never written to the wire.
+    cmd_STOP,                   // Stop the motors and hold them until resumed.
+    cmd_RESUME,                 // Let the motors drive again.
+    cmd_SET_FOLLOW_DISTANCE,    // Distance to keep from the target (inches).
+    cmd_SET_SPEED_CAP,          // Highest duty the motors are driven at (0-255).
+    cmd_COUNT
+};
+typedef enum _command_type CommandType;
+
+/**
+ * Order commands are sent and carried out in. Safety commands go ahead of everything else.
+ */
+enum _command_priority : uint8_t {
+    prio_SAFETY = 0,            // Sent at once in a frame of its own, and carried out ahead of queued frames.
+    prio_CONTROL,               // Rides on the next frame going out.
+    prio_COUNT
+};
+typedef enum _command_priority CommandPriority;
+
+/**
+ * A command as laid out on the wire. A rec_COMMAND record holds one or more, safety first.
+ */
+struct __attribute__((packed)) _command_entry {
+    uint16_t id;                // Identifies the command in acks. Never zero on the wire.
+    uint8_t type;               // CommandType.
+    float value;                // Argument, if the command takes one.
+    uint64_t issuedAt;          // When the sender issued the command, in its clock (us).
+};
+typedef struct _command_entry COMMAND_ENTRY;
+
+struct _command_stats {
+    uint32_t issued;                    // Commands issued by this node.
+    uint32_t superseded;                // Of those, replaced by a newer command of the same kind before being acked.
+    uint32_t acked;                     // Of those, acked by the peer.
+    uint32_t framesSent;                // Frames sent just to carry commands.
+    uint32_t received;                  // Commands received, not counting repeats.
+    uint32_t executed;                  // Commands carried out.
+    uint32_t stale;                     // Commands dropped for arriving after a newer one of the same kind.
+    uint32_t failsafeStops;             // Stops carried out because the link was lost.
+    uint32_t stopsUntimed;              // Stops carried out before the clocks were in sync.
+    uint32_t deadlineMisses;            // Stops slower than COMMAND_STOP_DEADLINE_US.
+    uint32_t lastStopLatency;           // Latency of the last stop (in microseconds).
+    LatencyHistogram stopLatency;       // Time from the peer issuing a stop to the motors stopping (in microseconds).
+    LatencyHistogram ackLatency;        // Time from this node issuing a command to the peer's ack (in microseconds).
+};
+typedef struct _command_stats COMMAND_STATS;
+
+/**
+ * Commands waiting for the peer's ack. Only the newest command of each kind is kept, so a
+ * resume issued after a stop replaces it rather than racing it. Commands ride on every frame
+ * sent until acked, and get a frame of their own when due. Not thread safe.
+ */
+class CommandQueue {
+    private:
+        struct _pending {
+            COMMAND_ENTRY entry;
+            int64_t lastSent;           // When the command last went out (us). Zero if never.
+            bool waiting;               // Is the command waiting for its ack.
+        };
+        _pending slots[COMMAND_SLOTS] = {};
+        uint16_t lastId = 0;
+
+        /**
+         * How long a command may wait before it needs a frame of its own (us).
+         */
+        static uint32_t waitOf(CommandType type) { return (priorityOf(type) == prio_SAFETY) ? COMMAND_SAFETY_RESEND_US : COMMAND_CONTROL_WAIT_US; }
+
+    public:
+        /**
+         * Queue a command, replacing any command of the same kind still waiting.
+         * @param now When the command is issued (us).
+         * @param superseded Set if a waiting command was replaced.
+         * @return Id of the command, or zero if the type is unknown.
+         */
+        uint16_t push(CommandType type, float value, int64_t now, bool *superseded);
+
+        /**
+         * Append a rec_COMMAND record of every command waiting, safety first.
+         * @param maxPayload Payload the peer accepts (bytes).
+         * @return Number of commands appended.
+         */
+        uint8_t writeRecord(ESP_NOW_PACKET *packet, int64_t now, uint8_t maxPayload = ESPNOW_PAYLOAD_SIZE);
+
+        /**
+         * When the next waiting command needs a frame of its own (us). INT64_MAX if none is waiting.
+         */
+        int64_t nextDueAt() const;
+
+        /**
+         * Apply the peer's rec_COMMAND_ACK.
+         * @param ackLatency Given the time from issue to ack of each command acked.
+         * @return Number of commands acked.
+         */
+        uint8_t onAck(const ACK_RECORD &ack, int64_t arrival, LatencyHistogram *ackLatency);
+
+        bool isWaiting() const;
+
+        static CommandPriority priorityOf(CommandType type) { return (type == cmd_STOP) ? prio_SAFETY : prio_CONTROL; }
+
+        /**
+         * Kind of a command. Commands of a kind replace one another, so a stop and a resume share one.
+         */
+        static int slotOf(CommandType type) {
+            switch(type) {
+                case cmd_STOP :
+                case cmd_RESUME :               return 0;
+                case cmd_SET_FOLLOW_DISTANCE :  return 1;
+                case cmd_SET_SPEED_CAP :        return 2;
+                default :                       return -1;
+            }
+        }
+
+        static const char *name(CommandType type);
+
+        /**
+         * Look a command up by name.
+         * @return False if no command has that name.
+         */
+        static bool typeOf(const char *name, CommandType *type);
+};
+
+/**
+ * Commands received from the peer. Drops repeats and commands older than one already carried
+ * out of the same kind, and keeps the ack owed. Not thread safe.
+ */
+class CommandInbox {
+    private:
+        ReceiveWindow window;                       // Command ids received, acked back to the peer.
+        uint16_t lastApplied[COMMAND_SLOTS] = {0};  // Id of the last command carried out, per kind.
+        bool applied[COMMAND_SLOTS] = {false};      // Has a command of each kind been carried out.
+        bool ackOwed = false;                       // Did the peer send commands it should hear back about.
+
+    public:
+        /**
+         * Take the commands of a packet's rec_COMMAND record.
+         * @param out Given the commands to carry out, safety first.
+         * @param stale Set to the number of commands dropped for arriving after a newer one of the same kind.
+         * @return Number of commands in `out`.
+         */
+        uint8_t read(const ESP_NOW_PACKET *packet, int64_t arrival, COMMAND_ENTRY *out, uint8_t max, uint8_t *stale);
+
+        /**
+         * Append a rec_COMMAND_ACK record, if one is owed.
+         * @return True if a record was appended.
+         */
+        bool writeAck(ESP_NOW_PACKET *packet, int64_t now);
+
+        bool isAckOwed() const { return ackOwed; }
+
+        /**
+         * Forget the peer's numbering, e.g. when it restarts with a handshake.
+         */
+        void reset();
+
+        /**
+         * Does a packet carry a safety command. Cheap enough for the Wi-Fi callback.
+         */
+        static bool hasSafety(const ESP_NOW_PACKET *packet);
+};
+
+#endif /* COMMAND_QUEUE_H */
@@ -0,0 +1,148 @@
+#include "ConfigStore.h"
+#include <string.h>
+
+static const char *const keyNames[cfg_COUNT] = {
+    "trigger_delay_ms",
+    "obstacle_in",
+    "presence_in",
+    "presence_diff_pct",
+    "presence_weak_pct",
+    "presence_strong_pct"
+};
+
+ConfigStore::ConfigStore(uint8_t replica) {
+    this->replica = (replica < CONFIG_MAX_REPLICAS) ? replica : CONFIG_MAX_REPLICAS - 1;
+    for(int i = 0; i < cfg_COUNT; i++) {
+        entries[i].key = i;
+        entries[i].replica = 0;
+        entries[i].counter = 0;
+        entries[i].value = 0;
+    }
+}
+
+void ConfigStore::setDefault(ConfigKey key, float value) {
+    if(key >= cfg_COUNT || entries[key].counter != 0) return;
+    entries[key].value = value;
+}
+
+bool ConfigStore::set(ConfigKey key, float value) {
+    // Rewriting the same value would only make traffic.
+    if(key >= cfg_COUNT || entries[key].value == value) return false;
+
+    // Stamp past every write seen from any device, so this one supersedes them all.
+    uint32_t clock = 0;
+    for(int i = 0; i < CONFIG_MAX_REPLICAS; i++) if(version[i] > clock) clock = version[i];
+    version[replica] = clock + 1;
+    entries[key].replica = replica;
+    entries[key].counter = version[replica];
+    entries[key].value = value;
+    return true;
+}
+
+bool ConfigStore::newer(const CONFIG_ENTRY &incoming) const {
+    const CONFIG_ENTRY &held = entries[incoming.key];
+    if(incoming.counter != held.counter) return incoming.counter > held.counter;
+    return incoming.replica > held.replica;
+}
+
+bool ConfigStore::hasDelta(const ConfigPeer &peer) const {
+    if(peer.ackOwed) return true;
+    for(int i = 0; i < CONFIG_MAX_REPLICAS; i++) if(version[i] > peer.known[i]) return true;
+    return false;
+}
+
+bool ConfigStore::writeDelta(ESP_NOW_PACKET *packet, ConfigPeer *peer, uint8_t maxPayload) {
+    if(!hasDelta(*peer)) return false;
+
+    // Count the writes the peer is missing and check they fit.
+    uint8_t count = 0;
+    for(int i = 0; i < cfg_COUNT; i++) {
+        if(entries[i].counter > peer->known[entries[i].replica]) count++;
+    }
+    size_t limit = (maxPayload < ESPNOW_PAYLOAD_SIZE) ? maxPayload : ESPNOW_PAYLOAD_SIZE;
+    uint8_t len = sizeof(CONFIG_RECORD_HEADER) + count * sizeof(CONFIG_ENTRY);
+    if((size_t) packet->payloadLength + ESPNOW_RECORD_HEADER_SIZE + len > limit) return false;
+
+    // Write the record in place: [type][len][header][entries].
+    uint8_t *rec = &packet->payload[packet->payloadLength];
+    rec[0] = RecordType::rec_CONFIG;
+    rec[1] = len;
+
+    CONFIG_RECORD_HEADER header;
+    memcpy(header.version, version, sizeof(version));
+    header.count = count;
+    memcpy(&rec[ESPNOW_RECORD_HEADER_SIZE], &header, sizeof(header));
+
+    uint8_t *out = &rec[ESPNOW_RECORD_HEADER_SIZE + sizeof(header)];
+    for(int i = 0; i < cfg_COUNT; i++) {
+        if(entries[i].counter <= peer->known[entries[i].replica]) continue;
+        memcpy(out, &entries[i], sizeof(CONFIG_ENTRY));
+        out += sizeof(CONFIG_ENTRY);
+    }
+
+    packet->payloadLength += ESPNOW_RECORD_HEADER_SIZE + len;
+    peer->ackOwed = false;
+    return true;
+}
+
+uint32_t ConfigStore::merge(const ESP_NOW_PACKET *packet, ConfigPeer *peer) {
+    uint8_t len = 0;
+    const uint8_t *rec = findRecord(packet, RecordType::rec_CONFIG, &len);
+    if(rec == NULL || len < sizeof(CONFIG_RECORD_HEADER)) return 0;
+
+    // Trust the record's length over its count.
+    CONFIG_RECORD_HEADER header;
+    memcpy(&header, rec, sizeof(header));
+    size_t available = (len - sizeof(header)) / sizeof(CONFIG_ENTRY);
+    uint8_t count = (header.count < available) ? header.count : available;
+
+    // Keep whichever write wins for each key.
+    uint32_t changed = 0;
+    const uint8_t *in = &rec[sizeof(header)];
+    for(uint8_t i = 0; i < count; i++, in += sizeof(CONFIG_ENTRY)) {
+        CONFIG_ENTRY entry;
+        memcpy(&entry, in, sizeof(entry));
+        if(entry.key >= cfg_COUNT || entry.replica >= CONFIG_MAX_REPLICAS || !newer(entry)) continue;
+        if(entries[entry.key].value != entry.value) changed |= (1UL << entry.key);
+        entries[entry.key] = entry;
+    }
+
+    // The peer holds everything up to its version vector, and so now does this device. Taking
+    // this device's own count back from the peer keeps writes after a restart winning.
+    bool advanced = false;
+    for(int i = 0; i < CONFIG_MAX_REPLICAS; i++) {
+        if(header.version[i] > version[i]) {
+            version[i] = header.version[i];
+            advanced = true;
+        }
+        if(header.version[i] > peer->known[i]) peer->known[i] = header.version[i];
+    }
+
+    // Let the peer know once what it sent has landed.
+    if(count > 0 || advanced) peer->ackOwed = true;
+    return changed;
+}
+
+void ConfigStore::setListener(ConfigChangeCallback callback, void *context) {
+    listener = callback;
+    listenerContext = context;
+}
+
+void ConfigStore::notify(uint32_t changed) const {
+    if(listener == NULL) return;
+    for(int i = 0; i < cfg_COUNT; i++) {
+        if(changed & (1UL << i)) listener((ConfigKey) i, entries[i].value, listenerContext);
+    }
+}
+
+const char *ConfigStore::name(ConfigKey key) { return (key < cfg_COUNT) ? keyNames[key] : "unknown"; }
+
+bool ConfigStore::keyOf(const char *name, ConfigKey *key) {
+    for(int i = 0; i < cfg_COUNT; i++) {
+        if(strcmp(name, keyNames[i]) == 0) {
+            *key = (ConfigKey) i;
+            return true;
+        }
+    }
+    return false;
+}
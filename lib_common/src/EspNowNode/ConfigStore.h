@@ -0,0 +1,139 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdint.h>
+#include "EspNowPacket.h"
+
+#define CONFIG_MAX_REPLICAS 4       // Devices that can write to a store.
+
+/**
+ * Tuning values shared by every device.
+ */
+enum _config_key : uint8_t {
+    cfg_TRIGGER_DELAY = 0,  // Delay of the trigger timer, and lead of scheduled triggers (ms).
+    cfg_OBSTACLE_LIMIT,     // HCSR04 obstacle detection limit (inches).
+    cfg_PRESENCE_LIMIT,     // HCSR04 presence detection limit (inches).
+    cfg_PRESENCE_DIFF,      // Meaningful difference between a buffer average and the presence limit (%).
+    cfg_PRESENCE_WEAK,      // Difference between buffer averages below which presence is weak (%).
+    cfg_PRESENCE_STRONG,    // Difference between buffer averages above which presence is strong (%).
+    cfg_COUNT
+};
+typedef enum _config_key ConfigKey;
+
+/**
+ * A value and the write that produced it, as laid out on the wire.
+ */
+struct __attribute__((packed)) _config_entry {
+    uint8_t key;                // ConfigKey.
+    uint8_t replica;            // Device that wrote the value.
+    uint32_t counter;           // One past the highest counter the writer had seen. Zero for defaults.
+    float value;
+};
+typedef struct _config_entry CONFIG_ENTRY;
+
+/**
+ * Header of a rec_CONFIG record. `count` entries follow it.
+ */
+struct __attribute__((packed)) _config_record_header {
+    uint32_t version[CONFIG_MAX_REPLICAS];  // Sender's version vector: highest counter seen from each device.
+    uint8_t count;                          // Number of entries in the record.
+};
+typedef struct _config_record_header CONFIG_RECORD_HEADER;
+
+typedef void (* ConfigChangeCallback)(ConfigKey key, float value, void *context);
+
+/**
+ * What one peer is known to hold. Kept per link.
+ */
+class ConfigPeer {
+    public:
+        uint32_t known[CONFIG_MAX_REPLICAS] = {0};  // Highest counter from each device the peer is known to hold.
+        bool ackOwed = false;                       // Did the peer send something it should hear back about.
+
+        /**
+         * Forget what the peer holds, e.g. when it restarts with a handshake.
+         */
+        void reset() {
+            for(int i = 0; i < CONFIG_MAX_REPLICAS; i++) known[i] = 0;
+            ackOwed = false;
+        }
+};
+
+/**
+ * Key/value store replicated between devices by exchanging deltas. Each value remembers the
+ * write that produced it. Writes are stamped with a Lamport counter, one past the highest seen
+ * from any device, so a write made after another has been merged always wins over it;
+ * concurrent writes are settled by counter, then by device.
+ * A device only sends what the peer's version vector shows it is missing, so nothing goes
+ * on the air once both agree. Not thread safe.
+ */
+class ConfigStore {
+    private:
+        uint8_t replica;                            // This device.
+        uint32_t version[CONFIG_MAX_REPLICAS] = {0};  // Highest counter seen from each device.
+        CONFIG_ENTRY entries[cfg_COUNT];
+        ConfigChangeCallback listener = NULL;
+        void *listenerContext = NULL;
+
+        /**
+         * Does write (counter, replica) win over the value held.
+         */
+        bool newer(const CONFIG_ENTRY &incoming) const;
+
+    public:
+        ConfigStore(uint8_t replica);
+
+        /**
+         * Value a key holds until written. Defaults are never sent, so must match on every device.
+         */
+        void setDefault(ConfigKey key, float value);
+
+        /**
+         * Write a value from this device. The listener is told through `notify`.
+         * @return True if the value changed.
+         */
+        bool set(ConfigKey key, float value);
+
+        float get(ConfigKey key) const { return entries[key].value; }
+
+        /**
+         * Does the peer need a record: it is missing writes, or owed word of what it sent.
+         */
+        bool hasDelta(const ConfigPeer &peer) const;
+
+        /**
+         * Append a rec_CONFIG record of the writes the peer is missing, if it needs one.
+         * @param maxPayload Payload the peer accepts (bytes).
+         * @return True if a record was appended.
+         */
+        bool writeDelta(ESP_NOW_PACKET *packet, ConfigPeer *peer, uint8_t maxPayload = ESPNOW_PAYLOAD_SIZE);
+
+        /**
+         * Apply the rec_CONFIG record of a received packet. The listener is told through `notify`.
+         * @return Bit mask of the keys whose value changed.
+         */
+        uint32_t merge(const ESP_NOW_PACKET *packet, ConfigPeer *peer);
+
+        /**
+         * Be told of every value that changes, locally or by merge.
+         */
+        void setListener(ConfigChangeCallback callback, void *context);
+
+        /**
+         * Tell the listener about the keys in a mask.
+         */
+        void notify(uint32_t changed) const;
+
+        uint8_t getReplica() const { return replica; }
+        uint32_t getVersion(uint8_t replica) const { return (replica < CONFIG_MAX_REPLICAS) ? version[replica] : 0; }
+
+        static const char *name(ConfigKey key);
+
+        /**
+         * Look a key up by name.
+         * @return False if no key has that name.
+         */
+        static bool keyOf(const char *name, ConfigKey *key);
+};
+
+#endif /* CONFIG_STORE_H */
@@ -0,0 +1,47 @@
+#include "EspNowNetwork.h"
+
+EspNowNetwork::~EspNowNetwork() {
+    for(uint8_t i = 0; i < sessionCount; i++) delete sessions[i];
+}
+
+EspNowNode *EspNowNetwork::addSession(EspNowNode *session) {
+    int slot = scheduler.addSlot();
+    if(slot < 0) {
+        delete session;
+        return NULL;
+    }
+    session->assignSlot(&scheduler, (uint8_t) slot);
+    sessions[sessionCount++] = session;
+    return session;
+}
+
+#ifdef ARDUINO
+EspNowNode *EspNowNetwork::addPeer(const uint8_t *peerMacAddress) {
+    if(started || sessionCount >= TDMA_MAX_SLOTS) return NULL;
+    return addSession(new EspNowNode(peerMacAddress, mode, ackRequired));
+}
+#endif
+
+EspNowNode *EspNowNetwork::addPeer(Transport *transport) {
+    if(started || sessionCount >= TDMA_MAX_SLOTS) return NULL;
+    return addSession(new EspNowNode(transport, mode, ackRequired));
+}
+
+bool EspNowNetwork::start() { return startSessions(false); }
+
+bool EspNowNetwork::startPolled() { return startSessions(true); }
+
+bool EspNowNetwork::startSessions(bool polled) {
+    bool res = true;
+
+    // Every slot is counted from the same instant.
+    scheduler.setEpoch(platformMicros());
+    for(uint8_t i = 0; i < sessionCount; i++) {
+        if(!(polled ? sessions[i]->startPolled() : sessions[i]->start())) {
+            platformLog("Session %u not started.", i);
+            res = false;
+        }
+    }
+    started = true;
+    return res;
+}
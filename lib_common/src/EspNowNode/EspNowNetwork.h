@@ -0,0 +1,78 @@
+#ifndef ESP_NOW_NETWORK_H
+#define ESP_NOW_NETWORK_H
+
+#include "EspNowNode.h"
+
+/**
+ * One node talking to several peers. Each peer gets its own session (an EspNowNode with its
+ * own sequence numbers, clock sync, retransmit timer and protocol state) and its own slot
+ * of a shared TDMA schedule, so the ping exchanges and the acoustic pings they trigger
+ * never overlap between pairs.
+ */
+class EspNowNetwork {
+    private:
+        Mode mode;                                      // Mode of every session.
+        bool ackRequired;                               // Do the sessions require explicit acknowledgement.
+        TdmaScheduler scheduler;                        // Slots shared by the sessions.
+        EspNowNode *sessions[TDMA_MAX_SLOTS] = {NULL};  // One session per peer.
+        uint8_t sessionCount = 0;                       // Sessions added.
+        bool started = false;                           // Have the sessions been started.
+
+        /**
+         * Give a new session the next slot.
+         */
+        EspNowNode *addSession(EspNowNode *session);
+
+        /**
+         * Start the schedule and every session, with or without their tasks.
+         */
+        bool startSessions(bool polled);
+
+    public:
+        EspNowNetwork(
+                Mode nodeMode,                                  // This node's Mode towards every peer.
+                bool ackRequired = false,                       // Does this node require EXPLICIT acknowledgement.
+                uint32_t slotUs = TDMA_DEFAULT_SLOT_US,         // Length of each peer's slot (us).
+                uint32_t guardUs = TDMA_DEFAULT_GUARD_US        // Closed tail of each slot (us). Cover the trigger lead and echo window.
+            ) :
+            scheduler(slotUs, guardUs)
+        {
+            this->mode = nodeMode;
+            this->ackRequired = ackRequired;
+        }
+
+        ~EspNowNetwork();
+
+#ifdef ARDUINO
+        /**
+         * Add a peer reached over ESP-NOW. Register the session's callbacks before `start`.
+         * @return The peer's session, or NULL if every slot is taken or the network has started.
+         */
+        EspNowNode *addPeer(const uint8_t *peerMacAddress);
+#endif
+
+        /**
+         * Add a peer reached over any transport. The transport is not owned by the network.
+         * @return The peer's session, or NULL if every slot is taken or the network has started.
+         */
+        EspNowNode *addPeer(Transport *transport);
+
+        /**
+         * Start the schedule and every session.
+         * @return True if every session started.
+         */
+        bool start();
+
+        /**
+         * Start the schedule and every session without their tasks. The caller services each
+         * session in their place (see EspNowNode::startPolled).
+         * @return True if every session started.
+         */
+        bool startPolled();
+
+        uint8_t getPeerCount() { return sessionCount; }
+        EspNowNode *getPeer(uint8_t index) { return (index < sessionCount) ? sessions[index] : NULL; }
+        TdmaScheduler &getScheduler() { return scheduler; }
+};
+
+#endif /* ESP_NOW_NETWORK_H */
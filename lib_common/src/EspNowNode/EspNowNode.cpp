@@ -1,119 +1,223 @@
 #include "EspNowNode.h"
+#include <stdio.h>
+#include <string.h>
 
-// Define task handles.
-TaskHandle_t esp_now_tx_rx_handle = NULL;
-TaskHandle_t esp_now_process_data_handle = NULL;
+#ifdef ARDUINO
+#include "EspNowTransport.h"
+#endif
+
+/**
+ * Ticks to block for to wait a number of microseconds, rounded up and never zero.
+ */
+static TickType_t ticksFor(int64_t us) {
+    TickType_t ticks = (us > 0) ? pdMS_TO_TICKS((us + 999) / 1000) : 0;
+    return (ticks > 0) ? ticks : 1;
+}
 
 void esp_now_tx_rx_task(void *pvParams) {
     // Setup.
     EspNowNode *node = static_cast<EspNowNode *>(pvParams);
-    bool txGood, txTimeout, tryToTx, printRxMsg;
-    ulong lastTimeSent = 0;
+    allocGuardWatchTask();
     
     // Task loop.
     for(;;) {
 
-        // End if possible.
-        if(node->isTransmissionPaused()) {
-            node->end();
-        }
-
-        // Ready to transmit.
-        txTimeout = (millis() - lastTimeSent) > ACK_TIMEOUT_MS;
-        tryToTx = (node->readyToTransmit() == true && !node->isTransmissionPaused()) || (txTimeout);
-        if(tryToTx) {
+        // Hold while paused. The tasks and session are kept so the link can resume.
+        node->waitWhilePaused();
 
-            //node->reRegister();
-            txGood = node->transmit();
-            if(txGood) {
-                lastTimeSent = millis();
-                printRxMsg = true;
-            }
-            else {
-                Serial.println("Failed Transmission");
-                node->reRegister();
-            }
-        }
-        
-        // Ready to receive.
-        else {
-            if(printRxMsg && false) {
-                if(node->isNodeTransmitter()) Serial.println("Waiting for Acknowledgment From Receiver (Bot)");
-                else Serial.println("Waiting for acknowledgement from Transmitter (Belt)");
-                printRxMsg = false;
-            }
-        }
-        vTaskDelay(pdMS_TO_TICKS(TaskDelayLength));
+        // Send whatever is due, then block until the node is signalled ready to transmit or the pass
+        // asked to run again.
+        ulTaskNotifyTake(pdTRUE, ticksFor(node->serviceTxRx()));
     }
 }
 
 void esp_now_process_data_task(void *pvParams) {
     // Setup.
     EspNowNode *node = static_cast<EspNowNode *>(pvParams);
-    bool success = false;
+    allocGuardWatchTask();
 
     // Task loop.
     for(;;) {
         // Wait for notifcation before processing data.
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);  
         
-        // End if possible.
-        if(node->isTransmissionPaused()) {
-            node->end();
-        }
-        
-        // Call the proper call back based on data sent.
-        //log_e("processing data called");
-        //node->showDataReceived();
-        success = node->proccessPacket();
-        if(success) node->setReadyToTransmit(true);
-        //else log_e("Data processing failed.");
+        // Hold while paused. Frames arriving meanwhile wait in the queue.
+        node->waitWhilePaused();
+        node->serviceReceived();
         
         // No need to delay due to blocking by notifcation waiting.
     }
 }
 
-bool EspNowNode::send_message() {
+#ifdef ARDUINO
+EspNowNode::EspNowNode(const uint8_t* peerMacAddress, Mode nodeMode, bool ackRequired) {
+    // Set the peer mac address.
+    for(int i = 0; i < 6; i++) this->peerMacAddress[i] = peerMacAddress[i];
+
+    // Run over ESP-NOW.
+    transport = new EspNowTransport(peerMacAddress, ESPNOW_WIFI_CHANNEL);
+    ownsTransport = true;
+    initNode(nodeMode, ackRequired);
+}
+#endif
+
+int64_t EspNowNode::serviceTxRx() {
+    bool tryToTx = false;
+
+    // Declare the link lost once the peer has gone quiet, and re-register it while it is.
+    checkLink();
+
+    // Let out frames the fault injector is holding back.
+    serviceFaults();
+
+    // Commands that are due go out at once in a frame of their own, ahead of acks, retransmissions and pings.
+    if(commandDue()) {
+        txGood = transmitCommand();
+        if(!txGood) {
+            platformLog("Failed Command");
+            reRegister();
+        }
+    }
+
+    // Emission times go out at once too, so the receiver can range the burst it is hearing.
+    else if(emissionDue()) {
+        txGood = transmitEmission();
+        if(!txGood) {
+            platformLog("Failed Emission");
+            reRegister();
+        }
+    }
+
+    // Report frames the peer skipped at once. Every other ack rides on a frame sent for its own sake.
+    else if(explicitAckDue()) {
+        txGood = transmitAck();
+        if(!txGood) {
+            platformLog("Failed Ack");
+            reRegister();
+        }
+    }
+
+    // Resend the frame in flight if its ack is overdue (or re-answer a duplicate). Only within this session's slot.
+    else if(retransmitDue() && slotOpen()) {
+        txGood = retransmit();
+        if(!txGood) {
+            platformLog("Failed Retransmission");
+            reRegister();
+        }
+    }
+
+    // Ready to transmit. Only the receiver sends a heartbeat after a silence; the transmitter retransmits.
+    else {
+        bool txTimeout = !isNodeTransmitter() && (platformMicros() - lastTimeSent) > LINK_HEARTBEAT_US;
+        tryToTx = (readyToTransmit() && !isTransmissionPaused()) || txTimeout;
+        tryToTx = tryToTx && slotOpen() && pingDue();
+    }
+    if(tryToTx) {
+        txGood = transmit();
+        if(txGood) lastTimeSent = platformMicros();
+        else {
+            platformLog("Failed Transmission");
+            reRegister();
+        }
+    }
+
+    // Time out to resend on a lost ack or send a heartbeat, or sooner to retry a failed send.
+    return txGood ? getTxWaitUs() : TX_RETRY_DELAY_MS * 1000LL;
+}
+
+uint32_t EspNowNode::serviceReceived() {
+    // Drain every frame that arrived since the last pass and call the proper call back for each.
+    uint32_t res = 0;
+    while(loadNextPacket()) {
+        if(proccessPacket()) setReadyToTransmit(true);
+        res++;
+    }
+    return res;
+}
+
+bool EspNowNode::send_message(const ESP_NOW_PACKET *packet, bool resend) {
     bool res = true;
-    if(!send((uint8_t *) &outgoingData, sizeof(ESP_NOW_PACKET))) {
+    size_t len = packetWireLength(packet);
+    lastSent = packet;
+    if(!transport->send((const uint8_t *) packet, len)) {
         //log_e("Failed to broadcast message!");
         res = false;
     }
+    int64_t now = platformMicros();
+
+    // Only the frame in flight runs the retransmit timer.
+    if(packet == &outgoingData) lastSendAttempt = now;
+    recordTransmission(res);
+    if(res) airtime.record(Airtime::classOf(packet->header, resend), len, now);
     return res;
 }
 
-void EspNowNode::initWifi() {
-    WiFi.mode(WIFI_MODE_APSTA);
-    WiFi.setChannel(ESPNOW_WIFI_CHANNEL);
-    while(!WiFi.STA.started()) vTaskDelay(pdMS_TO_TICKS(100));
-}
+void EspNowNode::recordTransmission(bool success) {
+    int64_t now = platformMicros();
+    if(!success) {
+        txStats.sendFailures++;
+        return;
+    }
+    txStats.framesSent++;
 
-void EspNowNode::initESPNOW() {
+    // Time from the reply that readied this node to this frame leaving.
+    if(replyPending) {
+        txStats.replyToSend.record((uint32_t) (now - lastArrivalTime));
+        replyPending = false;
+    }
 
-    // Begin ESP NOW and add Peer to the network.
-    bool success = true;
-    if(!ESP_NOW.begin()) {
-        //log_e("Failed to init ESP-NOW!");
-        success = false;
+    // Roll the send rate over once a second.
+    framesThisWindow++;
+    if(now - rateWindowStart >= 1000000) {
+        txStats.framesPerSecond = framesThisWindow * 1000000.0f / (now - rateWindowStart);
+        framesThisWindow = 0;
+        rateWindowStart = now;
     }
-    if(!success || !add()) {
-        //log_e("Failed to register broadcast peer!");
-        success = false;
-    } 
+}
 
-    if(!success) {
-        Serial.println("Failed to initilize ESP NOW.");
-        Serial.println("Rebooting");
-        vTaskDelay(pdMS_TO_TICKS(5000));
-        ESP.restart();
+void EspNowNode::initNode(Mode nodeMode, bool ackRequired) {
+    // Initialize outgoing data packet. First to be transmitted by the Master. 
+    clearPacket(&outgoingData, Header::HANDSHAKE, AckMessage::Received_Handshake);
+    
+    // Initialize incoming data packet.
+    clearPacket(&incomingData, Header::HANDSHAKE, AckMessage::Received_Handshake);
+    clearPacket(&controlData, Header::ACK, AckMessage::Received_Handshake);
+
+    // Select mode. Transmitter begins ready to transmit. Receiver begins waiting.
+    waitingForData = (nodeMode == Mode::Transmitter) ? false : true;
+    this->ackRequired = ackRequired;
+    this->mode = nodeMode;
+    protocol.setActionCallback(&EspNowNode::onProtocolAction, this);
+    transport->setListener(this);
+
+    // Assume a peer of the previous firmware generation until it says otherwise.
+    localCaps = Capabilities::baseline(ESPNOW_WIFI_CHANNEL);
+    localCaps.protocolVersion = ESPNOW_PROTOCOL_VERSION;
+    localCaps.features = CAP_LOCAL_FEATURES;
+    peerCaps = Capabilities::baseline(ESPNOW_WIFI_CHANNEL);
+    negotiated = Capabilities::negotiate(localCaps, peerCaps);
+}
+
+void EspNowNode::initTransport() {
+
+    // Bring up the link to the peer, backing off between attempts rather than rebooting.
+    ExponentialBackoff backoff;
+    while(!transport->begin()) {
+        uint32_t delay = backoff.attempt(platformMicros());
+        taskENTER_CRITICAL(&linkLock);
+        linkMonitor.recordInitRetry();
+        taskEXIT_CRITICAL(&linkLock);
+        platformLog("Failed to initilize ESP NOW. Retrying in %lu ms.", (unsigned long) (delay / 1000));
+        transport->end();
+        vTaskDelay(pdMS_TO_TICKS(delay / 1000));
     }
     esp_now_setup = true;
-    Serial.println("Peer Has Begun Broadcasting");
-    Serial.println("Communication info:");
-    Serial.println("\t Mode: " + String(WiFi.getMode()));
-    Serial.println("\t Node Mac Address: " + getThisMacAddress());
-    Serial.println("\t Peer Mac Address: " + getPeerMacAddress());
-    Serial.println("\t Channel: " + String(WiFi.channel()));
+    platformLog("Peer Has Begun Broadcasting");
+    platformLog("Communication info:");
+    platformLog("\t Mode: %d", platformWifiMode());
+    platformLog("\t Node Mac Address: %s", getThisMacAddress());
+    platformLog("\t Peer Mac Address: %s", getPeerMacAddress());
+    platformLog("\t Channel: %d", platformWifiChannel());
 }
 
 void EspNowNode::initTasks() {
@@ -121,13 +225,13 @@ void EspNowNode::initTasks() {
 
     // Begin the communication task.
     res = beginCommunicationTask();
-    if(res != pdPASS) Serial.println("ESP Now Communication Task Not Started!");
-    else Serial.println("ESP Now Communication Task Started Succesfully!");
+    if(res != pdPASS) platformLog("ESP Now Communication Task Not Started!");
+    else platformLog("ESP Now Communication Task Started Succesfully!");
 
     // Begin data processing task.
     res = beginProcessDataTask();
-    if(res != pdPASS) Serial.println("ESP Now Process Data Task Not Started!");
-    else Serial.println("ESP Now Process Data Task Started Succesfully!");
+    if(res != pdPASS) platformLog("ESP Now Process Data Task Not Started!");
+    else platformLog("ESP Now Process Data Task Started Succesfully!");
 }
 
 BaseType_t EspNowNode::beginCommunicationTask() {
@@ -137,7 +241,7 @@ BaseType_t EspNowNode::beginCommunicationTask() {
         ESPNOW_TASK_DEPTH,       // Size of stack allocated to the task (in bytes).
         this,                   // Pointer to parameters used for task creation.
         1,           // Task priority level.
-        &esp_now_tx_rx_handle, // Pointer to task handle.
+        &txRxHandle, // Pointer to task handle.
         1                       // Core that the task will run on.
     );
 }
@@ -149,21 +253,29 @@ BaseType_t EspNowNode::beginProcessDataTask() {
         ESPNOW_TASK_DEPTH,              // Size of stack allocated to the task (in bytes).
         this,                           // Pointer to parameters used for task creation.
         1,                              // Task priority level.
-        &esp_now_process_data_handle,   // Pointer to task handle.
+        &processDataHandle,   // Pointer to task handle.
         1                               // Core that the task will run on.
     );
 }
 
 void EspNowNode::buildTransmission() {
-    // Determine the next packet components.
-    Header head = determineNextHeader();
-    AckMessage ack = determineNextAck();
-    String data = determineNextData();
+    // Determine the next packet components and move the protocol past this frame.
+    taskENTER_CRITICAL(&protocolLock);
+    Header head = protocol.nextHeader();
+    AckMessage ack = protocol.nextAck();
+    protocol.dispatch(ProtocolEvent::ev_FRAME_BUILT);
+    taskEXIT_CRITICAL(&protocolLock);
 
-    // Construct the next packet.
-    outgoingData.header = head;
-    outgoingData.ack = ack;
-    sprintf(outgoingData.data, "%s", data.c_str());
+    // Construct the next packet in place.
+    clearPacket(&outgoingData, head, ack);
+    outgoingData.seq = ++txSeq;
+    outgoingData.ackSeq = lastRxSeq;
+    if(pullPending) {
+        outgoingData.flags |= PACKET_FLAG_PULL;
+        pullPending = false;
+    }
+    determineNextData(&outgoingData);
+    encodePacket(&outgoingData, platformMicros());
 }
 
 bool EspNowNode::registerProcessHandshakeCallBack(ProcessDataCallback pcb) {
@@ -186,36 +298,54 @@ bool EspNowNode::registerDataSentCallBack(ProcessDataCallback pcb) {
     return true;
 }
 
+bool EspNowNode::registerProcessTelemetryCallBack(ProcessDataCallback pcb) {
+    telemetryCallback = pcb;
+    return true;
+}
+
+bool EspNowNode::registerProcessCommandCallBack(ProcessCommandCallback pcb) {
+    commandCallback = pcb;
+    return true;
+}
+
+bool EspNowNode::hasCallbacks() {
+    return handshakeCallback != NULL && waveCallback != NULL && infoReceivedCallback != NULL && dataSentCallBack != NULL;
+}
+
 bool EspNowNode::start() {
 
     // Ensure proper callbacks are registered.
-    bool success = false;
-    success = (handshakeCallback != NULL && waveCallback != NULL && infoReceivedCallback != NULL && dataSentCallBack != NULL);
+    bool success = hasCallbacks();
     
     // Only start if callbacks are all good.
     if(success) {
-        initWifi();
-        initESPNOW();
+        initTransport();
         initTasks();
     }
-    else log_e("ESP Now Not started. Ensure all callbacks are registred");
+    else platformLog("ESP Now Not started. Ensure all callbacks are registred");
     
     // Return.
     return success;
 }
 
+bool EspNowNode::startPolled() {
+    bool success = hasCallbacks();
+    if(success) initTransport();
+    else platformLog("ESP Now Not started. Ensure all callbacks are registred");
+    return success;
+}
+
 bool EspNowNode::end() {
     bool res = true;
 
     // Delete tasks to free up the scheduler.
-    vTaskDelete(esp_now_tx_rx_handle);
-    vTaskDelete(esp_now_process_data_handle);
-    esp_now_tx_rx_handle = NULL;
-    esp_now_process_data_handle = NULL;
+    vTaskDelete(txRxHandle);
+    vTaskDelete(processDataHandle);
+    txRxHandle = NULL;
+    processDataHandle = NULL;
 
-    // Deinitialize ESP NOW.
-    this->remove();
-    esp_now_deinit();
+    // Take the link down.
+    transport->end();
 
     // Return.
     return res;
@@ -223,206 +353,1110 @@ bool EspNowNode::end() {
 
 void EspNowNode::pause() { isPaused = true; }
 
-void EspNowNode::unpause() { isPaused = false; }
+void EspNowNode::unpause() { 
+    isPaused = false;
+
+    // Wake the held tasks.
+    if(txRxHandle != NULL) xTaskNotifyGive(txRxHandle);
+    if(processDataHandle != NULL) xTaskNotifyGive(processDataHandle);
+}
+
+void EspNowNode::waitWhilePaused() {
+    while(isPaused) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
 
 bool EspNowNode::isTransmissionPaused() { return isPaused; }
 
-void EspNowNode::onReceive(const uint8_t *data, size_t len, bool broadcast) {
+void EspNowNode::onReceive(const uint8_t *data, size_t len, int8_t rssi) {
 
-    // Save data received.
-    ESP_NOW_PACKET *dataReceived = (ESP_NOW_PACKET *) data;
-    incomingData.header = dataReceived->header;
-    incomingData.ack = dataReceived->ack;
-    sprintf(incomingData.data, "%s", dataReceived->data);
+    // Validate the frame in place and drop anything malformed.
+    const ESP_NOW_PACKET *dataReceived = decodePacket(data, len);
+    if(dataReceived == NULL) {
+        rxRejected++;
+        return;
+    }
+
+    // Queue the frame for the process data task. Frames carrying safety commands jump the queue.
+    // A full queue counts the drop itself.
+    bool priority = CommandInbox::hasSafety(dataReceived);
+    RX_FRAME *slot = priority ? priorityQueue.reserve() : rxQueue.reserve();
+    if(slot == NULL) return;
+    slot->arrivalTime = platformMicros();
+    slot->length = len;
+    slot->rssi = rssi;
+    memcpy(&slot->packet, dataReceived, len);
+    if(priority) priorityQueue.commit();
+    else rxQueue.commit();
 
     // Notify the process Data task.
-    xTaskNotify(esp_now_process_data_handle, -1, eNoAction);
+    if(processDataHandle != NULL) xTaskNotifyGive(processDataHandle);
 }
 
 void EspNowNode::onSent(bool success) {
-    if(ackRequired) this->waitingForData = true;
-    dataSentCallBack("");
+    // Tally the radio's verdict per header and report the frame while it is still the one sent.
+    // Readying the Tx/Rx task first would let it build the next frame over this one.
+    const ESP_NOW_PACKET *sent = lastSent;
+    linkStats.recordSend(sent->header, success);
+    dataSentCallBack(sent);
+
+    // A frame sent out of turn leaves the exchange where it was.
+    if(sent == &controlData) return;
+
+    // Without acks the next frame can go as soon as the radio is done with this one.
+    // A streaming receiver only speaks again when it has something to say, or to keep the link alive.
+    if(isStreaming()) setReadyToTransmit(isNodeTransmitter());
+    else if(ackRequired) this->waitingForData = true;
+    else setReadyToTransmit(true);
 }
 
 bool EspNowNode::is_esp_now_setup() { return esp_now_setup; }
 
 bool EspNowNode::isNodeTransmitter() { return mode == Mode::Transmitter;}
 
+bool EspNowNode::isOutOfBand(Header header) {
+    return header == Header::COMMAND || header == Header::ACK || header == Header::EMISSION;
+}
+
 bool EspNowNode::transmit() { 
     // Construct the transmission and send it.
     buildTransmission();
+    if(isStreaming()) {
+        int64_t now = platformMicros();
+        taskENTER_CRITICAL(&streamLock);
+        txWindow.expire(now, STREAM_ACK_TIMEOUT_US);
+        txWindow.track(outgoingData.seq, now);
+        taskEXIT_CRITICAL(&streamLock);
+    }
+    if(governPings && isNodeTransmitter() && outgoingData.header == Header::TRIGGER_PING) {
+        taskENTER_CRITICAL(&governorLock);
+        pingGovernor.recordPing(platformMicros());
+        taskEXIT_CRITICAL(&governorLock);
+    }
+    retries = 0;
+    firstSendTime = platformMicros();
     //showDataTransmitted();
-    return send_message(); 
+    return send_message(&outgoingData);
+}
+
+bool EspNowNode::transmitAck() {
+    // An ack-only frame doesn't move the protocol along, or disturb the frame in flight.
+    clearPacket(&controlData, Header::ACK, determineNextAck());
+    controlData.seq = ++txSeq;
+    controlData.ackSeq = lastRxSeq;
+    appendAck(&controlData);
+    taskENTER_CRITICAL(&commandLock);
+    inbox.writeAck(&controlData, platformMicros());
+    taskEXIT_CRITICAL(&commandLock);
+    encodePacket(&controlData, platformMicros());
+    streamStats.explicitAcks++;
+    return send_message(&controlData);
+}
+
+bool EspNowNode::explicitAckDue() {
+    // A streaming node acks commands at once too, since it doesn't answer every frame.
+    if(ackDue) return true;
+    if(!isStreaming()) return false;
+    taskENTER_CRITICAL(&commandLock);
+    bool res = inbox.isAckOwed();
+    taskEXIT_CRITICAL(&commandLock);
+    return res;
+}
+
+bool EspNowNode::transmitCommand() {
+    // A command frame doesn't move the protocol along, and goes out whatever the pacing or slot.
+    // It is built apart so the frame in flight can still be resent. Commands are resent on their own schedule.
+    uint8_t maxPayload = getNegotiatedSettings().maxPayload;
+    int64_t now = platformMicros();
+    clearPacket(&controlData, Header::COMMAND, determineNextAck());
+    controlData.seq = ++txSeq;
+    controlData.ackSeq = lastRxSeq;
+    if(isStreaming()) appendAck(&controlData);
+    taskENTER_CRITICAL(&commandLock);
+    inbox.writeAck(&controlData, now);
+    commands.writeRecord(&controlData, now, maxPayload);
+    commandStats.framesSent++;
+    taskEXIT_CRITICAL(&commandLock);
+    encodePacket(&controlData, now);
+    if(isStreaming()) {
+        taskENTER_CRITICAL(&streamLock);
+        txWindow.expire(now, STREAM_ACK_TIMEOUT_US);
+        txWindow.track(controlData.seq, now);
+        taskEXIT_CRITICAL(&streamLock);
+    }
+    return send_message(&controlData);
+}
+
+bool EspNowNode::commandDue() {
+    if(!(getNegotiatedSettings().features & CAP_COMMANDS)) return false;
+    taskENTER_CRITICAL(&commandLock);
+    int64_t dueAt = commands.nextDueAt();
+    taskEXIT_CRITICAL(&commandLock);
+    return dueAt <= platformMicros();
+}
+
+bool EspNowNode::transmitEmission() {
+    // An emission frame doesn't move the protocol along, and isn't resent: a late emission is of no use.
+    clearPacket(&controlData, Header::EMISSION, determineNextAck());
+    controlData.seq = ++txSeq;
+    controlData.ackSeq = lastRxSeq;
+    appendAck(&controlData);
+    taskENTER_CRITICAL(&rangingLock);
+    if(appendRecord(&controlData, RecordType::rec_EMISSION, &pendingEmission, emissionRecordSize())) emissionPending = false;
+    taskEXIT_CRITICAL(&rangingLock);
+    encodePacket(&controlData, platformMicros());
+    return send_message(&controlData);
+}
+
+uint8_t EspNowNode::emissionRecordSize() {
+    return (getNegotiatedSettings().features & CAP_EMISSION_BOUNDS) ? sizeof(EMISSION_RECORD) : EMISSION_RECORD_SHORT_SIZE;
+}
+
+bool EspNowNode::emissionDue() {
+    // Without streaming the emission rides on the next ping, so as not to upset the ping/reply exchange.
+    if(!isNodeTransmitter() || !isStreaming() || !(getNegotiatedSettings().features & CAP_EMISSION_TIMES)) return false;
+    taskENTER_CRITICAL(&rangingLock);
+    bool res = emissionPending;
+    taskEXIT_CRITICAL(&rangingLock);
+    return res;
+}
+
+uint16_t EspNowNode::sendCommand(CommandType type, float value) {
+    bool superseded = false;
+    taskENTER_CRITICAL(&commandLock);
+    uint16_t id = commands.push(type, value, platformMicros(), &superseded);
+    if(id != 0) commandStats.issued++;
+    if(superseded) commandStats.superseded++;
+    taskEXIT_CRITICAL(&commandLock);
+
+    // Wake the Tx/Rx task so a safety command goes out now.
+    if(id != 0 && txRxHandle != NULL) xTaskNotifyGive(txRxHandle);
+    return id;
+}
+
+void EspNowNode::updateCommands(const ESP_NOW_PACKET *packet) {
+    COMMAND_ENTRY received[COMMAND_SLOTS];
+    uint8_t stale = 0;
+    ACK_RECORD ack;
+    bool hasAck = readRecord(packet, RecordType::rec_COMMAND_ACK, &ack, sizeof(ack));
+
+    taskENTER_CRITICAL(&commandLock);
+    if(hasAck) commandStats.acked += commands.onAck(ack, lastArrivalTime, &commandStats.ackLatency);
+
+    // A handshake restarts the peer's command numbering.
+    if(packet->header == Header::HANDSHAKE) inbox.reset();
+    uint8_t count = inbox.read(packet, lastArrivalTime, received, COMMAND_SLOTS, &stale);
+    commandStats.received += count + stale;
+    commandStats.stale += stale;
+    bool ackOwed = inbox.isAckOwed();
+    taskEXIT_CRITICAL(&commandLock);
+
+    for(uint8_t i = 0; i < count; i++) executeCommand(received[i], false);
+
+    // Get the ack out now rather than on the next frame.
+    if(ackOwed && isStreaming() && txRxHandle != NULL) xTaskNotifyGive(txRxHandle);
+}
+
+void EspNowNode::executeCommand(const COMMAND_ENTRY &command, bool failsafe) {
+    if(commandCallback != NULL) commandCallback(&command);
+
+    // Stop latency runs from the peer issuing the stop to the motors stopping, so needs the clocks in sync.
+    bool timed = !failsafe && command.type == cmd_STOP && clockSync.isSynchronized();
+    int64_t latency = timed ? platformMicros() - clockSync.fromPeerTime((int64_t) command.issuedAt) : 0;
+    if(latency < 0) latency = 0;
+
+    taskENTER_CRITICAL(&commandLock);
+    if(failsafe) commandStats.failsafeStops++;
+    else commandStats.executed++;
+    if(!failsafe && command.type == cmd_STOP && !timed) commandStats.stopsUntimed++;
+    if(timed) {
+        commandStats.lastStopLatency = (uint32_t) latency;
+        commandStats.stopLatency.record((uint32_t) latency);
+        if(latency > COMMAND_STOP_DEADLINE_US) commandStats.deadlineMisses++;
+    }
+    taskEXIT_CRITICAL(&commandLock);
+
+    if(timed && latency > COMMAND_STOP_DEADLINE_US) platformLog("Stop %u took %ld us.", command.id, (long) latency);
+}
+
+COMMAND_STATS EspNowNode::getCommandStats() {
+    taskENTER_CRITICAL(&commandLock);
+    COMMAND_STATS res = commandStats;
+    taskEXIT_CRITICAL(&commandLock);
+    return res;
+}
+
+bool EspNowNode::retransmitDue() {
+    if(resendRequested) return true;
+    if(!isNodeTransmitter() || !ackRequired || !waitingForData || isStreaming()) return false;
+    return (platformMicros() - lastSendAttempt) >= retransmitTimeout();
+}
+
+int64_t EspNowNode::retransmitTimeout() {
+    // While the link is lost, probe at a steady pace so the session resumes soon after the peer is back.
+    int64_t res = rtt.timeout();
+    if(!isLinkUp() && res > LINK_PROBE_INTERVAL_US) res = LINK_PROBE_INTERVAL_US;
+    return res;
+}
+
+bool EspNowNode::retransmit() {
+    // Re-answer a duplicate with the reply already built for it.
+    if(resendRequested) {
+        resendRequested = false;
+        encodePacket(&outgoingData, platformMicros());
+        return send_message(&outgoingData, true);
+    }
+
+    // Give up on the frame after too many tries and start a fresh exchange.
+    if(retries >= ESPNOW_MAX_RETRIES) {
+        lossStats.framesLost++;
+        rtt.resetBackoff();
+        reRegisterPeer();
+        waitingForData = false;
+        return transmit();
+    }
+
+    // Resend the same frame (same sequence number) with a fresh timestamp.
+    retries++;
+    lossStats.retransmits++;
+    rtt.backoff();
+    encodePacket(&outgoingData, platformMicros());
+    return send_message(&outgoingData, true);
+}
+
+int64_t EspNowNode::getTxWaitUs() {
+    int64_t now = platformMicros();
+    int64_t remaining = LINK_HEARTBEAT_US;
+
+    // Only the transmitter runs a retransmit timer, and not while streaming.
+    if(isNodeTransmitter() && ackRequired && !isStreaming()) remaining = retransmitTimeout() - (now - lastSendAttempt);
+
+    // Wake in time to notice the link going quiet.
+    taskENTER_CRITICAL(&linkLock);
+    int64_t untilLoss = (linkMonitor.getState() == link_UP) ? linkMonitor.lossDeadline() - now : remaining;
+    taskEXIT_CRITICAL(&linkLock);
+    if(untilLoss < remaining) remaining = untilLoss;
+
+    // Wake when a command needs a frame of its own.
+    if(getNegotiatedSettings().features & CAP_COMMANDS) {
+        taskENTER_CRITICAL(&commandLock);
+        int64_t dueAt = commands.nextDueAt();
+        taskEXIT_CRITICAL(&commandLock);
+        if(dueAt - now < remaining) remaining = dueAt - now;
+    }
+
+    // Wake when the fault injector lets out a frame it is holding back.
+    if(faults != NULL && faults->nextReleaseAt() - now < remaining) remaining = faults->nextReleaseAt() - now;
+
+    // Wake when the slot opens if something is waiting to go.
+    if(!slotOpen() && (readyToTransmit() || retransmitDue())) {
+        int64_t untilOpen = scheduler->nextOpen(slot, now) - now;
+        if(untilOpen < remaining) remaining = untilOpen;
+    }
+
+    // Wake when the next governed ping is due.
+    if(readyToTransmit() && !pingDue()) {
+        taskENTER_CRITICAL(&governorLock);
+        int64_t untilPing = pingGovernor.nextPingAt() - now;
+        taskEXIT_CRITICAL(&governorLock);
+        if(untilPing < remaining) remaining = untilPing;
+    }
+
+    return (remaining > 0) ? remaining : 0;
+}
+
+void EspNowNode::enablePingRateGovernor(uint32_t minIntervalUs, uint32_t keepAliveIntervalUs) {
+    governorMinInterval = minIntervalUs;
+    governorKeepAlive = keepAliveIntervalUs;
+    governPings = true;
+    applyNegotiatedSettings();
+}
+
+void EspNowNode::updateCapabilities(const ESP_NOW_PACKET *packet) {
+    // A handshake without a record comes from firmware that predates negotiation.
+    CAPABILITY_RECORD caps;
+    bool offered = Capabilities::read(packet, &caps);
+    if(!offered && packet->header != Header::HANDSHAKE) return;
+    if(!offered) caps = Capabilities::baseline(localCaps.channel);
+
+    taskENTER_CRITICAL(&capsLock);
+    peerCaps = caps;
+    negotiated = Capabilities::negotiate(localCaps, peerCaps);
+    peerCapsKnown = offered;
+    taskEXIT_CRITICAL(&capsLock);
+    applyNegotiatedSettings();
+}
+
+void EspNowNode::applyNegotiatedSettings() {
+    NEGOTIATED_SETTINGS settings = getNegotiatedSettings();
+
+    // Never ping faster than the slower node can keep up with.
+    if(governPings) {
+        uint32_t minInterval = governorMinInterval;
+        if(settings.minPingInterval * 1000U > minInterval) minInterval = settings.minPingInterval * 1000U;
+        taskENTER_CRITICAL(&governorLock);
+        pingGovernor.setLimits(minInterval, governorKeepAlive);
+        taskEXIT_CRITICAL(&governorLock);
+    }
+}
+
+void EspNowNode::setCapabilities(uint8_t sensors, uint16_t readTimeMs, uint16_t minPingIntervalMs) {
+    taskENTER_CRITICAL(&capsLock);
+    localCaps.sensors = sensors;
+    localCaps.readTime = readTimeMs;
+    localCaps.minPingInterval = minPingIntervalMs;
+    negotiated = Capabilities::negotiate(localCaps, peerCaps);
+    taskEXIT_CRITICAL(&capsLock);
+    applyNegotiatedSettings();
+}
+
+bool EspNowNode::hasNegotiated() { return peerCapsKnown; }
+
+NEGOTIATED_SETTINGS EspNowNode::getNegotiatedSettings() {
+    taskENTER_CRITICAL(&capsLock);
+    NEGOTIATED_SETTINGS res = negotiated;
+    taskEXIT_CRITICAL(&capsLock);
+    return res;
+}
+
+CAPABILITY_RECORD EspNowNode::getPeerCapabilities() {
+    taskENTER_CRITICAL(&capsLock);
+    CAPABILITY_RECORD res = peerCaps;
+    taskEXIT_CRITICAL(&capsLock);
+    return res;
+}
+
+void EspNowNode::observeTargetRange(int64_t time, float inches) {
+    taskENTER_CRITICAL(&governorLock);
+    pingGovernor.observeRange(time, inches);
+    taskEXIT_CRITICAL(&governorLock);
+}
+
+void EspNowNode::observeTargetBearing(int64_t time, float degrees) {
+    taskENTER_CRITICAL(&governorLock);
+    pingGovernor.observeBearing(time, degrees);
+    taskEXIT_CRITICAL(&governorLock);
+}
+
+void EspNowNode::requestPing() {
+    // Only the receiver pulls. The frame goes out now, whether or not a reply is owed.
+    if(isNodeTransmitter() || !(getNegotiatedSettings().features & CAP_PING_PULL)) return;
+    pullPending = true;
+    setReadyToTransmit(true);
+}
+
+bool EspNowNode::pingDue() {
+    // Only the transmitter's pings are governed; handshakes and replies go out at once.
+    if(!governPings || !isNodeTransmitter() || determineNextHeader() != Header::TRIGGER_PING) return true;
+    taskENTER_CRITICAL(&governorLock);
+    bool res = pingGovernor.shouldPing(platformMicros());
+    taskEXIT_CRITICAL(&governorLock);
+    return res;
+}
+
+PING_RATE_STATS EspNowNode::getPingRateStats() {
+    PING_RATE_STATS res;
+    taskENTER_CRITICAL(&governorLock);
+    pingGovernor.snapshot(&res);
+    taskEXIT_CRITICAL(&governorLock);
+    return res;
+}
+
+void EspNowNode::assignSlot(TdmaScheduler *scheduler, uint8_t slot) {
+    this->scheduler = scheduler;
+    this->slot = slot;
+}
+
+bool EspNowNode::slotOpen() {
+    if(scheduler == NULL || !isNodeTransmitter()) return true;
+    return scheduler->isOpen(slot, platformMicros());
+}
+
+bool EspNowNode::acceptSequence(const ESP_NOW_PACKET *packet) {
+    if(isStreaming()) return acceptStreamed(packet);
+
+    // Frames sent out of turn don't step the exchange, and aren't taken as a reply. Repeated commands are dropped by id.
+    if(isOutOfBand(packet->header)) {
+        linkStats.recordArrival(lastArrivalTime, packet->timestamp);
+        if(lastRssi != LINK_STATS_NO_RSSI) linkStats.recordRssi(lastRssi);
+        return true;
+    }
+
+    // Drop duplicates. A handshake always restarts the peer's numbering.
+    if(hasRxSeq && packet->header != Header::HANDSHAKE && packet->seq == lastRxSeq) {
+        lossStats.duplicates++;
+
+        // The receiver's reply was probably lost, so answer again. If the reply hasn't been built yet it
+        // answers the repeat anyway, and resending the one before would only use up the readiness to send it.
+        if(!isNodeTransmitter() && outgoingData.ackSeq == packet->seq) {
+            resendRequested = true;
+            if(txRxHandle != NULL) xTaskNotifyGive(txRxHandle);
+        }
+        return false;
+    }
+
+    // The transmitter only advances on the reply to the frame it has in flight.
+    if(isNodeTransmitter() && ackRequired) {
+        if(packet->ackSeq != outgoingData.seq) {
+            lossStats.staleAcks++;
+            return false;
+        }
+        // Only a frame in flight gives a round trip; a pull can arrive while none is.
+        if(retries == 0 && waitingForData) {
+            uint32_t roundTrip = (uint32_t) (lastArrivalTime - firstSendTime);
+            rtt.sample(roundTrip);
+            linkStats.recordRtt(roundTrip);
+        }
+        rtt.resetBackoff();
+        retries = 0;
+    }
+
+    hasRxSeq = true;
+    lastRxSeq = packet->seq;
+    linkStats.recordArrival(lastArrivalTime, packet->timestamp);
+    if(lastRssi != LINK_STATS_NO_RSSI) linkStats.recordRssi(lastRssi);
+    return true;
+}
+
+bool EspNowNode::acceptStreamed(const ESP_NOW_PACKET *packet) {
+    uint16_t missed = 0;
+    uint16_t lost = 0;
+    uint32_t roundTrip = 0;
+    ACK_RECORD ack;
+    bool hasAck = readRecord(packet, RecordType::rec_ACK, &ack, sizeof(ack));
+
+    taskENTER_CRITICAL(&streamLock);
+    // A handshake restarts the peer's numbering, and the exchange with it.
+    if(packet->header == Header::HANDSHAKE) {
+        rxWindow.reset();
+        txWindow.clear();
+    }
+    bool fresh = rxWindow.record(packet->seq, lastArrivalTime, &missed);
+    if(fresh && missed > 0) {
+        streamStats.gapsSeen += missed;
+        ackDue = true;
+    }
+    if(fresh && hasAck) lost = txWindow.onAck(ack, lastArrivalTime, &roundTrip);
+    taskEXIT_CRITICAL(&streamLock);
+
+    if(!fresh) {
+        lossStats.duplicates++;
+        return false;
+    }
+
+    // Tell the peer about the gap now rather than on the next frame.
+    if(ackDue && txRxHandle != NULL) xTaskNotifyGive(txRxHandle);
+
+    // Frames are never resent. A lost ping is made up for with a fresh one.
+    if(lost > 0) {
+        lossStats.framesLost += lost;
+        if(governPings && isNodeTransmitter()) {
+            taskENTER_CRITICAL(&governorLock);
+            pingGovernor.requestPull();
+            taskEXIT_CRITICAL(&governorLock);
+        }
+    }
+    if(roundTrip > 0) {
+        rtt.sample(roundTrip);
+        linkStats.recordRtt(roundTrip);
+    }
+
+    hasRxSeq = true;
+    lastRxSeq = packet->seq;
+    linkStats.recordArrival(lastArrivalTime, packet->timestamp);
+    if(lastRssi != LINK_STATS_NO_RSSI) linkStats.recordRssi(lastRssi);
+    return true;
+}
+
+bool EspNowNode::appendAck(ESP_NOW_PACKET *packet) {
+    ACK_RECORD ack;
+    taskENTER_CRITICAL(&streamLock);
+    bool res = rxWindow.fill(&ack, platformMicros());
+    ackDue = false;
+    taskEXIT_CRITICAL(&streamLock);
+    return res && appendRecord(packet, RecordType::rec_ACK, &ack, sizeof(ack));
+}
+
+bool EspNowNode::hasStreamData() {
+    // Reports, config and telemetry still go out when due; plain pings need no reply.
+    if(reportPending || pullPending) return true;
+    if(configStore != NULL) {
+        taskENTER_CRITICAL(&configLock);
+        bool delta = configStore->hasDelta(configPeer);
+        taskEXIT_CRITICAL(&configLock);
+        if(delta) return true;
+    }
+    taskENTER_CRITICAL(&telemetryLock);
+    bool res = telemetry.shouldFlush(platformMicros());
+    taskEXIT_CRITICAL(&telemetryLock);
+    return res;
+}
+
+void EspNowNode::attachConfigStore(ConfigStore *store) { configStore = store; }
+
+bool EspNowNode::setConfig(ConfigKey key, float value) {
+    if(configStore == NULL) return false;
+    taskENTER_CRITICAL(&configLock);
+    bool changed = configStore->set(key, value);
+    taskEXIT_CRITICAL(&configLock);
+    if(!changed) return false;
+    configStore->notify(1UL << key);
+
+    // A streaming receiver isn't answering every ping, so send the change on its own.
+    if(isStreaming() && !isNodeTransmitter()) setReadyToTransmit(true);
+    return true;
+}
+
+float EspNowNode::getConfig(ConfigKey key) {
+    if(configStore == NULL) return 0;
+    taskENTER_CRITICAL(&configLock);
+    float res = configStore->get(key);
+    taskEXIT_CRITICAL(&configLock);
+    return res;
+}
+
+void EspNowNode::updateConfig(const ESP_NOW_PACKET *packet) {
+    if(configStore == NULL) return;
+    taskENTER_CRITICAL(&configLock);
+    // A handshake means the peer may have restarted with only its defaults.
+    if(packet->header == Header::HANDSHAKE) configPeer.reset();
+    uint32_t changed = configStore->merge(packet, &configPeer);
+    taskEXIT_CRITICAL(&configLock);
+    configStore->notify(changed);
+}
+
+bool EspNowNode::setPhyRate(PhyRate rate) {
+    airtime.setRate(rate);
+    peerAirtime.setRate(rate);
+    return transport->setRate(rate);
+}
+
+AIRTIME_STATS EspNowNode::getAirtimeStats() {
+    AIRTIME_STATS res;
+    airtime.snapshot(&res);
+    return res;
+}
+
+AIRTIME_STATS EspNowNode::getPeerAirtimeStats() {
+    AIRTIME_STATS res;
+    peerAirtime.snapshot(&res);
+    return res;
+}
+
+bool EspNowNode::injectFaults(const FAULT_PROFILE &outgoing, const FAULT_PROFILE &incoming, uint32_t seed) {
+    if(esp_now_setup) return false;
+    if(faults == NULL) {
+        faults = new FaultyTransport(transport, &platformMicros, seed);
+        faults->setListener(this);
+        transport = faults;
+    }
+    faults->setProfiles(outgoing, incoming);
+    return true;
+}
+
+void EspNowNode::serviceFaults() { if(faults != NULL) faults->service(); }
+
+FAULT_STATS EspNowNode::getOutgoingFaultStats() {
+    FAULT_STATS res = {};
+    if(faults != NULL) res = faults->getOutgoingStats();
+    return res;
+}
+
+FAULT_STATS EspNowNode::getIncomingFaultStats() {
+    FAULT_STATS res = {};
+    if(faults != NULL) res = faults->getIncomingStats();
+    return res;
+}
+
+void EspNowNode::setStreaming(bool enabled) { streaming = enabled; }
+
+bool EspNowNode::isStreaming() { return streaming && (getNegotiatedSettings().features & CAP_STREAMING); }
+
+STREAM_STATS EspNowNode::getStreamStats() {
+    STREAM_STATS res;
+    taskENTER_CRITICAL(&streamLock);
+    txWindow.snapshot(&res);
+    res.gapsSeen = streamStats.gapsSeen;
+    taskEXIT_CRITICAL(&streamLock);
+    res.piggybackedAcks = streamStats.piggybackedAcks;
+    res.explicitAcks = streamStats.explicitAcks;
+    return res;
 }
 
 bool EspNowNode::readyToTransmit() { return !waitingForData; }
 
 Header EspNowNode::getHeaderToProcess() { return incomingData.header; }
 
-const char* EspNowNode::getDataToProcess() { return incomingData.data; }
+const ESP_NOW_PACKET* EspNowNode::getPacketToProcess() { return &incomingData; }
 
 void EspNowNode::setReadyToTransmit(bool status) {
     waitingForData = !status;
+
+    // Wake the Tx/Rx task so the next frame goes out immediately.
+    if(status && txRxHandle != NULL) xTaskNotifyGive(txRxHandle);
 }
 
 void EspNowNode::showDataReceived() {
-    Serial.println("------------------------------------------------");
-    Serial.printf("Synced Time: %lld\n", esp_wifi_get_tsf_time(WIFI_IF_AP));
-    Serial.printf("System Time: %lu\n", micros());
-    Serial.printf("WiFi Channel: %d\n",  WiFi.channel());
-    Serial.printf("Header Received: %d\n", incomingData.header);
-    Serial.printf("Ack Msg Received: %c\n", incomingData.ack);
-    Serial.printf("Data Received: %s\n", incomingData.data);
-    Serial.println("------------------------------------------------\n");
+    platformLog("------------------------------------------------");
+    platformLog("Synced Time: %lld", (long long) platformWifiTsf());
+    platformLog("System Time: %lld", (long long) platformMicros());
+    platformLog("WiFi Channel: %d",  platformWifiChannel());
+    platformLog("Header Received: %d", incomingData.header);
+    platformLog("Ack Msg Received: %c", incomingData.ack);
+    platformLog("Seq Received: %u (acks %u)", incomingData.seq, incomingData.ackSeq);
+    platformLog("Peer Timestamp: %llu", (unsigned long long) incomingData.timestamp);
+    platformLog("Payload Received: %u bytes", incomingData.payloadLength);
+    platformLog("------------------------------------------------\n");
 }
 
 void EspNowNode::showDataTransmitted() {
-    Serial.println("------------------------------------------------");
-    Serial.printf("Synced Time: %lld\n", esp_wifi_get_tsf_time(WIFI_IF_AP));
-    Serial.printf("System Time: %lu\n", micros());
-    Serial.printf("WiFi Channel: %d\n",  WiFi.channel());
-    Serial.printf("Header Transmitted: %d\n", outgoingData.header);
-    Serial.printf("Ack Msg Transmitted: %c\n", outgoingData.ack);
-    Serial.printf("Data Transmitted: %s\n", outgoingData.data);
-    Serial.println("------------------------------------------------\n");
+    platformLog("------------------------------------------------");
+    platformLog("Synced Time: %lld", (long long) platformWifiTsf());
+    platformLog("System Time: %lld", (long long) platformMicros());
+    platformLog("WiFi Channel: %d",  platformWifiChannel());
+    platformLog("Header Transmitted: %d", outgoingData.header);
+    platformLog("Ack Msg Transmitted: %c", outgoingData.ack);
+    platformLog("Seq Transmitted: %u (acks %u)", outgoingData.seq, outgoingData.ackSeq);
+    platformLog("Timestamp Transmitted: %llu", (unsigned long long) outgoingData.timestamp);
+    platformLog("Payload Transmitted: %u bytes", outgoingData.payloadLength);
+    platformLog("------------------------------------------------\n");
+}
+
+bool EspNowNode::loadNextPacket() {
+    // Move the oldest queued frame into the packet being processed. Frames carrying safety commands go first.
+    bool priority = true;
+    RX_FRAME *frame = priorityQueue.front();
+    if(frame == NULL) {
+        priority = false;
+        frame = rxQueue.front();
+    }
+    if(frame == NULL) return false;
+    memcpy(&incomingData, &frame->packet, frame->length);
+    lastArrivalTime = frame->arrivalTime;
+    lastRssi = frame->rssi;
+    peerAirtime.record(Airtime::classOf(incomingData.header, false), frame->length, lastArrivalTime);
+    if(priority) priorityQueue.pop();
+    else rxQueue.pop();
+
+    // Any frame from the peer shows the link is up. The session resumes where it left off.
+    taskENTER_CRITICAL(&linkLock);
+    bool recovered = linkMonitor.heard(lastArrivalTime);
+    reRegisterBackoff.reset();
+    LINK_RECOVERY_STATS stats;
+    if(recovered) linkMonitor.snapshot(&stats);
+    taskEXIT_CRITICAL(&linkLock);
+    if(recovered) platformLog("Link resumed in %ld ms.", (long) (stats.lastRecovery / 1000));
+    return true;
 }
 
 bool EspNowNode::proccessPacket() {
     // Retreive data to deal with.
     BaseType_t res = pdFAIL;
     Header headerToProcess = getHeaderToProcess();
-    const char* dataToProcess = getDataToProcess();
+    const ESP_NOW_PACKET* dataToProcess = getPacketToProcess();
+    if(!acceptSequence(dataToProcess)) return false;
+    updateCommands(dataToProcess);
+    updateCapabilities(dataToProcess);
+    updateConfig(dataToProcess);
+    updateClockSync(dataToProcess);
+    updateTriggerAlignment(dataToProcess);
+    updateEmissions(dataToProcess);
     
     switch (headerToProcess) {
         // Process Handshake.
         case Header::HANDSHAKE :
             if(handshakeCallback != NULL) handshakeCallback(dataToProcess);
-            else Serial.println("Unable to process handshake. Handshake Processing Callback Not Assigned.");
+            else platformLog("Unable to process handshake. Handshake Processing Callback Not Assigned.");
             break;
             
         // Process Wave.
         case Header::WAVE :
             if(waveCallback != NULL) waveCallback(dataToProcess);
-            else Serial.println("Unable to process wave. Wave Processing Callback Not Assigned.");
+            else platformLog("Unable to process wave. Wave Processing Callback Not Assigned.");
             break;
             
+        // Ack-only frames were dealt with when accepted, commands carried out and emissions taken.
+        case Header::ACK :
+        case Header::COMMAND :
+        case Header::EMISSION :
+            break;
+
         // Process Acknow
         case Header::TRIGGER_PING:
             if(infoReceivedCallback != NULL) infoReceivedCallback(dataToProcess);
-            else Serial.println("Unable to process ping. InfoReceived Processing Callback Not Assigned.");
+            else platformLog("Unable to process ping. InfoReceived Processing Callback Not Assigned.");
             break;
 
         default:
-            Serial.printf("Unable to Process Info (Unknown Header: %d)\n", headerToProcess);
+            platformLog("Unable to Process Info (Unknown Header: %d)", headerToProcess);
             break;
     }
-    // Clear the waiting for data flag and return.
-    waitingForData = false;
+
+    // The receiver asked for a ping, so skip the wait for the next one.
+    if(isNodeTransmitter() && (dataToProcess->flags & PACKET_FLAG_PULL)) {
+        taskENTER_CRITICAL(&governorLock);
+        pingGovernor.requestPull();
+        taskEXIT_CRITICAL(&governorLock);
+    }
+
+    // Advance the protocol on the header accepted.
+    taskENTER_CRITICAL(&protocolLock);
+    protocol.dispatch(ProtocolStateMachine::eventFor(headerToProcess));
+    taskEXIT_CRITICAL(&protocolLock);
+
+    // Telemetry can ride on any frame.
+    if(telemetryCallback != NULL && findRecord(dataToProcess, RecordType::rec_TELEMETRY, NULL) != NULL) telemetryCallback(dataToProcess);
+    // Clear the waiting for data flag, signal the Tx/Rx task and return.
+    // A streaming receiver only answers control frames, or when it has data of its own.
+    if(!isStreaming() || isNodeTransmitter() || headerToProcess == Header::HANDSHAKE || headerToProcess == Header::WAVE || hasStreamData()) {
+        replyPending = true;
+        setReadyToTransmit(true);
+    }
     return (res == pdPASS);
 }
 
-void EspNowNode::reRegisterPeer() {
-    bool removed = this->remove();
-    //log_e("Peer remove status: %s", removed ? "success" : "failed");
+bool EspNowNode::reRegisterPeer() {
+    // Re-registering on every failure turns brief interference into a storm, so back off.
+    int64_t now = platformMicros();
+    taskENTER_CRITICAL(&linkLock);
+    bool due = reRegisterBackoff.due(now);
+    if(due) reRegisterBackoff.attempt(now);
+    linkMonitor.recordReRegistration(!due);
+    taskEXIT_CRITICAL(&linkLock);
+
+    if(due) transport->reset();
+    return due;
+}
+
+void EspNowNode::checkLink() {
+    int64_t now = platformMicros();
+    taskENTER_CRITICAL(&linkLock);
+    bool lost = linkMonitor.poll(now);
+    bool down = linkMonitor.isLost();
+    taskEXIT_CRITICAL(&linkLock);
+
+    if(lost) platformLog("Link lost.");
+
+    // A node that takes commands stops itself once the peer can no longer reach it. This bounds the
+    // time to stop when the peer's stop never arrives.
+    if(lost && commandCallback != NULL) {
+        COMMAND_ENTRY stop = {};
+        stop.type = cmd_STOP;
+        stop.issuedAt = (uint64_t) now;
+        executeCommand(stop, true);
+    }
+    if(down) reRegisterPeer();
+}
 
-    this->setChannel(WiFi.channel());
+bool EspNowNode::isLinkUp() {
+    taskENTER_CRITICAL(&linkLock);
+    bool res = !linkMonitor.isLost();
+    taskEXIT_CRITICAL(&linkLock);
+    return res;
+}
 
-    bool added = this->add();
-    //log_e("Peer add status: %s", added ? "success" : "failed");
+LINK_RECOVERY_STATS EspNowNode::getRecoveryStats() {
+    LINK_RECOVERY_STATS res;
+    taskENTER_CRITICAL(&linkLock);
+    linkMonitor.snapshot(&res);
+    taskEXIT_CRITICAL(&linkLock);
+    return res;
 }
 
-// Only for Master.
 Header EspNowNode::determineNextHeader() {
+    taskENTER_CRITICAL(&protocolLock);
+    Header res = protocol.nextHeader();
+    taskEXIT_CRITICAL(&protocolLock);
+    return res;
+}
 
-    Header headerReceived = incomingData.header;
-    Header nextHeaderToSend = Header::HANDSHAKE;
-    
-    // Choose next header based on last header if node didn't just start.
-    if(!justStarted) {
-        switch(headerReceived) {
-            
-            // Send Ping after initial connection.
-            case Header::HANDSHAKE : 
-                nextHeaderToSend = Header::TRIGGER_PING;
-                break;
-            
-            // Time to disconnect.
-            case Header::WAVE :
-                nextHeaderToSend = Header::HANDSHAKE;
-                isPaused = true;
-                break;
-            
-            // Send ping after each ping.
-            case Header::TRIGGER_PING : 
-                nextHeaderToSend = Header::TRIGGER_PING;
-                break;
-    
-            default:
-                Serial.println("Unable to determine next header to transmit.");
-                break;
+AckMessage EspNowNode::determineNextAck() {
+    taskENTER_CRITICAL(&protocolLock);
+    AckMessage res = protocol.nextAck();
+    taskEXIT_CRITICAL(&protocolLock);
+    return res;
+}
+
+ProtocolState EspNowNode::getProtocolState() {
+    taskENTER_CRITICAL(&protocolLock);
+    ProtocolState res = protocol.getState();
+    taskEXIT_CRITICAL(&protocolLock);
+    return res;
+}
+
+void EspNowNode::onProtocolAction(ProtocolAction action, void *context) {
+    EspNowNode *node = static_cast<EspNowNode *>(context);
+    switch(action) {
+        case ProtocolAction::act_PAUSE :
+            node->isPaused = true;
+            break;
+
+        default:
+            break;
+    }
+}
+
+void EspNowNode::determineNextData(ESP_NOW_PACKET *packet) {
+    NEGOTIATED_SETTINGS settings = getNegotiatedSettings();
+
+    // Echo the timing of the last frame received so the peer can complete a clock exchange.
+    if(hasRxSeq && (settings.features & CAP_CLOCK_SYNC)) {
+        SYNC_RECORD sync;
+        sync.echoTimestamp = incomingData.timestamp;
+        sync.echoArrival = lastArrivalTime;
+        appendRecord(packet, RecordType::rec_SYNC, &sync, sizeof(sync));
+    }
+
+    // While streaming, every frame acks what has arrived from the peer.
+    if(isStreaming() && appendAck(packet)) streamStats.piggybackedAcks++;
+
+    // Commands ride on every frame until acked, ahead of everything else that follows.
+    if(settings.features & CAP_COMMANDS) {
+        int64_t now = platformMicros();
+        taskENTER_CRITICAL(&commandLock);
+        inbox.writeAck(packet, now);
+        commands.writeRecord(packet, now, settings.maxPayload);
+        taskEXIT_CRITICAL(&commandLock);
+    }
+
+    // Offer this node's capabilities with every handshake and every answer to one.
+    if(packet->header == Header::HANDSHAKE || (hasRxSeq && incomingData.header == Header::HANDSHAKE)) {
+        appendRecord(packet, RecordType::rec_CAPABILITIES, &localCaps, sizeof(localCaps));
+    }
+
+    // Announce the next trigger once the previous one's read window has passed.
+    // The spacing leaves the slower node room for a full read.
+    if(isNodeTransmitter() && triggerLead > 0 && packet->header == Header::TRIGGER_PING && (settings.features & CAP_SCHEDULED_TRIGGERS)) {
+        int64_t fireAt = platformMicros() + triggerLead;
+        int64_t period = triggerPeriod;
+        if(2000LL * settings.readTime > period) period = 2000LL * settings.readTime;
+        if(1000LL * settings.minPingInterval > period) period = 1000LL * settings.minPingInterval;
+        if(triggerStats.announced == 0 || fireAt - lastTriggerAt >= period) {
+            TRIGGER_RECORD trigger;
+            trigger.triggerId = ++lastTriggerId;
+            trigger.fireAt = fireAt;
+            if(appendRecord(packet, RecordType::rec_TRIGGER, &trigger, sizeof(trigger))) {
+                lastTriggerAt = fireAt;
+                triggerStats.announced++;
+            }
         }
     }
 
-    // Clear the just started flag for future pass throuhghs.
-    else justStarted = false;
+    // Tell the transmitter when this node actually fired.
+    if(!isNodeTransmitter() && reportPending && (settings.features & CAP_TRIGGER_REPORTS)) {
+        if(appendRecord(packet, RecordType::rec_TRIGGER_REPORT, &pendingReport, sizeof(pendingReport))) {
+            reportPending = false;
+            triggerStats.reportsSent++;
+        }
+    }
+
+    // Tell the receiver when the last burst went out, if it hasn't gone in a frame of its own.
+    if(isNodeTransmitter() && (settings.features & CAP_EMISSION_TIMES)) {
+        taskENTER_CRITICAL(&rangingLock);
+        if(emissionPending && appendRecord(packet, RecordType::rec_EMISSION, &pendingEmission, emissionRecordSize())) emissionPending = false;
+        taskEXIT_CRITICAL(&rangingLock);
+    }
+
+    // Send the config writes the peer is missing. Nothing is sent once both agree.
+    if(configStore != NULL && (settings.features & CAP_CONFIG_SYNC)) {
+        taskENTER_CRITICAL(&configLock);
+        configStore->writeDelta(packet, &configPeer, settings.maxPayload);
+        taskEXIT_CRITICAL(&configLock);
+    }
 
-    // Return;
-    return nextHeaderToSend;
+    // Fill what is left of the frame with telemetry once a flush is due. Goes last so it can take all remaining room.
+    taskENTER_CRITICAL(&telemetryLock);
+    if((settings.features & CAP_TELEMETRY) && telemetry.shouldFlush(platformMicros())) telemetry.writeBatch(packet, settings.maxPayload);
+    taskEXIT_CRITICAL(&telemetryLock);
 }
 
-// Only for Slave.
-AckMessage EspNowNode::determineNextAck() {
-    Header prevHeaderReceived = incomingData.header;
-    AckMessage nextAckToSend = AckMessage::Received_Handshake;
-    
-    // Choose next ack based on last header if node didn't just start.
-    if(!justStarted) {
-        if(isNodeTransmitter()) nextAckToSend = AckMessage::Received_Handshake;
-        switch(prevHeaderReceived) {
-            
-            // Acknowledge receipt of handshake.
-            case Header::HANDSHAKE : 
-                nextAckToSend = AckMessage::Received_Handshake;
-                break;
-            
-            // Acknowledge receipt of wave.
-            case Header::WAVE :
-                nextAckToSend = AckMessage::Received_Wave;
-                isPaused = true;
-                break;
-            
-            // Acknowledge receipt of ping.
-            case Header::TRIGGER_PING : 
-                nextAckToSend = AckMessage::Received_Ping;
-                break;
-                
-            default:
-                Serial.println("Unable to determine next ack to transmit.");
-                break;
-        }
+void EspNowNode::queueTelemetry(const TELEMETRY_SAMPLE &sample) {
+    // Stamp under the lock, so samples from different tasks are queued in time order.
+    taskENTER_CRITICAL(&telemetryLock);
+    telemetry.push(platformMicros(), sample);
+    taskEXIT_CRITICAL(&telemetryLock);
+}
+
+void EspNowNode::setTelemetryFlushPolicy(uint8_t samples, uint32_t deadlineUs) {
+    taskENTER_CRITICAL(&telemetryLock);
+    telemetry.setFlushPolicy(samples, deadlineUs);
+    taskEXIT_CRITICAL(&telemetryLock);
+}
+
+TELEMETRY_STATS EspNowNode::getTelemetryStats() {
+    TELEMETRY_STATS res;
+    taskENTER_CRITICAL(&telemetryLock);
+    res.queued = telemetry.size();
+    res.dropped = telemetry.getDroppedCount();
+    res.batches = telemetry.getBatchCount();
+    res.samplesSent = telemetry.getPackedCount();
+    taskEXIT_CRITICAL(&telemetryLock);
+    return res;
+}
+
+void EspNowNode::updateTriggerAlignment(const ESP_NOW_PACKET *packet) {
+    TRIGGER_REPORT_RECORD report;
+    if(!isNodeTransmitter() || !readRecord(packet, RecordType::rec_TRIGGER_REPORT, &report, sizeof(report))) return;
+    if(report.triggerId == 0 || report.triggerId != pendingReport.triggerId) return;
+
+    // Both fire times are in this node's clock.
+    int32_t error = (int32_t) ((int64_t) report.firedAt - (int64_t) pendingReport.firedAt);
+    triggerStats.reportsMatched++;
+    triggerStats.lastAlignmentError = error;
+    triggerStats.alignmentError.record((uint32_t) (error < 0 ? -error : error));
+    if(measureTriggers) platformLog("Trigger %u alignment error: %ld us", report.triggerId, (long) error);
+}
+
+void EspNowNode::enableScheduledTriggers(uint32_t leadUs, uint32_t periodUs) {
+    triggerLead = leadUs;
+    triggerPeriod = periodUs;
+}
+
+void EspNowNode::setTriggerMeasurement(bool enabled) { measureTriggers = enabled; }
+
+void EspNowNode::reportTriggerFired(uint16_t triggerId, int64_t firedAt) {
+    if(triggerId == 0) return;
+
+    // The transmitter keeps its own firing to match the receiver's report against.
+    pendingReport.triggerId = triggerId;
+    if(isNodeTransmitter()) {
+        pendingReport.firedAt = firedAt;
+        return;
     }
 
-    // Clear the just started flag for future pass throuhghs.
-    else justStarted = false;
+    // The receiver reports in the transmitter's clock, only when measuring.
+    if(!measureTriggers || !clockSync.isSynchronized()) return;
+    pendingReport.firedAt = clockSync.toPeerTime(firedAt);
+    reportPending = true;
 
-    // Return;
-    return nextAckToSend; 
+    // A streaming receiver isn't answering every ping, so send the report on its own.
+    if(isStreaming()) setReadyToTransmit(true);
 }
 
-String EspNowNode::determineNextData() {
-    
-    // Send current system time.
-    String nextDataToSend = String(micros());
+TRIGGER_STATS EspNowNode::getTriggerStats() { return triggerStats; }
+
+void EspNowNode::updateEmissions(const ESP_NOW_PACKET *packet) {
+    // A handshake restarts the transmitter's trigger numbering.
+    if(isNodeTransmitter()) return;
+    if(packet->header == Header::HANDSHAKE) {
+        taskENTER_CRITICAL(&rangingLock);
+        ranger.reset();
+        taskEXIT_CRITICAL(&rangingLock);
+    }
+
+    // A peer without CAP_EMISSION_BOUNDS leaves the capture bound off, so allow a typical one.
+    EMISSION_RECORD emission;
+    if(!readRecord(packet, RecordType::rec_EMISSION, &emission, sizeof(emission))) {
+        if(!readRecord(packet, RecordType::rec_EMISSION, &emission, EMISSION_RECORD_SHORT_SIZE)) return;
+        emission.captureBoundUs = RANGING_PEER_CAPTURE_US;
+    }
+
+    // Emissions can only be placed in this node's clock once the clocks are in sync.
+    if(emission.triggerId == 0 || !clockSync.isSynchronized()) return;
+    int64_t emittedAt = clockSync.fromPeerTime((int64_t) emission.emittedAt);
+    uint32_t bound = clockSync.errorBoundAt(emittedAt) + emission.captureBoundUs;
+
+    taskENTER_CRITICAL(&rangingLock);
+    ranger.addEmission(emission.triggerId, emittedAt, bound);
+    taskEXIT_CRITICAL(&rangingLock);
+}
+
+void EspNowNode::reportEmission(uint16_t triggerId, int64_t emittedAt, uint32_t boundUs) {
+    if(triggerId == 0 || !isNodeTransmitter()) return;
+    taskENTER_CRITICAL(&rangingLock);
+    pendingEmission.triggerId = triggerId;
+    pendingEmission.emittedAt = (uint64_t) emittedAt;
+    pendingEmission.captureBoundUs = (boundUs < UINT16_MAX) ? (uint16_t) boundUs : UINT16_MAX;
+    emissionPending = true;
+    taskEXIT_CRITICAL(&rangingLock);
+
+    // Wake the Tx/Rx task so a streaming node sends it now.
+    if(txRxHandle != NULL) xTaskNotifyGive(txRxHandle);
+}
+
+RangeStatus EspNowNode::rangeOneWay(uint16_t triggerId, int64_t arrivalAt, uint32_t arrivalBoundUs, RANGE_RESULT *result) {
+    taskENTER_CRITICAL(&rangingLock);
+    RangeStatus res = ranger.range(triggerId, arrivalAt, arrivalBoundUs, result);
+    taskEXIT_CRITICAL(&rangingLock);
+    return res;
+}
+
+void EspNowNode::recordRangeUnmatched() {
+    taskENTER_CRITICAL(&rangingLock);
+    ranger.recordUnmatched();
+    taskEXIT_CRITICAL(&rangingLock);
+}
+
+void EspNowNode::setRangingLatency(int32_t us) {
+    taskENTER_CRITICAL(&rangingLock);
+    ranger.setLatency(us);
+    taskEXIT_CRITICAL(&rangingLock);
+}
 
-    // Return;
-    return nextDataToSend;
+RANGE_STATS EspNowNode::getRangingStats() {
+    taskENTER_CRITICAL(&rangingLock);
+    RANGE_STATS res = ranger.getStats();
+    taskEXIT_CRITICAL(&rangingLock);
+    return res;
+}
+
+LINK_STATS EspNowNode::getLinkStats() {
+    LINK_STATS res;
+    linkStats.snapshot(&res);
+
+    // Loss counters live with the retransmit logic.
+    res.retransmits = lossStats.retransmits;
+    res.framesLost = lossStats.framesLost;
+    uint32_t firstSends = (txStats.framesSent > lossStats.retransmits) ? txStats.framesSent - lossStats.retransmits : 0;
+    res.lossRate = (firstSends > 0) ? (float) lossStats.retransmits / firstSends : 0;
+
+    // Streamed frames are never resent, so loss is what the peer's acks showed.
+    if(isStreaming()) {
+        STREAM_STATS stream = getStreamStats();
+        uint32_t settled = stream.framesAcked + stream.framesLost;
+        res.lossRate = (settled > 0) ? (float) stream.framesLost / settled : 0;
+    }
+    return res;
+}
+
+void EspNowNode::updateClockSync(const ESP_NOW_PACKET *packet) {
+    // A handshake means the peer (and its clock) may have restarted.
+    if(packet->header == Header::HANDSHAKE) clockSync.reset();
+
+    // t1/t4 are this node's send and receive, t2/t3 the peer's receive and send.
+    SYNC_RECORD sync;
+    if(!readRecord(packet, RecordType::rec_SYNC, &sync, sizeof(sync))) return;
+    clockSync.addExchange(sync.echoTimestamp, sync.echoArrival, packet->timestamp, lastArrivalTime);
+}
+
+bool EspNowNode::isClockSynchronized() { return clockSync.isSynchronized(); }
+
+int64_t EspNowNode::toPeerTime(int64_t localTime) { return clockSync.toPeerTime(localTime); }
+
+int64_t EspNowNode::fromPeerTime(int64_t peerTime) { return clockSync.fromPeerTime(peerTime); }
+
+const ClockSync &EspNowNode::getClockSync() { return clockSync; }
+
+uint32_t EspNowNode::getRejectedFrameCount() { return rxRejected; }
+
+RingStats EspNowNode::getRxQueueStats() { return rxQueue.stats(); }
+
+RingStats EspNowNode::getPriorityQueueStats() { return priorityQueue.stats(); }
+
+int64_t EspNowNode::getLastArrivalTime() { return lastArrivalTime; }
+
+TX_STATS EspNowNode::getTxStats() { return txStats; }
+
+LOSS_STATS EspNowNode::getLossStats() {
+    LOSS_STATS res = lossStats;
+    res.smoothedRtt = rtt.getSmoothedRtt();
+    res.retransmitTimeout = rtt.timeout();
+    return res;
 }
 
 void EspNowNode::reRegister() { reRegisterPeer(); }
 
-String EspNowNode::getPeerMacAddress() {
-    char macStr[18] = {0};
-    sprintf(macStr, "%02X:%02X:%02X:%02X:%02X:%02X", 
+const char *EspNowNode::getPeerMacAddress() {
+    snprintf(peerMacString, sizeof(peerMacString), "%02X:%02X:%02X:%02X:%02X:%02X", 
                 peerMacAddress[0],
                 peerMacAddress[1], 
                 peerMacAddress[2], 
@@ -430,9 +1464,12 @@ String EspNowNode::getPeerMacAddress() {
                 peerMacAddress[4], 
                 peerMacAddress[5]
             );
-    return String(macStr);
+    return peerMacString;
 }
 
-String EspNowNode::getThisMacAddress() {
-    return String(WiFi.macAddress());
+const char *EspNowNode::getThisMacAddress() {
+    uint8_t mac[6];
+    platformMacAddress(mac);
+    snprintf(thisMacString, sizeof(thisMacString), "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return thisMacString;
 }
\ No newline at end of file
@@ -1,20 +1,37 @@
 #ifndef ESP_NOW_NODE
 #define ESP_NOW_NODE
 
-#include <Arduino.h>
-#include <ESP32_NOW.h>
-#include <WiFi.h>
-#include <esp_mac.h>
-#include <esp_wifi.h>
-
-#define TaskDelayLength pdMS_TO_TICKS(100)
-#define ACK_TIMEOUT_MS 10000     // Transmission timeout length (ms).
-
-typedef BaseType_t (* ProcessDataCallback)(const char *);
+#include "EspNowPacket.h"
+#include "Transport.h"
+#include "SpscRing.h"
+#include "LatencyHistogram.h"
+#include "RttEstimator.h"
+#include "ClockSync.h"
+#include "LinkStats.h"
+#include "TelemetryPacker.h"
+#include "ProtocolStateMachine.h"
+#include "TdmaScheduler.h"
+#include "PingRateGovernor.h"
+#include "LinkMonitor.h"
+#include "Capabilities.h"
+#include "AckWindow.h"
+#include "ConfigStore.h"
+#include "CommandQueue.h"
+#include "FaultyTransport.h"
+#include "OneWayRanger.h"
+#include "../AllocGuard/AllocGuard.h"
+#include "../Platform/Platform.h"
+
+#define TX_RETRY_DELAY_MS 10     // Delay before retrying a failed transmission (ms).
+#define ESPNOW_MAX_RETRIES 5     // Retransmissions of a frame before it is given up as lost.
+
+typedef BaseType_t (* ProcessDataCallback)(const ESP_NOW_PACKET *);
+typedef BaseType_t (* ProcessCommandCallback)(const COMMAND_ENTRY *);
 
 const uint8_t ESPNOW_WIFI_CHANNEL = 6;      // Wi-Fi channel that system transmission occurs in.
-const uint8_t ESPNOW_DATA_SIZE = 8;         // Size of system data payload sent (in bytes)
 const int ESPNOW_TASK_DEPTH = 8192;         // Stack size of ESP-NOW tasks.
+const size_t ESPNOW_RX_QUEUE_DEPTH = 8;     // Number of received frames buffered for processing. Power of two.
+const size_t ESPNOW_PRIORITY_QUEUE_DEPTH = 2;   // Number of received frames carrying safety commands buffered ahead of the rest. Power of two.
 
 // ESP32-S3 Mac addrresses.
 const uint8_t dev_S3_A[] = {0x24, 0xEC, 0x4A, 0x09, 0xC8, 0x00};
@@ -31,66 +48,261 @@ enum _mode : char {
 };
 typedef enum _mode Mode;
 
-enum _header : uint8_t {
-    ACK = 10,            // Header indidcating this is an acknowledgement of the previously received message. Might be uselss.
-    HANDSHAKE = 11,      // Header indicating this is a connection establishing message.
-    WAVE = 13,           // Header indicating this is a connection terminating message.
-    TRIGGER_PING = 14    // Header indicating that a trigger event is about to happen.
-};
-typedef enum _header Header;
-
-enum _ack_messages : char {
-    Received_Handshake = 'H',
-    Received_Wave = 'W',
-    Received_Ping = 'G'
-};
-typedef enum _ack_messages AckMessage;
-
 #define HS_MSG "Received Handshake Request"
 #define WV_MSG "Received Wave Request"
 
-struct _esp_now_packet {
-    Header header;                      // Holds info on the kind of data being exchanged.
-    AckMessage ack;                     // Holds info on the kind of data last received by the sending node.
-    char data[ESPNOW_DATA_SIZE * 8];    // Holds data currently being exchanged.
+struct _rx_frame {
+    int64_t arrivalTime;        // Local time (in microseconds) the frame was handed over by Wi-Fi.
+    size_t length;              // Number of bytes received.
+    int8_t rssi;                // Signal strength of the frame (dBm).
+    ESP_NOW_PACKET packet;      // Frame received.
 };
-typedef struct _esp_now_packet ESP_NOW_PACKET;
+typedef struct _rx_frame RX_FRAME;
 
-extern TaskHandle_t esp_now_tx_rx_handle;           // Transmission and Reception task handle.
-extern TaskHandle_t esp_now_process_data_handle;    // Data processing task handle.
+struct _tx_stats {
+    uint32_t framesSent;                // Frames handed to the radio successfully.
+    uint32_t sendFailures;              // Frames the radio refused.
+    float framesPerSecond;              // Send rate over the last completed one second window.
+    LatencyHistogram replyToSend;       // Time from a reply arriving to the next frame being sent (in microseconds).
+};
+typedef struct _tx_stats TX_STATS;
+
+struct _loss_stats {
+    uint32_t retransmits;               // Frames resent after their ack timed out.
+    uint32_t framesLost;                // Frames given up on after ESPNOW_MAX_RETRIES.
+    uint32_t duplicates;                // Received frames dropped as repeats.
+    uint32_t staleAcks;                 // Replies dropped because they answered an older frame.
+    uint32_t smoothedRtt;               // Smoothed round trip time (in microseconds).
+    uint32_t retransmitTimeout;         // Current retransmit timeout (in microseconds).
+};
+typedef struct _loss_stats LOSS_STATS;
+
+struct _trigger_stats {
+    uint32_t announced;                 // Triggers announced by the transmitter.
+    uint32_t reportsSent;               // Fire reports sent by the receiver.
+    uint32_t reportsMatched;            // Fire reports matched against this node's own firing.
+    int32_t lastAlignmentError;         // Receiver fire time minus transmitter fire time for the last match (in microseconds).
+    LatencyHistogram alignmentError;    // Magnitude of the alignment error (in microseconds).
+};
+typedef struct _trigger_stats TRIGGER_STATS;
+
+struct _telemetry_stats {
+    uint32_t queued;                    // Samples waiting to be sent.
+    uint32_t dropped;                   // Samples overwritten before being sent.
+    uint32_t batches;                   // Batches sent.
+    uint32_t samplesSent;               // Samples sent.
+};
+typedef struct _telemetry_stats TELEMETRY_STATS;
 
 void esp_now_tx_rx_task(void *pvParams);            // Transmit and receive information from peer.
 void esp_now_process_data_task(void *pvParams);     // Process data received.
 
-class EspNowNode : ESP_NOW_Peer {
+class EspNowNode : public TransportListener {
     private:
+        Transport *transport;                       // Link to the peer the protocol runs over.
+        bool ownsTransport = false;                 // Was `transport` created by this node.
+        FaultyTransport *faults = NULL;             // Fault injector wrapped around the transport, if any. Owned.
+        TaskHandle_t txRxHandle = NULL;             // Transmission and Reception task handle.
+        TaskHandle_t processDataHandle = NULL;      // Data processing task handle.
+        TdmaScheduler *scheduler = NULL;            // Schedule shared with the node's other sessions, if any.
+        uint8_t slot = 0;                           // Slot this session starts exchanges in.
         Mode mode = Mode::Unassigned;               // Is this node is a transmitter or receiver.
         bool esp_now_setup = false;                 // Is ESP Now setup for this node.        
         bool waitingForData = false;                // Is this node waiting for data.
-        bool justStarted = true;                    // Has this node just begun in network.
         bool isPaused = false;                      // Has this node (transmission or reception) been paused.
         bool hasFoundPeer = false;                  // Has this node found its peer. 
+        ProtocolStateMachine protocol;              // Handshake/ping/wave state of the link.
+        portMUX_TYPE protocolLock = portMUX_INITIALIZER_UNLOCKED;   // Guards `protocol` between the Tx/Rx and processing tasks.
         bool ackRequired = false;
+        uint16_t txSeq = 0;                         // Sequence number of the last frame built by this node.
+        bool txGood = true;                         // Did the last send attempt succeed.
+        int64_t lastTimeSent = 0;                   // When a frame last went out (in microseconds), for the receiver's heartbeat.
+        uint32_t rxRejected = 0;                    // Count of received frames that failed to decode.
+        int64_t lastArrivalTime = 0;                // Arrival time of the packet currently being processed.
+        int8_t lastRssi = LINK_STATS_NO_RSSI;       // Signal strength of the packet currently being processed.
+        SpscRing<RX_FRAME, ESPNOW_RX_QUEUE_DEPTH> rxQueue;  // Frames handed from the Wi-Fi callback to the processing task.
+        SpscRing<RX_FRAME, ESPNOW_PRIORITY_QUEUE_DEPTH> priorityQueue;  // Frames carrying safety commands, processed ahead of `rxQueue`.
+
+        TX_STATS txStats = {};                      // Transmission counters.
+        bool replyPending = false;                  // Was this node readied by a reply it has not answered yet.
+        int64_t rateWindowStart = 0;                // Start of the current send rate window (in microseconds).
+        uint32_t framesThisWindow = 0;              // Frames sent in the current send rate window.
+
+        RttEstimator rtt;                           // Round trip estimate driving the retransmit timer.
+        LOSS_STATS lossStats = {};                  // Loss recovery counters.
+        uint8_t retries = 0;                        // Times the frame in flight has been resent.
+        int64_t firstSendTime = 0;                  // When the frame in flight was first sent (in microseconds).
+        int64_t lastSendAttempt = 0;                // When any frame was last handed to the radio (in microseconds).
+        uint16_t lastRxSeq = 0;                     // Sequence number of the last frame accepted from the peer.
+        bool hasRxSeq = false;                      // Has a frame been accepted from the peer yet.
+        bool resendRequested = false;               // Should the last reply be sent again.
+
+        ClockSync clockSync;                        // Offset and drift between this node's clock and its peer's.
+
+        uint32_t triggerLead = 0;                   // How far ahead triggers are announced (in microseconds). Zero disables them.
+        uint32_t triggerPeriod = 0;                 // Minimum spacing between announced triggers (in microseconds).
+        int64_t lastTriggerAt = 0;                  // Last trigger announced, in the transmitter's clock.
+        uint16_t lastTriggerId = 0;                 // Id of the last trigger announced.
+        bool measureTriggers = false;               // Report and measure trigger alignment.
+        bool reportPending = false;                 // Is a fire report waiting to be sent.
+        TRIGGER_REPORT_RECORD pendingReport = {};   // Fire report to be sent (receiver) or own firing to match (transmitter).
+        TRIGGER_STATS triggerStats = {};            // Trigger scheduling counters.
+
+        OneWayRanger ranger;                        // Ranges arrivals against the peer's emissions (receiver).
+        EMISSION_RECORD pendingEmission = {};       // Emission to be sent (transmitter).
+        bool emissionPending = false;               // Is an emission waiting to be sent.
+        portMUX_TYPE rangingLock = portMUX_INITIALIZER_UNLOCKED;   // Guards the ranger and the pending emission between tasks.
+
+        LinkStats linkStats;                        // Link health counters.
+
+        LinkMonitor linkMonitor;                    // Detects the peer going silent and times the recovery.
+        ExponentialBackoff reRegisterBackoff;       // Spaces out re-registrations of the peer while sends fail.
+        portMUX_TYPE linkLock = portMUX_INITIALIZER_UNLOCKED;      // Guards `linkMonitor` and `reRegisterBackoff` between tasks.
+
+        PingRateGovernor pingGovernor;              // Paces the transmitter's pings by target motion.
+        bool governPings = false;                   // Is the ping rate governed.
+        bool pullPending = false;                   // Should the next frame ask the transmitter for a ping.
+        portMUX_TYPE governorLock = portMUX_INITIALIZER_UNLOCKED;  // Guards `pingGovernor` between the Tx/Rx and processing tasks.
+        uint32_t governorMinInterval = 0;           // Fastest ping spacing asked for locally (in microseconds).
+        uint32_t governorKeepAlive = 0;             // Keep-alive ping spacing (in microseconds).
+
+        CAPABILITY_RECORD localCaps;                // What this node supports.
+        CAPABILITY_RECORD peerCaps;                 // What the peer supports, or the baseline until it says.
+        NEGOTIATED_SETTINGS negotiated;             // Best settings both support.
+        bool peerCapsKnown = false;                 // Has the peer sent its capabilities.
+        portMUX_TYPE capsLock = portMUX_INITIALIZER_UNLOCKED;      // Guards the capabilities between the Tx/Rx and processing tasks.
+
+        bool streaming = false;                     // Stream frames without per-frame replies, once the peer agrees.
+        ReceiveWindow rxWindow;                     // Frames received from the peer, acked on every frame sent.
+        SendWindow txWindow;                        // Frames sent that are waiting for the peer's ack.
+        bool ackDue = false;                        // Should an ack-only frame report frames found missing.
+        STREAM_STATS streamStats = {};              // Streaming counters.
+        portMUX_TYPE streamLock = portMUX_INITIALIZER_UNLOCKED;    // Guards the ack windows between the Tx/Rx and processing tasks.
+
+        ConfigStore *configStore = NULL;            // Tuning values replicated with the peer, if any.
+        ConfigPeer configPeer;                      // What the peer holds of the store.
+        portMUX_TYPE configLock = portMUX_INITIALIZER_UNLOCKED;    // Guards the store and `configPeer` between tasks.
+
+        CommandQueue commands;                      // Commands sent to the peer, waiting for its ack.
+        CommandInbox inbox;                         // Commands received from the peer.
+        COMMAND_STATS commandStats = {};            // Command counters.
+        portMUX_TYPE commandLock = portMUX_INITIALIZER_UNLOCKED;   // Guards the command queues between tasks.
+
+        AirtimeMeter airtime;                       // Channel time of the frames this node sends.
+        AirtimeMeter peerAirtime;                   // Channel time of the frames received, estimated at this node's rate.
+
+        TelemetryPacker telemetry;                  // Samples waiting to ride on the next reply.
+        portMUX_TYPE telemetryLock = portMUX_INITIALIZER_UNLOCKED;  // Guards `telemetry` between the producing tasks and the Tx/Rx task.
         
-        uint8_t peerMacAddress[6];                  // Address of this nodes peer.
-        inline static ESP_NOW_PACKET outgoingData;  // Storage for the data to be transmitted from this node.
-        inline static ESP_NOW_PACKET incomingData;  // storage for the data received by this node.
+        uint8_t peerMacAddress[6] = {0};            // Address of this nodes peer.
+        char thisMacString[18] = {0};               // This node's address, formatted for printing.
+        char peerMacString[18] = {0};               // The peer's address, formatted for printing.
+        ESP_NOW_PACKET outgoingData;                // Storage for the data to be transmitted from this node.
+        ESP_NOW_PACKET controlData;                 // Storage for frames sent out of turn (commands, explicit acks, emissions), so the frame in flight is kept.
+        const ESP_NOW_PACKET *lastSent = &outgoingData;     // Frame last handed to the transport, for its send report.
+        ESP_NOW_PACKET incomingData;                // storage for the data received by this node.
+
+        /**
+         * Set up the packets and the node's role. Shared by the constructors.
+         */
+        void initNode(Mode nodeMode, bool ackRequired);
+
+        /**
+         * Carries out the protocol state machine's entry and exit actions.
+         */
+        static void onProtocolAction(ProtocolAction action, void *context);
+
+        /**
+         * Brings up the transport, retrying with exponential backoff until it comes up. Each
+         * retry is counted in the link's stats.
+         */
+        void initTransport();
+
+        /**
+         * Are the callbacks `start` needs registered.
+         */
+        bool hasCallbacks();
+
+        /**
+         * Transmits one of this node's frames over ESP NOW.
+         * @param packet `outgoingData`, or `controlData` for a frame sent out of turn.
+         * @param resend Is the frame going out again.
+         */
+        bool send_message(const ESP_NOW_PACKET *packet, bool resend = false);
 
         /**
-         * Intializes Wi-Fi on the ESP, specifically begins
-         * Wi-Fi in station mode a required by ESP-NOW.
+         * Is a frame with this header sent out of turn, outside the ping/reply exchange.
          */
-        void initWifi();
+        static bool isOutOfBand(Header header);
 
         /**
-         * Initializes ESP Now for use on the ESP.
+         * Update the transmission counters after a send attempt.
          */
-        void initESPNOW();
+        void recordTransmission(bool success);
 
         /**
-         * Transmits this nodes message over ESP NOW.
+         * Check a received frame's sequence numbers, dropping duplicates and stale replies.
+         * @return True if the frame should be processed.
          */
-        bool send_message();
+        bool acceptSequence(const ESP_NOW_PACKET *packet);
+
+        /**
+         * Check a received frame against the ack window while streaming, and apply the ack it carries.
+         * @return True if the frame should be processed.
+         */
+        bool acceptStreamed(const ESP_NOW_PACKET *packet);
+
+        /**
+         * Append an ack of everything received from the peer.
+         * @return True if the ack fit.
+         */
+        bool appendAck(ESP_NOW_PACKET *packet);
+
+        /**
+         * Does this node have something to send to the peer while streaming.
+         */
+        bool hasStreamData();
+
+        /**
+         * Complete a clock exchange from the sync record the peer echoed back.
+         */
+        void updateClockSync(const ESP_NOW_PACKET *packet);
+
+        /**
+         * Renegotiate from the capability record the peer sent, if any.
+         */
+        void updateCapabilities(const ESP_NOW_PACKET *packet);
+
+        /**
+         * Apply negotiated settings that live outside the frame builder.
+         */
+        void applyNegotiatedSettings();
+
+        /**
+         * Merge the config writes the peer sent, if any.
+         */
+        void updateConfig(const ESP_NOW_PACKET *packet);
+
+        /**
+         * Apply the peer's acks of this node's commands, and carry out the commands it sent, safety first.
+         */
+        void updateCommands(const ESP_NOW_PACKET *packet);
+
+        /**
+         * Hand a command to the device, and time it if it is a stop.
+         * @param failsafe Was the stop raised locally because the link was lost.
+         */
+        void executeCommand(const COMMAND_ENTRY &command, bool failsafe);
+
+        /**
+         * Match a receiver's fire report against this node's own firing.
+         */
+        void updateTriggerAlignment(const ESP_NOW_PACKET *packet);
+
+        /**
+         * Take the emission time the transmitter sent, if any, mapped into this node's clock.
+         */
+        void updateEmissions(const ESP_NOW_PACKET *packet);
 
         /**
          * Creates this nodes message to be transmitted over 
@@ -99,9 +311,15 @@ class EspNowNode : ESP_NOW_Peer {
         void buildTransmission();
 
         /**
-         * Re regsiters the peer of this node.
+         * Re regsiters the peer of this node, unless the backoff says it was done too recently.
+         * @return True if the peer was re-registered.
+         */
+        bool reRegisterPeer();
+
+        /**
+         * Time after the last send at which the frame in flight is resent (us).
          */
-        void reRegisterPeer();
+        int64_t retransmitTimeout();
 
         /**
          * Grab the header of the packet to be processed.
@@ -109,9 +327,9 @@ class EspNowNode : ESP_NOW_Peer {
         Header getHeaderToProcess();
 
         /**
-         * Grab the payload of the packet to be processed.
+         * Grab the packet to be processed.
          */
-        const char* getDataToProcess();
+        const ESP_NOW_PACKET* getPacketToProcess();
 
         /**
          * Initialize all system tasks.
@@ -132,73 +350,220 @@ class EspNowNode : ESP_NOW_Peer {
         ProcessDataCallback waveCallback = NULL;
         ProcessDataCallback infoReceivedCallback = NULL;
         ProcessDataCallback dataSentCallBack = NULL;
+        ProcessDataCallback telemetryCallback = NULL;
+        ProcessCommandCallback commandCallback = NULL;
 
     public:
+#ifdef ARDUINO
         EspNowNode( 
-                const uint8_t* peerMacAddress,      // Mac address of the device to be registered as this nodes peer.
+                const uint8_t* peerMacAddress,      // Mac address of the device to be registered as this nodes peer. Runs over ESP-NOW.
                 Mode nodeMode,                      // This nodes Mode in network (tranmitter/receiver).
                 bool ackRequired = false            // Does this node require EXPLICIT acknowledgement. Defaults to `false`.
-            ) :
-            ESP_NOW_Peer(peerMacAddress, ESPNOW_WIFI_CHANNEL, WIFI_IF_STA, NULL)
-        {   
-            // Set the peer mac address.
-            for(int i = 0; i < 6; i++) this->peerMacAddress[i] = peerMacAddress[i];
-
-            // Initialize outgoing data packet. First to be transmitted by the Master. 
-            outgoingData.header = Header::HANDSHAKE;
-            outgoingData.ack = AckMessage::Received_Handshake;
-            String tmp = "Nothing outgoing";
-            sprintf(outgoingData.data, "%s", tmp.c_str());
-            
-            // Initialize incoming data packet.
-            incomingData.header = Header::HANDSHAKE;
-            incomingData.ack = AckMessage::Received_Handshake;
-            tmp = "Nothing incoming";
-            sprintf(incomingData.data, "%s", tmp.c_str());
-
-            // Select mode. Transmitter begins ready to transmit. Receiver begins waiting.
-            waitingForData = (nodeMode == Mode::Transmitter) ? false : true;
-            this->ackRequired = ackRequired;
-            this->mode = nodeMode;
+            );
+#endif
+
+        EspNowNode(
+                Transport *transport,               // Link to run over. Not owned by the node and must outlive it.
+                Mode nodeMode,                      // This nodes Mode in network (tranmitter/receiver).
+                bool ackRequired = false            // Does this node require EXPLICIT acknowledgement. Defaults to `false`.
+            )
+        {
+            this->transport = transport;
+            initNode(nodeMode, ackRequired);
         }
         
         // Destructor to preserve memory integrity when ending ESP-NOW transmission.
-        ~EspNowNode() { remove(); }
+        ~EspNowNode() { 
+            transport->end();
+            if(faults != NULL) {
+                transport = faults->getInner();
+                delete faults;
+            }
+            if(ownsTransport) delete transport;
+        }
         
         // Methods to register appropriate callbacks. To be further fleshed out and changed.        
         bool registerProcessHandshakeCallBack(ProcessDataCallback pcb);
         bool registerProcessWaveCallBack(ProcessDataCallback pcb);
         bool registerProcessInfoReceivedCallBack(ProcessDataCallback pcb);
         bool registerDataSentCallBack(ProcessDataCallback pcb);
+        bool registerProcessTelemetryCallBack(ProcessDataCallback pcb);
+        bool registerProcessCommandCallBack(ProcessCommandCallback pcb);
 
         // Methods to facilitate ESP-NOW transmission between nodes.
         bool start();
+
+        /**
+         * Bring the node up without its tasks, for hosts without a scheduler. The caller runs
+         * `serviceTxRx` and `serviceReceived` in their place, and holds off while paused.
+         */
+        bool startPolled();
+
+        /**
+         * One pass of the Tx/Rx task: check the link and send whatever is due.
+         * @return Time until the pass should run again unless woken sooner (in microseconds).
+         */
+        int64_t serviceTxRx();
+
+        /**
+         * One pass of the process data task: process every frame received since the last pass.
+         * @return Number of frames processed.
+         */
+        uint32_t serviceReceived();
         bool end();
         void pause();
         void unpause();
         bool isTransmissionPaused();
+        void waitWhilePaused();
         bool is_esp_now_setup();
         bool isNodeTransmitter();
         
         // Methods for processing transmission and reception events between nodes.
-        void onReceive(const uint8_t *data, size_t len, bool broadcast) override;
+        void onReceive(const uint8_t *data, size_t len, int8_t rssi) override;
         void onSent(bool success) override;
 
         bool transmit();
+        bool transmitAck();
+        bool transmitCommand();
+        bool commandDue();
+        bool transmitEmission();
+        bool emissionDue();
+
+        /**
+         * Size of the emission record the peer reads: with its capture bound only if negotiated.
+         */
+        uint8_t emissionRecordSize();
+        bool explicitAckDue();
+        bool retransmit();
+        bool retransmitDue();
+        int64_t getTxWaitUs();
+
+        /**
+         * Only start exchanges during a slot of a schedule shared with other sessions.
+         * Only the transmitter is held to the slot; the receiver answers whenever asked.
+         */
+        void assignSlot(TdmaScheduler *scheduler, uint8_t slot);
+        bool slotOpen();
+
+        /**
+         * Give the peer a command. Safety commands go out at once, ahead of pings and telemetry,
+         * and every command is resent until the peer acks it. A newer command of the same kind
+         * replaces one still waiting.
+         * @return Id of the command, or zero if the type is unknown.
+         */
+        uint16_t sendCommand(CommandType type, float value = 0);
+        COMMAND_STATS getCommandStats();
+
+        /**
+         * Drop, delay, duplicate, reorder or corrupt the frames this node sends and receives.
+         * Wraps the node's transport, so must be called before `start`.
+         * @param seed Seed of the fault generators. The same seed repeats the same faults.
+         * @return False if the node has already started.
+         */
+        bool injectFaults(const FAULT_PROFILE &outgoing, const FAULT_PROFILE &incoming, uint32_t seed);
+        void serviceFaults();
+        FAULT_STATS getOutgoingFaultStats();
+        FAULT_STATS getIncomingFaultStats();
+
+        // Methods for replicating tuning values with the peer.
+        void attachConfigStore(ConfigStore *store);
+        bool setConfig(ConfigKey key, float value);
+        float getConfig(ConfigKey key);
+
+        // Methods for choosing the PHY rate and accounting for the channel time used.
+        bool setPhyRate(PhyRate rate);
+        AIRTIME_STATS getAirtimeStats();
+        AIRTIME_STATS getPeerAirtimeStats();
+
+        // Methods for agreeing on the settings both nodes support.
+        void setCapabilities(uint8_t sensors, uint16_t readTimeMs, uint16_t minPingIntervalMs);
+        bool hasNegotiated();
+        NEGOTIATED_SETTINGS getNegotiatedSettings();
+        CAPABILITY_RECORD getPeerCapabilities();
+
+        /**
+         * Stream frames without waiting for a reply to each, acking on frames going the other way.
+         * Only takes effect once the peer's capabilities show it streams too.
+         */
+        void setStreaming(bool enabled);
+        bool isStreaming();
+        STREAM_STATS getStreamStats();
+
+        // Methods for pacing the transmitter's pings by how fast the target moves.
+        void enablePingRateGovernor(uint32_t minIntervalUs, uint32_t keepAliveIntervalUs);
+        void observeTargetRange(int64_t time, float inches);
+        void observeTargetBearing(int64_t time, float degrees);
+        void requestPing();
+        bool pingDue();
+        PING_RATE_STATS getPingRateStats();
         bool readyToTransmit(); 
         void setReadyToTransmit(bool status);
         Header determineNextHeader();
         AckMessage determineNextAck();
-        String determineNextData();
+        ProtocolState getProtocolState();
+        void determineNextData(ESP_NOW_PACKET *packet);
+        uint32_t getRejectedFrameCount();
+        RingStats getRxQueueStats();
+        RingStats getPriorityQueueStats();
+        TX_STATS getTxStats();
+        LOSS_STATS getLossStats();
+
+        // Methods for mapping time between this node's clock and its peer's (in microseconds).
+        bool isClockSynchronized();
+        int64_t toPeerTime(int64_t localTime);
+        int64_t fromPeerTime(int64_t peerTime);
+        const ClockSync &getClockSync();
+
+        // Methods for firing both nodes' transducers at the same instant.
+        void enableScheduledTriggers(uint32_t leadUs, uint32_t periodUs);
+        void setTriggerMeasurement(bool enabled);
+        void reportTriggerFired(uint16_t triggerId, int64_t firedAt);
+        TRIGGER_STATS getTriggerStats();
+
+        /**
+         * Tell the receiver when this node's transducer actually emitted a trigger's burst. A
+         * streaming node sends it at once in a frame of its own; otherwise it rides on the next frame.
+         * @param emittedAt When the burst went out, in this node's clock (in microseconds).
+         * @param boundUs Bound on emittedAt's error from timestamping the burst (in microseconds).
+         */
+        void reportEmission(uint16_t triggerId, int64_t emittedAt, uint32_t boundUs);
+
+        /**
+         * Range an arrival of the transmitter's burst by its one-way time of flight.
+         * @param arrivalAt When the burst arrived, in this node's clock (in microseconds).
+         * @param arrivalBoundUs Bound on arrivalAt's error from timestamping the burst (in microseconds).
+         * @return range_PENDING until the transmitter's emission time has been received.
+         */
+        RangeStatus rangeOneWay(uint16_t triggerId, int64_t arrivalAt, uint32_t arrivalBoundUs, RANGE_RESULT *result);
+        void recordRangeUnmatched();
+        void setRangingLatency(int32_t us);
+        RANGE_STATS getRangingStats();
+
+        /**
+         * Snapshot of the link's health. Costs nothing on the send/receive path.
+         */
+        LINK_STATS getLinkStats();
+
+        // Methods for streaming batched telemetry to the peer on the replies this node sends.
+        void queueTelemetry(const TELEMETRY_SAMPLE &sample);
+        void setTelemetryFlushPolicy(uint8_t samples, uint32_t deadlineUs);
+        TELEMETRY_STATS getTelemetryStats();
+        int64_t getLastArrivalTime();
 
         void showDataReceived();
         void showDataTransmitted();
+        bool loadNextPacket();
         bool proccessPacket();
         void reRegister();
 
+        // Methods for detecting link loss and resuming the session after it.
+        void checkLink();
+        bool isLinkUp();
+        LINK_RECOVERY_STATS getRecoveryStats();
+
         // Methods for identifying info on nodes in the network.
-        String getThisMacAddress();
-        String getPeerMacAddress();
+        const char *getThisMacAddress();
+        const char *getPeerMacAddress();
     };
 
 
@@ -0,0 +1,196 @@
+#ifndef ESP_NOW_PACKET_H
+#define ESP_NOW_PACKET_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ESPNOW_WIRE_MAGIC 0xAF          // First byte of every frame produced by this codec.
+#define ESPNOW_WIRE_VERSION 1           // Bumped whenever the frame layout changes.
+#define ESPNOW_MAX_FRAME_SIZE 250       // Largest frame ESP-NOW will carry (in bytes).
+#define ESPNOW_PACKET_HEADER_SIZE 20    // Size of the fixed part of a frame (in bytes).
+#define ESPNOW_PAYLOAD_SIZE (ESPNOW_MAX_FRAME_SIZE - ESPNOW_PACKET_HEADER_SIZE)    // Room left for records (in bytes).
+
+enum _header : uint8_t {
+    ACK = 10,            // Header indidcating this frame only carries an ack (rec_ACK), sent when streaming finds frames missing.
+    HANDSHAKE = 11,      // Header indicating this is a connection establishing message.
+    COMMAND = 12,        // Header indicating this frame was sent out of turn to carry commands (rec_COMMAND).
+    WAVE = 13,           // Header indicating this is a connection terminating message.
+    TRIGGER_PING = 14,   // Header indicating that a trigger event is about to happen.
+    EMISSION = 15        // Header indicating this frame was sent out of turn to carry an emission time (rec_EMISSION).
+};
+typedef enum _header Header;
+
+enum _ack_messages : char {
+    Received_Handshake = 'H',
+    Received_Wave = 'W',
+    Received_Ping = 'G'
+};
+typedef enum _ack_messages AckMessage;
+
+/**
+ * Types of the records carried in a packet's payload. Each record is laid out as
+ * [type (1 byte)][length (1 byte)][value (length bytes)].
+ */
+enum _record_type : uint8_t {
+    rec_NONE = 0,       // Reserved. Never written to the wire.
+    rec_SYNC = 1,       // SYNC_RECORD: timing of the last frame received from the peer.
+    rec_TRIGGER = 2,    // TRIGGER_RECORD: absolute time both nodes fire their transducers.
+    rec_TRIGGER_REPORT = 3, // TRIGGER_REPORT_RECORD: when the receiver actually fired.
+    rec_TELEMETRY = 4,  // TELEMETRY_BATCH_HEADER followed by TELEMETRY_SAMPLEs.
+    rec_CAPABILITIES = 5,   // CAPABILITY_RECORD: what the sender supports, exchanged around handshakes.
+    rec_ACK = 6,        // ACK_RECORD: frames received from the peer, carried on every frame while streaming.
+    rec_CONFIG = 7,     // CONFIG_RECORD_HEADER followed by CONFIG_ENTRYs: config writes the peer is missing.
+    rec_COMMAND = 8,    // COMMAND_ENTRYs: commands waiting for the peer's ack, safety first.
+    rec_COMMAND_ACK = 9,    // ACK_RECORD over command ids: commands received from the peer.
+    rec_EMISSION = 10   // EMISSION_RECORD: when the transmitter's burst actually went out.
+};
+typedef enum _record_type RecordType;
+
+#define ESPNOW_RECORD_HEADER_SIZE 2     // Size of a record's type and length fields (in bytes).
+
+#define PACKET_FLAG_PULL 0x01           // The receiver asks the transmitter for a ping now.
+
+/**
+ * Fixed-layout frame exchanged between nodes. Multi-byte fields are little-endian, which
+ * matches the ESP32 (and x86/ARM hosts), so frames are read and written in place.
+ * Only the first `ESPNOW_PACKET_HEADER_SIZE + payloadLength` bytes go on the air.
+ */
+struct __attribute__((packed)) _esp_now_packet {
+    uint8_t magic;              // Always ESPNOW_WIRE_MAGIC.
+    uint8_t version;            // Always ESPNOW_WIRE_VERSION.
+    Header header;              // Holds info on the kind of data being exchanged.
+    AckMessage ack;             // Holds info on the kind of data last received by the sending node.
+    uint16_t seq;               // Sequence number of this frame.
+    uint16_t ackSeq;            // Sequence number of the last frame the sending node received.
+    uint64_t timestamp;         // Sender's clock (in microseconds) when the frame was encoded.
+    uint8_t payloadLength;      // Number of payload bytes in use.
+    uint8_t flags;              // Per-frame options (PACKET_FLAG_*).
+    uint16_t crc;               // CRC-16/CCITT over the header (with this field zeroed) and payload.
+    uint8_t payload[ESPNOW_PAYLOAD_SIZE];   // Typed records.
+};
+typedef struct _esp_now_packet ESP_NOW_PACKET;
+
+static_assert(offsetof(ESP_NOW_PACKET, payload) == ESPNOW_PACKET_HEADER_SIZE, "ESP_NOW_PACKET header layout changed.");
+static_assert(sizeof(ESP_NOW_PACKET) == ESPNOW_MAX_FRAME_SIZE, "ESP_NOW_PACKET must fill exactly one ESP-NOW frame.");
+
+/**
+ * Echo of the last frame received from the peer, letting the peer complete a
+ * four-timestamp clock exchange with this frame's own timestamp and arrival.
+ */
+struct __attribute__((packed)) _sync_record {
+    uint64_t echoTimestamp;     // Timestamp of the peer's frame, in the peer's clock (us).
+    uint64_t echoArrival;       // Arrival of the peer's frame, in the sender's clock (us).
+};
+typedef struct _sync_record SYNC_RECORD;
+
+/**
+ * Trigger announced by the transmitter, carried in TRIGGER_PING frames.
+ */
+struct __attribute__((packed)) _trigger_record {
+    uint16_t triggerId;         // Identifies the trigger in reports.
+    uint64_t fireAt;            // When both nodes fire, in the transmitter's clock (us).
+};
+typedef struct _trigger_record TRIGGER_RECORD;
+
+/**
+ * Receiver's account of when it fired a trigger, used to measure alignment.
+ */
+struct __attribute__((packed)) _trigger_report_record {
+    uint16_t triggerId;         // Trigger being reported.
+    uint64_t firedAt;           // When the receiver fired, mapped into the transmitter's clock (us).
+};
+typedef struct _trigger_report_record TRIGGER_REPORT_RECORD;
+
+/**
+ * When the transmitter's transducer actually emitted a trigger's burst, for one-way ranging.
+ */
+struct __attribute__((packed)) _emission_record {
+    uint16_t triggerId;         // Trigger the burst was fired for.
+    uint64_t emittedAt;         // When the burst went out, in the transmitter's clock (us).
+    uint16_t captureBoundUs;    // Bound on emittedAt's error from timestamping the burst (us). Only sent with CAP_EMISSION_BOUNDS.
+};
+typedef struct _emission_record EMISSION_RECORD;
+
+#define EMISSION_RECORD_SHORT_SIZE 10   // Size of an emission record without its capture bound (in bytes).
+
+/**
+ * What a node supports. Newer firmware may append fields; readers take the prefix they know
+ * and treat fields missing from an older peer as zero.
+ */
+struct __attribute__((packed)) _capability_record {
+    uint8_t protocolVersion;    // Highest protocol version spoken.
+    uint16_t features;          // CAP_* feature bits.
+    uint8_t sensors;            // CAP_SENSOR_* bits of the sensors and actuators fitted.
+    uint16_t minPingInterval;   // Shortest spacing between pings the node can keep up with (ms).
+    uint16_t readTime;          // Time the node needs to read a transducer (ms).
+    uint8_t maxPayload;         // Largest payload accepted (bytes).
+    uint8_t channel;            // Wi-Fi channel the node runs on.
+};
+typedef struct _capability_record CAPABILITY_RECORD;
+
+/**
+ * Cumulative ack of the frames received from the peer, riding on frames going its way.
+ */
+struct __attribute__((packed)) _ack_record {
+    uint16_t highestSeq;        // Highest sequence number received from the peer.
+    uint32_t received;          // Bit i set if frame `highestSeq - 1 - i` was received too.
+    uint32_t ackDelay;          // Time from the highest frame arriving to this frame being sent (us).
+};
+typedef struct _ack_record ACK_RECORD;
+
+/**
+ * Compute the CRC-16/CCITT-FALSE of a buffer.
+ * @param data Bytes to checksum.
+ * @param len Number of bytes.
+ * @param crc Running value, allowing the CRC to be computed over several pieces.
+ */
+uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF);
+
+/**
+ * Reset a packet to an empty frame carrying the given header and ack.
+ */
+void clearPacket(ESP_NOW_PACKET *packet, Header header, AckMessage ack);
+
+/**
+ * Finalize a packet in place for transmission: stamps the wire magic, version and
+ * timestamp and computes the CRC.
+ * @param timestamp Sender's clock (in microseconds).
+ * @return Number of bytes to put on the air.
+ */
+size_t encodePacket(ESP_NOW_PACKET *packet, uint64_t timestamp);
+
+/**
+ * Validate a received buffer and view it as a packet without copying it.
+ * @param data Bytes received. The returned pointer aliases this buffer.
+ * @param len Number of bytes received.
+ * @return The packet, or NULL if the buffer is truncated, of another version, or corrupt.
+ */
+const ESP_NOW_PACKET *decodePacket(const uint8_t *data, size_t len);
+
+/**
+ * Number of bytes a packet occupies on the air.
+ */
+size_t packetWireLength(const ESP_NOW_PACKET *packet);
+
+/**
+ * Append a typed record to a packet's payload.
+ * @return True if the record fit, false otherwise (the packet is left untouched).
+ */
+bool appendRecord(ESP_NOW_PACKET *packet, RecordType type, const void *value, uint8_t len);
+
+/**
+ * Find the first record of a given type in a packet's payload.
+ * @param len Set to the record's length when found.
+ * @return Pointer to the record's value inside the packet, or NULL if absent or malformed.
+ */
+const uint8_t *findRecord(const ESP_NOW_PACKET *packet, RecordType type, uint8_t *len);
+
+/**
+ * Copy the first record of a given type out of a packet's payload.
+ * @param value Destination of the record's value.
+ * @param len Expected length of the record.
+ * @return True if a record of that type and length was found.
+ */
+bool readRecord(const ESP_NOW_PACKET *packet, RecordType type, void *value, uint8_t len);
+
+#endif /* ESP_NOW_PACKET_H */
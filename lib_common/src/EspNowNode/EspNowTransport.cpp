@@ -0,0 +1,139 @@
+#include "EspNowTransport.h"
+
+// Wi-Fi driver rate of each PhyRate.
+static const wifi_phy_rate_t wifiPhyRates[phy_COUNT] = {
+    WIFI_PHY_RATE_1M_L, WIFI_PHY_RATE_2M_L, WIFI_PHY_RATE_5M_L, WIFI_PHY_RATE_11M_L,
+    WIFI_PHY_RATE_6M, WIFI_PHY_RATE_9M, WIFI_PHY_RATE_12M, WIFI_PHY_RATE_18M,
+    WIFI_PHY_RATE_24M, WIFI_PHY_RATE_36M, WIFI_PHY_RATE_48M, WIFI_PHY_RATE_54M,
+    WIFI_PHY_RATE_MCS0_LGI, WIFI_PHY_RATE_MCS1_LGI, WIFI_PHY_RATE_MCS2_LGI, WIFI_PHY_RATE_MCS3_LGI,
+    WIFI_PHY_RATE_MCS4_LGI, WIFI_PHY_RATE_MCS5_LGI, WIFI_PHY_RATE_MCS6_LGI, WIFI_PHY_RATE_MCS7_LGI
+};
+
+void EspNowTransport::initWifi() {
+    WiFi.mode(WIFI_MODE_APSTA);
+    WiFi.setChannel(channel);
+    while(!WiFi.STA.started()) vTaskDelay(pdMS_TO_TICKS(100));
+
+    // Sniff management frames to learn the RSSI of the peers' ESP-NOW frames.
+    if(ESPNOW_TRACK_RSSI) {
+        wifi_promiscuous_filter_t filter = { .filter_mask = WIFI_PROMIS_FILTER_MASK_MGMT };
+        esp_wifi_set_promiscuous_filter(&filter);
+        esp_wifi_set_promiscuous_rx_cb(&EspNowTransport::onPromiscuousRx);
+        esp_wifi_set_promiscuous(true);
+    }
+}
+
+void EspNowTransport::onPromiscuousRx(void *buf, wifi_promiscuous_pkt_type_t type) {
+    if(type != WIFI_PKT_MGMT) return;
+
+    // ESP-NOW rides in action frames; the transmitter address sits at offset 10 of the MAC header.
+    const wifi_promiscuous_pkt_t *pkt = (const wifi_promiscuous_pkt_t *) buf;
+    const uint8_t *macHeader = pkt->payload;
+    if(macHeader[0] != 0xD0) return;
+    for(int i = 0; i < ESPNOW_MAX_PEERS; i++) {
+        EspNowTransport *transport = active[i];
+        if(transport != NULL && memcmp(&macHeader[10], transport->peerMacAddress, 6) == 0) {
+            transport->peerRssi = pkt->rx_ctrl.rssi;
+            return;
+        }
+    }
+}
+
+int EspNowTransport::setActive(bool up) {
+    int res = 0, freeSlot = -1;
+    taskENTER_CRITICAL(&activeLock);
+    for(int i = 0; i < ESPNOW_MAX_PEERS; i++) {
+        if(active[i] == this) {
+            if(!up) active[i] = NULL;
+            else freeSlot = -2;
+        }
+        else if(active[i] == NULL && freeSlot == -1) freeSlot = i;
+    }
+    if(up && freeSlot >= 0) active[freeSlot] = this;
+    for(int i = 0; i < ESPNOW_MAX_PEERS; i++) if(active[i] != NULL) res++;
+    taskEXIT_CRITICAL(&activeLock);
+    return (up && freeSlot == -1) ? -1 : res;
+}
+
+bool EspNowTransport::begin() {
+    int count = setActive(true);
+    if(count < 0) return false;
+
+    // Wi-Fi is shared by every transport, so only the first brings it up.
+    if(count == 1) initWifi();
+
+    // Begin ESP NOW (a no-op once begun) and add Peer to the network.
+    bool success = true;
+    if(!ESP_NOW.begin()) {
+        //log_e("Failed to init ESP-NOW!");
+        success = false;
+    }
+    if(!success || !add()) {
+        //log_e("Failed to register broadcast peer!");
+        success = false;
+    }
+    if(success && !applyRate()) log_e("Failed to set the peer's PHY rate.");
+    if(!success) setActive(false);
+    return success;
+}
+
+void EspNowTransport::end() {
+    if(!isActive()) return;
+    this->remove();
+
+    // Deinitialize ESP NOW once the last transport is down.
+    if(setActive(false) == 0) esp_now_deinit();
+}
+
+bool EspNowTransport::isActive() {
+    bool res = false;
+    taskENTER_CRITICAL(&activeLock);
+    for(int i = 0; i < ESPNOW_MAX_PEERS; i++) if(active[i] == this) res = true;
+    taskEXIT_CRITICAL(&activeLock);
+    return res;
+}
+
+bool EspNowTransport::send(const uint8_t *data, size_t len) {
+    // The Wi-Fi driver allocates its transmit buffers; count those apart from this code's own.
+    AllocGuardExempt exempt;
+    return ESP_NOW_Peer::send(data, len) > 0;
+}
+
+bool EspNowTransport::reset() {
+    bool removed = this->remove();
+    //log_e("Peer remove status: %s", removed ? "success" : "failed");
+
+    this->setChannel(WiFi.channel());
+
+    bool added = this->add();
+    //log_e("Peer add status: %s", added ? "success" : "failed");
+
+    // A re-added peer starts at the default rate.
+    if(added) applyRate();
+    return added;
+}
+
+bool EspNowTransport::setRate(PhyRate rate) {
+    this->rate = rate;
+    return !isActive() || applyRate();
+}
+
+bool EspNowTransport::applyRate() {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 4, 0)
+    esp_now_rate_config_t config = {};
+    config.phymode = (rate <= phy_CCK_11M) ? WIFI_PHY_MODE_11B : (rate <= phy_OFDM_54M) ? WIFI_PHY_MODE_11G : WIFI_PHY_MODE_HT20;
+    config.rate = wifiPhyRates[rate];
+    return esp_now_set_peer_rate_config(peerMacAddress, &config) == ESP_OK;
+#else
+    // Older IDFs only set one rate for every ESP-NOW peer on the interface.
+    return esp_wifi_config_espnow_rate(WIFI_IF_STA, wifiPhyRates[rate]) == ESP_OK;
+#endif
+}
+
+void EspNowTransport::onReceive(const uint8_t *data, size_t len, bool broadcast) {
+    if(listener != NULL) listener->onReceive(data, len, ESPNOW_TRACK_RSSI ? peerRssi : TRANSPORT_NO_RSSI);
+}
+
+void EspNowTransport::onSent(bool success) {
+    if(listener != NULL) listener->onSent(success);
+}
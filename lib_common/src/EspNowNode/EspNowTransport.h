@@ -0,0 +1,77 @@
+#ifndef ESP_NOW_TRANSPORT_H
+#define ESP_NOW_TRANSPORT_H
+
+#include <Arduino.h>
+#include <ESP32_NOW.h>
+#include <WiFi.h>
+#include <esp_wifi.h>
+#include <esp_idf_version.h>
+#include "Transport.h"
+#include "../AllocGuard/AllocGuard.h"
+
+#define ESPNOW_TRACK_RSSI 1      // Sniff the RSSI of the peer's frames in promiscuous mode.
+#define ESPNOW_MAX_PEERS 8       // Most ESP-NOW transports (peers) that can be up at once.
+
+/**
+ * Transport over ESP-NOW to a single registered peer.
+ */
+class EspNowTransport : public Transport, ESP_NOW_Peer {
+    private:
+        uint8_t channel;                            // Wi-Fi channel the link runs on.
+        uint8_t peerMacAddress[6];                  // Address of the peer.
+        volatile int8_t peerRssi = TRANSPORT_NO_RSSI;   // RSSI of the last frame sniffed from the peer.
+        inline static EspNowTransport *active[ESPNOW_MAX_PEERS] = {NULL};  // Transports that are up, for RSSI sniffing and shutdown.
+        inline static portMUX_TYPE activeLock = portMUX_INITIALIZER_UNLOCKED;   // Guards `active`.
+
+        /**
+         * Add or remove this transport from the transports that are up.
+         * @return Number of transports up afterwards, or -1 if there was no room.
+         */
+        int setActive(bool up);
+
+        /**
+         * Is this transport up.
+         */
+        bool isActive();
+
+        /**
+         * Intializes Wi-Fi on the ESP, specifically begins
+         * Wi-Fi in station mode a required by ESP-NOW.
+         */
+        void initWifi();
+
+        /**
+         * Apply `rate` to the registered peer.
+         */
+        bool applyRate();
+
+        /**
+         * Promiscuous mode callback recording the RSSI of the peer's ESP-NOW frames.
+         */
+        static void onPromiscuousRx(void *buf, wifi_promiscuous_pkt_type_t type);
+
+    public:
+        EspNowTransport(
+                const uint8_t* peerMacAddress,      // Mac address of the device to be registered as the peer.
+                uint8_t channel                     // Wi-Fi channel to communicate in.
+            ) :
+            ESP_NOW_Peer(peerMacAddress, channel, WIFI_IF_STA, NULL)
+        {
+            for(int i = 0; i < 6; i++) this->peerMacAddress[i] = peerMacAddress[i];
+            this->channel = channel;
+        }
+
+        ~EspNowTransport() { end(); }
+
+        bool begin() override;
+        void end() override;
+        bool send(const uint8_t *data, size_t len) override;
+        bool reset() override;
+        bool setRate(PhyRate rate) override;
+
+        // ESP-NOW events, forwarded to the listener.
+        void onReceive(const uint8_t *data, size_t len, bool broadcast) override;
+        void onSent(bool success) override;
+};
+
+#endif /* ESP_NOW_TRANSPORT_H */
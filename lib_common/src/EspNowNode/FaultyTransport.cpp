@@ -0,0 +1,169 @@
+#include "FaultyTransport.h"
+#include <string.h>
+
+bool FaultChannel::lose() {
+    stats.frames++;
+
+    // Gilbert-Elliott: every frame of a burst is lost, and each one lost may end it.
+    if(inBurst) {
+        float end = (profile.burstLength > 1) ? 1.0f / profile.burstLength : 1.0f;
+        if(random.chance(end)) inBurst = false;
+        stats.burstDropped++;
+        return true;
+    }
+    if(random.chance(profile.burstStart)) {
+        inBurst = profile.burstLength > 1;
+        stats.bursts++;
+        stats.burstDropped++;
+        return true;
+    }
+    if(random.chance(profile.drop)) {
+        stats.dropped++;
+        return true;
+    }
+    return false;
+}
+
+bool FaultChannel::duplicate() {
+    bool res = random.chance(profile.duplicate);
+    if(res) stats.duplicated++;
+    return res;
+}
+
+bool FaultChannel::reorder() {
+    bool res = random.chance(profile.reorder);
+    if(res) stats.reordered++;
+    return res;
+}
+
+uint32_t FaultChannel::delay() {
+    if(!random.chance(profile.delay)) return 0;
+    stats.delayed++;
+    uint32_t res = random.between(profile.delayMinUs, profile.delayMaxUs);
+    return (res > 0) ? res : 1;
+}
+
+bool FaultChannel::corrupt(uint8_t *data, size_t len) {
+    if(len == 0 || !random.chance(profile.corrupt)) return false;
+    uint32_t bit = random.next() % (len * 8);
+    data[bit / 8] ^= (uint8_t) (1 << (bit % 8));
+    stats.corrupted++;
+    return true;
+}
+
+FaultyTransport::FaultyTransport(Transport *inner, FaultClock clock, uint32_t seed) {
+    this->inner = inner;
+    this->clock = clock;
+    this->rate = inner->getRate();
+    outgoing.setSeed(seed);
+    incoming.setSeed(seed * 2654435761UL + 1);
+    inner->setListener(this);
+}
+
+void FaultyTransport::setProfiles(const FAULT_PROFILE &outgoing, const FAULT_PROFILE &incoming) {
+    this->outgoing.setProfile(outgoing);
+    this->incoming.setProfile(incoming);
+}
+
+bool FaultyTransport::begin() { return inner->begin(); }
+
+void FaultyTransport::end() {
+    for(int i = 0; i < FAULT_HOLD_DEPTH; i++) held[i].used = false;
+    inner->end();
+}
+
+bool FaultyTransport::reset() { return inner->reset(); }
+
+bool FaultyTransport::setRate(PhyRate rate) {
+    this->rate = rate;
+    return inner->setRate(rate);
+}
+
+bool FaultyTransport::forward(const uint8_t *data, size_t len) {
+    sentToSwallow++;
+    if(inner->send(data, len)) return true;
+    sentToSwallow--;
+    return false;
+}
+
+bool FaultyTransport::hold(const uint8_t *data, size_t len, int64_t releaseAt, bool overtake) {
+    for(int i = 0; i < FAULT_HOLD_DEPTH; i++) {
+        if(held[i].used) continue;
+        memcpy(held[i].data, data, len);
+        held[i].len = len;
+        held[i].releaseAt = releaseAt;
+        held[i].overtake = overtake;
+        held[i].used = true;
+        return true;
+    }
+    return false;
+}
+
+int64_t FaultyTransport::nextReleaseAt() const {
+    int64_t res = INT64_MAX;
+    for(int i = 0; i < FAULT_HOLD_DEPTH; i++) if(held[i].used && held[i].releaseAt < res) res = held[i].releaseAt;
+    return res;
+}
+
+int64_t FaultyTransport::service() {
+    int64_t now = clock();
+    int64_t res = INT64_MAX;
+    for(int i = 0; i < FAULT_HOLD_DEPTH; i++) {
+        if(!held[i].used) continue;
+        if(held[i].releaseAt <= now) {
+            held[i].used = false;
+            forward(held[i].data, held[i].len);
+        }
+        else if(held[i].releaseAt < res) res = held[i].releaseAt;
+    }
+    return res;
+}
+
+bool FaultyTransport::send(const uint8_t *data, size_t len) {
+    if(len > ESPNOW_MAX_FRAME_SIZE) return false;
+
+    // A lost frame is reported as the radio reports a frame the peer never acked.
+    if(outgoing.lose()) {
+        service();
+        if(listener != NULL) listener->onSent(false);
+        return true;
+    }
+
+    memcpy(txBuffer, data, len);
+    if(outgoing.corrupt(txBuffer, len)) data = txBuffer;
+
+    // Held frames are reported sent at once; their own reports are swallowed when they go.
+    int64_t now = clock();
+    uint32_t wait = outgoing.delay();
+    bool overtaken = (wait == 0) && outgoing.reorder();
+    if(overtaken) wait = FAULT_REORDER_HOLD_US;
+    if(wait > 0) {
+        if(hold(data, len, now + wait, overtaken)) {
+            if(listener != NULL) listener->onSent(true);
+            return true;
+        }
+        outgoing.recordHoldOverflow();
+    }
+
+    // This frame goes now, then any frame it was meant to overtake.
+    bool res = inner->send(data, len);
+    if(res && outgoing.duplicate()) forward(data, len);
+    for(int i = 0; i < FAULT_HOLD_DEPTH; i++) if(held[i].used && held[i].overtake) held[i].releaseAt = now;
+    service();
+    return res;
+}
+
+void FaultyTransport::onReceive(const uint8_t *data, size_t len, int8_t rssi) {
+    if(listener == NULL || len > ESPNOW_MAX_FRAME_SIZE || incoming.lose()) return;
+    memcpy(rxBuffer, data, len);
+    incoming.corrupt(rxBuffer, len);
+    listener->onReceive(rxBuffer, len, rssi);
+    if(incoming.duplicate()) listener->onReceive(rxBuffer, len, rssi);
+}
+
+void FaultyTransport::onSent(bool success) {
+    // Reports of held and duplicated frames were already given when they were sent.
+    uint32_t owed = sentToSwallow.load();
+    while(owed > 0 && !sentToSwallow.compare_exchange_weak(owed, owed - 1)) {}
+    if(owed == 0 && listener != NULL) listener->onSent(success);
+}
@@ -0,0 +1,190 @@
+#ifndef FAULTY_TRANSPORT_H
+#define FAULTY_TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "Transport.h"
+#include "EspNowPacket.h"
+
+#define FAULT_HOLD_DEPTH 4              // Outgoing frames that can be held back (delayed or reordered) at once.
+#define FAULT_REORDER_HOLD_US 50000     // Longest a frame waits for another to overtake it before going anyway (us).
+
+/**
+ * Chances of each fault befalling a frame, and how long held frames wait. Zero everywhere
+ * passes frames untouched.
+ */
+struct _fault_profile {
+    float drop;                 // Chance a frame is lost on its own.
+    float burstStart;           // Chance a frame starts a burst of losses.
+    float burstLength;          // Mean frames lost per burst, taken as geometric. Below one means one.
+    float duplicate;            // Chance a frame is delivered twice.
+    float corrupt;              // Chance one bit of a frame is flipped.
+    float reorder;              // Chance a frame is held back until the next one has gone. Outgoing only.
+    float delay;                // Chance a frame is held back for a while. Outgoing only.
+    uint32_t delayMinUs;        // Shortest hold of a delayed frame (us).
+    uint32_t delayMaxUs;        // Longest hold of a delayed frame (us).
+};
+typedef struct _fault_profile FAULT_PROFILE;
+
+struct _fault_stats {
+    uint32_t frames;            // Frames that went through the injector.
+    uint32_t dropped;           // Frames lost on their own.
+    uint32_t burstDropped;      // Frames lost in bursts.
+    uint32_t bursts;            // Bursts started.
+    uint32_t duplicated;        // Frames delivered twice.
+    uint32_t corrupted;         // Frames with a bit flipped.
+    uint32_t reordered;         // Frames overtaken by the next one.
+    uint32_t delayed;           // Frames held back for a while.
+    uint32_t holdOverflows;     // Frames sent at once because the hold was full.
+};
+typedef struct _fault_stats FAULT_STATS;
+
+/**
+ * Small seedable generator, so a run of faults can be repeated exactly.
+ */
+class FaultRandom {
+    private:
+        uint32_t state;
+
+    public:
+        FaultRandom(uint32_t seed = 1) { setSeed(seed); }
+
+        void setSeed(uint32_t seed) { state = (seed != 0) ? seed : 0x9E3779B9; }
+
+        uint32_t next() {
+            // xorshift32.
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        }
+
+        /**
+         * True with the given chance.
+         */
+        bool chance(float p) { return p > 0 && (next() >> 8) < (uint32_t) (p * 16777216.0f); }
+
+        /**
+         * Uniform in [low, high].
+         */
+        uint32_t between(uint32_t low, uint32_t high) { return (high > low) ? low + next() % (high - low + 1) : low; }
+};
+
+/**
+ * Fault state of one direction of the link: its profile, generator, burst and counters.
+ */
+class FaultChannel {
+    private:
+        FAULT_PROFILE profile = {};
+        FaultRandom random;
+        bool inBurst = false;       // Is a burst of losses under way.
+        FAULT_STATS stats = {};
+
+    public:
+        void setProfile(const FAULT_PROFILE &profile) { this->profile = profile; }
+        const FAULT_PROFILE &getProfile() const { return profile; }
+        void setSeed(uint32_t seed) { random.setSeed(seed); }
+
+        /**
+         * Decide whether the next frame is lost, on its own or in a burst.
+         */
+        bool lose();
+
+        bool duplicate();
+        bool reorder();
+
+        /**
+         * Decide how long the next frame is held back (us). Zero if it isn't.
+         */
+        uint32_t delay();
+
+        /**
+         * Flip one bit of a frame, if the profile says to.
+         * @return True if the frame was corrupted.
+         */
+        bool corrupt(uint8_t *data, size_t len);
+
+        void recordHoldOverflow() { stats.holdOverflows++; }
+        FAULT_STATS getStats() const { return stats; }
+};
+
+typedef int64_t (* FaultClock)();
+
+/**
+ * Transport that wraps another and drops, delays, duplicates, reorders or corrupts the frames
+ * going through it, so link problems seen in the field can be reproduced on the bench.
+ * Outgoing frames can suffer every fault. Incoming frames arrive on the radio's task, so they
+ * are only dropped, duplicated or corrupted there; wrap the peer's transport too to delay or
+ * reorder the other direction. Held frames go out as later frames are sent, or when `service`
+ * is called. `send` and `service` must be called from the same task.
+ */
+class FaultyTransport : public Transport, public TransportListener {
+    private:
+        struct _held_frame {
+            uint8_t data[ESPNOW_MAX_FRAME_SIZE];
+            size_t len;
+            int64_t releaseAt;      // When the frame goes out (us).
+            bool overtake;          // Does the frame go as soon as the next one has.
+            bool used;
+        };
+
+        Transport *inner;                       // Transport the frames really go over. Not owned.
+        FaultClock clock;                       // Time source for holds (us).
+        FaultChannel outgoing;                  // Faults of frames sent.
+        FaultChannel incoming;                  // Faults of frames received.
+        _held_frame held[FAULT_HOLD_DEPTH] = {};
+        uint8_t rxBuffer[ESPNOW_MAX_FRAME_SIZE];    // Copy of an incoming frame being corrupted.
+        uint8_t txBuffer[ESPNOW_MAX_FRAME_SIZE];    // Copy of the outgoing frame, for corrupting.
+        std::atomic<uint32_t> sentToSwallow{0}; // Inner send reports for frames this transport already reported.
+
+        /**
+         * Send a frame over the inner transport, without its send report reaching the listener.
+         */
+        bool forward(const uint8_t *data, size_t len);
+
+        /**
+         * Hold a frame back until a time (us).
+         * @return False if the hold is full.
+         */
+        bool hold(const uint8_t *data, size_t len, int64_t releaseAt, bool overtake);
+
+    public:
+        FaultyTransport(
+                Transport *inner,           // Transport to wrap. Must outlive this one.
+                FaultClock clock,           // Time source (us).
+                uint32_t seed = 1           // Seed of the fault generators.
+            );
+
+        /**
+         * Set the faults of each direction.
+         */
+        void setProfiles(const FAULT_PROFILE &outgoing, const FAULT_PROFILE &incoming);
+
+        /**
+         * Send held frames that are due.
+         * @return When the next held frame is due (us), or INT64_MAX if none is held.
+         */
+        int64_t service();
+
+        /**
+         * When the next held frame is due (us), or INT64_MAX if none is held.
+         */
+        int64_t nextReleaseAt() const;
+
+        FAULT_STATS getOutgoingStats() const { return outgoing.getStats(); }
+        FAULT_STATS getIncomingStats() const { return incoming.getStats(); }
+        Transport *getInner() { return inner; }
+
+        bool begin() override;
+        void end() override;
+        bool send(const uint8_t *data, size_t len) override;
+        bool reset() override;
+        bool setRate(PhyRate rate) override;
+
+        // Events of the inner transport, passed on with faults.
+        void onReceive(const uint8_t *data, size_t len, int8_t rssi) override;
+        void onSent(bool success) override;
+};
+
+#endif /* FAULTY_TRANSPORT_H */
@@ -0,0 +1,84 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define LATENCY_HISTOGRAM_BUCKETS 24    // Bucket i holds samples in [2^i, 2^(i+1)) microseconds; the last also holds anything larger.
+
+/**
+ * Fixed-memory log2 histogram of latencies (in microseconds).
+ * Recording is O(1) and never allocates, so it is safe to use on hot paths.
+ */
+class LatencyHistogram {
+    private:
+        uint32_t buckets[LATENCY_HISTOGRAM_BUCKETS];
+        uint32_t count;
+        uint32_t minimum;
+        uint32_t maximum;
+        uint64_t sum;
+
+        static int bucketOf(uint32_t us) {
+            int i = 0;
+            while(us > 1 && i < LATENCY_HISTOGRAM_BUCKETS - 1) {
+                us >>= 1;
+                i++;
+            }
+            return i;
+        }
+
+    public:
+        LatencyHistogram() { reset(); }
+
+        /**
+         * Clear every sample.
+         */
+        void reset() {
+            memset(buckets, 0, sizeof(buckets));
+            count = 0;
+            minimum = UINT32_MAX;
+            maximum = 0;
+            sum = 0;
+        }
+
+        /**
+         * Record a single latency sample.
+         * @param us Latency in microseconds.
+         */
+        void record(uint32_t us) {
+            buckets[bucketOf(us)]++;
+            count++;
+            sum += us;
+            if(us < minimum) minimum = us;
+            if(us > maximum) maximum = us;
+        }
+
+        /**
+         * Estimate a percentile from the buckets.
+         * @param percent Percentile to estimate, between 0 and 100.
+         * @return Upper edge of the bucket holding the percentile (in microseconds), clamped to the largest sample seen.
+         */
+        uint32_t percentile(float percent) const {
+            if(count == 0) return 0;
+            uint32_t rank = (uint32_t) (percent / 100.0f * count);
+            if(rank >= count) rank = count - 1;
+
+            uint32_t seen = 0;
+            for(int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+                seen += buckets[i];
+                if(seen > rank) {
+                    uint32_t edge = (i == LATENCY_HISTOGRAM_BUCKETS - 1) ? maximum : ((uint32_t) 2 << i) - 1;
+                    return (edge < maximum) ? edge : maximum;
+                }
+            }
+            return maximum;
+        }
+
+        uint32_t getCount() const { return count; }
+        uint32_t getMin() const { return (count == 0) ? 0 : minimum; }
+        uint32_t getMax() const { return maximum; }
+        uint32_t getMean() const { return (count == 0) ? 0 : (uint32_t) (sum / count); }
+        uint32_t getBucket(int i) const { return (i >= 0 && i < LATENCY_HISTOGRAM_BUCKETS) ? buckets[i] : 0; }
+};
+
+#endif /* LATENCY_HISTOGRAM_H */
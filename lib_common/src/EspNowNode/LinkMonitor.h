@@ -0,0 +1,140 @@
+#ifndef LINK_MONITOR_H
+#define LINK_MONITOR_H
+
+#include <stdint.h>
+#include "LatencyHistogram.h"
+
+#define LINK_HEARTBEAT_US 1000000       // Longest either node stays silent while the link is up (us).
+#define LINK_LOSS_MISSES 3              // Heartbeats missed before the link is declared lost.
+#define LINK_PROBE_INTERVAL_US 200000   // Spacing of the transmitter's probes while the link is lost (us).
+#define LINK_BACKOFF_MIN_US 100000      // First delay before re-registering the peer or retrying init (us).
+#define LINK_BACKOFF_MAX_US 5000000     // Longest delay between re-registrations or init retries (us).
+
+/**
+ * Delay that doubles every time it is used, up to a limit, until reset.
+ */
+class ExponentialBackoff {
+    private:
+        uint32_t minDelay;
+        uint32_t maxDelay;
+        uint32_t delay;
+        int64_t nextAt = 0;         // When the next attempt may go (us).
+
+    public:
+        ExponentialBackoff(uint32_t minUs = LINK_BACKOFF_MIN_US, uint32_t maxUs = LINK_BACKOFF_MAX_US) {
+            minDelay = minUs;
+            maxDelay = (maxUs > minUs) ? maxUs : minUs;
+            delay = minDelay;
+        }
+
+        /**
+         * May an attempt be made at this time.
+         */
+        bool due(int64_t now) const { return now >= nextAt; }
+
+        /**
+         * Record an attempt made at this time and push the next one back.
+         * @return Delay until the next attempt (us).
+         */
+        uint32_t attempt(int64_t now) {
+            uint32_t res = delay;
+            nextAt = now + delay;
+            delay = (delay > maxDelay / 2) ? maxDelay : delay * 2;
+            return res;
+        }
+
+        /**
+         * Back to the shortest delay, with the next attempt allowed at once.
+         */
+        void reset() {
+            delay = minDelay;
+            nextAt = 0;
+        }
+
+        int64_t getNextAt() const { return nextAt; }
+};
+
+enum _link_state : uint8_t {
+    link_CONNECTING = 0,    // Nothing heard from the peer yet.
+    link_UP,                // The peer was heard within the loss timeout.
+    link_LOST               // The peer has been silent for LINK_LOSS_MISSES heartbeats.
+};
+typedef enum _link_state LinkState;
+
+struct _link_recovery_stats {
+    LinkState state;                    // Current state of the link.
+    uint32_t outages;                   // Times the link was declared lost.
+    uint32_t recoveries;                // Times the session resumed after an outage.
+    uint32_t reRegistrations;           // Times the peer was re-registered.
+    uint32_t reRegistrationsDeferred;   // Re-registrations skipped by the backoff.
+    uint32_t initRetries;               // Failed attempts to bring the transport up.
+    int64_t lastOutage;                 // Silence of the last outage, from the last frame heard to the first after (in microseconds).
+    int64_t lastRecovery;               // Time from detecting the last outage to resuming the session (in microseconds).
+    LatencyHistogram recoveryTime;      // Time from detecting an outage to resuming the session (in microseconds).
+};
+typedef struct _link_recovery_stats LINK_RECOVERY_STATS;
+
+/**
+ * Heartbeat-based detector of link loss. The link counts as lost once the peer has been
+ * silent for LINK_LOSS_MISSES heartbeats, so loss is detected within
+ * LINK_LOSS_MISSES * LINK_HEARTBEAT_US of the last frame heard. Not thread safe.
+ */
+class LinkMonitor {
+    private:
+        LinkState state = link_CONNECTING;
+        int64_t lastHeard = 0;          // When a frame was last heard from the peer (us).
+        int64_t lossDetectedAt = 0;     // When the current outage was detected (us).
+        LINK_RECOVERY_STATS stats = {};
+
+    public:
+        /**
+         * A frame was heard from the peer.
+         * @return True if this ends an outage.
+         */
+        bool heard(int64_t now) {
+            bool res = (state == link_LOST);
+            if(res) {
+                stats.recoveries++;
+                stats.lastOutage = now - lastHeard;
+                stats.lastRecovery = now - lossDetectedAt;
+                stats.recoveryTime.record((uint32_t) stats.lastRecovery);
+            }
+            state = link_UP;
+            lastHeard = now;
+            return res;
+        }
+
+        /**
+         * Check the link for loss.
+         * @return True if the link was declared lost by this call.
+         */
+        bool poll(int64_t now) {
+            if(state != link_UP || now - lastHeard < (int64_t) LINK_HEARTBEAT_US * LINK_LOSS_MISSES) return false;
+            state = link_LOST;
+            lossDetectedAt = now;
+            stats.outages++;
+            return true;
+        }
+
+        /**
+         * When the link will be declared lost if nothing is heard (us). Only meaningful while up.
+         */
+        int64_t lossDeadline() const { return lastHeard + (int64_t) LINK_HEARTBEAT_US * LINK_LOSS_MISSES; }
+
+        void recordReRegistration(bool deferred) {
+            if(deferred) stats.reRegistrationsDeferred++;
+            else stats.reRegistrations++;
+        }
+        void recordInitRetry() { stats.initRetries++; }
+
+        LinkState getState() const { return state; }
+        bool isLost() const { return state == link_LOST; }
+        int64_t getLastHeard() const { return lastHeard; }
+
+        void snapshot(LINK_RECOVERY_STATS *out) const {
+            *out = stats;
+            out->state = state;
+        }
+};
+
+#endif /* LINK_MONITOR_H */
@@ -0,0 +1,128 @@
+#ifndef LINK_STATS_H
+#define LINK_STATS_H
+
+#include <stdint.h>
+#include "EspNowPacket.h"
+#include "LatencyHistogram.h"
+
+#define LINK_STATS_HEADER_SLOTS 16      // Headers tracked individually, counted from Header::ACK.
+#define LINK_STATS_NO_RSSI -128         // RSSI reported before any frame has been measured (dBm).
+
+struct _link_stats {
+    LatencyHistogram rtt;                               // Round trip times of frames answered without a resend (in microseconds).
+    uint32_t rttP50;                                    // Median round trip time (in microseconds).
+    uint32_t rttP90;                                    // 90th percentile round trip time (in microseconds).
+    uint32_t rttP99;                                    // 99th percentile round trip time (in microseconds).
+    uint32_t sentOk[LINK_STATS_HEADER_SLOTS];           // Frames the radio delivered, per header.
+    uint32_t sendFailed[LINK_STATS_HEADER_SLOTS];       // Frames the radio failed to deliver, per header.
+    uint32_t framesReceived;                            // Frames accepted from the peer.
+    uint32_t retransmits;                               // Frames resent after their ack timed out.
+    uint32_t framesLost;                                // Frames given up on.
+    float lossRate;                                     // Fraction of first transmissions that needed a resend.
+    int8_t rssiLast;                                    // RSSI of the last frame received (dBm).
+    int8_t rssiMin;                                     // Weakest RSSI seen (dBm).
+    int8_t rssiMax;                                     // Strongest RSSI seen (dBm).
+    float rssiAverage;                                  // Smoothed RSSI (dBm).
+    uint32_t jitter;                                    // Smoothed inter-arrival jitter, RFC 3550 style (in microseconds).
+};
+typedef struct _link_stats LINK_STATS;
+
+/**
+ * Fixed-memory rolling statistics on the health of the link to the peer.
+ * Every record call is O(1) and lock-free; each counter has a single writer. A snapshot
+ * reads each counter atomically, though counters may come from slightly different instants.
+ */
+class LinkStats {
+    private:
+        LatencyHistogram rtt;
+        uint32_t sentOk[LINK_STATS_HEADER_SLOTS] = {0};
+        uint32_t sendFailed[LINK_STATS_HEADER_SLOTS] = {0};
+        uint32_t framesReceived = 0;
+
+        int8_t rssiLast = LINK_STATS_NO_RSSI;
+        int8_t rssiMin = 0;
+        int8_t rssiMax = LINK_STATS_NO_RSSI;
+        float rssiAverage = LINK_STATS_NO_RSSI;
+
+        int64_t lastArrival = 0;        // Local arrival of the previous frame (us).
+        int64_t lastPeerTimestamp = 0;  // Peer timestamp of the previous frame (us).
+        float jitter = 0;               // Smoothed jitter (us).
+
+        static int slotOf(Header header) {
+            int slot = (int) header - (int) Header::ACK;
+            return (slot >= 0 && slot < LINK_STATS_HEADER_SLOTS) ? slot : LINK_STATS_HEADER_SLOTS - 1;
+        }
+
+    public:
+        /**
+         * Record the radio's verdict on a frame sent.
+         */
+        void recordSend(Header header, bool success) {
+            if(success) sentOk[slotOf(header)]++;
+            else sendFailed[slotOf(header)]++;
+        }
+
+        /**
+         * Record a round trip measured on a frame that was not resent.
+         */
+        void recordRtt(uint32_t us) { rtt.record(us); }
+
+        /**
+         * Record a frame accepted from the peer.
+         * @param arrival Local arrival time (us).
+         * @param peerTimestamp Timestamp the peer put in the frame (us).
+         */
+        void recordArrival(int64_t arrival, int64_t peerTimestamp) {
+            // Jitter is the smoothed change in one-way transit time, so no clock sync is needed.
+            if(framesReceived > 0) {
+                int64_t d = (arrival - lastArrival) - (peerTimestamp - lastPeerTimestamp);
+                float magnitude = (float) (d < 0 ? -d : d);
+                jitter += (magnitude - jitter) / 16.0f;
+            }
+            lastArrival = arrival;
+            lastPeerTimestamp = peerTimestamp;
+            framesReceived++;
+        }
+
+        /**
+         * Record the signal strength of a frame received.
+         */
+        void recordRssi(int8_t rssi) {
+            if(rssiMax == LINK_STATS_NO_RSSI) {
+                rssiMin = rssi;
+                rssiMax = rssi;
+                rssiAverage = rssi;
+            }
+            if(rssi < rssiMin) rssiMin = rssi;
+            if(rssi > rssiMax) rssiMax = rssi;
+            rssiAverage += (rssi - rssiAverage) / 8.0f;
+            rssiLast = rssi;
+        }
+
+        /**
+         * Copy the statistics out. Loss counters are owned elsewhere and filled in by the caller.
+         */
+        void snapshot(LINK_STATS *out) const {
+            out->rtt = rtt;
+            out->rttP50 = rtt.percentile(50);
+            out->rttP90 = rtt.percentile(90);
+            out->rttP99 = rtt.percentile(99);
+            for(int i = 0; i < LINK_STATS_HEADER_SLOTS; i++) {
+                out->sentOk[i] = sentOk[i];
+                out->sendFailed[i] = sendFailed[i];
+            }
+            out->framesReceived = framesReceived;
+            out->rssiLast = rssiLast;
+            out->rssiMin = rssiMin;
+            out->rssiMax = rssiMax;
+            out->rssiAverage = rssiAverage;
+            out->jitter = (uint32_t) jitter;
+        }
+
+        /**
+         * Slot of a header in the per-header arrays of a snapshot.
+         */
+        static int headerSlot(Header header) { return slotOf(header); }
+};
+
+#endif /* LINK_STATS_H */
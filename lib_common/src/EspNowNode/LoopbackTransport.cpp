@@ -0,0 +1,28 @@
+#include "LoopbackTransport.h"
+
+void LoopbackTransport::connect(LoopbackTransport &a, LoopbackTransport &b) {
+    a.peer = &b;
+    b.peer = &a;
+}
+
+bool LoopbackTransport::begin() {
+    up = (peer != NULL);
+    return up;
+}
+
+void LoopbackTransport::end() { up = false; }
+
+bool LoopbackTransport::send(const uint8_t *data, size_t len) {
+    if(!up) return false;
+
+    // A peer that is down loses the frame, as the radio would.
+    bool success = peer->up && peer->listener != NULL;
+    if(success) {
+        peer->listener->onReceive(data, len, TRANSPORT_NO_RSSI);
+        delivered++;
+    }
+    else undeliverable++;
+
+    if(listener != NULL) listener->onSent(success);
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef LOOPBACK_TRANSPORT_H
+#define LOOPBACK_TRANSPORT_H
+
+#include "Transport.h"
+
+/**
+ * In-process transport. Two instances are connected back to back, and a frame sent by one
+ * is handed straight to the other's listener before `send` returns, so a pair of nodes can
+ * exchange frames as fast as they can build and process them.
+ */
+class LoopbackTransport : public Transport {
+    private:
+        LoopbackTransport *peer = NULL;     // Instance frames are delivered to.
+        bool up = false;                    // Has `begin` been called without `end`.
+        uint32_t delivered = 0;             // Frames handed to the peer.
+        uint32_t undeliverable = 0;         // Frames sent while either end was down.
+
+    public:
+        /**
+         * Connect two instances to each other.
+         */
+        static void connect(LoopbackTransport &a, LoopbackTransport &b);
+
+        bool begin() override;
+        void end() override;
+        bool send(const uint8_t *data, size_t len) override;
+
+        uint32_t getDeliveredCount() const { return delivered; }
+        uint32_t getUndeliverableCount() const { return undeliverable; }
+};
+
+#endif /* LOOPBACK_TRANSPORT_H */
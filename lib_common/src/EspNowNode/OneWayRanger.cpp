@@ -0,0 +1,50 @@
+#include "OneWayRanger.h"
+
+void OneWayRanger::addEmission(uint16_t triggerId, int64_t emittedAt, uint32_t boundUs) {
+    // A retransmitted record replaces its first copy rather than taking another slot.
+    int slot = next;
+    bool found = false;
+    for(int i = 0; i < RANGING_EMISSIONS; i++) {
+        if(emissions[i].used && emissions[i].triggerId == triggerId) {
+            slot = i;
+            found = true;
+            break;
+        }
+    }
+    if(!found) {
+        next = (next + 1) % RANGING_EMISSIONS;
+        stats.emissions++;
+    }
+    emissions[slot].triggerId = triggerId;
+    emissions[slot].emittedAt = emittedAt;
+    emissions[slot].boundUs = boundUs;
+    emissions[slot].used = true;
+}
+
+RangeStatus OneWayRanger::range(uint16_t triggerId, int64_t arrivalAt, uint32_t arrivalBoundUs, RANGE_RESULT *result) {
+    const _emission *emission = NULL;
+    for(int i = 0; i < RANGING_EMISSIONS; i++) {
+        if(emissions[i].used && emissions[i].triggerId == triggerId) {
+            emission = &emissions[i];
+            break;
+        }
+    }
+    if(emission == NULL) return range_PENDING;
+
+    int64_t flight = arrivalAt - emission->emittedAt - latencyUs;
+    if(flight < 0 || flight > RANGING_MAX_FLIGHT_US) {
+        stats.implausible++;
+        return range_IMPLAUSIBLE;
+    }
+    result->flightUs = (int32_t) flight;
+    result->inches = flight / RANGING_US_PER_INCH;
+    result->boundUs = emission->boundUs + arrivalBoundUs;
+    stats.ranged++;
+    stats.lastBoundUs = result->boundUs;
+    return range_OK;
+}
+
+void OneWayRanger::reset() {
+    for(int i = 0; i < RANGING_EMISSIONS; i++) emissions[i].used = false;
+    next = 0;
+}
@@ -0,0 +1,92 @@
+#ifndef ONE_WAY_RANGER_H
+#define ONE_WAY_RANGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RANGING_EMISSIONS 4             // Emissions kept for arrivals to be matched against.
+#define RANGING_US_PER_INCH 74.0f       // One-way flight time of sound per inch (us).
+#define RANGING_MAX_FLIGHT_US 30000     // Longer flights can't come from the matched emission (us). About 34 ft.
+#define RANGING_PEER_CAPTURE_US 10      // Capture bound taken for the emission of a peer that doesn't report one (us).
+
+/**
+ * Outcome of ranging an arrival.
+ */
+enum _range_status : uint8_t {
+    range_OK,               // Ranged.
+    range_PENDING,          // The emission hasn't been heard of yet.
+    range_IMPLAUSIBLE       // The flight came out negative or too long to be this emission's.
+};
+typedef enum _range_status RangeStatus;
+
+struct _range_result {
+    float inches;           // Distance flown (inches).
+    int32_t flightUs;       // One-way time of flight (us).
+    uint32_t boundUs;       // Bound on the flight's error from the clock mapping and both timestamps (us).
+};
+typedef struct _range_result RANGE_RESULT;
+
+struct _range_stats {
+    uint32_t emissions;     // Emissions heard of from the peer.
+    uint32_t ranged;        // Arrivals ranged.
+    uint32_t implausible;   // Arrivals whose flight was negative or too long.
+    uint32_t unmatched;     // Arrivals given up on before their emission was heard of.
+    uint32_t lastBoundUs;   // Error bound of the last range (us).
+};
+typedef struct _range_stats RANGE_STATS;
+
+/**
+ * Ranges by one-way time of flight: an arrival timestamped on this node less the peer's
+ * emission of the same trigger, mapped into this node's clock. Neither the radio's latency
+ * nor either trigger timer's jitter enters the range, only the clock mapping's error.
+ * Not thread safe.
+ */
+class OneWayRanger {
+    private:
+        struct _emission {
+            uint16_t triggerId;
+            int64_t emittedAt;      // When the burst went out, in this node's clock (us).
+            uint32_t boundUs;       // Error bound of the emission time in this node's clock (us).
+            bool used;
+        };
+        _emission emissions[RANGING_EMISSIONS] = {};
+        int next = 0;                   // Slot the next emission is written to.
+        int32_t latencyUs = 0;          // Fixed part of arrival less emission that isn't flight (us).
+        RANGE_STATS stats = {};
+
+    public:
+        /**
+         * Take the peer's emission of a trigger. A repeat of a trigger replaces it.
+         * @param emittedAt When the burst went out, mapped into this node's clock (us).
+         * @param boundUs Bound on its error: the clock mapping's plus the peer's timestamp's (us).
+         */
+        void addEmission(uint16_t triggerId, int64_t emittedAt, uint32_t boundUs);
+
+        /**
+         * Range an arrival of a trigger's burst.
+         * @param arrivalAt When the burst arrived, in this node's clock (us).
+         * @param arrivalBoundUs Bound on the arrival time's error (us).
+         * @param result Given the range when ranged.
+         */
+        RangeStatus range(uint16_t triggerId, int64_t arrivalAt, uint32_t arrivalBoundUs, RANGE_RESULT *result);
+
+        /**
+         * Count an arrival whose emission never came.
+         */
+        void recordUnmatched() { stats.unmatched++; }
+
+        /**
+         * Set the fixed delay between the emission and arrival timestamps that isn't flight,
+         * such as the receiver's detection of the burst. Calibrated on the bench.
+         */
+        void setLatency(int32_t us) { latencyUs = us; }
+
+        /**
+         * Forget every emission, for instance after the peer restarts.
+         */
+        void reset();
+
+        RANGE_STATS getStats() const { return stats; }
+};
+
+#endif /* ONE_WAY_RANGER_H */
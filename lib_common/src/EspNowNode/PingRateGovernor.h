@@ -0,0 +1,167 @@
+#ifndef PING_RATE_GOVERNOR_H
+#define PING_RATE_GOVERNOR_H
+
+#include <stdint.h>
+
+#define GOVERNOR_STATIC_RANGE_SPEED 2.0f    // Range speed below which the target counts as still (in/s).
+#define GOVERNOR_FAST_RANGE_SPEED 24.0f     // Range speed that earns the fastest ping rate (in/s).
+#define GOVERNOR_STATIC_BEARING_RATE 5.0f   // Bearing rate below which the target counts as still (deg/s).
+#define GOVERNOR_FAST_BEARING_RATE 45.0f    // Bearing rate that earns the fastest ping rate (deg/s).
+#define GOVERNOR_SMOOTHING 0.25f            // Weight of each new motion observation.
+#define GOVERNOR_STALE_US 2000000           // Observations further apart than this restart the estimate (us).
+
+/**
+ * Why a ping was sent.
+ */
+enum _ping_mode : uint8_t {
+    ping_KEEPALIVE = 0,     // Target still. Pinging at the slowest rate to keep the link alive.
+    ping_TRACKING,          // Target moving. Pinging faster the faster it moves.
+    ping_PULL,              // The receiver asked for a ping.
+    ping_COUNT
+};
+typedef enum _ping_mode PingMode;
+
+struct _ping_rate_stats {
+    uint32_t pings[ping_COUNT];         // Pings sent per mode.
+    float rate[ping_COUNT];             // Achieved ping rate per mode, over the time spent in it (Hz).
+    uint32_t pullRequests;              // Pings asked for by the receiver.
+    uint32_t interval;                  // Current spacing between pings (in microseconds).
+    float rangeSpeed;                   // Smoothed speed of the target along the range (in/s).
+    float bearingRate;                  // Smoothed rate of change of the bearing (deg/s).
+};
+typedef struct _ping_rate_stats PING_RATE_STATS;
+
+/**
+ * Paces the transmitter's pings by how fast the target is moving. A still target is pinged
+ * at a slow keep-alive rate; a moving one up to the fastest rate the trigger schedule allows.
+ * The receiver can also pull a ping at any time. Not thread safe.
+ */
+class PingRateGovernor {
+    private:
+        uint32_t minInterval;               // Spacing between pings of a fast target (us).
+        uint32_t maxInterval;               // Spacing between keep-alive pings (us).
+
+        float rangeSpeed = 0;
+        float bearingRate = 0;
+        int64_t lastRangeTime = 0;
+        float lastRange = 0;
+        bool hasRange = false;
+        int64_t lastBearingTime = 0;
+        float lastBearing = 0;
+        bool hasBearing = false;
+
+        bool pullPending = false;           // Has the receiver asked for a ping.
+        int64_t lastPing = 0;               // When the last ping was sent (us).
+        bool hasPinged = false;
+
+        uint32_t pings[ping_COUNT] = {0};
+        int64_t timeInMode[ping_COUNT] = {0};
+        uint32_t pullRequests = 0;
+
+        /**
+         * Fold a new speed into a smoothed one.
+         */
+        static void smooth(float *smoothed, float latest) { *smoothed += (latest - *smoothed) * GOVERNOR_SMOOTHING; }
+
+        /**
+         * Target motion as a fraction of what earns the fastest rate. Zero when still.
+         */
+        float motion() const {
+            float range = (rangeSpeed < GOVERNOR_STATIC_RANGE_SPEED) ? 0 : rangeSpeed / GOVERNOR_FAST_RANGE_SPEED;
+            float bearing = (bearingRate < GOVERNOR_STATIC_BEARING_RATE) ? 0 : bearingRate / GOVERNOR_FAST_BEARING_RATE;
+            float res = (range > bearing) ? range : bearing;
+            return (res > 1) ? 1 : res;
+        }
+
+    public:
+        PingRateGovernor(uint32_t minIntervalUs = 0, uint32_t maxIntervalUs = 0) { setLimits(minIntervalUs, maxIntervalUs); }
+
+        /**
+         * Set the fastest and slowest spacing between pings (us).
+         */
+        void setLimits(uint32_t minIntervalUs, uint32_t maxIntervalUs) {
+            minInterval = minIntervalUs;
+            maxInterval = (maxIntervalUs > minIntervalUs) ? maxIntervalUs : minIntervalUs;
+        }
+
+        /**
+         * Fold in a range to the target (inches) measured at a time (us).
+         */
+        void observeRange(int64_t time, float range) {
+            if(hasRange && time > lastRangeTime && time - lastRangeTime < GOVERNOR_STALE_US) {
+                float speed = (range - lastRange) * 1e6f / (float) (time - lastRangeTime);
+                smooth(&rangeSpeed, speed < 0 ? -speed : speed);
+            }
+            lastRangeTime = time;
+            lastRange = range;
+            hasRange = true;
+        }
+
+        /**
+         * Fold in a bearing to the target (degrees) measured at a time (us).
+         */
+        void observeBearing(int64_t time, float bearing) {
+            if(hasBearing && time > lastBearingTime && time - lastBearingTime < GOVERNOR_STALE_US) {
+                float rate = (bearing - lastBearing) * 1e6f / (float) (time - lastBearingTime);
+                smooth(&bearingRate, rate < 0 ? -rate : rate);
+            }
+            lastBearingTime = time;
+            lastBearing = bearing;
+            hasBearing = true;
+        }
+
+        /**
+         * The receiver asked for a ping. The next one goes out without waiting.
+         */
+        void requestPull() {
+            pullPending = true;
+            pullRequests++;
+        }
+
+        /**
+         * Spacing between pings for the target's current motion (us).
+         */
+        uint32_t interval() const {
+            return maxInterval - (uint32_t) ((maxInterval - minInterval) * motion());
+        }
+
+        /**
+         * When the next ping is due (us).
+         */
+        int64_t nextPingAt() const {
+            if(pullPending || !hasPinged) return lastPing;
+            return lastPing + interval();
+        }
+
+        /**
+         * Is a ping due at this time.
+         */
+        bool shouldPing(int64_t now) const { return pullPending || !hasPinged || now >= nextPingAt(); }
+
+        /**
+         * Record a ping sent at a time (us), crediting it to the mode that earned it.
+         * @return The mode it was credited to.
+         */
+        PingMode recordPing(int64_t now) {
+            PingMode mode = pullPending ? ping_PULL : (interval() >= maxInterval) ? ping_KEEPALIVE : ping_TRACKING;
+            if(hasPinged) timeInMode[mode] += now - lastPing;
+            pings[mode]++;
+            pullPending = false;
+            lastPing = now;
+            hasPinged = true;
+            return mode;
+        }
+
+        void snapshot(PING_RATE_STATS *out) const {
+            for(int i = 0; i < ping_COUNT; i++) {
+                out->pings[i] = pings[i];
+                out->rate[i] = (timeInMode[i] > 0) ? pings[i] * 1e6f / (float) timeInMode[i] : 0;
+            }
+            out->pullRequests = pullRequests;
+            out->interval = interval();
+            out->rangeSpeed = rangeSpeed;
+            out->bearingRate = bearingRate;
+        }
+};
+
+#endif /* PING_RATE_GOVERNOR_H */
@@ -0,0 +1,138 @@
+#ifndef PROTOCOL_STATE_MACHINE_H
+#define PROTOCOL_STATE_MACHINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "EspNowPacket.h"
+
+/**
+ * States of the link as seen by one node. A node that has just started always announces
+ * itself with a handshake first, whatever it heard, so the peer knows to restart its
+ * sequence numbering and clock sync.
+ */
+enum _protocol_state : uint8_t {
+    st_IDLE = 0,            // Nothing sent or heard yet.
+    st_ANNOUNCE_HANDSHAKE,  // Heard a handshake, but has yet to announce itself.
+    st_ANNOUNCE_PING,       // Heard a ping, but has yet to announce itself.
+    st_CONNECTED,           // Handshake heard. Pings follow.
+    st_PINGING,             // Trading pings.
+    st_CLOSING,             // Wave heard. Answer it, then pause.
+    st_CLOSED,              // Wave answered. The node is paused.
+    st_COUNT
+};
+typedef enum _protocol_state ProtocolState;
+
+enum _protocol_event : uint8_t {
+    ev_RX_HANDSHAKE = 0,    // Handshake accepted from the peer.
+    ev_RX_PING,             // Ping accepted from the peer.
+    ev_RX_WAVE,             // Wave accepted from the peer.
+    ev_RX_OTHER,            // Frame with a header the protocol doesn't act on.
+    ev_FRAME_BUILT,         // This node built its next frame.
+    ev_COUNT
+};
+typedef enum _protocol_event ProtocolEvent;
+
+enum _protocol_action : uint8_t {
+    act_NONE = 0,           // Nothing to do.
+    act_PAUSE,              // Pause the node's transmission and reception.
+    act_COUNT
+};
+typedef enum _protocol_action ProtocolAction;
+
+/**
+ * What a node in a state sends next, and what it does on entering and leaving the state.
+ */
+struct _protocol_state_info {
+    Header header;          // Header of the next frame sent.
+    AckMessage ack;         // Ack of the next frame sent.
+    ProtocolAction entry;   // Run on entering the state.
+    ProtocolAction exit;    // Run on leaving the state.
+};
+typedef struct _protocol_state_info PROTOCOL_STATE_INFO;
+
+typedef void (* ProtocolActionCallback)(ProtocolAction action, void *context);
+
+/**
+ * Explicit state machine for the handshake/ping/wave protocol. The behaviour lives in two
+ * constant tables, one row per state, so dispatch is a pair of array lookups and adding a
+ * state means adding rows rather than branches. Not thread safe.
+ */
+class ProtocolStateMachine {
+    public:
+        static constexpr PROTOCOL_STATE_INFO states[st_COUNT] = {
+            /* st_IDLE               */ { Header::HANDSHAKE,    AckMessage::Received_Handshake, act_NONE,  act_NONE },
+            /* st_ANNOUNCE_HANDSHAKE */ { Header::HANDSHAKE,    AckMessage::Received_Handshake, act_NONE,  act_NONE },
+            /* st_ANNOUNCE_PING      */ { Header::HANDSHAKE,    AckMessage::Received_Ping,      act_NONE,  act_NONE },
+            /* st_CONNECTED          */ { Header::TRIGGER_PING, AckMessage::Received_Handshake, act_NONE,  act_NONE },
+            /* st_PINGING            */ { Header::TRIGGER_PING, AckMessage::Received_Ping,      act_NONE,  act_NONE },
+            /* st_CLOSING            */ { Header::HANDSHAKE,    AckMessage::Received_Wave,      act_NONE,  act_NONE },
+            /* st_CLOSED             */ { Header::HANDSHAKE,    AckMessage::Received_Wave,      act_PAUSE, act_NONE }
+        };
+
+        static constexpr ProtocolState transitions[st_COUNT][ev_COUNT] = {
+            //                            ev_RX_HANDSHAKE        ev_RX_PING        ev_RX_WAVE  ev_RX_OTHER            ev_FRAME_BUILT
+            /* st_IDLE               */ { st_ANNOUNCE_HANDSHAKE, st_ANNOUNCE_PING, st_CLOSING, st_IDLE,               st_CONNECTED },
+            /* st_ANNOUNCE_HANDSHAKE */ { st_ANNOUNCE_HANDSHAKE, st_ANNOUNCE_PING, st_CLOSING, st_ANNOUNCE_HANDSHAKE, st_CONNECTED },
+            /* st_ANNOUNCE_PING      */ { st_ANNOUNCE_HANDSHAKE, st_ANNOUNCE_PING, st_CLOSING, st_ANNOUNCE_PING,      st_PINGING },
+            /* st_CONNECTED          */ { st_CONNECTED,          st_PINGING,       st_CLOSING, st_CONNECTED,          st_CONNECTED },
+            /* st_PINGING            */ { st_CONNECTED,          st_PINGING,       st_CLOSING, st_PINGING,            st_PINGING },
+            /* st_CLOSING            */ { st_CONNECTED,          st_PINGING,       st_CLOSING, st_CLOSING,            st_CLOSED },
+            /* st_CLOSED             */ { st_CONNECTED,          st_PINGING,       st_CLOSING, st_CLOSED,             st_CLOSED }
+        };
+
+        static_assert(sizeof(states) / sizeof(states[0]) == st_COUNT, "Every state needs a row in `states`.");
+        static_assert(sizeof(transitions) / sizeof(transitions[0]) == st_COUNT, "Every state needs a row in `transitions`.");
+
+        /**
+         * Event raised by accepting a frame with the given header.
+         */
+        static constexpr ProtocolEvent eventFor(Header header) {
+            return (header == Header::HANDSHAKE) ? ev_RX_HANDSHAKE :
+                   (header == Header::TRIGGER_PING) ? ev_RX_PING :
+                   (header == Header::WAVE) ? ev_RX_WAVE : ev_RX_OTHER;
+        }
+
+    private:
+        ProtocolState state = st_IDLE;
+        ProtocolActionCallback actionCallback = NULL;
+        void *actionContext = NULL;
+
+        void run(ProtocolAction action) {
+            if(action != act_NONE && actionCallback != NULL) actionCallback(action, actionContext);
+        }
+
+    public:
+        /**
+         * Set who carries out the entry and exit actions.
+         */
+        void setActionCallback(ProtocolActionCallback callback, void *context) {
+            actionCallback = callback;
+            actionContext = context;
+        }
+
+        /**
+         * Feed an event through the table. Exit and entry actions only run when the state changes.
+         * @return The new state.
+         */
+        ProtocolState dispatch(ProtocolEvent event) {
+            if(event >= ev_COUNT) return state;
+            ProtocolState next = transitions[state][event];
+            if(next != state) {
+                run(states[state].exit);
+                state = next;
+                run(states[state].entry);
+            }
+            return state;
+        }
+
+        /**
+         * Return to the state of a node that has just started. Runs no actions.
+         */
+        void reset() { state = st_IDLE; }
+
+        ProtocolState getState() const { return state; }
+        Header nextHeader() const { return states[state].header; }
+        AckMessage nextAck() const { return states[state].ack; }
+};
+
+#endif /* PROTOCOL_STATE_MACHINE_H */
@@ -0,0 +1,67 @@
+#ifndef RTT_ESTIMATOR_H
+#define RTT_ESTIMATOR_H
+
+#include <stdint.h>
+
+#define RTO_INITIAL_US 250000       // Retransmit timeout used before any round trip has been measured (us).
+#define RTO_MIN_US 10000            // Smallest retransmit timeout allowed (us).
+#define RTO_MAX_US 10000000         // Largest retransmit timeout allowed (us).
+#define RTO_MAX_BACKOFF 6           // Most times the timeout is doubled after consecutive timeouts.
+
+/**
+ * Smoothed round trip time and retransmit timeout estimator (Jacobson/Karels, RFC 6298).
+ */
+class RttEstimator {
+    private:
+        int32_t srtt = 0;           // Smoothed round trip time (us).
+        int32_t rttvar = 0;         // Round trip time variation (us).
+        bool hasSample = false;     // Has a round trip been measured yet.
+        uint8_t backoffShift = 0;   // Number of times the timeout has been doubled.
+
+    public:
+        /**
+         * Fold in a round trip measured on a frame that was not retransmitted (Karn's rule).
+         * @param rttUs Round trip time (us).
+         */
+        void sample(uint32_t rttUs) {
+            int32_t rtt = (int32_t) rttUs;
+            if(!hasSample) {
+                srtt = rtt;
+                rttvar = rtt / 2;
+                hasSample = true;
+            }
+            else {
+                int32_t err = rtt - srtt;
+                srtt += err / 8;
+                rttvar += ((err < 0 ? -err : err) - rttvar) / 4;
+            }
+            backoffShift = 0;
+        }
+
+        /**
+         * Double the timeout after a retransmission went unanswered.
+         */
+        void backoff() { if(backoffShift < RTO_MAX_BACKOFF) backoffShift++; }
+
+        /**
+         * Drop any backoff once the exchange makes progress again.
+         */
+        void resetBackoff() { backoffShift = 0; }
+
+        /**
+         * Current retransmit timeout (us).
+         */
+        uint32_t timeout() const {
+            int64_t rto = hasSample ? (int64_t) srtt + 4 * (int64_t) rttvar : RTO_INITIAL_US;
+            if(rto < RTO_MIN_US) rto = RTO_MIN_US;
+            rto <<= backoffShift;
+            if(rto > RTO_MAX_US) rto = RTO_MAX_US;
+            return (uint32_t) rto;
+        }
+
+        uint32_t getSmoothedRtt() const { return (uint32_t) srtt; }
+        uint32_t getRttVariation() const { return (uint32_t) rttvar; }
+        bool hasMeasurement() const { return hasSample; }
+};
+
+#endif /* RTT_ESTIMATOR_H */
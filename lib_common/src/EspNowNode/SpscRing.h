@@ -0,0 +1,100 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+struct _ring_stats {
+    uint32_t pushed;        // Items accepted by the ring.
+    uint32_t dropped;       // Items rejected because the ring was full.
+    uint32_t highWater;     // Most items ever waiting at once.
+};
+typedef struct _ring_stats RingStats;
+
+/**
+ * Bounded, lock-free ring shared by exactly one producer and one consumer.
+ * The producer fills a slot in place with `reserve()`/`commit()` and the consumer
+ * reads it in place with `front()`/`pop()`, so no item is ever copied by the ring.
+ * @tparam T Type of the items held.
+ * @tparam Capacity Number of slots. Must be a power of two.
+ */
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two.");
+
+    private:
+        T slots[Capacity];
+        std::atomic<size_t> head{0};        // Next slot the producer fills. Written by the producer only.
+        std::atomic<size_t> tail{0};        // Next slot the consumer reads. Written by the consumer only.
+
+        // Counters are written by the producer only.
+        std::atomic<uint32_t> pushed{0};
+        std::atomic<uint32_t> dropped{0};
+        std::atomic<uint32_t> highWater{0};
+
+    public:
+        /**
+         * Producer side. Grab the next free slot to fill.
+         * @return The slot, or NULL if the ring is full (the drop is counted).
+         */
+        T *reserve() {
+            size_t h = head.load(std::memory_order_relaxed);
+            if(h - tail.load(std::memory_order_acquire) >= Capacity) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return NULL;
+            }
+            return &slots[h & (Capacity - 1)];
+        }
+
+        /**
+         * Producer side. Publish the slot last returned by `reserve()`.
+         */
+        void commit() {
+            size_t h = head.load(std::memory_order_relaxed) + 1;
+            head.store(h, std::memory_order_release);
+            pushed.fetch_add(1, std::memory_order_relaxed);
+
+            uint32_t depth = (uint32_t) (h - tail.load(std::memory_order_relaxed));
+            if(depth > highWater.load(std::memory_order_relaxed)) highWater.store(depth, std::memory_order_relaxed);
+        }
+
+        /**
+         * Consumer side. Peek at the oldest item.
+         * @return The item, or NULL if the ring is empty.
+         */
+        T *front() {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if(t == head.load(std::memory_order_acquire)) return NULL;
+            return &slots[t & (Capacity - 1)];
+        }
+
+        /**
+         * Consumer side. Release the item last returned by `front()`.
+         */
+        void pop() {
+            tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * Number of items currently waiting. Exact only when called from either side.
+         */
+        size_t size() {
+            return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+        }
+
+        /**
+         * Snapshot of the ring's counters.
+         */
+        RingStats stats() {
+            RingStats res;
+            res.pushed = pushed.load(std::memory_order_relaxed);
+            res.dropped = dropped.load(std::memory_order_relaxed);
+            res.highWater = highWater.load(std::memory_order_relaxed);
+            return res;
+        }
+
+        static constexpr size_t capacity() { return Capacity; }
+};
+
+#endif /* SPSC_RING_H */
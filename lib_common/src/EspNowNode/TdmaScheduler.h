@@ -0,0 +1,84 @@
+#ifndef TDMA_SCHEDULER_H
+#define TDMA_SCHEDULER_H
+
+#include <stdint.h>
+#include "../HCSR04/EchoDecoder.h"
+
+#define TDMA_MAX_SLOTS 8                // Most slots (and so peers) in a cycle.
+#define TDMA_DEFAULT_SLOT_US 100000     // Default length of a slot (us).
+#define TDMA_TRIGGER_LEAD_US 40000      // Default lead of scheduled triggers: the belt's trigger delay of TTR_US (us).
+#define TDMA_DEFAULT_GUARD_US (TDMA_TRIGGER_LEAD_US + ECHO_MAX_US)  // Default tail of a slot in which no new exchange starts (us).
+
+/**
+ * Time-division schedule shared by the sessions of one node. The cycle is split into equal
+ * slots, one per peer, and a session only starts exchanges during the open part of its own
+ * slot. The guard at the end of each slot must cover the trigger lead plus the echo read
+ * window, so the acoustic traffic of one pair dies down before the next pair's slot opens.
+ * All times are in the owning node's clock.
+ */
+class TdmaScheduler {
+    private:
+        uint32_t slotLength;            // Length of each slot (us).
+        uint32_t guard;                 // Closed tail of each slot (us).
+        uint8_t slots = 0;              // Slots handed out.
+        int64_t epoch = 0;              // Local time the first cycle began (us).
+
+        /**
+         * Position of a time within the cycle (us).
+         */
+        int64_t cyclePosition(int64_t now) const {
+            int64_t cycle = getCycleLength();
+            int64_t pos = (now - epoch) % cycle;
+            return (pos < 0) ? pos + cycle : pos;
+        }
+
+    public:
+        TdmaScheduler(
+                uint32_t slotUs = TDMA_DEFAULT_SLOT_US,     // Length of each slot (us).
+                uint32_t guardUs = TDMA_DEFAULT_GUARD_US    // Closed tail of each slot (us). Must be shorter than the slot.
+            ) {
+            slotLength = (slotUs > 0) ? slotUs : 1;
+            guard = (guardUs < slotLength) ? guardUs : slotLength - 1;
+        }
+
+        /**
+         * Hand out the next slot. Slots should be handed out before the sessions start, as
+         * adding one lengthens the cycle.
+         * @return Index of the slot, or -1 if every slot is taken.
+         */
+        int addSlot() {
+            if(slots >= TDMA_MAX_SLOTS) return -1;
+            return slots++;
+        }
+
+        /**
+         * Start the first cycle at the given time (us).
+         */
+        void setEpoch(int64_t time) { epoch = time; }
+
+        /**
+         * May a session start an exchange in its slot at this time.
+         */
+        bool isOpen(uint8_t slot, int64_t now) const {
+            if(slots == 0) return true;
+            int64_t start = (int64_t) slot * slotLength;
+            int64_t pos = cyclePosition(now);
+            return pos >= start && pos < start + (slotLength - guard);
+        }
+
+        /**
+         * Earliest time at or after `now` the slot is open (us).
+         */
+        int64_t nextOpen(uint8_t slot, int64_t now) const {
+            if(isOpen(slot, now)) return now;
+            int64_t start = now - cyclePosition(now) + (int64_t) slot * slotLength;
+            return (start > now) ? start : start + getCycleLength();
+        }
+
+        int64_t getCycleLength() const { return (int64_t) slotLength * (slots > 0 ? slots : 1); }
+        uint32_t getSlotLength() const { return slotLength; }
+        uint32_t getGuard() const { return guard; }
+        uint8_t getSlotCount() const { return slots; }
+};
+
+#endif /* TDMA_SCHEDULER_H */
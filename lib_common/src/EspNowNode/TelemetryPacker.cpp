@@ -0,0 +1,89 @@
+#include "TelemetryPacker.h"
+#include <string.h>
+
+void TelemetryPacker::setFlushPolicy(uint8_t samples, uint32_t deadlineUs) {
+    flushSamples = (samples > 0) ? samples : 1;
+    flushDeadline = deadlineUs;
+}
+
+bool TelemetryPacker::push(int64_t time, const TELEMETRY_SAMPLE &sample) {
+    bool res = true;
+
+    // Make room by dropping the oldest sample.
+    if(count == TELEMETRY_BUFFER_SAMPLES) {
+        head = (head + 1) % TELEMETRY_BUFFER_SAMPLES;
+        count--;
+        dropped++;
+        res = false;
+    }
+
+    int slot = (head + count) % TELEMETRY_BUFFER_SAMPLES;
+    if(count > 0) {
+        int64_t last = buffer[(slot + TELEMETRY_BUFFER_SAMPLES - 1) % TELEMETRY_BUFFER_SAMPLES].time;
+        if(time < last) time = last;
+    }
+    buffer[slot].time = time;
+    buffer[slot].sample = sample;
+    count++;
+    return res;
+}
+
+bool TelemetryPacker::shouldFlush(int64_t now) const {
+    if(count == 0) return false;
+    return count >= flushSamples || (now - buffer[head].time) >= (int64_t) flushDeadline;
+}
+
+uint8_t TelemetryPacker::writeBatch(ESP_NOW_PACKET *packet, uint8_t maxPayload) {
+    // Work out how many samples fit in what is left of the payload.
+    size_t limit = (maxPayload < ESPNOW_PAYLOAD_SIZE) ? maxPayload : ESPNOW_PAYLOAD_SIZE;
+    if(packet->payloadLength >= limit) return 0;
+    size_t room = limit - packet->payloadLength;
+    if(count == 0 || room < ESPNOW_RECORD_HEADER_SIZE + sizeof(TELEMETRY_BATCH_HEADER) + sizeof(TELEMETRY_SAMPLE)) return 0;
+    size_t fit = (room - ESPNOW_RECORD_HEADER_SIZE - sizeof(TELEMETRY_BATCH_HEADER)) / sizeof(TELEMETRY_SAMPLE);
+    if(fit > TELEMETRY_MAX_BATCH) fit = TELEMETRY_MAX_BATCH;
+    uint8_t n = (count < (int) fit) ? count : fit;
+
+    // Write the record in place: [type][len][batch header][samples].
+    uint8_t *rec = &packet->payload[packet->payloadLength];
+    uint8_t len = sizeof(TELEMETRY_BATCH_HEADER) + n * sizeof(TELEMETRY_SAMPLE);
+    rec[0] = RecordType::rec_TELEMETRY;
+    rec[1] = len;
+
+    TELEMETRY_BATCH_HEADER batch;
+    batch.baseTime = buffer[head].time;
+    batch.count = n;
+    memcpy(&rec[ESPNOW_RECORD_HEADER_SIZE], &batch, sizeof(batch));
+
+    uint8_t *out = &rec[ESPNOW_RECORD_HEADER_SIZE + sizeof(batch)];
+    for(uint8_t i = 0; i < n; i++) {
+        TELEMETRY_SAMPLE sample = buffer[head].sample;
+        sample.timeOffset = (uint32_t) (buffer[head].time - (int64_t) batch.baseTime);
+        memcpy(out, &sample, sizeof(sample));
+        out += sizeof(sample);
+        head = (head + 1) % TELEMETRY_BUFFER_SAMPLES;
+        count--;
+    }
+
+    packet->payloadLength += ESPNOW_RECORD_HEADER_SIZE + len;
+    batches++;
+    packed += n;
+    return n;
+}
+
+uint8_t TelemetryPacker::readBatch(const ESP_NOW_PACKET *packet, int64_t *baseTime, TELEMETRY_SAMPLE *out, uint8_t maxOut) {
+    uint8_t len = 0;
+    const uint8_t *rec = findRecord(packet, RecordType::rec_TELEMETRY, &len);
+    if(rec == NULL || len < sizeof(TELEMETRY_BATCH_HEADER)) return 0;
+
+    // Trust the record's length over its count.
+    TELEMETRY_BATCH_HEADER batch;
+    memcpy(&batch, rec, sizeof(batch));
+    size_t available = (len - sizeof(batch)) / sizeof(TELEMETRY_SAMPLE);
+    uint8_t n = batch.count;
+    if(n > available) n = available;
+    if(n > maxOut) n = maxOut;
+
+    *baseTime = (int64_t) batch.baseTime;
+    memcpy(out, rec + sizeof(batch), n * sizeof(TELEMETRY_SAMPLE));
+    return n;
+}
@@ -0,0 +1,100 @@
+#ifndef TELEMETRY_PACKER_H
+#define TELEMETRY_PACKER_H
+
+#include <stdint.h>
+#include "EspNowPacket.h"
+
+#define TELEMETRY_BUFFER_SAMPLES 32         // Samples held while waiting to be flushed. The oldest is dropped when full.
+#define TELEMETRY_FLUSH_SAMPLES 8           // Default number of samples that triggers a flush.
+#define TELEMETRY_FLUSH_DEADLINE_US 200000  // Default age of the oldest sample that triggers a flush (us).
+#define TELEMETRY_NO_VALUE INT16_MIN        // Marks a sample field that was not measured.
+
+/**
+ * A single timestamped telemetry sample, as laid out on the wire.
+ */
+struct __attribute__((packed)) _telemetry_sample {
+    uint32_t timeOffset;        // Time since the batch's base time (us).
+    int16_t leftDistance;       // Left receiver distance (hundredths of an inch).
+    int16_t rightDistance;      // Right receiver distance (hundredths of an inch).
+    int16_t bearing;            // Bearing to the target (hundredths of a degree).
+    int8_t leftMotor;           // Left drive command (-100 to 100 %).
+    int8_t rightMotor;          // Right drive command (-100 to 100 %).
+    uint8_t obstacleFlags;      // HCSR04 obstacle (bit 0) and presence (bit 1) flags, left sensor in the low nibble, right in the high.
+};
+typedef struct _telemetry_sample TELEMETRY_SAMPLE;
+
+/**
+ * Header of a rec_TELEMETRY record. `count` samples follow it.
+ */
+struct __attribute__((packed)) _telemetry_batch_header {
+    uint64_t baseTime;          // Time of the first sample, in the sender's clock (us).
+    uint8_t count;              // Number of samples in the batch.
+};
+typedef struct _telemetry_batch_header TELEMETRY_BATCH_HEADER;
+
+#define TELEMETRY_MAX_BATCH ((255 - sizeof(TELEMETRY_BATCH_HEADER)) / sizeof(TELEMETRY_SAMPLE))    // Samples that fit in one record.
+
+/**
+ * Collects telemetry samples and packs as many as fit into a frame's payload once
+ * enough have accumulated or the oldest has waited too long. Not thread safe.
+ */
+class TelemetryPacker {
+    private:
+        struct {
+            int64_t time;
+            TELEMETRY_SAMPLE sample;
+        } buffer[TELEMETRY_BUFFER_SAMPLES];
+        int head = 0;                   // Oldest sample held.
+        int count = 0;                  // Samples held.
+
+        uint8_t flushSamples = TELEMETRY_FLUSH_SAMPLES;
+        uint32_t flushDeadline = TELEMETRY_FLUSH_DEADLINE_US;
+
+        uint32_t dropped = 0;           // Samples overwritten before being sent.
+        uint32_t batches = 0;           // Batches packed.
+        uint32_t packed = 0;            // Samples packed.
+
+    public:
+        /**
+         * Set when a flush is due.
+         * @param samples Flush once this many samples are held.
+         * @param deadlineUs Flush once the oldest sample is this old (us).
+         */
+        void setFlushPolicy(uint8_t samples, uint32_t deadlineUs);
+
+        /**
+         * Queue a sample. The sample's timeOffset is filled in when packed.
+         * @param time When the sample was taken (us). A time before the last sample's is taken
+         * as the last sample's, as a batch's offsets can't go back.
+         * @return False if the oldest sample had to be dropped to make room.
+         */
+        bool push(int64_t time, const TELEMETRY_SAMPLE &sample);
+
+        /**
+         * Is a flush due at the given time.
+         */
+        bool shouldFlush(int64_t now) const;
+
+        /**
+         * Append a rec_TELEMETRY record holding as many queued samples as fit in the packet.
+         * @param maxPayload Payload the peer accepts (bytes).
+         * @return Number of samples packed.
+         */
+        uint8_t writeBatch(ESP_NOW_PACKET *packet, uint8_t maxPayload = ESPNOW_PAYLOAD_SIZE);
+
+        /**
+         * Unpack the telemetry record of a received packet.
+         * @param baseTime Set to the batch's base time, in the sender's clock (us).
+         * @param out Destination of the samples.
+         * @param maxOut Room in `out`.
+         * @return Number of samples unpacked.
+         */
+        static uint8_t readBatch(const ESP_NOW_PACKET *packet, int64_t *baseTime, TELEMETRY_SAMPLE *out, uint8_t maxOut);
+
+        int size() const { return count; }
+        uint32_t getDroppedCount() const { return dropped; }
+        uint32_t getBatchCount() const { return batches; }
+        uint32_t getPackedCount() const { return packed; }
+};
+
+#endif /* TELEMETRY_PACKER_H */
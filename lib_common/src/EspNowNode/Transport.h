@@ -0,0 +1,82 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Airtime.h"
+
+#define TRANSPORT_NO_RSSI -128      // RSSI reported by transports that can't measure it (dBm).
+
+/**
+ * Receives the events of a transport. Implemented by the node running the protocol.
+ */
+class TransportListener {
+    public:
+        virtual ~TransportListener() {}
+
+        /**
+         * A frame arrived from the peer. `data` is only valid for the duration of the call.
+         * @param rssi Signal strength of the frame (dBm), or TRANSPORT_NO_RSSI.
+         */
+        virtual void onReceive(const uint8_t *data, size_t len, int8_t rssi) = 0;
+
+        /**
+         * The transport is done with the last frame handed to `send`.
+         * @param success Did the frame reach the peer, as far as the transport can tell.
+         */
+        virtual void onSent(bool success) = 0;
+};
+
+/**
+ * A point-to-point link to a single peer that moves whole frames.
+ * EspNowNode runs its protocol over this interface, so the same state machine can ride on
+ * ESP-NOW, on a loopback pair within one process or on a UDP socket.
+ */
+class Transport {
+    protected:
+        TransportListener *listener = NULL;     // Receiver of this transport's events.
+        PhyRate rate = phy_DSSS_1M;             // PHY rate frames go to the peer at.
+
+    public:
+        virtual ~Transport() {}
+
+        /**
+         * Set who receives this transport's events. Must be set before `begin`.
+         */
+        void setListener(TransportListener *listener) { this->listener = listener; }
+
+        /**
+         * Bring the link up.
+         * @return True if the link is ready to send.
+         */
+        virtual bool begin() = 0;
+
+        /**
+         * Take the link down.
+         */
+        virtual void end() = 0;
+
+        /**
+         * Hand a frame to the link. `onSent` follows once the link is done with it.
+         * @return True if the frame was accepted for sending.
+         */
+        virtual bool send(const uint8_t *data, size_t len) = 0;
+
+        /**
+         * Re-establish the link to the peer after a failure. Defaults to doing nothing.
+         */
+        virtual bool reset() { return true; }
+
+        /**
+         * Set the PHY rate frames go to the peer at. Transports without a radio only record it.
+         * @return True if the rate was applied.
+         */
+        virtual bool setRate(PhyRate rate) {
+            this->rate = rate;
+            return true;
+        }
+
+        PhyRate getRate() const { return rate; }
+};
+
+#endif /* TRANSPORT_H */
@@ -0,0 +1,71 @@
+#include "UdpTransport.h"
+
+#if !defined(ARDUINO)
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+UdpTransport::UdpTransport(uint16_t localPort, const char *peerHost, uint16_t peerPort) {
+    this->localPort = localPort;
+    memset(&peerAddress, 0, sizeof(peerAddress));
+    peerAddress.sin_family = AF_INET;
+    peerAddress.sin_port = htons(peerPort);
+    peerValid = inet_pton(AF_INET, peerHost, &peerAddress.sin_addr) == 1;
+}
+
+bool UdpTransport::begin() {
+    if(!peerValid) return false;
+    if(sock >= 0) return true;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if(sock < 0) return false;
+
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(localPort);
+    if(bind(sock, (struct sockaddr *) &local, sizeof(local)) != 0) {
+        end();
+        return false;
+    }
+    return true;
+}
+
+void UdpTransport::end() {
+    if(sock < 0) return;
+    close(sock);
+    sock = -1;
+}
+
+bool UdpTransport::send(const uint8_t *data, size_t len) {
+    if(sock < 0) return false;
+    ssize_t sent = sendto(sock, data, len, 0, (struct sockaddr *) &peerAddress, sizeof(peerAddress));
+    if(sent != (ssize_t) len) return false;
+
+    if(listener != NULL) listener->onSent(true);
+    return true;
+}
+
+bool UdpTransport::poll(int timeoutMs) {
+    if(sock < 0) return false;
+
+    struct pollfd fd = { sock, POLLIN, 0 };
+    if(::poll(&fd, 1, timeoutMs) <= 0 || !(fd.revents & POLLIN)) return false;
+
+    // Only frames from the configured peer count.
+    uint8_t buffer[UDP_TRANSPORT_MAX_DATAGRAM];
+    struct sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    ssize_t len = recvfrom(sock, buffer, sizeof(buffer), 0, (struct sockaddr *) &from, &fromLen);
+    if(len <= 0) return false;
+    if(from.sin_addr.s_addr != peerAddress.sin_addr.s_addr || from.sin_port != peerAddress.sin_port) return false;
+
+    if(listener != NULL) listener->onReceive(buffer, (size_t) len, TRANSPORT_NO_RSSI);
+    return true;
+}
+
+#endif /* !defined(ARDUINO) */
@@ -0,0 +1,46 @@
+#ifndef UDP_TRANSPORT_H
+#define UDP_TRANSPORT_H
+
+// Host-only backend for running the protocol between processes on a workstation.
+#if !defined(ARDUINO)
+
+#include <netinet/in.h>
+#include "Transport.h"
+
+#define UDP_TRANSPORT_MAX_DATAGRAM 512      // Largest datagram read. Larger than any valid frame, so oversize frames still reach the decoder.
+
+/**
+ * Transport over a UDP socket on Linux. Each frame is one datagram. UDP gives no delivery
+ * report, so `onSent` reports success once the datagram is handed to the kernel.
+ * Frames are only received while `poll` is being called.
+ */
+class UdpTransport : public Transport {
+    private:
+        int sock = -1;                      // Socket bound to the local port.
+        uint16_t localPort;                 // Port frames are received on.
+        struct sockaddr_in peerAddress;     // Where frames are sent.
+        bool peerValid = false;             // Did the peer address parse.
+
+    public:
+        UdpTransport(
+                uint16_t localPort,         // Port to bind and receive on.
+                const char *peerHost,       // Dotted IPv4 address of the peer.
+                uint16_t peerPort           // Port the peer receives on.
+            );
+        ~UdpTransport() { end(); }
+
+        bool begin() override;
+        void end() override;
+        bool send(const uint8_t *data, size_t len) override;
+
+        /**
+         * Wait for a frame and hand it to the listener.
+         * @param timeoutMs How long to wait (ms). Negative waits forever.
+         * @return True if a frame was received.
+         */
+        bool poll(int timeoutMs);
+};
+
+#endif /* !defined(ARDUINO) */
+
+#endif /* UDP_TRANSPORT_H */
@@ -0,0 +1,78 @@
+#ifndef CAPTURE_CLOCK_H
+#define CAPTURE_CLOCK_H
+
+#include <stdint.h>
+
+/**
+ * Maps the timestamps of a free running 32 bit capture counter into esp_timer's clock
+ * (us), through a reference pair: the counter latched at some moment between two reads of
+ * esp_timer. The moment is taken as the middle of the two reads, so the mapping's error is
+ * half their spread, plus the rounding of a tick to a microsecond and any latency the
+ * timestamps carry. The counter and esp_timer run off the same crystal, so the mapping
+ * doesn't drift; it only has to be renewed before the counter wraps past it.
+ */
+class CaptureClock {
+    private:
+        uint32_t resolutionHz = 1000000;    // Ticks per second of the counter.
+        uint32_t latencyUs = 0;             // Latency the timestamps carry that the reference doesn't (us).
+        uint32_t refTicks = 0;              // Counter at the reference (ticks).
+        int64_t refUs = 0;                  // esp_timer at the reference (us).
+        uint32_t refBoundUs = 0;            // Bound on the reference's error (us).
+        bool valid = false;                 // Has a reference been taken.
+
+    public:
+        /**
+         * Set the counter's tick rate, dropping the reference.
+         * @param latencyUs Latency between an edge and its timestamp, such as an interrupt's (us).
+         */
+        void setResolution(uint32_t resolutionHz, uint32_t latencyUs = 0) {
+            this->resolutionHz = (resolutionHz > 0) ? resolutionHz : 1;
+            this->latencyUs = latencyUs;
+            valid = false;
+        }
+
+        /**
+         * Take a reference pair.
+         * @param ticks The counter, latched at some moment between the two reads.
+         * @param before esp_timer read before the counter was latched (us).
+         * @param after esp_timer read after (us).
+         */
+        void setReference(uint32_t ticks, int64_t before, int64_t after) {
+            if(after < before) return;
+            refTicks = ticks;
+            refUs = before + (after - before) / 2;
+            refBoundUs = (uint32_t) ((after - before + 1) / 2);
+            valid = true;
+        }
+
+        /**
+         * Map a timestamp into esp_timer's clock.
+         * @param ticks Timestamp, within half the counter's range of the reference (about 27 s at 80 MHz).
+         * @param us Given the time (us).
+         * @return False if no reference has been taken.
+         */
+        bool toMicros(uint32_t ticks, int64_t *us) const {
+            if(!valid) return false;
+
+            // Signed difference, so timestamps either side of the reference and across the wrap map right.
+            int32_t delta = (int32_t) (ticks - refTicks);
+            *us = refUs + ((int64_t) delta * 1000000) / resolutionHz;
+            return true;
+        }
+
+        /**
+         * Bound on the error of a mapped timestamp (us): the reference's, a microsecond each for
+         * esp_timer's resolution and the rounding of ticks, and the timestamps' latency.
+         */
+        uint32_t boundUs() const { return refBoundUs + 2 + latencyUs; }
+
+        /**
+         * Drop the reference, until the next is taken.
+         */
+        void reset() { valid = false; }
+
+        bool hasReference() const { return valid; }
+        uint32_t getResolution() const { return resolutionHz; }
+};
+
+#endif /* CAPTURE_CLOCK_H */
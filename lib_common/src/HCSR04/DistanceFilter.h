@@ -0,0 +1,171 @@
+#ifndef DISTANCE_FILTER_H
+#define DISTANCE_FILTER_H
+
+#include <stdint.h>
+
+/**
+ * Filter stages for distance readings. Each stage takes one reading at a time through `push`
+ * and returns its output, holds everything it needs inline, and is composed with the others
+ * at compile time through `FilterChain`, so a chain costs no allocation and no virtual calls.
+ */
+
+/**
+ * Mean of the last N readings, kept as a running sum. The sum is recomputed each time the
+ * window wraps so float rounding can't build up, which keeps a push O(1) amortized.
+ * Until N readings are in, the mean is over those there are.
+ */
+template<int N>
+class RunningMean {
+    static_assert(N > 0, "RunningMean needs a window of at least one reading.");
+
+    private:
+        float window[N] = {0};
+        float sum = 0;
+        int next = 0;           // Slot the next reading is written to.
+        int count = 0;          // Readings held.
+
+    public:
+        float push(float x) {
+            if(count == N) sum -= window[next];
+            else count++;
+            window[next] = x;
+            sum += x;
+            if(++next == N) {
+                next = 0;
+                sum = 0;
+                for(int i = 0; i < N; i++) sum += window[i];
+            }
+            return sum / count;
+        }
+
+        void reset() {
+            sum = 0;
+            next = 0;
+            count = 0;
+        }
+};
+
+/**
+ * Median of the last N readings, rejecting spikes shorter than half the window. Keeps the
+ * window sorted alongside its arrival order, so a push moves at most N readings.
+ */
+template<int N>
+class MedianFilter {
+    static_assert(N > 0 && N % 2 == 1, "MedianFilter needs an odd window.");
+
+    private:
+        float window[N] = {0};  // Readings in arrival order.
+        float sorted[N] = {0};  // The same readings in ascending order.
+        int next = 0;           // Slot of `window` the next reading is written to.
+        int count = 0;          // Readings held.
+
+    public:
+        float push(float x) {
+            // Take the oldest reading out of the sorted copy once the window is full.
+            if(count == N) {
+                float old = window[next];
+                int i = 0;
+                while(i < count - 1 && sorted[i] != old) i++;
+                for(; i < count - 1; i++) sorted[i] = sorted[i + 1];
+                count--;
+            }
+            window[next] = x;
+            if(++next == N) next = 0;
+
+            // Insert the new reading in order.
+            int i = count;
+            for(; i > 0 && sorted[i - 1] > x; i--) sorted[i] = sorted[i - 1];
+            sorted[i] = x;
+            count++;
+
+            // While filling, the lower middle stands in for an even count's median.
+            return sorted[(count - 1) / 2];
+        }
+
+        void reset() {
+            next = 0;
+            count = 0;
+        }
+};
+
+/**
+ * Exponential smoothing: each reading moves the output AlphaPercent of the way to it.
+ * The first reading is taken as is.
+ */
+template<int AlphaPercent>
+class ExponentialSmoothing {
+    static_assert(AlphaPercent > 0 && AlphaPercent <= 100, "ExponentialSmoothing needs an alpha in (0, 100] percent.");
+
+    private:
+        float value = 0;
+        bool primed = false;    // Has a reading been taken.
+
+    public:
+        float push(float x) {
+            if(!primed) {
+                value = x;
+                primed = true;
+            }
+            else value += (AlphaPercent / 100.0f) * (x - value);
+            return value;
+        }
+
+        void reset() { primed = false; }
+};
+
+/**
+ * Limits how far the output moves per reading, so a jump no target could make is followed
+ * over several readings rather than at once. The first reading is taken as is.
+ */
+template<int MaxStep>
+class RateLimiter {
+    static_assert(MaxStep > 0, "RateLimiter needs a positive step.");
+
+    private:
+        float value = 0;
+        bool primed = false;    // Has a reading been taken.
+
+    public:
+        float push(float x) {
+            if(!primed) {
+                value = x;
+                primed = true;
+            }
+            else if(x > value + MaxStep) value += MaxStep;
+            else if(x < value - MaxStep) value -= MaxStep;
+            else value = x;
+            return value;
+        }
+
+        void reset() { primed = false; }
+};
+
+/**
+ * Stages run in order, each taking the one before's output.
+ */
+template<typename... Stages>
+class FilterChain;
+
+template<>
+class FilterChain<> {
+    public:
+        float push(float x) { return x; }
+        void reset() {}
+};
+
+template<typename First, typename... Rest>
+class FilterChain<First, Rest...> {
+    private:
+        First first;
+        FilterChain<Rest...> rest;
+
+    public:
+        float push(float x) { return rest.push(first.push(x)); }
+
+        void reset() {
+            first.reset();
+            rest.reset();
+        }
+};
+
+#endif /* DISTANCE_FILTER_H */
@@ -0,0 +1,122 @@
+#include "EchoCapture.h"
+#include "esp_timer.h"
+
+bool McpwmEchoCapture::startTimer(int group) {
+    if(timers[group] != NULL) return true;
+
+    mcpwm_capture_timer_config_t config = {};
+    config.group_id = group;
+    config.clk_src = MCPWM_CAPTURE_CLK_SRC_DEFAULT;
+    mcpwm_cap_timer_handle_t timer = NULL;
+    if(mcpwm_new_capture_timer(&config, &timer) != ESP_OK) return false;
+    if(mcpwm_capture_timer_enable(timer) != ESP_OK || mcpwm_capture_timer_start(timer) != ESP_OK) {
+        log_e("MCPWM group %d: capture timer not started.", group);
+        return false;
+    }
+    timers[group] = timer;
+    return true;
+}
+
+bool McpwmEchoCapture::onCapture(mcpwm_cap_channel_handle_t channel, const mcpwm_capture_event_data_t *edata, void *arg) {
+    McpwmEchoCapture *capture = static_cast<McpwmEchoCapture *>(arg);
+
+    // The software capture of a reference pair isn't an edge.
+    if(capture->referencePending) {
+        capture->referenceTicks = edata->cap_value;
+        capture->referenceAt = esp_timer_get_time();
+        capture->referencePending = false;
+        return false;
+    }
+    EchoEdge edge = (edata->cap_edge == MCPWM_CAP_EDGE_POS) ? edge_RISING : edge_FALLING;
+    return capture->callback(capture->arg, edge, edata->cap_value);
+}
+
+bool McpwmEchoCapture::begin(int pin, EchoEdgeCallback callback, void *arg) {
+    if(channel != NULL) return false;
+    this->callback = callback;
+    this->arg = arg;
+
+    mcpwm_capture_channel_config_t config = {};
+    config.gpio_num = pin;
+    config.prescale = 1;
+    config.flags.pos_edge = true;
+    config.flags.neg_edge = true;
+
+    // Take the first group with a channel left, unless one was asked for.
+    for(int group = 0; group < ECHO_CAPTURE_GROUPS; group++) {
+        if(this->group >= 0 && group != this->group) continue;
+        if(!startTimer(group)) continue;
+        if(mcpwm_new_capture_channel(timers[group], &config, &channel) != ESP_OK) {
+            channel = NULL;
+            continue;
+        }
+
+        mcpwm_capture_event_callbacks_t callbacks = {};
+        callbacks.on_cap = onCapture;
+        if(mcpwm_capture_channel_register_event_callbacks(channel, &callbacks, this) != ESP_OK
+                || mcpwm_capture_channel_enable(channel) != ESP_OK) {
+            mcpwm_del_capture_channel(channel);
+            channel = NULL;
+            return false;
+        }
+        mcpwm_capture_timer_get_resolution(timers[group], &resolution);
+        this->group = group;
+        return true;
+    }
+    return false;
+}
+
+bool McpwmEchoCapture::sampleReference(CaptureClock *clock) {
+    if(channel == NULL) return false;
+
+    // The counter is latched somewhere between the read before the software capture and the read in its interrupt.
+    referencePending = true;
+    int64_t before = esp_timer_get_time();
+    if(mcpwm_capture_channel_trigger_soft_catch(channel) != ESP_OK) {
+        referencePending = false;
+        return false;
+    }
+    while(referencePending && esp_timer_get_time() - before < ECHO_REFERENCE_TIMEOUT_US) {}
+    if(referencePending) {
+        referencePending = false;
+        return false;
+    }
+    clock->setReference(referenceTicks, before, referenceAt);
+    return true;
+}
+
+void McpwmEchoCapture::end() {
+    if(channel == NULL) return;
+    mcpwm_capture_channel_disable(channel);
+    mcpwm_del_capture_channel(channel);
+    channel = NULL;
+}
+
+void GpioEchoCapture::onChange(void *arg) {
+    ulong currTime = micros();
+    GpioEchoCapture *capture = static_cast<GpioEchoCapture *>(arg);
+    EchoEdge edge = (digitalRead(capture->pin) == HIGH) ? edge_RISING : edge_FALLING;
+    if(capture->callback(capture->arg, edge, (uint32_t) currTime)) portYIELD_FROM_ISR(pdTRUE);
+}
+
+bool GpioEchoCapture::begin(int pin, EchoEdgeCallback callback, void *arg) {
+    if(this->pin >= 0) return false;
+    this->pin = pin;
+    this->callback = callback;
+    this->arg = arg;
+    attachInterruptArg(pin, onChange, this, CHANGE);
+    return true;
+}
+
+bool GpioEchoCapture::sampleReference(CaptureClock *clock) {
+    // The timestamps are micros(), which is esp_timer cut to 32 bits.
+    int64_t now = esp_timer_get_time();
+    clock->setReference((uint32_t) now, now, now);
+    return true;
+}
+
+void GpioEchoCapture::end() {
+    if(pin < 0) return;
+    detachInterrupt(pin);
+    pin = -1;
+}
@@ -0,0 +1,133 @@
+#ifndef ECHO_CAPTURE_H
+#define ECHO_CAPTURE_H
+
+#include <Arduino.h>
+#include "driver/mcpwm_cap.h"
+#include "EchoDecoder.h"
+#include "CaptureClock.h"
+
+#define ECHO_CAPTURE_GROUPS 2           // MCPWM groups on the ESP32 and ESP32-S3, each with one capture timer of 3 channels.
+#define ECHO_REFERENCE_TIMEOUT_US 100   // Longest wait for a software capture to be latched (us).
+#define ECHO_GPIO_LATENCY_US 10         // Allowance for the GPIO interrupt's latency, which its timestamps carry (us).
+#define ECHO_TIMEBASE_MICROS -1         // Timebase of edges timestamped with micros().
+#define ECHO_TIMEBASE_NONE -2           // Timebase of a sensor with no backend.
+
+/**
+ * Called from interrupt context with each edge of an echo pin.
+ * @param arg Argument given to `begin`.
+ * @param ticks When the edge happened, in ticks of the backend's counter.
+ * @return True if a higher priority task was woken.
+ */
+typedef bool (* EchoEdgeCallback)(void *arg, EchoEdge edge, uint32_t ticks);
+
+/**
+ * Source of timestamped edges of an ultrasonic sensor's echo pin.
+ */
+class EchoCapture {
+    public:
+        virtual ~EchoCapture() {}
+
+        /**
+         * Start timestamping both edges of a pin.
+         * @return False if the pin couldn't be captured.
+         */
+        virtual bool begin(int pin, EchoEdgeCallback callback, void *arg) = 0;
+
+        /**
+         * Stop capturing.
+         */
+        virtual void end() = 0;
+
+        /**
+         * Ticks per second of the edge timestamps.
+         */
+        virtual uint32_t getResolution() = 0;
+
+        /**
+         * Latency between an edge and its timestamp (us), at most.
+         */
+        virtual uint32_t getLatencyUs() = 0;
+
+        /**
+         * Read the edge counter together with esp_timer, giving the clock a reference pair that
+         * maps edge timestamps into esp_timer's clock. Call between echoes, as before a trigger.
+         * @return False if the counter couldn't be read.
+         */
+        virtual bool sampleReference(CaptureClock *clock) = 0;
+
+        /**
+         * Counter the edges are timestamped on. Backends of the same timebase share the counter,
+         * so their ticks can be compared directly.
+         */
+        virtual int getTimebase() = 0;
+
+        virtual const char *name() = 0;
+};
+
+/**
+ * Edges latched by the MCPWM capture unit as they happen, so interrupt latency and other
+ * interrupts don't skew the timestamps, and the edge's direction comes from the hardware
+ * rather than a read of the pin after the fact. The channels of a group share its capture
+ * timer. `begin` must be called from one task at a time.
+ */
+class McpwmEchoCapture : public EchoCapture {
+    private:
+        inline static mcpwm_cap_timer_handle_t timers[ECHO_CAPTURE_GROUPS] = {NULL};    // Capture timer of each group, started on first use.
+
+        int group = -1;                             // Group the channel is taken from, or -1 for the first with one left.
+        mcpwm_cap_channel_handle_t channel = NULL;
+        uint32_t resolution = 0;
+        EchoEdgeCallback callback = NULL;
+        void *arg = NULL;
+        volatile bool referencePending = false;     // Is the next capture the software one of a reference pair.
+        volatile uint32_t referenceTicks = 0;       // Counter latched by the software capture (ticks).
+        volatile int64_t referenceAt = 0;           // esp_timer read as the software capture was handled (us).
+
+        /**
+         * Create and start a group's capture timer, unless it already runs.
+         */
+        static bool startTimer(int group);
+
+        static bool IRAM_ATTR onCapture(mcpwm_cap_channel_handle_t channel, const mcpwm_capture_event_data_t *edata, void *arg);
+
+    public:
+        /**
+         * @param group MCPWM group to take the channel from, or -1 for the first with one left. Channels
+         *              that must be timed against each other are put on the same group, so on the same timer.
+         */
+        McpwmEchoCapture(int group = -1) : group(group) {}
+        ~McpwmEchoCapture() { end(); }
+        bool begin(int pin, EchoEdgeCallback callback, void *arg) override;
+        void end() override;
+        uint32_t getResolution() override { return resolution; }
+        uint32_t getLatencyUs() override { return 0; }
+        bool sampleReference(CaptureClock *clock) override;
+        int getTimebase() override { return group; }
+        const char *name() override { return "MCPWM capture"; }
+};
+
+/**
+ * Edges timestamped with `micros()` in a GPIO interrupt, for when no capture channel is left.
+ * The timestamp carries the interrupt's latency, and the edge's direction is read from the
+ * pin, so a glitch shorter than that latency can be taken for the wrong edge.
+ */
+class GpioEchoCapture : public EchoCapture {
+    private:
+        int pin = -1;
+        EchoEdgeCallback callback = NULL;
+        void *arg = NULL;
+
+        static void IRAM_ATTR onChange(void *arg);
+
+    public:
+        ~GpioEchoCapture() { end(); }
+        bool begin(int pin, EchoEdgeCallback callback, void *arg) override;
+        void end() override;
+        uint32_t getResolution() override { return 1000000; }
+        uint32_t getLatencyUs() override { return ECHO_GPIO_LATENCY_US; }
+        bool sampleReference(CaptureClock *clock) override;
+        int getTimebase() override { return ECHO_TIMEBASE_MICROS; }
+        const char *name() override { return "GPIO interrupt"; }
+};
+
+#endif /* ECHO_CAPTURE_H */
@@ -0,0 +1,115 @@
+#ifndef ECHO_DECODER_H
+#define ECHO_DECODER_H
+
+#include <stdint.h>
+
+#define ECHO_MIN_US 100         // Shorter echo pulses are glitches. An HC-SR04 holds echo high ~150 us at its 2 cm minimum (us).
+#define ECHO_MAX_US 40000       // Longer echo pulses span a missed edge. An HC-SR04 gives up at ~38 ms (us).
+
+/**
+ * Direction of an echo pin change.
+ */
+enum _echo_edge : uint8_t {
+    edge_RISING,        // Echo went high: the burst went out.
+    edge_FALLING        // Echo went low: the echo came back, or the sensor gave up.
+};
+typedef enum _echo_edge EchoEdge;
+
+struct _echo_stats {
+    uint32_t pulses;        // Pulses decoded.
+    uint32_t missedFalls;   // Rises seen while high: the fall before was missed, and the pulse it ended lost.
+    uint32_t missedRises;   // Falls seen while low: the rise before was missed.
+    uint32_t glitches;      // Pulses shorter than the shortest echo.
+    uint32_t overlong;      // Pulses longer than the longest echo.
+};
+typedef struct _echo_stats ECHO_STATS;
+
+/**
+ * Turns a stream of timestamped echo edges into pulse widths. Timestamps are in ticks of a
+ * free running 32 bit counter, so a pulse across the counter's wrap still decodes. Edges are
+ * given from the capture interrupt; the width is read by the task it notifies.
+ */
+class EchoDecoder {
+    private:
+        uint32_t resolutionHz;      // Ticks per second of the edge timestamps.
+        uint32_t minUs;             // Shortest pulse taken as an echo (us).
+        uint32_t maxUs;             // Longest pulse taken as an echo (us).
+        uint32_t minTicks;
+        uint32_t maxTicks;
+        uint32_t riseAt = 0;        // Timestamp of the rise of the pulse under way (ticks).
+        bool high = false;          // Is a pulse under way.
+        uint32_t widthTicks = 0;    // Width of the last pulse decoded (ticks).
+        ECHO_STATS stats = {};
+
+        static uint32_t toTicks(uint32_t us, uint32_t resolutionHz) { return (uint32_t) (((uint64_t) us * resolutionHz) / 1000000); }
+
+    public:
+        EchoDecoder(
+                uint32_t resolutionHz = 1000000,    // Ticks per second of the edge timestamps.
+                uint32_t minUs = ECHO_MIN_US,       // Shortest pulse taken as an echo (us).
+                uint32_t maxUs = ECHO_MAX_US        // Longest pulse taken as an echo (us).
+            ) : minUs(minUs), maxUs(maxUs) { setResolution(resolutionHz); }
+
+        /**
+         * Set the tick rate of the edge timestamps, dropping any pulse under way.
+         */
+        void setResolution(uint32_t resolutionHz) {
+            this->resolutionHz = (resolutionHz > 0) ? resolutionHz : 1;
+            minTicks = toTicks(minUs, this->resolutionHz);
+            maxTicks = toTicks(maxUs, this->resolutionHz);
+            high = false;
+        }
+
+        /**
+         * Take an edge of the echo pin.
+         * @param ticks When the edge happened (ticks).
+         * @return True if the edge ended a pulse of echo width, now given by `getWidthTicks`.
+         */
+        bool onEdge(EchoEdge edge, uint32_t ticks) {
+            if(edge == edge_RISING) {
+                // A rise while high means the fall was missed. Time from the newer rise.
+                if(high) stats.missedFalls++;
+                riseAt = ticks;
+                high = true;
+                return false;
+            }
+
+            if(!high) {
+                stats.missedRises++;
+                return false;
+            }
+            high = false;
+
+            // Unsigned difference, so a pulse across the counter's wrap measures right.
+            uint32_t width = ticks - riseAt;
+            if(width < minTicks) {
+                stats.glitches++;
+                return false;
+            }
+            if(width > maxTicks) {
+                stats.overlong++;
+                return false;
+            }
+            widthTicks = width;
+            stats.pulses++;
+            return true;
+        }
+
+        /**
+         * Forget any pulse under way.
+         */
+        void reset() { high = false; }
+
+        uint32_t getWidthTicks() const { return widthTicks; }
+
+        /**
+         * Width of the last pulse decoded (us), to the resolution of the timestamps.
+         */
+        float getWidthUs() const { return (float) ((double) widthTicks * 1000000.0 / resolutionHz); }
+
+        uint32_t getResolution() const { return resolutionHz; }
+        bool isHigh() const { return high; }
+        ECHO_STATS getStats() const { return stats; }
+};
+
+#endif /* ECHO_DECODER_H */
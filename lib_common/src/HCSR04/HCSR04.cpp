@@ -1,4 +1,5 @@
 #include "HCSR04.h"
+#include "esp_timer.h"
 
 /**
  * Initializes the sensor pin connections wrt the ESP32 and enables sensor.
@@ -27,6 +28,8 @@ bool HCSR04::readSensor(TickType_t xMaxBlockTime) {
     }
 
     // Pulse trigger for 10 us.
+    waitForRise = false;
+    sampleClock();
     pulseTrigger();
     
     // Wait for pulse to complete.
@@ -35,12 +38,11 @@ bool HCSR04::readSensor(TickType_t xMaxBlockTime) {
         // Compute distance just measured.
         float inches = computeInches();
 
-        // Store the last average for later comparisons.
-        lastBufferAverage = averageBuffer();
-
-        // Update the buffer.
-        if(distIndex == bufferSize) distIndex = 0;
-        pastDistances[distIndex++] = inches;
+        // Store the last filter output for later comparisons, then filter the new reading.
+        lastBufferAverage = filteredDistance;
+        filteredDistance = filter(inches);
+        if(lastDistance < 0) lastBufferAverage = filteredDistance;
+        lastDistance = inches;
         res = true;
     }
 
@@ -48,6 +50,40 @@ bool HCSR04::readSensor(TickType_t xMaxBlockTime) {
     return res;
 }
 
+/**
+ * Pulse the trigger and wait for the burst to go out.
+ * @return When the echo rose with the burst, or zero if it didn't in time.
+ */
+int64_t HCSR04::fire(TickType_t xMaxBlockTime) {
+    if(!active || taskHandle == NULL) {
+        log_e("Invalid Fire. Sensor(%d) inactive or Task Handle Not Set.", id);
+        return 0;
+    }
+
+    waitForRise = true;
+    sampleClock();
+    int64_t firedAt = esp_timer_get_time();
+    pulseTrigger();
+    if(ulTaskNotifyTake(pdTRUE, xMaxBlockTime) == 0 || echoRiseAt < firedAt) return 0;
+    return echoRiseAt;
+}
+
+int64_t HCSR04::getEchoEndAt() { return echoEndAt; }
+
+uint32_t HCSR04::getEchoEndTicks() { return echoEndTicks; }
+
+uint32_t HCSR04::getEchoBoundUs() { return echoBoundUs; }
+
+void HCSR04::sampleClock() {
+    // Without a fresh reference, edges are timed as their interrupt runs.
+    if(capture == NULL || !capture->sampleReference(&clock)) {
+        clock.reset();
+        echoBoundUs = ECHO_GPIO_LATENCY_US;
+        return;
+    }
+    echoBoundUs = clock.boundUs();
+}
+
 /**
  * Mark a sensor as relevant for output collection.
  */
@@ -75,8 +111,8 @@ void HCSR04::disable() {
 char HCSR04::passedThreshold() {
     char flag = 0x00;
 
-    // Only check thresholds if sensor is active.
-    if(this->active == false) return flag;
+    // Only check thresholds if sensor is active and has read something.
+    if(this->active == false || lastDistance < 0) return flag;
 
     // Check obstacle detection threshold. (This is checked against most recent distance instead of the buffers).
     if(getDistanceReading() <= obstacleDetectionThreshold) flag |= OBSTACLE_THRESHOLD_BREACHED;
@@ -84,7 +120,7 @@ char HCSR04::passedThreshold() {
     // Check human presence estimation threshold.
     float currBufferAvg = averageBuffer();
     float HpeCheck = presenceDetectionThreshold/currBufferAvg - 1;
-    if(HpeCheck >= HPE_PERCENT_DIFF/100.0) {
+    if(HpeCheck >= hpePercentDiff/100.0) {
         // Set the bit indicating human presence was detected.
         flag |= PRESENCE_THRESHOLD_BREACHED;
 
@@ -92,13 +128,13 @@ char HCSR04::passedThreshold() {
         float bufferPercentDiff = abs(currBufferAvg - lastBufferAverage)/lastBufferAverage;
 
         // Greater than a 10% difference between buffers while presence is detected strongly indicates presence (and motion within boundary).
-        if(bufferPercentDiff > HPE_STRONG_PERCENT/100.0) {
+        if(bufferPercentDiff > hpeStrongPercent/100.0) {
             flag |= STRONG_PRESENCE_BREACH;
             //Serial.printf("😁diff: %f->Strong Presence Detected->Flag = 0x%x\n", bufferPercentDiff, flag);
         }
 
         // Less than a 5% difference between buffers while presence is detected weakly indicates presence (and motion within boundary).
-        else if(bufferPercentDiff < HPE_WEAK_PERCENT/100.0) {
+        else if(bufferPercentDiff < hpeWeakPercent/100.0) {
             flag |= WEAK_PRESENCE_BREACH;
             //Serial.printf("😁diff: %f->Weak Presence Detected->Flag = 0x%x\n", bufferPercentDiff, flag);
         }
@@ -116,13 +152,11 @@ char HCSR04::passedThreshold() {
 }
 
 /**
- * Take the avarage of this sensors past distances buffer.
- * @return The average value of this sensors past distances.
+ * Take the output of this sensors distance filter.
+ * @return The filtered distance (inches).
  */
 float HCSR04::averageBuffer() {
-    float sum = 0;
-    for(int i = 0; i < bufferSize; i++) sum += pastDistances[i];
-    return sum/bufferSize;
+    return filteredDistance;
 }
 
 /**
@@ -153,6 +187,20 @@ float HCSR04::getObstacleDetectionThreshold() {
  */
 float HCSR04::getHpeThreshold() { return presenceDetectionThreshold; }
 
+/**
+ * Set this sensors human presence threshold.
+ */
+void HCSR04::setHpeThreshold(float threshold) { presenceDetectionThreshold = threshold; }
+
+/**
+ * Set how readily this sensor reports presence, and how strongly.
+ */
+void HCSR04::setHpeSensitivity(float percentDiff, float weakPercent, float strongPercent) {
+    hpePercentDiff = percentDiff;
+    hpeWeakPercent = weakPercent;
+    hpeStrongPercent = strongPercent;
+}
+
 /**
  * Pulse this ultrasonic sensors trigger pin to initiate measurements.
  */
@@ -166,25 +214,71 @@ void HCSR04::pulseTrigger() {
 }
 
 float HCSR04::computeInches() {
-    float isrPulseDuration = (isrPulseEnd - isrPulseStart) * 1.0;
+    float isrPulseDuration = decoder.getWidthUs();
     float distanceInInches = (isrPulseDuration/2) / 74;
     return distanceInInches;
 }
 
-void HCSR04::setISRStartPulse(ulong start) {
-    isrPulseStart = start;
+/**
+ * Start timing this sensor's echo with a capture backend, replacing any before it.
+ */
+bool HCSR04::attachEcho(EchoCapture *capture) {
+    if(this->capture != NULL) {
+        delete this->capture;
+        this->capture = NULL;
+    }
+
+    if(!capture->begin(echo, onEchoEdge, this)) {
+        delete capture;
+        return false;
+    }
+
+    // Echo edges only follow a trigger, so none races the decoder and clock taking the backend's tick rate.
+    decoder.setResolution(capture->getResolution());
+    clock.setResolution(capture->getResolution(), capture->getLatencyUs());
+    this->capture = capture;
+    return true;
 }
 
-void HCSR04::setIRSEndPulse(ulong end) {
-    isrPulseEnd = end;
+const char *HCSR04::getEchoCaptureName() { return (capture != NULL) ? capture->name() : "none"; }
+
+int HCSR04::getEchoTimebase() { return (capture != NULL) ? capture->getTimebase() : ECHO_TIMEBASE_NONE; }
+
+uint32_t HCSR04::getEchoResolution() { return (capture != NULL) ? capture->getResolution() : 1000000; }
+
+ECHO_STATS HCSR04::getEchoStats() { return decoder.getStats(); }
+
+bool HCSR04::onEchoEdge(void *arg, EchoEdge edge, uint32_t ticks) {
+    HCSR04 *sensor = static_cast<HCSR04 *>(arg);
+
+    // Time the edge when it happened rather than when its interrupt ran, unless the counter has no reference yet.
+    int64_t now;
+    if(!sensor->clock.toMicros(ticks, &now)) now = esp_timer_get_time();
+    if(edge == edge_RISING) sensor->echoRiseAt = now;
+    bool ended = sensor->decoder.onEdge(edge, ticks);
+    if(ended) {
+        sensor->echoEndAt = now;
+        sensor->echoEndTicks = ticks;
+    }
+
+    // A transducer that only transmits wakes its task as the burst goes out, the rest once it is heard.
+    if(sensor->waitForRise ? (edge != edge_RISING) : !ended) return false;
+
+    TaskHandle_t handle = sensor->getTaskHandle();
+    NotificationMask notifValue = sensor->getNotifValue();
+    if(handle == NULL || notifValue == UNSET) {
+        if(handle == NULL) log_e("US(%d): Null Task Handle.", sensor->identify());
+        if(notifValue == UNSET) log_e("US(%d): Notif Value Unset.", sensor->identify());
+        return false;
+    }
+    BaseType_t higherPriorityWasAwoken = pdFALSE;
+    xTaskNotifyFromISR(handle, notifValue, eSetBits, &higherPriorityWasAwoken);
+    return higherPriorityWasAwoken == pdTRUE;
 }
 
 float HCSR04::getDistanceReading() { 
-    float res = -1;
-    if(!active) return res;
-    if(distIndex > 0) res = pastDistances[distIndex - 1]; 
-    else res = pastDistances[bufferSize - 1]; // Index should get the last element in the buffer.
-    return res;
+    if(!active) return -1;
+    return lastDistance;
 }
 
 float HCSR04::getLastBufferAverage() { return lastBufferAverage; }
@@ -5,12 +5,17 @@
 // Grab libraries. 
 #include <Arduino.h>
 #include <Preferences.h>
+#include "EchoDecoder.h"
+#include "EchoCapture.h"
+#include "DistanceFilter.h"
 
 #define HPE_PERCENT_DIFF 2      // Meaningful percent difference between current buffer average and HPE Threshold (in %).
 #define HPE_WEAK_PERCENT 5      // Percent difference between current and last buffer averages weakly indicating presence (in %).
 #define HPE_STRONG_PERCENT 10   // Percent difference between current and last buffer averages strongly indicating presence (in %).
 #define DEF_HP_EST_LIM 10
 
+#define BURST_TIME_MS 3  // Time an HC-SR04 takes to send its burst and raise echo after a trigger, with room to spare (ms).
+
 #define OBS_LIM 30      // USS obstacle detection limit (inches).
 #define OBSTACLE_THRESHOLD_BREACHED  0x0001     // Mask representing that the Obstacle Detection Threshold of an HCSR04 Sensor has been passed.
 #define PRESENCE_THRESHOLD_BREACHED  0x0002     // Mask representing that the Presence Detection Threshold of an HCSR04 Sensor has been passed.
@@ -18,6 +23,13 @@
 #define MODERATE_PRESENCE_BREACH 0x08           // Mask for when HPE breach is moderate.
 #define WEAK_PRESENCE_BREACH 0x04               // Mask for when HPE breach is weak.
 
+// Filters each kind of sensor's distances go through. Transducers hear the belt across the room, so spikes
+// from missed or stray bursts are rejected, and the range can't change faster than a person runs: 6 inches
+// of echo a read is a foot of range every TRIGGER_PERIOD_MS. Obstacle sensors must react to something close
+// at once, so they are only despiked and lightly smoothed.
+typedef FilterChain<MedianFilter<3>, RateLimiter<6>, RunningMean<5>> TransducerFilter;
+typedef FilterChain<MedianFilter<3>, ExponentialSmoothing<50>> ObstacleFilter;
+
 typedef uint32_t NotificationMask;  // Mask to delineate between Notifcations.
 #define UNSET ((NotificationMask) 0xFFFF)
 #define T_US_READY ((NotificationMask) 0x0001)  // Transducer ultrasonic sensor notification.
@@ -36,6 +48,7 @@ typedef enum _sensor_id SensorID;
 
 /**
  * Class representing the HC-SR04 Ultrasonic Sensors used as obstacle and presence detectors.
+ * Each kind of sensor filters its distances its own way, so only its subclasses are built.
  */
 class HCSR04 {
 
@@ -75,44 +88,74 @@ class HCSR04 {
          */
         float presenceDetectionThreshold = DEF_HP_EST_LIM;
 
+        float hpePercentDiff = HPE_PERCENT_DIFF;        // Meaningful percent difference between the buffer average and the HPE threshold (in %).
+        float hpeWeakPercent = HPE_WEAK_PERCENT;        // Percent difference between buffer averages weakly indicating presence (in %).
+        float hpeStrongPercent = HPE_STRONG_PERCENT;    // Percent difference between buffer averages strongly indicating presence (in %).
+
         /**
          * Quantifies if this sensor is on or not (should be polled or not).
          */
         bool active = false;
 
         /**
-         * Index into the distance buffer pointing to the last distance measured.
+         * Last distance measured (inches), unfiltered. Negative until the first reading.
          */
-        int distIndex = 0;
-        
+        float lastDistance = -1;
+
+        /**
+         * Output of the distance filter after the last reading (inches).
+         */
+        float filteredDistance = 0;
+
         /**
-         * Last average of the buffer.
+         * Output of the distance filter before the last reading (inches).
          */
         float lastBufferAverage = 0;
 
         /**
-         * Size of distance buffer.
+         * Backend timestamping this sensor's echo edges. Owned.
          */
-        static constexpr int bufferSize = 5;
+        EchoCapture *capture = NULL;
 
         /**
-         * Buffer of past distances measured.
+         * Turns the echo edges into pulse widths. Fed from the capture interrupt.
          */
-        float pastDistances[bufferSize];
+        EchoDecoder decoder;
 
-        unsigned long isrPulseStart = 0; // Stores the time at which the sensor's echo has begun from ISR.
-        unsigned long isrPulseEnd = 0;   // Stores the time at which the sensor's echo has finished from ISR.    
+        /**
+         * Maps the backend's edge timestamps into esp_timer's clock. Renewed before each trigger.
+         */
+        CaptureClock clock;
+
+        volatile int64_t echoRiseAt = 0;    // When the echo last rose, as the burst went out (us).
+        volatile int64_t echoEndAt = 0;     // When the last echo pulse decoded ended (us).
+        volatile uint32_t echoEndTicks = 0; // The same, in ticks of the backend's counter.
+        volatile uint32_t echoBoundUs = 0;  // Bound on the error of both times above (us).
+        volatile bool waitForRise = false;  // Is the task waiting for the burst to go out rather than for its echo.
 
         /**
          * Pulse this ultrasonic sensor's trigger pin to initiate a measurement.
          */
         void pulseTrigger();
 
+        /**
+         * Renew the mapping of edge timestamps into esp_timer's clock, ahead of a trigger.
+         */
+        void sampleClock();
+
         /**
          * Compute the distance in inches measured by the sensor.
          */
         float computeInches();
 
+    protected:
+        /**
+         * Run a reading through this kind of sensor's distance filter.
+         * @param inches The reading (inches).
+         * @return The filter's output (inches).
+         */
+        virtual float filter(float inches) = 0;
+
     public:
         /**
          * Defines the sensors pins and connects them to the ESP32, and sets the thresholds of a sensor.
@@ -129,6 +172,8 @@ class HCSR04 {
             obstacleDetectionThreshold(obstacleDetectionThreshold),
             notif(notif) {};
 
+        virtual ~HCSR04() {}
+
         /**
          * Initializes the sensor pin connections wrt the ESP32 and enables sensor.
          */
@@ -141,6 +186,31 @@ class HCSR04 {
          */
         bool readSensor(TickType_t xMaxBlockTime);
 
+        /**
+         * Pulse the trigger and wait for the burst to go out, for a transducer that only transmits.
+         * This must only be called from within a task.
+         * @param xMaxBlockTime The maximum time allotted for the burst to go out.
+         * @return When the echo rose with the burst (in microseconds), or zero if it didn't in time.
+         */
+        int64_t fire(TickType_t xMaxBlockTime);
+
+        /**
+         * When the last echo pulse ended, i.e. when the burst was heard (in microseconds).
+         */
+        int64_t getEchoEndAt();
+
+        /**
+         * When the last echo pulse ended, in ticks of the backend's counter. Only comparable
+         * with the ticks of a sensor on the same timebase.
+         */
+        uint32_t getEchoEndTicks();
+
+        /**
+         * Bound on the error of the echo's rise and end times (in microseconds), from mapping the
+         * capture's timestamps into esp_timer's clock.
+         */
+        uint32_t getEchoBoundUs();
+
         /**
          * Mark a sensor as relevant for output collection.
          */
@@ -156,6 +226,20 @@ class HCSR04 {
          */
         float getHpeThreshold();
 
+        /**
+         * Set this sensors Human presence estimation threshold.
+         * @param threshold The distance from the sensor (in inches) that an object/person must be to be "detected".
+         */
+        void setHpeThreshold(float threshold);
+
+        /**
+         * Set how readily this sensor reports presence, and how strongly.
+         * @param percentDiff Meaningful percent difference between the buffer average and the HPE threshold (in %).
+         * @param weakPercent Percent difference between buffer averages below which presence is weak (in %).
+         * @param strongPercent Percent difference between buffer averages above which presence is strong (in %).
+         */
+        void setHpeSensitivity(float percentDiff, float weakPercent, float strongPercent);
+
         /**
          * Signal that this ultrasonic sensor has passed one or both of its 2 thresholds.
          * @return A byte where the least two significant bits represent detection threshold
@@ -169,8 +253,8 @@ class HCSR04 {
         char passedThreshold();
 
         /**
-         * Take the avarage of this sensors past distances buffer.
-         * @return The average value of this sensors past distnaces.
+         * Take the output of this sensors distance filter. Costs nothing; the filter runs as readings come in.
+         * @return The filtered distance (inches).
          */
         float averageBuffer();
 
@@ -192,22 +276,43 @@ class HCSR04 {
         float getObstacleDetectionThreshold();
 
         /**
-         * For purposes of sensor reading in the appropriate ISR from the Sensor Manager.
-         * Sets the start time of the echo pulse once it begins.
-         * @param start This is the start time of the echo pulse once this sensor has begun measuring.
+         * Start timing this sensor's echo with a capture backend, replacing any before it.
+         * @param capture The backend to use. Taken over by the sensor, and deleted if it can't capture the echo pin.
+         * @return True if the backend captures the echo pin.
+         */
+        bool attachEcho(EchoCapture *capture);
+
+        /**
+         * Name of the backend timing this sensor's echo.
+         */
+        const char *getEchoCaptureName();
+
+        /**
+         * Counter this sensor's echo is timestamped on, ECHO_TIMEBASE_NONE without a backend.
+         */
+        int getEchoTimebase();
+
+        /**
+         * Ticks per second of the echo's timestamps.
+         */
+        uint32_t getEchoResolution();
+
+        /**
+         * Counts of echo pulses decoded and edges dropped.
          */
-        void setISRStartPulse(ulong start);
+        ECHO_STATS getEchoStats();
 
         /**
-         * For purposes of sensor reading in the appropriate ISR from the Sensor Manager.
-         * Sets the end time of the echo pulse once it begins.
-         * @param end This is the end time of the echo pulse once this sensor has begun measuring.
+         * For the capture backend's interrupt. Feeds an echo edge to the sensor's decoder, and
+         * notifies the sensor's task once a pulse is complete.
+         * @param arg The sensor.
+         * @return True if a higher priority task was woken.
          */
-        void setIRSEndPulse(ulong end);
+        static bool IRAM_ATTR onEchoEdge(void *arg, EchoEdge edge, uint32_t ticks);
 
         /**
-         * Get the last distance reading.
-         * @return The last known distance reading from this sensor.
+         * Get the last distance reading, unfiltered.
+         * @return The last known distance reading from this sensor, or -1 if there is none.
          */
         float getDistanceReading();
 
@@ -223,5 +328,35 @@ class HCSR04 {
         NotificationMask getNotifValue();
 };
 
+/**
+ * HC-SR04 used as an ultrasonic transducer, timing the belt's bursts.
+ */
+class TransducerHCSR04 : public HCSR04 {
+    private:
+        TransducerFilter chain;
+
+    protected:
+        float filter(float inches) override { return chain.push(inches); }
+
+    public:
+        TransducerHCSR04(int trigger, int echo, SensorID id, int obstacleDetectionThreshold, NotificationMask notif) :
+            HCSR04(trigger, echo, id, obstacleDetectionThreshold, notif) {};
+};
+
+/**
+ * HC-SR04 used for obstacle detection in front of the bot.
+ */
+class ObstacleHCSR04 : public HCSR04 {
+    private:
+        ObstacleFilter chain;
+
+    protected:
+        float filter(float inches) override { return chain.push(inches); }
+
+    public:
+        ObstacleHCSR04(int trigger, int echo, SensorID id, int obstacleDetectionThreshold, NotificationMask notif) :
+            HCSR04(trigger, echo, id, obstacleDetectionThreshold, notif) {};
+};
+
 // End include guard.
 #endif /*HCSR04.h*/
\ No newline at end of file
@@ -6,6 +6,7 @@ TaskHandle_t trig_tx_transducer_task_handle = NULL;
 TaskHandle_t trig_left_rx_transducer_task_handle = NULL;
 TaskHandle_t trig_right_rx_transducer_task_handle = NULL;
 TaskHandle_t poll_obs_detection_uss_handle = NULL;              
+TaskHandle_t drive_task_handle = NULL;
 
 /**
  * This task reads and provides the distance values measured from the ultrasonic sensors.
@@ -30,6 +31,11 @@ void trig_tx_transducer_task(void *pvPeripheralManager) {
         // Wait for notifcation from tirgger timer before trigger.
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);  
 
+#if ONE_WAY_RANGING
+        // Fire the transmitter, and tell the bot when its burst actually went out.
+        int64_t risenAt = transducer->fire(pdMS_TO_TICKS(BURST_TIME_MS));
+        manager->reportEmission(risenAt, transducer->getEchoBoundUs());
+#else
         // Trigger the transmitter.
         readingGood = transducer->readSensor(US_READ_TIME);
 
@@ -37,6 +43,7 @@ void trig_tx_transducer_task(void *pvPeripheralManager) {
         // ReadingGood will always be false due to the mutilation of the sensor into tx only.
         if(!readingGood) log_e("Tx triggered Succesfully.");
         else log_e("Tx Trigger Issue.");
+#endif
     }
 }
 
@@ -54,12 +61,19 @@ void trig_left_rx_transducer_task(void *pvPeripheralManager) {
 
         // Wait for notifcation from tirgger timer before trigger.
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);  
+        uint16_t triggerId = manager->getFiredTriggerId();
 
         readingGood = transducer->readSensor(US_READ_TIME);
         if(readingGood) {
-            instDistance = transducer->getDistanceReading() * 2;
+            // Range from the belt's emission when it can be had. The echo's width only holds if both fired together.
+            if(!ONE_WAY_RANGING || !manager->rangeOneWay(triggerId, transducer->getEchoEndAt(), transducer->getEchoBoundUs(), &instDistance)) {
+                instDistance = transducer->getDistanceReading() * 2;
+            }
             avgDistance = transducer->getLastBufferAverage() * 2;
             Serial.printf("Left Rx: Distance: %f, Average: %f\n", instDistance, avgDistance);
+            manager->publishDistance(SensorID::leftRxTransducer, instDistance);
+            manager->observeRange(SensorID::leftRxTransducer, transducer->getEchoEndAt(), instDistance);
+            manager->observeArrival(SensorID::leftRxTransducer, triggerId);
         }
         else Serial.println("Left Rx Failed.");
     }
@@ -79,65 +93,74 @@ void trig_right_rx_transducer_task(void *pvPeripheralManager) {
 
         // Wait for notifcation from tirgger timer before trigger.
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);  
+        uint16_t triggerId = manager->getFiredTriggerId();
 
         readingGood = transducer->readSensor(US_READ_TIME);
         if(readingGood) {
-            instDistance = transducer->getDistanceReading() * 2;
+            // Range from the belt's emission when it can be had. The echo's width only holds if both fired together.
+            if(!ONE_WAY_RANGING || !manager->rangeOneWay(triggerId, transducer->getEchoEndAt(), transducer->getEchoBoundUs(), &instDistance)) {
+                instDistance = transducer->getDistanceReading() * 2;
+            }
             avgDistance = transducer->getLastBufferAverage() * 2;
             Serial.printf("Right Rx: Distance: %f, Average: %f\n", instDistance, avgDistance);
+            manager->publishDistance(SensorID::rightRxTransducer, instDistance);
+            manager->observeRange(SensorID::rightRxTransducer, transducer->getEchoEndAt(), instDistance);
+            manager->observeArrival(SensorID::rightRxTransducer, triggerId);
         }
         else Serial.println("Right Rx Failed.");
     }
 }
 
+/**
+ * Reads the obstacle detection sensors every MAX_US_POLL_TIME, one after the other so neither hears the
+ * other's burst, and keeps their threshold flags for telemetry. A failed read counts as nothing in range.
+ * @param *pvPeripheralManager a pointer to the Peripheral Manager whose obstacle sensors are read.
+ */
 void poll_obs_detection_uss_task(void *pvPeripheralManager) {
     // Initialize task.
+    TickType_t xLastWakeTime = xTaskGetTickCount();
+    PeripheralManager *manager = static_cast<PeripheralManager *>(pvPeripheralManager);
+    HCSR04 *left = manager->fetchUS(SensorID::leftObsDet);
+    HCSR04 *right = manager->fetchUS(SensorID::rightObsDet);
 
     // Begin task loop.
     for(;;) {
-        vTaskDelay(1000);
+        vTaskDelayUntil(&xLastWakeTime, MAX_US_POLL_TIME);
+
+        // The sensors are only enabled once initialized, after the task starts.
+        if(!left->isActive() || !right->isActive()) continue;
+        char leftFlags = left->readSensor(US_READ_TIME) ? left->passedThreshold() : 0;
+        char rightFlags = right->readSensor(US_READ_TIME) ? right->passedThreshold() : 0;
+        manager->updateObstacleFlags(leftFlags, rightFlags);
     }
 }
 
-void on_transducer_us_echo_changed(void *arg) {
-    ulong currTime = micros();
-    HCSR04 *transducer = static_cast<HCSR04 *>(arg);
-    int pinState = digitalRead(transducer->getEchoPinNumber());
-    if(pinState == HIGH) transducer->setISRStartPulse(currTime);
-    else {
-        transducer->setIRSEndPulse(currTime);
-        TaskHandle_t handle = transducer->getTaskHandle();
-        NotificationMask notifValue = transducer->getNotifValue();
-        if(handle != NULL && notifValue != UNSET) {
-            BaseType_t higherPriorityWasAwoken = pdFALSE;
-            xTaskNotifyFromISR(transducer->getTaskHandle(), transducer->getNotifValue(), eSetBits, &higherPriorityWasAwoken);
-            portYIELD_FROM_ISR(higherPriorityWasAwoken);
-        }
-        else {
-            if(handle == NULL) log_e("Transducer(%d): Null Task Handle.", transducer->identify());
-            if(notifValue == UNSET) log_e("Transducer(%d): Notif Value Unset.", transducer->identify());
-        }
+/**
+ * Hands the target's estimate to the drive system every TRACK_PERIOD_MS, whether or not a ping came in
+ * since. Between pings the track is predicted forward, so the bot steers on where the target is now
+ * rather than where it was last heard: toward its bearing, at a speed set by how far it is beyond the
+ * follow distance.
+ * @param *pvPeripheralManager a pointer to the Peripheral Manager whose target is tracked.
+ */
+void drive_task(void *pvPeripheralManager) {
+    // Initialize task.
+    TickType_t xLastWakeTime = xTaskGetTickCount();
+    PeripheralManager *manager = static_cast<PeripheralManager *>(pvPeripheralManager);
+
+    // Begin task loop.
+    for(;;) {
+        vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(TRACK_PERIOD_MS));
+        manager->updateTargetEstimate(esp_timer_get_time());
+        manager->followTarget();
     }
 }
 
-void on_hcsr04_us_echo_changed(void *arg) {
-    ulong currTime = micros();
-    HCSR04 *sensor = static_cast<HCSR04 *>(arg);
-    int pinState = digitalRead(sensor->getEchoPinNumber());
-    if(pinState == HIGH) sensor->setISRStartPulse(currTime);
-    else {
-        sensor->setIRSEndPulse(currTime);
-        BaseType_t higherPriorityWasAwoken = pdFALSE;
-        xTaskNotifyFromISR(sensor->getTaskHandle(), sensor->getNotifValue(), eSetBits, &higherPriorityWasAwoken);
-        portYIELD_FROM_ISR(higherPriorityWasAwoken);
-    } 
-} 
-
 /**
  * Create Peripheral Manager.
  * @param dev Pointer to the device who's peripherals require management.
  */
 PeripheralManager::PeripheralManager(Device *dev) : dev(dev) { 
+    trackerMutex = xSemaphoreCreateMutex();
     if(dev->isTransmitter()) {
         constructBeltPeripherals();
         log_e("Belt Peripheral Setup Complete.");
@@ -192,86 +215,175 @@ void PeripheralManager::initUS() {
 }
 
 void PeripheralManager::attachBeltInterrupts() {
-    int txEcho;
-    switch (dev->getSocInUse()) {
-        case SocConfig::ESP32_4MB :
-            txEcho = (int) BeltPin::single_uss_echo;
-            log_e("Succesfully Attached Belt Transducer Interrupt (ESP32).");
-            break;
+    attachEcho(txTransducer);
+}
 
-        case SocConfig::ESP32_S3_8MB :
-            txEcho = (int) S3BeltPin::single_uss_echo;
-            log_e("Succesfully Attached Belt Transducer Interrupt (ESP32-S3).");
-            break;
+void PeripheralManager::attachBotInterrupts() {
+    // Transducers first, so they get the hardware capture channels if there aren't enough for all.
+    attachEchoPair(leftRxTransducer, rightRxTransducer);
+    attachEcho(leftObsDetUS);
+    attachEcho(rightObsDetUS);
+}
 
-        default:
-            log_e("Invalid Soc Config. No Valid interrutps.");
-            break;
+/**
+ * Start timing a sensor's echo, in hardware if a capture channel is left, else with a GPIO interrupt.
+ * @param sensor The sensor whose echo pin to capture.
+ */
+void PeripheralManager::attachEcho(HCSR04 *sensor) {
+    bool attached = false;
+#if ECHO_CAPTURE_MCPWM
+    attached = sensor->attachEcho(new McpwmEchoCapture());
+    if(!attached) log_e("US(%d): No MCPWM capture channel. Falling back to GPIO interrupt.", sensor->identify());
+#endif
+    if(!attached) attached = sensor->attachEcho(new GpioEchoCapture());
+    if(attached) log_e("US(%d): Echo timed by %s.", sensor->identify(), sensor->getEchoCaptureName());
+    else log_e("US(%d): Echo not attached.", sensor->identify());
+}
+
+/**
+ * Start timing the receivers' echoes on the same MCPWM group, so both are latched by its one capture timer
+ * and the difference of their ticks is the difference of arrival, with no clock mapping in it. Without a
+ * group with two channels left, both fall back to GPIO interrupts.
+ * @param left The left receiving transducer.
+ * @param right The right receiving transducer.
+ */
+void PeripheralManager::attachEchoPair(HCSR04 *left, HCSR04 *right) {
+    bool attached = false;
+#if ECHO_CAPTURE_MCPWM
+    // Attaching again replaces the channel of a group that had only one left.
+    for(int group = 0; group < ECHO_CAPTURE_GROUPS && !attached; group++) {
+        attached = left->attachEcho(new McpwmEchoCapture(group)) && right->attachEcho(new McpwmEchoCapture(group));
+    }
+    if(!attached) log_e("US(%d, %d): No MCPWM group with two capture channels. Falling back to GPIO interrupts.", left->identify(), right->identify());
+#endif
+    if(!attached) {
+        left->attachEcho(new GpioEchoCapture());
+        right->attachEcho(new GpioEchoCapture());
     }
+    for(HCSR04 *sensor : {left, right}) log_e("US(%d): Echo timed by %s.", sensor->identify(), sensor->getEchoCaptureName());
 
-    attachInterruptArg(
-        txEcho, 
-        on_transducer_us_echo_changed,
-        txTransducer, 
-        CHANGE
-    );
+    // Receivers on different counters can only be compared once mapped into esp_timer's clock.
+    xSemaphoreTake(trackerMutex, portMAX_DELAY);
+    rxSharedTimebase = left->getEchoTimebase() == right->getEchoTimebase() && left->getEchoTimebase() != ECHO_TIMEBASE_NONE;
+    bearingEstimator.setResolution(rxSharedTimebase ? left->getEchoResolution() : 1000000);
+    xSemaphoreGive(trackerMutex);
 }
 
-void PeripheralManager::attachBotInterrupts() {
-    int leftObsEcho, rightObsEcho;
-    int leftTransducerEcho, rightTransducerEcho;
-    
-    switch (dev->getSocInUse()) {
-        case SocConfig::ESP32_4MB :
-            // Attach interrupts for echo pins on 2 rx transducers.
-            leftTransducerEcho = (int) BotPin::left_us_transducer_echo;
-            rightTransducerEcho = (int) BotPin::right_us_transducer_echo;
-            leftObsEcho = (int) BotPin::left_hcsr04_echo;
-            rightObsEcho = (int) BotPin::right_hcsr04_echo; 
-            log_e("Succesfully Attached Bot Transducer Interrupt (ESP32).");
-            break;
+/**
+ * Tell the bot when the belt's burst went out. Without a rise of the echo, the trigger's firing stands in for it,
+ * with no bound on how far the burst lagged it.
+ * @param risenAt When the echo rose with the burst (in microseconds), or zero if it didn't.
+ * @param boundUs Bound on risenAt's error (in microseconds).
+ */
+void PeripheralManager::reportEmission(int64_t risenAt, uint32_t boundUs) {
+    uint16_t triggerId = dev->getFiredTriggerId();
+    if(triggerId == 0) return;
+    int64_t firedAt = dev->getFiredAt();
+    if(risenAt >= firedAt) dev->getNode()->reportEmission(triggerId, risenAt, boundUs);
+    else dev->getNode()->reportEmission(triggerId, firedAt, UINT16_MAX);
+}
 
-        case SocConfig::ESP32_S3_8MB :
-            leftTransducerEcho = (int) S3BotPin::left_us_transducer_echo;
-            rightTransducerEcho = (int) S3BotPin::right_us_transducer_echo;
-            leftObsEcho = (int) S3BotPin::left_hcsr04_echo;
-            rightObsEcho = (int) S3BotPin::right_hcsr04_echo;
-            log_e("Succesfully Attached Bot Transducer Interrupt (ESP32-S3).");
-            break;
+/**
+ * Range a burst heard by the bot by its one-way flight from the belt. Must be called from a task.
+ * @param triggerId Trigger the burst was fired for.
+ * @param arrivalAt When the burst was heard (in microseconds).
+ * @param boundUs Bound on arrivalAt's error (in microseconds).
+ * @param inches Set to the range when ranged.
+ * @return False if the belt's emission time didn't come in time, or doesn't fit the arrival.
+ */
+bool PeripheralManager::rangeOneWay(uint16_t triggerId, int64_t arrivalAt, uint32_t boundUs, float *inches) {
+    if(triggerId == 0) return false;
+    EspNowNode *node = dev->getNode();
+    RANGE_RESULT result;
 
-        default:
-            log_e("Invalid Soc Config. No Valid interrutps.");
-            break;
+    // The emission time may still be on its way over the radio.
+    TickType_t waited = 0;
+    for(;;) {
+        RangeStatus status = node->rangeOneWay(triggerId, arrivalAt, boundUs, &result);
+        if(status == range_OK) {
+            *inches = result.inches;
+            return true;
+        }
+        if(status == range_IMPLAUSIBLE) return false;
+        if(waited >= pdMS_TO_TICKS(RANGING_WAIT_MS)) break;
+        vTaskDelay(1);
+        waited++;
     }
+    node->recordRangeUnmatched();
+    return false;
+}
 
-    attachInterruptArg(
-        leftTransducerEcho, 
-        on_transducer_us_echo_changed, 
-        this->leftRxTransducer, 
-        CHANGE
-    );
+uint16_t PeripheralManager::getFiredTriggerId() { return dev->getFiredTriggerId(); }
 
-    attachInterruptArg(
-        rightTransducerEcho, 
-        on_transducer_us_echo_changed, 
-        this->rightRxTransducer, 
-        CHANGE
-    );
+/**
+ * Fold a receiver's range into the target's track.
+ * @param id The receiving transducer that heard the burst.
+ * @param arrivalAt When the burst was heard (in microseconds).
+ * @param inches Distance from the belt to the receiver.
+ */
+void PeripheralManager::observeRange(SensorID id, int64_t arrivalAt, float inches) {
+    RxSide side;
+    if(id == SensorID::leftRxTransducer) side = side_LEFT;
+    else if(id == SensorID::rightRxTransducer) side = side_RIGHT;
+    else return;
+
+    xSemaphoreTake(trackerMutex, portMAX_DELAY);
+    tracker.observeRange(side, arrivalAt, inches);
+    xSemaphoreGive(trackerMutex);
+}
 
-    // Attach interrupts fro echo pins on 2 obstacle detection HC-SR04s.
-    attachInterruptArg(
-        leftObsEcho, 
-        on_hcsr04_us_echo_changed, 
-        this->leftObsDetUS, 
-        CHANGE
-    );
+/**
+ * Steer the target's track by the bearing from when each receiver heard the same burst. Their difference
+ * of arrival takes a single subtraction of capture ticks and the baseline to give the bearing, and carries
+ * none of either range's error.
+ * @param id The receiving transducer that heard the burst.
+ * @param triggerId Trigger the burst was fired for, pairing the two receivers' arrivals.
+ */
+void PeripheralManager::observeArrival(SensorID id, uint16_t triggerId) {
+    RxSide side;
+    if(id == SensorID::leftRxTransducer) side = side_LEFT;
+    else if(id == SensorID::rightRxTransducer) side = side_RIGHT;
+    else return;
+    HCSR04 *transducer = fetchUS(id);
+    int64_t arrivalAt = transducer->getEchoEndAt();
+    uint32_t ticks = rxSharedTimebase ? transducer->getEchoEndTicks() : (uint32_t) arrivalAt;
+
+    BEARING_RESULT result;
+    TARGET_ESTIMATE estimate;
+    xSemaphoreTake(trackerMutex, portMAX_DELAY);
+    // The track's range, when there is one, corrects the bearing for a close target.
+    tracker.estimate(arrivalAt, &estimate);
+    BearingStatus status = bearingEstimator.observeArrival(side, triggerId, ticks, estimate.tracking ? estimate.range : 0, &result);
+    if(status == bearing_OK) tracker.observeBearing(arrivalAt, result.bearing, result.sigma);
+    xSemaphoreGive(trackerMutex);
+
+    if(status == bearing_OK) publishBearing(result.bearing);
+    else if(status == bearing_IMPLAUSIBLE) log_e("Trigger %u: receivers heard the burst %d us apart, wider than the baseline allows.", triggerId, (int) result.tdoaUs);
+}
 
-    attachInterruptArg(
-        rightObsEcho, 
-        on_hcsr04_us_echo_changed, 
-        this->rightObsDetUS, 
-        CHANGE
-    );
+void PeripheralManager::updateTargetEstimate(int64_t now) {
+    // Predict under the mutex, and only hold the spinlock to hand the result over.
+    TARGET_ESTIMATE estimate;
+    xSemaphoreTake(trackerMutex, portMAX_DELAY);
+    tracker.estimate(now, &estimate);
+    xSemaphoreGive(trackerMutex);
+
+    taskENTER_CRITICAL(&trackerLock);
+    targetEstimate = estimate;
+    taskEXIT_CRITICAL(&trackerLock);
+}
+
+TARGET_ESTIMATE PeripheralManager::getTargetEstimate() {
+    taskENTER_CRITICAL(&trackerLock);
+    TARGET_ESTIMATE res = targetEstimate;
+    taskEXIT_CRITICAL(&trackerLock);
+    return res;
+}
+
+void PeripheralManager::followTarget() {
+    if(driveSystem == NULL) return;
+    DRIVE_COMMAND command = followCommand(getTargetEstimate(), followDistance);
+    driveSystem->drive(command.left, command.right);
 }
 
 // Per name.
@@ -288,12 +400,91 @@ void PeripheralManager::beginTasks() {
         taskCreated = beginPollObstacleDetectionUssTask();
         if(taskCreated != pdPASS) log_e("Read Ultrasonic Sensor task not created. Fail Code: %d\n", taskCreated);
         else log_e("Read Ultrasonic Sensor task created.");
+
+        taskCreated = beginDriveTask();
+        if(taskCreated != pdPASS) log_e("Drive task not created. Fail Code: %d\n", taskCreated);
+        else log_e("Drive task created.");
     }
     
 }
 
 bool PeripheralManager::isTransmitter() { return dev->isTransmitter(); }
 
+void PeripheralManager::publishDistance(SensorID id, float inches) {
+    // Distances go out in hundredths of an inch, clamped to the field's range.
+    float hundredths = inches * 100;
+    if(hundredths > INT16_MAX) hundredths = INT16_MAX;
+    if(hundredths < 0) hundredths = 0;
+
+    // Each receiver reports on its own; the side not measured is left unset.
+    TELEMETRY_SAMPLE sample = {};
+    sample.leftDistance = (id == SensorID::leftRxTransducer) ? (int16_t) hundredths : TELEMETRY_NO_VALUE;
+    sample.rightDistance = (id == SensorID::rightRxTransducer) ? (int16_t) hundredths : TELEMETRY_NO_VALUE;
+    sample.bearing = TELEMETRY_NO_VALUE;
+    fillDriveState(&sample);
+    dev->recordTelemetry(sample);
+}
+
+void PeripheralManager::publishBearing(float degrees) {
+    // Bearings go out in hundredths of a degree, alone in their sample.
+    TELEMETRY_SAMPLE sample = {};
+    sample.leftDistance = TELEMETRY_NO_VALUE;
+    sample.rightDistance = TELEMETRY_NO_VALUE;
+    sample.bearing = (int16_t) (degrees * 100);
+    fillDriveState(&sample);
+    dev->recordTelemetry(sample);
+}
+
+void PeripheralManager::fillDriveState(TELEMETRY_SAMPLE *sample) {
+    // Duties go out as percent of full, positive forward.
+    if(driveSystem != NULL) {
+        sample->leftMotor = (int8_t) (driveSystem->getLeftDuty() * 100 / LED_C_HIGH);
+        sample->rightMotor = (int8_t) (driveSystem->getRightDuty() * 100 / LED_C_HIGH);
+    }
+    sample->obstacleFlags = obstacleFlags;
+}
+
+void PeripheralManager::applyConfig(const ConfigStore &config) {
+    // Every sensor fitted to this device takes the same thresholds.
+    HCSR04 *sensors[] = {txTransducer, leftRxTransducer, rightRxTransducer, leftObsDetUS, rightObsDetUS};
+    for(HCSR04 *sensor : sensors) {
+        if(sensor == NULL) continue;
+        sensor->setObstacleDetectionThreshold(config.get(cfg_OBSTACLE_LIMIT));
+        sensor->setHpeThreshold(config.get(cfg_PRESENCE_LIMIT));
+        sensor->setHpeSensitivity(config.get(cfg_PRESENCE_DIFF), config.get(cfg_PRESENCE_WEAK), config.get(cfg_PRESENCE_STRONG));
+    }
+}
+
+void PeripheralManager::executeCommand(const COMMAND_ENTRY &command) {
+    switch(command.type) {
+        // Stop first; everything else can wait.
+        case cmd_STOP :
+            if(driveSystem != NULL) driveSystem->halt(BRAKE);
+            break;
+
+        case cmd_RESUME :
+            if(driveSystem != NULL) driveSystem->resume();
+            break;
+
+        case cmd_SET_FOLLOW_DISTANCE :
+            if(command.value > 0) followDistance = command.value;
+            break;
+
+        case cmd_SET_SPEED_CAP :
+            if(driveSystem != NULL) driveSystem->setSpeedCap((int) command.value);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void PeripheralManager::updateObstacleFlags(char left, char right) {
+    // Only the obstacle and presence bits fit, a nibble per sensor.
+    const char mask = OBSTACLE_THRESHOLD_BREACHED | PRESENCE_THRESHOLD_BREACHED;
+    obstacleFlags = (uint8_t) ((left & mask) | ((right & mask) << 4));
+}
+
 HCSR04* PeripheralManager::fetchUS(SensorID id) {
     HCSR04 *res = NULL;
     switch (id) {
@@ -429,7 +620,7 @@ void PeripheralManager::constructBeltPeripherals() {
     }
 
     // Construct the belt peripheral.
-    this->txTransducer = new HCSR04(
+    this->txTransducer = new TransducerHCSR04(
         trig, 
         echo, 
         SensorID::txTransducer, 
@@ -484,7 +675,7 @@ void PeripheralManager::constructBotPeripherals() {
     }
 
     // Construct Bot peripherals.
-    this->leftRxTransducer = new HCSR04(
+    this->leftRxTransducer = new TransducerHCSR04(
         leftTransducerTrig,
         leftTransducerEcho,
         SensorID::leftRxTransducer,
@@ -492,7 +683,7 @@ void PeripheralManager::constructBotPeripherals() {
         T_US_READY
     );
 
-    this->rightRxTransducer = new HCSR04(
+    this->rightRxTransducer = new TransducerHCSR04(
         rightTransducerTrig,
         rightTransducerEcho,
         SensorID::rightRxTransducer,
@@ -500,7 +691,7 @@ void PeripheralManager::constructBotPeripherals() {
         T_US_READY
     );
 
-    this->rightObsDetUS = new HCSR04(
+    this->rightObsDetUS = new ObstacleHCSR04(
         rightObsTrig,
         rightObsEcho,
         SensorID::rightObsDet,
@@ -508,7 +699,7 @@ void PeripheralManager::constructBotPeripherals() {
         R_US_READY
     );
 
-    this->leftObsDetUS = new HCSR04(
+    this->leftObsDetUS = new ObstacleHCSR04(
         leftObsTrig,
         leftObsEcho,
         SensorID::leftObsDet,
@@ -516,6 +707,8 @@ void PeripheralManager::constructBotPeripherals() {
         L_US_READY
     );
 
+    bearingEstimator.setSkew(TDOA_SKEW_US);
+
     driveSystem = new BTS7960(
         leftMotLeftPWM,
         leftMotRightPWM,
@@ -528,7 +721,17 @@ void PeripheralManager::initDriveSystem() {
     driveSystem->init();
 }
 
+// Create the task that hands the target estimate to the drive system.
 BaseType_t PeripheralManager::beginDriveTask() {
     BaseType_t res;
+    res = xTaskCreatePinnedToCore(
+        &drive_task,                        // Pointer to task function.
+        "drive_Task",                       // Task name.
+        TaskStackDepth::tsd_DRIVE,          // Size of stack allocated to the task (in bytes).
+        this,                               // Pointer to parameters used for task creation.
+        TaskPriorityLevel::tpl_MEDIUM_HIGH, // Task priority level.
+        &drive_task_handle,                 // Pointer to task handle.
+        1                                   // Core that the task will run on.
+    );
     return res;
 }
\ No newline at end of file
@@ -6,6 +6,12 @@
 
 #include "../HCSR04/HCSR04.h"
 #include "../BTS7960/BTS7960.h"
+#include "../EspNowNode/TelemetryPacker.h"
+#include "../EspNowNode/ConfigStore.h"
+#include "../EspNowNode/CommandQueue.h"
+#include "../TargetTracker/TargetTracker.h"
+#include "../TargetTracker/TdoaBearing.h"
+#include "../TargetTracker/FollowControl.h"
 #include "config.h"
 #include <Preferences.h>
 
@@ -21,18 +27,17 @@ typedef uint32_t milliSeconds;      // Milliseconds.
 #define US_READ_TIME ((milliSeconds) pdMS_TO_TICKS(TTR_US))     // The maximum time it takes to read an ultrasonic sensor (in ticks).
 #define MAX_US_POLL_TIME ((4 * US_READ_TIME) + 10)              // The delay between polling all 4 ultrasonic sensors w/ some buffer time.
 
-void IRAM_ATTR on_transducer_us_echo_changed(void *arg);        // ISR that deals with timing of front ultrasonic sensor's trigger pulse. Arg is a ref to sensor in question.
-void IRAM_ATTR on_hcsr04_us_echo_changed(void *arg);              // ISR that deals with timing of left ultrasonic sensor's trigger pulse. Arg is a ref to sensor in question.
-
 extern TaskHandle_t trig_tx_transducer_task_handle;             // Handle to task that triggers the transmitters distance measuring transducer.
 extern TaskHandle_t trig_left_rx_transducer_task_handle;        // Handle to task that triggers the receivers left distance measuring transducer.
 extern TaskHandle_t trig_right_rx_transducer_task_handle;       // Handle to task that triggers the receivers left distance measuring transducer.
 extern TaskHandle_t poll_obs_detection_uss_handle;              // Handle to task that triggers reading the obstacle detection uss.
+extern TaskHandle_t drive_task_handle;                          // Handle to task that hands the target estimate to the drive system.
 
 void trig_tx_transducer_task(void *pvPeripheralManager);        // Task function that triggers the transmitters distance measuring transducer.
 void trig_left_rx_transducer_task(void *pvPeripheralManager);   // Task function that triggers the receivers left distance measuring transducer.
 void trig_right_rx_transducer_task(void *pvPeripheralManager);  // Task function that triggers the receivers left distance measuring transducer.
 void poll_obs_detection_uss_task(void *pvPeripheralManager);    // Task function that triggers reading the obstacle detection uss. 
+void drive_task(void *pvPeripheralManager);                     // Task function that hands the target estimate to the drive system.
 
 /**
  * Class used to manage device peripherals.
@@ -46,6 +51,8 @@ class PeripheralManager {
         void constructBotPeripherals();
         void attachBeltInterrupts();
         void attachBotInterrupts();
+        void attachEcho(HCSR04 *sensor);
+        void attachEchoPair(HCSR04 *left, HCSR04 *right);
 
     public:
         /**
@@ -58,6 +65,13 @@ class PeripheralManager {
         void attachInterrupts();    // Attach all interrupts.     
         void beginTasks();          // Begin all tasks.
         bool isTransmitter();       
+        void publishDistance(SensorID id, float inches);   // Queue a distance reading as telemetry for the peer.
+        void publishBearing(float degrees);                 // Queue a bearing as telemetry for the peer.
+        void applyConfig(const ConfigStore &config);        // Apply the sensor thresholds of the replicated config.
+        void executeCommand(const COMMAND_ENTRY &command);  // Carry out a command from the peer.
+        void reportEmission(int64_t risenAt, uint32_t boundUs);    // Tell the bot when the belt's burst went out.
+        bool rangeOneWay(uint16_t triggerId, int64_t arrivalAt, uint32_t boundUs, float *inches);  // Range a burst heard by the bot by its one-way flight.
+        uint16_t getFiredTriggerId();                       // Trigger the transducers last fired for. Zero if unscheduled.
 
     //************************************************************************************/
     
@@ -72,6 +86,7 @@ class PeripheralManager {
         float isrPulseDuration = -1;        // Stores the duration of the pulse captured by ISR.
         unsigned long isrPulseStart = -1;   // Stores the time at which the sensor's echo has begun from ISR.
         unsigned long isrPulseEnd = -1;     // Stores the time at which the sensor's echo has finished from ISR.    
+        volatile uint8_t obstacleFlags = 0; // Obstacle sensors' threshold flags, packed as in TELEMETRY_SAMPLE.
         
         BaseType_t beginTriggerTxTransducerTask();
         BaseType_t beginTriggerLeftRxTransducerTask();
@@ -82,15 +97,32 @@ class PeripheralManager {
         BaseType_t beginTransducerTriggerTasks();
         BaseType_t beginPollObstacleDetectionUssTask();
         HCSR04 *fetchUS(SensorID id);
+        void updateObstacleFlags(char left, char right);    // Keep the obstacle sensors' latest threshold flags for telemetry.
     //************************************************************************************/
 
     //*****************************  Drive System  *********************************/
     private:  
-        BTS7960 *driveSystem;
+        BTS7960 *driveSystem = NULL;        // Drive motors (if device == Bot).
+        float followDistance = FOLLOW_DISTANCE_IN;  // Distance to keep from the target (inches).
+
+        TargetTracker tracker = TargetTracker(RX_BASELINE_IN);     // Fuses both receivers' ranges into the target's motion.
+        TdoaBearing bearingEstimator = TdoaBearing(RX_BASELINE_IN);    // Bearing from the receivers' difference of arrival.
+        bool rxSharedTimebase = false;                              // Are both receivers timed by the one counter, so their ticks compare.
+        TARGET_ESTIMATE targetEstimate = {};                        // Latest estimate handed to the drive system.
+        SemaphoreHandle_t trackerMutex = NULL;                      // Guards the tracker and the bearing estimator, whose math is too long to run with interrupts off.
+        portMUX_TYPE trackerLock = portMUX_INITIALIZER_UNLOCKED;   // Guards the estimate.
+
+        void fillDriveState(TELEMETRY_SAMPLE *sample);              // Stamp a sample with the motors' duties and the obstacle flags.
 
     public:
         void initDriveSystem();
         BaseType_t beginDriveTask();
+        float getFollowDistance() { return followDistance; }
+        void observeRange(SensorID id, int64_t arrivalAt, float inches);   // Fold a receiver's range into the target's track.
+        void observeArrival(SensorID id, uint16_t triggerId);               // Steer the target's track by when each receiver heard a burst.
+        void updateTargetEstimate(int64_t now);                             // Predict the target's track forward to now.
+        void followTarget();                                                // Drive toward the latest estimate, keeping the follow distance.
+        TARGET_ESTIMATE getTargetEstimate();
     //************************************************************************************/
 
 };
@@ -0,0 +1,68 @@
+#include "Platform.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+
+int64_t platformMicros() { return esp_timer_get_time(); }
+
+void platformLog(const char *format, ...) {
+    char line[PLATFORM_LOG_LINE];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    Serial.println(line);
+}
+
+void platformMacAddress(uint8_t mac[6]) { WiFi.macAddress(mac); }
+
+uint8_t platformWifiChannel() { return WiFi.channel(); }
+
+int platformWifiMode() { return WiFi.getMode(); }
+
+int64_t platformWifiTsf() { return esp_wifi_get_tsf_time(WIFI_IF_AP); }
+
+#else
+
+#include <atomic>
+#include <chrono>
+
+static std::atomic<int64_t> simulatedNow{-1};    // Simulated time (us), or negative to use the monotonic clock.
+
+int64_t platformMicros() {
+    int64_t now = simulatedNow.load(std::memory_order_relaxed);
+    if(now >= 0) return now;
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void platformSetMicros(int64_t now) { simulatedNow.store(now, std::memory_order_relaxed); }
+
+void platformAdvanceMicros(int64_t us) { simulatedNow.fetch_add(us, std::memory_order_relaxed); }
+
+void platformLog(const char *format, ...) {
+    char line[PLATFORM_LOG_LINE];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    puts(line);
+}
+
+void platformMacAddress(uint8_t mac[6]) {
+    static const uint8_t host[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    for(int i = 0; i < 6; i++) mac[i] = host[i];
+}
+
+uint8_t platformWifiChannel() { return 0; }
+
+int platformWifiMode() { return 0; }
+
+int64_t platformWifiTsf() { return platformMicros(); }
+
+#endif /* ARDUINO */
@@ -0,0 +1,95 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef ARDUINO
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#else
+
+#include <mutex>
+
+// Enough of FreeRTOS for the protocol code to build on a host. There are no tasks there: the
+// caller drives the node in place of them (see EspNowNode::startPolled), so notifications and
+// delays do nothing and creating a task fails.
+typedef void *TaskHandle_t;
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL 0
+#define pdPASS 1
+#define portMAX_DELAY ((TickType_t) 0xFFFFFFFF)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms))
+
+// Critical sections become a recursive mutex, so nested sections behave as they do on the ESP32.
+struct _port_mux {
+    std::recursive_mutex mutex;
+};
+typedef struct _port_mux portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define taskENTER_CRITICAL(mux) (mux)->mutex.lock()
+#define taskEXIT_CRITICAL(mux) (mux)->mutex.unlock()
+
+inline void xTaskNotifyGive(TaskHandle_t task) {}
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) { return 0; }
+inline void vTaskDelay(TickType_t ticks) {}
+inline void vTaskDelete(TaskHandle_t task) {}
+inline BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char *name, uint32_t depth, void *params,
+                                          int priority, TaskHandle_t *handle, int core) { return pdFAIL; }
+
+#endif /* ARDUINO */
+
+/**
+ * Microseconds since boot. esp_timer on the ESP32; on a host, a monotonic clock, or the
+ * simulated one once `platformSetMicros` has been called.
+ */
+int64_t platformMicros();
+
+/**
+ * Print a formatted line to the console. Formats into a buffer on the stack rather than the
+ * heap, so it is safe to call from the ESP-NOW tasks once the alloc guard is armed. Lines
+ * longer than PLATFORM_LOG_LINE are cut short.
+ */
+void platformLog(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+#define PLATFORM_LOG_LINE 128   // Longest line platformLog prints (in characters).
+
+/**
+ * This node's station MAC address. A fixed, locally administered address on a host.
+ */
+void platformMacAddress(uint8_t mac[6]);
+
+/**
+ * Wi-Fi channel and mode the radio is in. Zero on a host.
+ */
+uint8_t platformWifiChannel();
+int platformWifiMode();
+
+/**
+ * Wi-Fi timing synchronization function timer (us). platformMicros() on a host.
+ */
+int64_t platformWifiTsf();
+
+#ifndef ARDUINO
+
+/**
+ * Run platformMicros() off a simulated clock that only moves when told, so tests step
+ * through timeouts deterministically. A negative time goes back to the monotonic clock.
+ */
+void platformSetMicros(int64_t now);
+
+/**
+ * Move the simulated clock on.
+ */
+void platformAdvanceMicros(int64_t us);
+
+#endif /* ARDUINO */
+
+#endif /* PLATFORM_H */
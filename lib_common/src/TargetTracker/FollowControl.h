@@ -0,0 +1,53 @@
+#ifndef FOLLOW_CONTROL_H
+#define FOLLOW_CONTROL_H
+
+#include "TargetTracker.h"
+
+#define FOLLOW_DUTY_MAX 255             // Full duty at the drive's PWM resolution.
+#define FOLLOW_DEADBAND_IN 3.0f         // Range beyond the follow distance the bot lets stand (inches).
+#define FOLLOW_SPEED_GAIN 6.0f          // Duty per inch of range beyond the deadband.
+#define FOLLOW_BEARING_DEADBAND_DEG 5.0f    // Bearing the bot lets stand (deg).
+#define FOLLOW_STEER_GAIN 4.0f          // Duty per degree of bearing beyond the deadband, added to one side and taken off the other.
+
+/**
+ * Duty of each side of the drive, positive forward.
+ */
+struct _drive_command {
+    int left;
+    int right;
+};
+typedef struct _drive_command DRIVE_COMMAND;
+
+/**
+ * Turn the target's estimate into a duty for each side of the drive. The bot closes on the
+ * target in proportion to how far it is beyond the follow distance, and turns toward its
+ * bearing by driving the outside harder. A target that comes closer than the follow distance
+ * is waited on rather than backed away from, and a lost target stops the bot.
+ * @param estimate The target's estimate, predicted to now.
+ * @param followDistance Distance to keep from the target (inches).
+ */
+inline DRIVE_COMMAND followCommand(const TARGET_ESTIMATE &estimate, float followDistance) {
+    DRIVE_COMMAND res = {0, 0};
+    if(!estimate.tracking) return res;
+
+    float speed = 0;
+    float error = estimate.range - followDistance;
+    if(error > FOLLOW_DEADBAND_IN) speed = (error - FOLLOW_DEADBAND_IN) * FOLLOW_SPEED_GAIN;
+    if(speed > FOLLOW_DUTY_MAX) speed = FOLLOW_DUTY_MAX;
+
+    // Positive bearings are to the right, so turn right by driving the left side harder.
+    float turn = 0;
+    if(estimate.bearing > FOLLOW_BEARING_DEADBAND_DEG) turn = (estimate.bearing - FOLLOW_BEARING_DEADBAND_DEG) * FOLLOW_STEER_GAIN;
+    if(estimate.bearing < -FOLLOW_BEARING_DEADBAND_DEG) turn = (estimate.bearing + FOLLOW_BEARING_DEADBAND_DEG) * FOLLOW_STEER_GAIN;
+
+    float sides[2] = {speed + turn, speed - turn};
+    for(float &side : sides) {
+        if(side > FOLLOW_DUTY_MAX) side = FOLLOW_DUTY_MAX;
+        if(side < -FOLLOW_DUTY_MAX) side = -FOLLOW_DUTY_MAX;
+    }
+    res.left = (int) sides[0];
+    res.right = (int) sides[1];
+    return res;
+}
+
+#endif /* FOLLOW_CONTROL_H */
@@ -0,0 +1,146 @@
+#include "TargetTracker.h"
+#include <math.h>
+#include <string.h>
+
+#define DEG_PER_RAD 57.29578f
+#define HALF_PI 1.5707963f
+
+void TargetTracker::predict(float state[4], float cov[4][4], float dt) const {
+    state[0] += state[1] * dt;
+    state[2] += state[3] * dt;
+
+    // P = F P F' with F advancing each position by its rate.
+    for(int i = 0; i < 4; i++) {
+        cov[i][0] += cov[i][1] * dt;
+        cov[i][2] += cov[i][3] * dt;
+    }
+    for(int j = 0; j < 4; j++) {
+        cov[0][j] += cov[1][j] * dt;
+        cov[2][j] += cov[3][j] * dt;
+    }
+
+    // Plus the spread a random acceleration over dt adds to each position and rate.
+    float dt2 = dt * dt;
+    float accel[2] = {TRACK_RANGE_ACCEL * TRACK_RANGE_ACCEL, (TRACK_BEARING_ACCEL / DEG_PER_RAD) * (TRACK_BEARING_ACCEL / DEG_PER_RAD)};
+    for(int k = 0; k < 2; k++) {
+        int p = 2 * k, v = p + 1;
+        cov[p][p] += accel[k] * dt2 * dt2 / 4;
+        cov[p][v] += accel[k] * dt2 * dt / 2;
+        cov[v][p] += accel[k] * dt2 * dt / 2;
+        cov[v][v] += accel[k] * dt2;
+    }
+}
+
+void TargetTracker::start(int64_t time, float inches) {
+    memset(x, 0, sizeof(x));
+    memset(P, 0, sizeof(P));
+    x[0] = inches;
+    P[0][0] = rangeVar;
+    P[1][1] = TRACK_INITIAL_RATE * TRACK_INITIAL_RATE;
+    P[2][2] = (TRACK_INITIAL_BEARING / DEG_PER_RAD) * (TRACK_INITIAL_BEARING / DEG_PER_RAD);
+    P[3][3] = (TRACK_INITIAL_TURN / DEG_PER_RAD) * (TRACK_INITIAL_TURN / DEG_PER_RAD);
+    at = time;
+    lastRangeAt = time;
+    started = true;
+    rejectsInRow = 0;
+    stats.restarts++;
+}
+
+bool TargetTracker::observeRange(RxSide side, int64_t time, float inches) {
+    if(side >= side_COUNT) return false;
+    if(!started || rejectsInRow >= TRACK_MAX_REJECTS || time - lastRangeAt > TRACK_LOST_US) {
+        start(time, inches);
+        stats.ranges[side]++;
+        return true;
+    }
+
+    // The other receiver's range of the same burst may have been taken first; it is close enough to now.
+    if(time > at) {
+        predict(x, P, (time - at) / 1e6f);
+        at = time;
+    }
+
+    // The receivers sit half the baseline either side of the middle, the left one on the negative side,
+    // so a target off to the right is further from the left receiver.
+    float sign = (side == side_LEFT) ? 1.0f : -1.0f;
+    float r = x[0], sinB = sinf(x[2]), cosB = cosf(x[2]);
+    float halfBase = baseline / 2;
+    float squared = r * r + sign * r * baseline * sinB + halfBase * halfBase;
+    float predicted = sqrtf(squared > 1e-6f ? squared : 1e-6f);
+
+    // Linearize the range about the state. Only range and bearing enter it.
+    float H0 = (r + sign * halfBase * sinB) / predicted;
+    float H2 = sign * r * halfBase * cosB / predicted;
+    float PHt[4];
+    for(int i = 0; i < 4; i++) PHt[i] = P[i][0] * H0 + P[i][2] * H2;
+    float S = H0 * PHt[0] + H2 * PHt[2] + rangeVar;
+
+    float innovation = inches - predicted;
+    if(innovation * innovation > TRACK_GATE_SIGMA * TRACK_GATE_SIGMA * S) {
+        rejectsInRow++;
+        stats.rejected++;
+        return false;
+    }
+
+    for(int i = 0; i < 4; i++) x[i] += PHt[i] / S * innovation;
+    for(int i = 0; i < 4; i++) {
+        for(int j = 0; j < 4; j++) P[i][j] -= PHt[i] * PHt[j] / S;
+    }
+
+    // The receivers can't tell in front from behind, so the target is kept in front.
+    if(x[0] < 0) x[0] = 0;
+    if(x[2] > HALF_PI) x[2] = HALF_PI;
+    if(x[2] < -HALF_PI) x[2] = -HALF_PI;
+
+    lastRangeAt = time;
+    rejectsInRow = 0;
+    stats.ranges[side]++;
+    return true;
+}
+
+bool TargetTracker::observeBearing(int64_t time, float degrees, float sigmaDeg) {
+    if(!started || rejectsInRow >= TRACK_MAX_REJECTS || time - lastRangeAt > TRACK_LOST_US) return false;
+    if(time > at) {
+        predict(x, P, (time - at) / 1e6f);
+        at = time;
+    }
+
+    // The bearing is measured as is, so the update only involves the bearing's row of the covariance.
+    float measured = degrees / DEG_PER_RAD, sigma = sigmaDeg / DEG_PER_RAD;
+    float S = P[2][2] + sigma * sigma;
+    float innovation = measured - x[2];
+    if(innovation * innovation > TRACK_GATE_SIGMA * TRACK_GATE_SIGMA * S) {
+        stats.rejected++;
+        return false;
+    }
+
+    float PHt[4];
+    for(int i = 0; i < 4; i++) PHt[i] = P[i][2];
+    for(int i = 0; i < 4; i++) x[i] += PHt[i] / S * innovation;
+    for(int i = 0; i < 4; i++) {
+        for(int j = 0; j < 4; j++) P[i][j] -= PHt[i] * PHt[j] / S;
+    }
+    if(x[0] < 0) x[0] = 0;
+    if(x[2] > HALF_PI) x[2] = HALF_PI;
+    if(x[2] < -HALF_PI) x[2] = -HALF_PI;
+
+    stats.bearings++;
+    return true;
+}
+
+void TargetTracker::estimate(int64_t time, TARGET_ESTIMATE *out) const {
+    float state[4], cov[4][4];
+    memcpy(state, x, sizeof(state));
+    memcpy(cov, P, sizeof(cov));
+    if(started && time > at) predict(state, cov, (time - at) / 1e6f);
+
+    out->range = state[0];
+    out->rangeRate = state[1];
+    out->bearing = state[2] * DEG_PER_RAD;
+    out->bearingRate = state[3] * DEG_PER_RAD;
+    out->rangeSigma = sqrtf(cov[0][0]);
+    out->rangeRateSigma = sqrtf(cov[1][1]);
+    out->bearingSigma = sqrtf(cov[2][2]) * DEG_PER_RAD;
+    out->bearingRateSigma = sqrtf(cov[3][3]) * DEG_PER_RAD;
+    out->tracking = started && time - lastRangeAt <= TRACK_LOST_US;
+}
@@ -0,0 +1,122 @@
+#ifndef TARGET_TRACKER_H
+#define TARGET_TRACKER_H
+
+#include <stdint.h>
+
+#define TRACK_RANGE_SIGMA_IN 1.0f       // Noise of a single receiver's range (inches).
+#define TRACK_RANGE_ACCEL 40.0f         // Spread of the target's acceleration along the range (in/s^2). About 1 m/s^2.
+#define TRACK_BEARING_ACCEL 90.0f       // Spread of the target's angular acceleration about the bot (deg/s^2).
+#define TRACK_INITIAL_RATE 24.0f        // Spread of the range rate when a track starts (in/s).
+#define TRACK_INITIAL_BEARING 45.0f     // Spread of the bearing when a track starts (deg).
+#define TRACK_INITIAL_TURN 30.0f        // Spread of the bearing rate when a track starts (deg/s).
+#define TRACK_GATE_SIGMA 4.0f           // Ranges further than this many deviations from the prediction are rejected.
+#define TRACK_MAX_REJECTS 4             // Rejections in a row after which the track restarts on the next range.
+#define TRACK_LOST_US 1000000           // Without a range for this long the target counts as lost (us).
+
+/**
+ * Receiver a range was measured by.
+ */
+enum _rx_side : uint8_t {
+    side_LEFT = 0,
+    side_RIGHT,
+    side_COUNT
+};
+typedef enum _rx_side RxSide;
+
+struct _target_estimate {
+    float range;            // Distance from the middle of the receivers to the target (inches).
+    float rangeRate;        // Rate the range grows at (in/s).
+    float bearing;          // Angle of the target off straight ahead, positive to the right (degrees).
+    float bearingRate;      // Rate the bearing turns at (deg/s).
+    float rangeSigma;       // Standard deviation of each of the above, from the covariance.
+    float rangeRateSigma;
+    float bearingSigma;
+    float bearingRateSigma;
+    bool tracking;          // Has the target been ranged within TRACK_LOST_US.
+};
+typedef struct _target_estimate TARGET_ESTIMATE;
+
+struct _tracker_stats {
+    uint32_t ranges[side_COUNT];    // Ranges taken per receiver.
+    uint32_t bearings;              // Bearings taken.
+    uint32_t rejected;              // Ranges and bearings rejected by the gate.
+    uint32_t restarts;              // Tracks started, the first included.
+};
+typedef struct _tracker_stats TRACKER_STATS;
+
+/**
+ * Tracks the target's range, range rate, bearing and bearing rate with an extended Kalman
+ * filter, fusing each receiver's range on its own as it comes. Both receivers hear the same
+ * burst from either side of the bot, so their difference is what carries the bearing. A
+ * missed range costs nothing but a wider covariance: the state is predicted forward to
+ * whenever it is next ranged or asked for. Fixed size, no heap. Not thread safe.
+ */
+class TargetTracker {
+    private:
+        float baseline;                 // Distance between the receivers (inches).
+        float rangeVar;                 // Variance of a single range (in^2).
+
+        float x[4] = {0};               // Range (in), range rate (in/s), bearing (rad), bearing rate (rad/s).
+        float P[4][4] = {{0}};          // Covariance of x.
+        int64_t at = 0;                 // Time x is for (us).
+        bool started = false;           // Has a track been started.
+        int64_t lastRangeAt = 0;        // When the target was last ranged (us).
+        int rejectsInRow = 0;
+        TRACKER_STATS stats = {};
+
+        /**
+         * Predict a state and its covariance forward under constant velocity.
+         * @param dt Time to predict over (s).
+         */
+        void predict(float state[4], float cov[4][4], float dt) const;
+
+        /**
+         * Start a track at a single range, straight ahead until the receivers tell otherwise.
+         */
+        void start(int64_t time, float inches);
+
+    public:
+        /**
+         * Create a tracker.
+         * @param baselineIn Distance between the receivers (inches).
+         */
+        TargetTracker(float baselineIn, float rangeSigmaIn = TRACK_RANGE_SIGMA_IN) :
+            baseline(baselineIn),
+            rangeVar(rangeSigmaIn * rangeSigmaIn) {}
+
+        /**
+         * Fold in a range measured by a receiver.
+         * @param time When the burst arrived (us). A range older than the track is taken as current.
+         * @param inches Distance from the belt to the receiver.
+         * @return False if the range was rejected as too far off the track.
+         */
+        bool observeRange(RxSide side, int64_t time, float inches);
+
+        /**
+         * Fold in a bearing measured directly, such as from the receivers' difference of arrival.
+         * Only steers a track the ranges have started.
+         * @param time When the burst arrived (us). A bearing older than the track is taken as current.
+         * @param degrees Angle off straight ahead, positive to the right.
+         * @param sigmaDeg Standard deviation of the bearing (degrees).
+         * @return False if there is no track or the bearing was rejected as too far off it.
+         */
+        bool observeBearing(int64_t time, float degrees, float sigmaDeg);
+
+        /**
+         * The estimate predicted forward to a time, leaving the track as it is.
+         * @param time Time to predict to (us). An earlier time than the track's gives the track's.
+         */
+        void estimate(int64_t time, TARGET_ESTIMATE *out) const;
+
+        /**
+         * Drop the track, for instance when the target is known to have changed.
+         */
+        void reset() {
+            started = false;
+            rejectsInRow = 0;
+        }
+
+        TRACKER_STATS getStats() const { return stats; }
+};
+
+#endif /* TARGET_TRACKER_H */
@@ -0,0 +1,65 @@
+#include "TdoaBearing.h"
+#include <math.h>
+
+#define DEG_PER_RAD 57.29578f
+
+/**
+ * Arc sine, taking values past either end as the end.
+ */
+static float clampedAsin(float s) {
+    if(s > 1) s = 1;
+    if(s < -1) s = -1;
+    return asinf(s);
+}
+
+BearingStatus TdoaBearing::solve(float tdoaUs, float rangeIn, BEARING_RESULT *result) const {
+    float tdoa = tdoaUs - skewUs;
+    float delta = tdoa / TDOA_US_PER_INCH;                              // Left path less right path (inches).
+    float deltaSigma = 1.4142136f * TDOA_TIMING_SIGMA_US / TDOA_US_PER_INCH;
+    result->tdoaUs = tdoa;
+    if(fabsf(delta) > baseline + TDOA_GATE_SIGMA * deltaSigma) return bearing_IMPLAUSIBLE;
+
+    // With the receivers at half the baseline either side of the middle, the squared paths differ by
+    // 2 r b sin(bearing) and sum to 2 r^2 + b^2 / 2. Far off, that leaves sin(bearing) = delta / b.
+    float scale;                // How much the sine moves per inch of path difference.
+    if(rangeIn > baseline / 2) {
+        float sum = 4 * rangeIn * rangeIn + baseline * baseline - delta * delta;
+        scale = sqrtf(sum > 0 ? sum : 0) / (2 * rangeIn * baseline);
+    }
+    else scale = 1 / baseline;
+    // Noise can carry the sine just past either end when the target is side on.
+    float sinBearing = delta * scale;
+    if(sinBearing > 1) sinBearing = 1;
+    if(sinBearing < -1) sinBearing = -1;
+
+    // The bearing's spread, taken across the sines one deviation either side, so it stays finite side on.
+    float sinSigma = deltaSigma * scale;
+    float sigma = (clampedAsin(sinBearing + sinSigma) - clampedAsin(sinBearing - sinSigma)) / 2 * DEG_PER_RAD;
+    float confidence = 1 - sigma / TDOA_MAX_SIGMA_DEG;
+
+    result->bearing = asinf(sinBearing) * DEG_PER_RAD;
+    result->sigma = sigma;
+    result->confidence = (confidence < 0) ? 0 : (confidence > 1) ? 1 : confidence;
+    return bearing_OK;
+}
+
+BearingStatus TdoaBearing::observeArrival(RxSide side, uint16_t triggerId, uint32_t ticks, float rangeIn, BEARING_RESULT *result) {
+    if(side >= side_COUNT || triggerId == 0) return bearing_PENDING;
+    RxSide other = (side == side_LEFT) ? side_RIGHT : side_LEFT;
+
+    // Another trigger's arrival still held on this side never found its pair.
+    if(arrivals[side].held) stats.unpaired++;
+    arrivals[side].triggerId = triggerId;
+    arrivals[side].ticks = ticks;
+    arrivals[side].held = true;
+    if(!arrivals[other].held || arrivals[other].triggerId != triggerId) return bearing_PENDING;
+
+    arrivals[side_LEFT].held = false;
+    arrivals[side_RIGHT].held = false;
+    // Signed difference, so arrivals either side of the counter's wrap compare right.
+    int32_t tdoaTicks = (int32_t) (arrivals[side_LEFT].ticks - arrivals[side_RIGHT].ticks);
+    BearingStatus status = solve((float) ((double) tdoaTicks * 1000000 / resolutionHz), rangeIn, result);
+    if(status == bearing_OK) stats.solved++;
+    else stats.implausible++;
+    return status;
+}
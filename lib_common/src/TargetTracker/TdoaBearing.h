@@ -0,0 +1,98 @@
+#ifndef TDOA_BEARING_H
+#define TDOA_BEARING_H
+
+#include <stdint.h>
+#include "TargetTracker.h"
+
+#define TDOA_US_PER_INCH 74.0f          // Flight time of sound per inch (us).
+#define TDOA_TIMING_SIGMA_US 10.0f      // Jitter of a single arrival, mostly the receiver's detection of the burst (us).
+#define TDOA_GATE_SIGMA 3.0f            // Path differences this many deviations longer than the baseline are rejected.
+#define TDOA_MAX_SIGMA_DEG 20.0f        // Bearing deviation at which the confidence reaches zero (deg).
+
+/**
+ * Outcome of an arrival handed to the estimator.
+ */
+enum _bearing_status : uint8_t {
+    bearing_OK,             // Both receivers heard the burst; a bearing was solved.
+    bearing_PENDING,        // Waiting on the other receiver to hear the same burst.
+    bearing_IMPLAUSIBLE     // The arrivals are further apart than the baseline allows.
+};
+typedef enum _bearing_status BearingStatus;
+
+struct _bearing_result {
+    float bearing;          // Angle of the target off straight ahead, positive to the right (degrees).
+    float sigma;            // Standard deviation of the bearing from timestamp jitter (degrees).
+    float confidence;       // 1 for a bearing known to within a degree or so, falling to 0 at TDOA_MAX_SIGMA_DEG.
+    float tdoaUs;           // Left arrival less right arrival, after the skew (us).
+};
+typedef struct _bearing_result BEARING_RESULT;
+
+struct _bearing_stats {
+    uint32_t solved;        // Bearings solved.
+    uint32_t implausible;   // Pairs whose arrivals were too far apart.
+    uint32_t unpaired;      // Arrivals dropped before the other receiver heard the same burst.
+};
+typedef struct _bearing_stats BEARING_STATS;
+
+/**
+ * Bearing from the time difference of arrival of one burst at the left and right receivers.
+ * Both arrivals are capture ticks of the one counter, paired by the trigger they were fired
+ * for, so when the trigger went off, and how long either receiver took to fire, cancel out,
+ * and no mapping into another clock adds its error. Only the path difference is left, which
+ * with the baseline fixes the bearing. Not thread safe.
+ */
+class TdoaBearing {
+    private:
+        struct _arrival {
+            uint16_t triggerId;
+            uint32_t ticks;         // When the burst was heard (ticks).
+            bool held;
+        };
+        _arrival arrivals[side_COUNT] = {};
+        float baseline;             // Distance between the receivers (inches).
+        uint32_t resolutionHz = 1000000;    // Ticks per second of the arrivals' counter.
+        int32_t skewUs = 0;         // Fixed lag of the left receiver's timestamps over the right's (us).
+        BEARING_STATS stats = {};
+
+    public:
+        /**
+         * Create an estimator.
+         * @param baselineIn Distance between the receivers (inches).
+         */
+        TdoaBearing(float baselineIn) : baseline(baselineIn) {}
+
+        /**
+         * Solve the bearing for a difference of arrival.
+         * @param tdoaUs Left arrival less right arrival (us). Positive when the target is to the right.
+         * @param rangeIn Distance from the middle of the receivers to the target, or zero if unknown.
+         *                A known range corrects for the wavefront's curvature up close.
+         */
+        BearingStatus solve(float tdoaUs, float rangeIn, BEARING_RESULT *result) const;
+
+        /**
+         * Take a receiver's arrival, solving the bearing once the other receiver has heard the same burst.
+         * @param triggerId Trigger the burst was fired for. Zero, for an unscheduled trigger, can't be paired.
+         * @param ticks When the burst was heard, on the counter both receivers are timed by.
+         * @param rangeIn As for solve.
+         */
+        BearingStatus observeArrival(RxSide side, uint16_t triggerId, uint32_t ticks, float rangeIn, BEARING_RESULT *result);
+
+        /**
+         * Set the tick rate of the arrivals' counter, dropping any arrival held.
+         */
+        void setResolution(uint32_t hz) {
+            resolutionHz = (hz > 0) ? hz : 1;
+            arrivals[side_LEFT].held = false;
+            arrivals[side_RIGHT].held = false;
+        }
+
+        /**
+         * Set the fixed lag of the left receiver's timestamps over the right's. Calibrated on the bench
+         * with the target straight ahead.
+         */
+        void setSkew(int32_t us) { skewUs = us; }
+
+        BEARING_STATS getStats() const { return stats; }
+};
+
+#endif /* TDOA_BEARING_H */
@@ -5,12 +5,34 @@
 
 #define TESTING_LEFT_RX_ONLY 0
 #define TESTING_RIGHT_RX_ONLY 0
+#define MEASURE_TRIGGER_ALIGNMENT 0     // Report the alignment error of every scheduled trigger.
 
 #define BAUD_RATE 115200
 
 typedef uint32_t milliSeconds;
 #define TTR_US 40  // Time-to-read a single ultrasonic sensor (in milliseconds).
 #define US_READ_TIME ((milliSeconds) pdMS_TO_TICKS(TTR_US))     // The maximum time it takes to read an ultrasonic sensor (in ticks).
+#define TRIGGER_PERIOD_MS (2 * TTR_US)  // Minimum spacing between scheduled triggers, leaving room for a full read (in milliseconds).
+#define ADAPTIVE_PING_RATE 1            // Pace the belt's pings by how fast the target moves.
+#define KEEPALIVE_PERIOD_MS 1000        // Spacing between the belt's pings while the target is still (in milliseconds).
+#define ESPNOW_PHY_RATE phy_OFDM_6M     // PHY rate frames go to the peer at. Cuts a ping's airtime about six fold over the 1 Mbps default.
+#define STREAM_ACKS 1                   // Stream pings without per-ping replies, acking on frames going the other way.
+#define ECHO_CAPTURE_MCPWM 1            // Time ultrasonic echoes with the MCPWM capture unit, falling back to a GPIO interrupt when no channel is left.
+#define ONE_WAY_RANGING 1               // Range by the one-way flight from the belt's emission, rather than doubling the bot's echo width.
+#define RANGING_WAIT_MS 10              // Longest the bot waits for the belt's emission time once it has heard the burst (in milliseconds).
+#define RANGING_LATENCY_US 0            // Fixed part of arrival less emission that isn't flight, such as the bot detecting the burst (in microseconds). Calibrate on the bench.
+#define FOLLOW_DISTANCE_IN 36           // Distance the bot keeps from the belt until told otherwise (in inches).
+#define RX_BASELINE_IN 12.0f            // Distance between the bot's left and right receiving transducers (in inches).
+#define TDOA_SKEW_US 0                  // Fixed lag of the left receiver's arrivals over the right's, with the belt straight ahead (in microseconds). Calibrate on the bench.
+#define TRACK_PERIOD_MS 20              // Spacing between the target estimates handed to the drive system (in milliseconds).
+
+#define FAULT_INJECTION 0               // Inject link faults on the bench to see how ranging and following degrade.
+#define FAULT_SEED 1                    // Seed of the injected faults. The same seed repeats the same run.
+#define FAULT_DROP_PERCENT 5            // Chance a frame is lost on its own, each way (%).
+#define FAULT_BURST_PERCENT 1           // Chance a frame starts a burst of losses, each way (%).
+#define FAULT_BURST_FRAMES 4            // Mean frames lost per burst.
+#define FAULT_DELAY_PERCENT 5           // Chance a frame sent is held back (%).
+#define FAULT_DELAY_MAX_MS 30           // Longest a frame sent is held back (ms).
 
 /**
  * Identify which ESP32 SoC is in Use.